@@ -3,50 +3,1126 @@
 
 #include "stdafx.h"
 #include "../PeBinaryInfoLib/PeBinaryInfo.h"
+#include "../PeBinaryInfoLib/BatchScanner.h"
+#include "../PeBinaryInfoLib/ResultWriter.h"
+#include "../PeBinaryInfoLib/ScanIndex.h"
+#include "../PeBinaryInfoLib/SymbolIndex.h"
+#include "../PeBinaryInfoLib/DirectoryWatcher.h"
+#include "../PeBinaryInfoLib/DependencyGraph.h"
+#include "../PeBinaryInfoLib/ForwarderResolver.h"
 
 using namespace peinfo;
 
-int wmain(int argc, wchar_t* argv[])
+void PrintInfo(std::wostream& output, const std::wstring& filePath, const PeFileFormattedInfo& peInfo)
 {
-	if (argc < 2)
+	output << "File: " << filePath << std::endl;
+
+	for (const auto& category : peInfo.Categories)
 	{
+		output << L"========== " << category.Name << L" ==========" << std::endl;
+
+		for (const auto& item : category.Items)
+		{
+			output << item.Name << L": " << item.Value << std::endl;
+		}
+	}
+}
+
+// "-" reads the image from stdin front to back, without a temporary file
+std::unique_ptr<PeFileFormattedInfoExtractor> CreateExtractor(const std::wstring& filePath)
+{
+	if (filePath == L"-")
+	{
+#ifdef _WIN32
+		_setmode(_fileno(stdin), _O_BINARY);
+#endif
+		return std::make_unique<PeFileFormattedInfoExtractor>(std::make_unique<StreamPeImage>(std::cin));
+	}
+
+	return std::make_unique<PeFileFormattedInfoExtractor>(filePath);
+}
+
+int Run(const std::wstring& filePath)
+{
+	try
+	{
+		auto peInfoExtractor = CreateExtractor(filePath);
+		PeFileFormattedInfo peInfo = peInfoExtractor->Extract();
+
+		PrintInfo(std::wcout, filePath, peInfo);
+
+		//std::wcout << "Machine: " << peInfo.Machine << std::endl;
+
+		//std::wcout << "Architecture: " << peInfo.Architecture << std::endl;
+
+		//std::wcout << "TimeDateStamp: " << peInfo.TimeDateStamp << std::endl;
+
+		//std::wcout << "Subsystem: " << peInfo.Subsystem << std::endl;
+
+		//std::wcout << "Configuration: " << peInfo.Configuration << std::endl;
+
+		return 0;
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "Exception: " << e.what() << std::endl;
 		return 1;
 	}
+}
+
+struct BatchOptions
+{
+	BatchScanOptions Scan;
+	bool IsTextOutput = true;
+	OutputFormat Format = OutputFormat::JsonLines;  // used unless IsTextOutput
+	bool PrintIoStatistics = false;
+	std::wstring IndexPath;  // empty writes no index
+	std::wstring SymbolIndexPath;  // empty writes no symbol index; batch mode only
+	std::vector<std::wstring> Fields;  // empty selects every field
+	std::vector<FieldPredicate> Predicates;
+	std::chrono::milliseconds SettleTime = std::chrono::milliseconds(2000);  // watch mode only
+	std::vector<std::wstring> SearchDirectories;  // deps and exports modes only
+	bool PrintMissingOnly = false;                // deps mode only
+	std::wstring Symbol;                          // exports mode only
+	std::vector<std::wstring> Directories;
+	std::vector<std::wstring> FileLists;
+	std::vector<std::wstring> Files;
+};
+
+// Adds one UTF-8 path per line; "-" reads the list from stdin.
+void AddFilesFromList(BatchScanner& scanner, const std::wstring& listPath)
+{
+	std::ifstream listFile;
+	if (listPath != L"-")
+	{
+#ifdef _WIN32
+		listFile.open(listPath);
+#else
+		listFile.open(utf16_to_native_path(listPath));
+#endif
+		if (!listFile)
+		{
+			throw std::runtime_error("Failed to open the file list");
+		}
+	}
+
+	std::istream& list = listPath == L"-" ? std::cin : listFile;
+	std::string line;
+	while (std::getline(list, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+
+		if (!line.empty())
+		{
+			scanner.AddFile(native_path_to_utf16(line));
+		}
+	}
+}
+
+void AddInputs(BatchScanner& scanner, const BatchOptions& options)
+{
+	for (const auto& filePath : options.Files)
+	{
+		scanner.AddFile(filePath);
+	}
 
+	for (const auto& listPath : options.FileLists)
+	{
+		AddFilesFromList(scanner, listPath);
+	}
+
+	for (const auto& directory : options.Directories)
+	{
+		scanner.AddDirectory(directory);
+	}
+}
+
+// Returns no writer for text output
+std::unique_ptr<ResultWriter> CreateResultWriter(const BatchOptions& options)
+{
+	if (options.IsTextOutput)
+	{
+		return nullptr;
+	}
+
+#ifdef _WIN32
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	return ResultWriter::Create(options.Format, std::cout, options.Scan.Plan);
+}
+
+void WriteResult(ResultWriter* resultWriter, const BatchScanResult& result)
+{
+	if (resultWriter != nullptr)
+	{
+		resultWriter->Write(result);
+		return;
+	}
+
+	std::wostringstream output;
+	if (result.Succeeded)
+	{
+		PrintInfo(output, result.FilePath, result.Info);
+	}
+	else
+	{
+		output << L"File: " << result.FilePath << std::endl;
+		output << L"Exception: " << utf8_to_utf16(result.Error) << std::endl;
+	}
+
+	std::wcout << output.str() << std::flush;
+}
+
+void PrintStatistics(const BatchOptions& options, const BatchScanStatistics& statistics)
+{
+	std::wcerr << L"Extracted: " << statistics.Extracted
+		<< L", failed: " << statistics.Failed
+		<< L", skipped (not PE): " << statistics.Skipped;
+	if (!options.Scan.CachePath.empty())
+	{
+		std::wcerr << L", cache hits: " << statistics.CacheHits;
+	}
+
+	if (options.Scan.Deduplicate)
+	{
+		std::wcerr << L", duplicates: " << statistics.Duplicates;
+	}
+
+	if (!options.Predicates.empty())
+	{
+		std::wcerr << L", filtered: " << statistics.Filtered;
+	}
+
+	if (statistics.Unreported != 0)
+	{
+		std::wcerr << L", failed without output: " << statistics.Unreported;
+	}
+}
+
+int RunBatch(BatchOptions options)
+{
 	try
 	{
-		::CoInitializeEx(nullptr, COINITBASE_MULTITHREADED);
+		IoStatistics ioStatistics;
+		options.Scan.Io.Statistics = &ioStatistics;
+		options.Scan.Plan = ExtractionPlan(options.Fields, options.Predicates);
 
-		PeFileFormattedInfoExtractor peInfoExtractor(argv[1]);
-		PeFileFormattedInfo peInfo = peInfoExtractor.Extract();
+		auto resultWriter = CreateResultWriter(options);
 
-		std::wcout << "File: " << argv[1] << std::endl;
+		std::unique_ptr<ScanIndexWriter> indexWriter;
+		if (!options.IndexPath.empty())
+		{
+			indexWriter = std::make_unique<ScanIndexWriter>();
+		}
 
-		for (const auto& category : peInfo.Categories)
+		std::unique_ptr<SymbolIndexWriter> symbolIndexWriter;
+		if (!options.SymbolIndexPath.empty())
 		{
-			std::wcout << L"========== " << category.Name << L" ==========" << std::endl;
+			symbolIndexWriter = std::make_unique<SymbolIndexWriter>();
+			options.Scan.ImageVisitor = [&symbolIndexWriter](const std::wstring& filePath, PeFileInfoExtractor& extractor)
+			{
+				symbolIndexWriter->Add(filePath, extractor.GetImports());
+			};
+		}
 
-			for (const auto& item : category.Items)
+		BatchScanner scanner(options.Scan, [&resultWriter, &indexWriter](const BatchScanResult& result)
+		{
+			if (indexWriter)
 			{
-				std::wcout << item.Name << L": " << item.Value << std::endl;
+				indexWriter->Add(result);
 			}
+
+			WriteResult(resultWriter.get(), result);
+		});
+
+		AddInputs(scanner, options);
+		auto statistics = scanner.Finish();
+		if (resultWriter)
+		{
+			resultWriter->Flush();
 		}
 
-		//std::wcout << "Machine: " << peInfo.Machine << std::endl;
+		if (indexWriter)
+		{
+			indexWriter->Write(options.IndexPath);
+		}
 
-		//std::wcout << "Architecture: " << peInfo.Architecture << std::endl;
+		if (symbolIndexWriter)
+		{
+			symbolIndexWriter->Write(options.SymbolIndexPath);
+		}
 
-		//std::wcout << "TimeDateStamp: " << peInfo.TimeDateStamp << std::endl;
+		PrintStatistics(options, statistics);
+		std::wcerr << std::endl;
 
-		//std::wcout << "Subsystem: " << peInfo.Subsystem << std::endl;
+		if (options.PrintIoStatistics)
+		{
+			std::wcerr << L"Buffered: " << ioStatistics.BufferedFiles
+				<< L", mapped: " << ioStatistics.MappedFiles
+				<< L", ranged: " << ioStatistics.RangedFiles
+				<< L", reads: " << ioStatistics.ReadCalls
+				<< L", bytes read: " << ioStatistics.BytesRead << std::endl;
+		}
 
-		//std::wcout << "Configuration: " << peInfo.Configuration << std::endl;
+		return statistics.Failed == 0 && statistics.Unreported == 0 ? 0 : 1;
+	}
+	catch (const std::exception& e)
+	{
+		std::wcerr << L"Exception: " << utf8_to_utf16(e.what()) << std::endl;
+		return 1;
+	}
+}
+
+bool IsPathBelow(const std::wstring& path, const std::wstring& directoryPath)
+{
+	return path.compare(0, directoryPath.size(), directoryPath) == 0
+		&& (path.size() == directoryPath.size() || path[directoryPath.size()] == L'/' || path[directoryPath.size()] == L'\\');
+}
+
+// The watch index is written whole again once its delta holds more than this fraction of its
+// rows; until then a rescan writes only the files that changed since, and queries read little
+// more than the index itself
+const std::size_t IndexDeltaDivisor = 8;
+
+// Scans the directories, then rescans whatever changes below them until the process is stopped.
+// Every rescan updates the cache in place and writes the changes to the delta of the index, and
+// files that were reported before but are gone, or are no longer PE images, are reported as removed.
+int RunWatch(BatchOptions options)
+{
+	try
+	{
+		options.Scan.Plan = ExtractionPlan(options.Fields, options.Predicates);
+		auto resultWriter = CreateResultWriter(options);
+
+		// Subscribed before the first scan, so nothing that changes during it is missed
+		DirectoryWatcher watcher(options.Directories, options.SettleTime);
+
+		// Reported files; results are kept whole only when the index is written from them
+		std::map<std::wstring, BatchScanResult> results;
+		std::set<std::wstring> staleFiles;
+
+		// Rows of the index file, and the files reported or removed since it was written, which
+		// make up its delta with the rows they replace
+		std::unordered_map<std::wstring, std::uint64_t> indexRows;
+		std::uint64_t indexGeneration = 0;
+		std::set<std::wstring> changedFiles;
+		std::set<std::uint64_t> removedRows;
+
+		auto scan = [&](const std::function<void(BatchScanner&)>& addFiles)
+		{
+			BatchScanner scanner(options.Scan, [&](const BatchScanResult& result)
+			{
+				WriteResult(resultWriter.get(), result);
+				staleFiles.erase(result.FilePath);
+				results[result.FilePath] = options.IndexPath.empty()
+					? BatchScanResult{ result.FilePath, result.Succeeded, PeFileFormattedInfo(), std::string() }
+					: result;
+				if (!options.IndexPath.empty())
+				{
+					changedFiles.insert(result.FilePath);
+				}
+			});
+
+			addFiles(scanner);
+			auto statistics = scanner.Finish();
+
+			for (const auto& filePath : staleFiles)
+			{
+				results.erase(filePath);
+				changedFiles.erase(filePath);
+				if (resultWriter)
+				{
+					resultWriter->WriteRemoved(filePath);
+				}
+				else
+				{
+					std::wcout << L"Removed: " << filePath << std::endl;
+				}
+			}
+
+			if (resultWriter)
+			{
+				resultWriter->Flush();
+			}
+
+			if (!options.IndexPath.empty())
+			{
+				for (const auto* filePaths : { &changedFiles, &staleFiles })
+				{
+					for (const auto& filePath : *filePaths)
+					{
+						auto row = indexRows.find(filePath);
+						if (row != indexRows.end())
+						{
+							removedRows.insert(row->second);
+						}
+					}
+				}
+
+				if (indexGeneration == 0 || changedFiles.size() + removedRows.size() > indexRows.size() / IndexDeltaDivisor)
+				{
+					ScanIndexWriter indexWriter;
+					indexRows.clear();
+					for (const auto& result : results)
+					{
+						if (result.second.Succeeded)
+						{
+							indexRows.emplace(result.first, static_cast<std::uint64_t>(indexRows.size()));
+						}
+
+						indexWriter.Add(result.second);
+					}
+
+					indexGeneration = indexWriter.Write(options.IndexPath);
+					changedFiles.clear();
+					removedRows.clear();
+				}
+				else
+				{
+					ScanIndexWriter deltaWriter;
+					for (const auto& filePath : changedFiles)
+					{
+						deltaWriter.Add(results[filePath]);
+					}
+
+					for (auto row : removedRows)
+					{
+						deltaWriter.Remove(row);
+					}
+
+					deltaWriter.WriteDelta(options.IndexPath, indexGeneration, indexRows.size());
+				}
+			}
+
+			PrintStatistics(options, statistics);
+			std::wcerr << L", removed: " << staleFiles.size() << std::endl;
+			staleFiles.clear();
+		};
+
+		scan([&options](BatchScanner& scanner)
+		{
+			for (const auto& directory : options.Directories)
+			{
+				scanner.AddDirectory(directory);
+			}
+		});
+
+		for (;;)
+		{
+			auto changes = watcher.WaitForChanges(std::chrono::hours(1));
+			if (changes.empty())
+			{
+				continue;
+			}
+
+			// Everything that was reported below a changed path has to be reported again or is gone
+			for (const auto& change : changes)
+			{
+				// Paths below a directory sort among the others that start with its name, such as "dir-1"
+				for (auto i = results.lower_bound(change.Path); i != results.end() && i->first.compare(0, change.Path.size(), change.Path) == 0; ++i)
+				{
+					if (change.Kind == DirectoryChangeKind::Overflow || IsPathBelow(i->first, change.Path))
+					{
+						staleFiles.insert(i->first);
+					}
+				}
+			}
+
+			scan([&options, &changes](BatchScanner& scanner)
+			{
+				for (const auto& change : changes)
+				{
+					if (change.Kind == DirectoryChangeKind::Overflow)
+					{
+						for (const auto& directory : options.Directories)
+						{
+							scanner.AddDirectory(directory);
+						}
+					}
+					else if (change.Kind == DirectoryChangeKind::Changed)
+					{
+						if (change.IsDirectory)
+						{
+							scanner.AddDirectory(change.Path);
+						}
+						else
+						{
+							scanner.AddFile(change.Path);
+						}
+					}
+				}
+			});
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::wcerr << L"Exception: " << utf8_to_utf16(e.what()) << std::endl;
+		return 1;
+	}
+}
+
+// The module names of a list field of a projected result, such as imports
+std::vector<std::wstring> GetModuleList(const PeFileFormattedInfo& info, const wchar_t* field)
+{
+	std::vector<std::wstring> modules;
+	for (const auto& item : info.Categories.front().Items)
+	{
+		if (item.Name != field)
+		{
+			continue;
+		}
+
+		for (std::size_t start = 0; start < item.Value.size();)
+		{
+			auto separator = item.Value.find(L", ", start);
+			auto end = separator == std::wstring::npos ? item.Value.size() : separator;
+			modules.push_back(item.Value.substr(start, end - start));
+			start = end + 2;
+		}
+	}
+
+	return modules;
+}
+
+const char* FormatResolution(DependencyResolution resolution)
+{
+	switch (resolution)
+	{
+	case DependencyResolution::Scanned:
+		return "scanned";
+	case DependencyResolution::Listed:
+		return "listed";
+	case DependencyResolution::ApiSet:
+		return "apiset";
+	default:
+		return "missing";
+	}
+}
+
+// On Windows the system directory is searched unless search directories are given
+void AddDefaultSearchDirectories(BatchOptions& options)
+{
+#ifdef _WIN32
+	if (options.SearchDirectories.empty())
+	{
+		wchar_t systemDirectory[MAX_PATH];
+		auto length = GetSystemDirectoryW(systemDirectory, MAX_PATH);
+		if (length != 0 && length < MAX_PATH)
+		{
+			options.SearchDirectories.push_back(systemDirectory);
+		}
+	}
+#else
+	(void)options;
+#endif
+}
+
+// Scans the files for their imports and prints one tab-separated UTF-8 line per imported module:
+// the importer, the module name, import or delay, the resolution and the resolved path.
+int RunDependencies(BatchOptions options)
+{
+	try
+	{
+		options.Scan.Plan = ExtractionPlan({ L"imports", L"delayimports" }, options.Predicates);
+		AddDefaultSearchDirectories(options);
+
+		DependencyGraph graph(options.SearchDirectories);
+		BatchScanner scanner(options.Scan, [&graph](const BatchScanResult& result)
+		{
+			if (result.Succeeded)
+			{
+				graph.AddModule(result.FilePath, GetModuleList(result.Info, L"imports"), GetModuleList(result.Info, L"delayimports"));
+			}
+			else
+			{
+				std::wcerr << L"File: " << result.FilePath << std::endl;
+				std::wcerr << L"Exception: " << utf8_to_utf16(result.Error) << std::endl;
+			}
+		});
+
+		AddInputs(scanner, options);
+		auto statistics = scanner.Finish();
+
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		std::string output = "importer\tmodule\tkind\tresolution\tpath\n";
+		std::uint64_t dependencyCount = 0;
+		std::uint64_t missingCount = 0;
+		graph.Resolve([&](const ModuleDependency& dependency)
+		{
+			++dependencyCount;
+			if (dependency.Resolution == DependencyResolution::Missing)
+			{
+				++missingCount;
+			}
+			else if (options.PrintMissingOnly)
+			{
+				return;
+			}
 
+			output.append(utf16_to_native_path(dependency.Importer)).push_back('\t');
+			output.append(utf16_to_utf8(dependency.Name)).push_back('\t');
+			output.append(dependency.IsDelayLoaded ? "delay" : "import").push_back('\t');
+			output.append(FormatResolution(dependency.Resolution)).push_back('\t');
+			output.append(utf16_to_native_path(dependency.ResolvedPath)).push_back('\n');
+
+			if (output.size() >= 1024 * 1024)
+			{
+				std::cout.write(output.data(), static_cast<std::streamsize>(output.size()));
+				output.clear();
+			}
+		});
+
+		std::cout.write(output.data(), static_cast<std::streamsize>(output.size()));
+		std::cout.flush();
+
+		PrintStatistics(options, statistics);
+		std::wcerr << L", modules: " << graph.GetModuleCount() << L", dependencies: " << dependencyCount
+			<< L", missing: " << missingCount << std::endl;
+		return statistics.Failed == 0 && statistics.Unreported == 0 ? 0 : 1;
+	}
+	catch (const std::exception& e)
+	{
+		std::wcerr << L"Exception: " << utf8_to_utf16(e.what()) << std::endl;
+		return 1;
+	}
+}
+
+const char* FormatResolution(const ResolvedForwarder& resolved)
+{
+	switch (resolved.Resolution)
+	{
+	case ForwarderResolution::Exported:
+		return resolved.Hops == 0 ? "exported" : "forwarded";
+	case ForwarderResolution::ApiSet:
+		return "apiset";
+	case ForwarderResolution::ModuleMissing:
+		return "modulemissing";
+	case ForwarderResolution::ExportMissing:
+		return "exportmissing";
+	default:
+		return "toolong";
+	}
+}
+
+std::string FormatRva(DWORD rva)
+{
+	std::ostringstream text;
+	text << "0x" << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << rva;
+	return text.str();
+}
+
+// Scans the files for the images that export the symbol and prints one tab-separated UTF-8 line
+// for each: the file, the export, its ordinal and forwarder, and where its forwarder chain ends.
+// The lookup is a predicate of the extraction plan, so it runs on the scanner threads; only the
+// images that match are opened again to follow their forwarders.
+int RunExports(BatchOptions options)
+{
+	try
+	{
+		options.Predicates.push_back(FieldPredicate{ L"exports", PredicateOperator::Equal, options.Symbol });
+		options.Scan.Plan = ExtractionPlan({ L"exportname" }, options.Predicates);
+		AddDefaultSearchDirectories(options);
+
+		std::vector<std::wstring> matches;
+		BatchScanner scanner(options.Scan, [&matches](const BatchScanResult& result)
+		{
+			if (result.Succeeded)
+			{
+				matches.push_back(result.FilePath);
+			}
+			else
+			{
+				std::wcerr << L"File: " << result.FilePath << std::endl;
+				std::wcerr << L"Exception: " << utf8_to_utf16(result.Error) << std::endl;
+			}
+		});
+
+		AddInputs(scanner, options);
+		auto statistics = scanner.Finish();
+		std::sort(matches.begin(), matches.end());
+
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		auto symbol = utf16_to_utf8(options.Symbol);
+		ForwarderResolver resolver(options.SearchDirectories);
+		std::string output = "file\tsymbol\tordinal\tforwarder\tresolution\ttarget\ttargetsymbol\trva\n";
+		for (const auto& filePath : matches)
+		{
+			try
+			{
+				// The file may have changed since it was scanned
+				PeFileInfoExtractor extractor(filePath);
+				Export exported;
+				if (!extractor.GetExports().TryFind(Span<const char>(symbol.data(), symbol.size()), exported))
+				{
+					continue;
+				}
+
+				auto resolved = resolver.Resolve(filePath, exported);
+				output.append(utf16_to_native_path(filePath)).push_back('\t');
+				output.append(symbol).push_back('\t');
+				output.append(std::to_string(exported.Ordinal)).push_back('\t');
+				output.append(exported.Forwarder.begin(), exported.Forwarder.end()).push_back('\t');
+				output.append(FormatResolution(resolved)).push_back('\t');
+				output.append(utf16_to_native_path(resolved.FilePath)).push_back('\t');
+				output.append(resolved.Module.empty() ? resolved.Symbol : resolved.Module + "." + resolved.Symbol).push_back('\t');
+				output.append(resolved.Resolution == ForwarderResolution::Exported ? FormatRva(resolved.Rva) : std::string()).push_back('\n');
+			}
+			catch (const std::exception& e)
+			{
+				std::wcerr << L"File: " << filePath << std::endl;
+				std::wcerr << L"Exception: " << utf8_to_utf16(e.what()) << std::endl;
+			}
+		}
+
+		std::cout.write(output.data(), static_cast<std::streamsize>(output.size()));
+		std::cout.flush();
+
+		PrintStatistics(options, statistics);
+		std::wcerr << L", matches: " << matches.size() << L", forwarded modules: " << resolver.GetLoadedModuleCount() << std::endl;
+		return statistics.Failed == 0 && statistics.Unreported == 0 ? 0 : 1;
+	}
+	catch (const std::exception& e)
+	{
+		std::wcerr << L"Exception: " << utf8_to_utf16(e.what()) << std::endl;
+		return 1;
+	}
+}
+
+void PrintUsage()
+{
+	std::wcerr << L"Usage: PeBinaryInfo <file|->" << std::endl;
+	std::wcerr << L"       PeBinaryInfo [--threads <count>] [--sync-io] [--small-file-threshold <bytes>] [--large-file-threshold <bytes>] [--io-stats]" << std::endl;
+	std::wcerr << L"                    [--cache <file>] [--cache-size <bytes>] [--dedupe] [--format <text|jsonl|csv|tsv>] [--index <file>]" << std::endl;
+	std::wcerr << L"                    [--symbol-index <file>]" << std::endl;
+	std::wcerr << L"                    [--fields <field>[,<field>]...] [--where <predicate>]..." << std::endl;
+	std::wcerr << L"                    [--recursive <directory>]... [--files-from <list|->]... [file]..." << std::endl;
+	std::wcerr << L"       PeBinaryInfo watch [--debounce <milliseconds>] [batch options] <directory>..." << std::endl;
+	std::wcerr << L"       PeBinaryInfo deps [--search-path <directory>]... [--missing] [batch options]" << std::endl;
+	std::wcerr << L"       PeBinaryInfo exports --symbol <name|#ordinal> [--search-path <directory>]... [batch options]" << std::endl;
+	std::wcerr << L"       PeBinaryInfo query <index> [--where <predicate>]... [--count]" << std::endl;
+	std::wcerr << L"       PeBinaryInfo query-symbols <symbol index> [--symbol <function|module!function>]... [--module <module>]... [--count]" << std::endl;
+	std::wcerr << L"A predicate is <field><=|!=|~|<|<=|>|>=><value>, such as aslr=no or timestamp>=1500000000." << std::endl;
+}
+
+// Prints the UTF-8 paths of the matching rows, or only their number
+int RunQuery(const std::vector<std::wstring>& arguments)
+{
+	std::wstring indexPath;
+	std::vector<FieldPredicate> predicates;
+	bool printCountOnly = false;
+	for (std::size_t i = 0; i < arguments.size(); ++i)
+	{
+		const auto& argument = arguments[i];
+		FieldPredicate predicate;
+		if (argument == L"--where" && i + 1 < arguments.size() && TryParsePredicate(arguments[i + 1], predicate))
+		{
+			predicates.push_back(predicate);
+			++i;
+		}
+		else if (argument == L"--count")
+		{
+			printCountOnly = true;
+		}
+		else if (argument.compare(0, 2, L"--") != 0 && indexPath.empty())
+		{
+			indexPath = argument;
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (indexPath.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	try
+	{
+		ScanIndex index(indexPath);
+
+		auto start = std::chrono::steady_clock::now();
+		auto matches = index.Evaluate(predicates);
+		auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+		std::uint64_t matchCount = 0;
+		for (auto word : matches)
+		{
+			matchCount += std::bitset<64>(word).count();
+		}
+
+		if (!printCountOnly)
+		{
+#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+			std::string output;
+			for (std::size_t word = 0; word < matches.size(); ++word)
+			{
+				for (std::uint64_t bits = matches[word], bit = 0; bits != 0; bits >>= 1, ++bit)
+				{
+					if ((bits & 1) != 0)
+					{
+						auto path = index.GetPath(word * 64 + bit);
+						output.append(path.data(), path.size());
+						output.push_back('\n');
+					}
+				}
+
+				if (output.size() >= 1024 * 1024)
+				{
+					std::cout.write(output.data(), static_cast<std::streamsize>(output.size()));
+					output.clear();
+				}
+			}
+
+			std::cout.write(output.data(), static_cast<std::streamsize>(output.size()));
+			std::cout.flush();
+		}
+		else
+		{
+			std::wcout << matchCount << std::endl;
+		}
+
+		std::wcerr << L"Matched: " << matchCount << L" of " << index.GetRowCount()
+			<< L" in " << elapsed.count() << L" ms" << std::endl;
 		return 0;
 	}
 	catch (const std::exception& e)
 	{
-		std::cout << "Exception: " << e.what() << std::endl;
+		std::wcerr << L"Exception: " << utf8_to_utf16(e.what()) << std::endl;
+		return 1;
+	}
+}
+
+// Prints the UTF-8 paths of the files that import every symbol and module, or only their number
+int RunQuerySymbols(const std::vector<std::wstring>& arguments)
+{
+	std::wstring indexPath;
+	std::vector<std::string> functions;
+	std::vector<std::string> modules;
+	bool printCountOnly = false;
+	for (std::size_t i = 0; i < arguments.size(); ++i)
+	{
+		const auto& argument = arguments[i];
+		bool hasValue = i + 1 < arguments.size();
+		if (argument == L"--symbol" && hasValue)
+		{
+			functions.push_back(utf16_to_native_path(arguments[++i]));
+		}
+		else if (argument == L"--module" && hasValue)
+		{
+			modules.push_back(utf16_to_native_path(arguments[++i]));
+		}
+		else if (argument == L"--count")
+		{
+			printCountOnly = true;
+		}
+		else if (argument.compare(0, 2, L"--") != 0 && indexPath.empty())
+		{
+			indexPath = argument;
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (indexPath.empty() || (functions.empty() && modules.empty()))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	try
+	{
+		SymbolIndex index(indexPath);
+
+		// Posting lists are sorted, so the files that have every term are their running intersection
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::uint32_t> matches;
+		bool isFirst = true;
+		auto intersect = [&matches, &isFirst](std::vector<std::uint32_t> fileIds)
+		{
+			if (isFirst)
+			{
+				matches = std::move(fileIds);
+				isFirst = false;
+				return;
+			}
+
+			std::vector<std::uint32_t> common;
+			std::set_intersection(matches.begin(), matches.end(), fileIds.begin(), fileIds.end(), std::back_inserter(common));
+			matches = std::move(common);
+		};
+
+		for (const auto& module : modules)
+		{
+			intersect(index.FindModule(module));
+		}
+
+		for (const auto& function : functions)
+		{
+			intersect(index.FindFunction(function));
+		}
+
+		auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+		if (!printCountOnly)
+		{
+#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+			std::string output;
+			for (auto fileId : matches)
+			{
+				auto path = index.GetPath(fileId);
+				output.append(path.data(), path.size());
+				output.push_back('\n');
+				if (output.size() >= 1024 * 1024)
+				{
+					std::cout.write(output.data(), static_cast<std::streamsize>(output.size()));
+					output.clear();
+				}
+			}
+
+			std::cout.write(output.data(), static_cast<std::streamsize>(output.size()));
+			std::cout.flush();
+		}
+		else
+		{
+			std::wcout << matches.size() << std::endl;
+		}
+
+		std::wcerr << L"Matched: " << matches.size() << L" of " << index.GetFileCount()
+			<< L" in " << elapsed.count() << L" ms" << std::endl;
+		return 0;
+	}
+	catch (const std::exception& e)
+	{
+		std::wcerr << L"Exception: " << utf8_to_utf16(e.what()) << std::endl;
+		return 1;
+	}
+}
+
+int RunCommandLine(const std::vector<std::wstring>& commandLine)
+{
+	if (!commandLine.empty() && commandLine[0] == L"query")
+	{
+		return RunQuery(std::vector<std::wstring>(commandLine.begin() + 1, commandLine.end()));
+	}
+
+	if (!commandLine.empty() && commandLine[0] == L"query-symbols")
+	{
+		return RunQuerySymbols(std::vector<std::wstring>(commandLine.begin() + 1, commandLine.end()));
+	}
+
+	if (commandLine.size() == 1 && commandLine[0].compare(0, 2, L"--") != 0)
+	{
+		return Run(commandLine[0]);
+	}
+
+	// "--option=value" is the same as "--option value"
+	std::vector<std::wstring> arguments;
+	for (const auto& argument : commandLine)
+	{
+		auto separator = argument.find(L'=');
+		if (argument.compare(0, 2, L"--") == 0 && separator != std::wstring::npos)
+		{
+			arguments.push_back(argument.substr(0, separator));
+			arguments.push_back(argument.substr(separator + 1));
+		}
+		else
+		{
+			arguments.push_back(argument);
+		}
+	}
+
+	BatchOptions options;
+	bool isWatch = !arguments.empty() && arguments[0] == L"watch";
+	bool isDependencies = !arguments.empty() && arguments[0] == L"deps";
+	bool isExports = !arguments.empty() && arguments[0] == L"exports";
+	for (std::size_t i = isWatch || isDependencies || isExports ? 1 : 0; i < arguments.size(); ++i)
+	{
+		const auto& argument = arguments[i];
+		bool hasValue = i + 1 < arguments.size();
+		if (argument == L"--recursive" && hasValue)
+		{
+			options.Directories.push_back(arguments[++i]);
+		}
+		else if (argument == L"--files-from" && hasValue)
+		{
+			options.FileLists.push_back(arguments[++i]);
+		}
+		else if (argument == L"--threads" && hasValue)
+		{
+			options.Scan.ThreadCount = std::wcstoul(arguments[++i].c_str(), nullptr, 10);
+		}
+		else if (argument == L"--sync-io")
+		{
+			options.Scan.UseAsyncIo = false;
+		}
+		else if (argument == L"--small-file-threshold" && hasValue)
+		{
+			options.Scan.Io.SmallFileThreshold = std::wcstoull(arguments[++i].c_str(), nullptr, 10);
+		}
+		else if (argument == L"--large-file-threshold" && hasValue)
+		{
+			options.Scan.Io.LargeFileThreshold = std::wcstoull(arguments[++i].c_str(), nullptr, 10);
+		}
+		else if (argument == L"--cache" && hasValue)
+		{
+			options.Scan.CachePath = arguments[++i];
+		}
+		else if (argument == L"--cache-size" && hasValue)
+		{
+			options.Scan.CacheMaxSize = std::wcstoull(arguments[++i].c_str(), nullptr, 10);
+		}
+		else if (argument == L"--dedupe")
+		{
+			options.Scan.Deduplicate = true;
+		}
+		else if (argument == L"--format" && hasValue)
+		{
+			const auto& format = arguments[++i];
+			options.IsTextOutput = format == L"text";
+			if (!options.IsTextOutput && !TryParseOutputFormat(format, options.Format))
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (argument == L"--index" && hasValue)
+		{
+			options.IndexPath = arguments[++i];
+		}
+		else if (argument == L"--symbol-index" && hasValue)
+		{
+			options.SymbolIndexPath = arguments[++i];
+		}
+		else if (argument == L"--fields" && hasValue)
+		{
+			std::wistringstream fields(arguments[++i]);
+			for (std::wstring field; std::getline(fields, field, L',');)
+			{
+				options.Fields.push_back(field);
+			}
+		}
+		else if (argument == L"--where" && hasValue)
+		{
+			FieldPredicate predicate;
+			if (!TryParsePredicate(arguments[++i], predicate))
+			{
+				PrintUsage();
+				return 1;
+			}
+
+			options.Predicates.push_back(predicate);
+		}
+		else if (argument == L"--debounce" && hasValue && isWatch)
+		{
+			options.SettleTime = std::chrono::milliseconds(std::wcstoul(arguments[++i].c_str(), nullptr, 10));
+		}
+		else if (argument == L"--search-path" && hasValue && (isDependencies || isExports))
+		{
+			options.SearchDirectories.push_back(arguments[++i]);
+		}
+		else if (argument == L"--missing" && isDependencies)
+		{
+			options.PrintMissingOnly = true;
+		}
+		else if (argument == L"--symbol" && hasValue && isExports)
+		{
+			options.Symbol = arguments[++i];
+		}
+		else if (argument == L"--io-stats")
+		{
+			options.PrintIoStatistics = true;
+		}
+		else if (argument.compare(0, 2, L"--") == 0)
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+		{
+			options.Files.push_back(argument);
+		}
+	}
+
+	if (isWatch)
+	{
+		options.Directories.insert(options.Directories.end(), options.Files.begin(), options.Files.end());
+		options.Files.clear();
+		if (options.Directories.empty() || !options.FileLists.empty())
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	// The index needs every field of every result, and the dependency graph and the export lookup write their own output.
+	// The symbol index is built from the images, which are only opened for the first file of a deduplicated content.
+	if ((options.Directories.empty() && options.FileLists.empty() && options.Files.empty())
+		|| (!options.IndexPath.empty() && !options.Fields.empty())
+		|| (!options.SymbolIndexPath.empty() && (isWatch || isDependencies || isExports || options.Scan.Deduplicate))
+		|| ((isDependencies || isExports) && (!options.IndexPath.empty() || !options.Fields.empty() || !options.IsTextOutput))
+		|| (isExports && options.Symbol.empty()))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (isDependencies)
+	{
+		return RunDependencies(options);
+	}
+
+	if (isExports)
+	{
+		return RunExports(options);
+	}
+
+	return isWatch ? RunWatch(options) : RunBatch(options);
+}
+
+#ifdef _WIN32
+int wmain(int argc, wchar_t* argv[])
+{
+	if (argc < 2)
+	{
+		return 1;
+	}
+
+	return RunCommandLine(std::vector<std::wstring>(argv + 1, argv + argc));
+}
+#else
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
 		return 1;
 	}
+
+	std::setlocale(LC_ALL, "");
+
+	std::vector<std::wstring> arguments;
+	for (int i = 1; i < argc; ++i)
+	{
+		arguments.push_back(native_path_to_utf16(argv[i]));
+	}
+
+	return RunCommandLine(arguments);
 }
+#endif
@@ -5,10 +5,12 @@
 
 #pragma once
 
+#ifdef _WIN32
 #include "targetver.h"
 
 #include <stdio.h>
 #include <tchar.h>
+#endif
 
 
 
@@ -17,4 +19,33 @@
 #include <string>
 #include <vector>
 #include <ctime>
-#include <windows.h>
\ No newline at end of file
+#include <cstdint>
+#include <clocale>
+#include <locale>
+#include <codecvt>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <chrono>
+#include <bitset>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include "../PeBinaryInfoLib/WinTypes.h"
+#endif
\ No newline at end of file
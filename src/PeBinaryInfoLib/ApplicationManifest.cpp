@@ -0,0 +1,176 @@
+#include "stdafx.h"
+#include "ApplicationManifest.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		// The markup of a manifest is ASCII, so UTF-16 is narrowed by dropping the high bytes
+		std::string GetManifestText(Span<const std::uint8_t> manifest)
+		{
+			if (manifest.size() >= 2 && manifest[0] == 0xFF && manifest[1] == 0xFE)
+			{
+				std::string text;
+				text.reserve(manifest.size() / 2);
+				for (std::size_t i = 2; i + 1 < manifest.size(); i += 2)
+				{
+					text.push_back(manifest[i + 1] == 0 ? static_cast<char>(manifest[i]) : '?');
+				}
+
+				return text;
+			}
+
+			std::size_t start = manifest.size() >= 3 && manifest[0] == 0xEF && manifest[1] == 0xBB && manifest[2] == 0xBF ? 3 : 0;
+			return std::string(reinterpret_cast<const char*>(manifest.data()) + start, manifest.size() - start);
+		}
+
+		bool IsNameCharacter(char character)
+		{
+			return std::isalnum(static_cast<unsigned char>(character)) || character == '_' || character == '-' || character == '.' || character == ':';
+		}
+
+		// The name without a namespace prefix, such as asmv3:
+		std::string GetLocalName(const std::string& name)
+		{
+			auto colon = name.rfind(':');
+			return colon == std::string::npos ? name : name.substr(colon + 1);
+		}
+
+		struct Tag
+		{
+			std::string Name;
+			bool IsEnd;
+			std::map<std::string, std::string> Attributes;
+		};
+
+		// position is just past the '<'; on return it is just past the '>'
+		Tag ReadTag(const std::string& text, std::size_t& position)
+		{
+			Tag tag{ std::string(), false, {} };
+			if (position < text.size() && text[position] == '/')
+			{
+				tag.IsEnd = true;
+				++position;
+			}
+
+			auto nameStart = position;
+			while (position < text.size() && IsNameCharacter(text[position]))
+			{
+				++position;
+			}
+
+			tag.Name = GetLocalName(text.substr(nameStart, position - nameStart));
+
+			while (position < text.size() && text[position] != '>')
+			{
+				if (!IsNameCharacter(text[position]))
+				{
+					++position;
+					continue;
+				}
+
+				auto attributeStart = position;
+				while (position < text.size() && IsNameCharacter(text[position]))
+				{
+					++position;
+				}
+
+				auto attribute = GetLocalName(text.substr(attributeStart, position - attributeStart));
+				while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position])))
+				{
+					++position;
+				}
+
+				if (position >= text.size() || text[position] != '=')
+				{
+					continue;
+				}
+
+				++position;
+				while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position])))
+				{
+					++position;
+				}
+
+				if (position >= text.size() || (text[position] != '"' && text[position] != '\''))
+				{
+					continue;
+				}
+
+				auto quote = text[position++];
+				auto valueEnd = text.find(quote, position);
+				if (valueEnd == std::string::npos)
+				{
+					valueEnd = text.size();
+				}
+
+				tag.Attributes[attribute] = text.substr(position, valueEnd - position);
+				position = std::min(valueEnd + 1, text.size());
+			}
+
+			if (position < text.size())
+			{
+				++position;
+			}
+
+			return tag;
+		}
+	}
+
+	ApplicationManifest ParseApplicationManifest(Span<const std::uint8_t> manifest)
+	{
+		ApplicationManifest result;
+		auto text = GetManifestText(manifest);
+
+		int dependentAssemblyDepth = 0;
+		for (auto position = text.find('<'); position != std::string::npos; position = text.find('<', position))
+		{
+			++position;
+			if (text.compare(position, 3, "!--") == 0)
+			{
+				auto commentEnd = text.find("-->", position);
+				position = commentEnd == std::string::npos ? text.size() : commentEnd + 3;
+				continue;
+			}
+
+			if (position < text.size() && (text[position] == '?' || text[position] == '!'))
+			{
+				continue;
+			}
+
+			auto tag = ReadTag(text, position);
+			if (tag.Name == "dependentAssembly")
+			{
+				bool isEmptyElement = position >= 2 && text[position - 2] == '/';
+				if (tag.IsEnd)
+				{
+					dependentAssemblyDepth = std::max(dependentAssemblyDepth - 1, 0);
+				}
+				else if (!isEmptyElement)
+				{
+					++dependentAssemblyDepth;
+				}
+			}
+			else if (tag.IsEnd)
+			{
+				continue;
+			}
+			else if (tag.Name == "assemblyIdentity" && dependentAssemblyDepth > 0)
+			{
+				auto name = tag.Attributes.find("name");
+				if (name != tag.Attributes.end())
+				{
+					result.Dependencies.push_back(name->second);
+				}
+			}
+			else if (tag.Name == "requestedExecutionLevel" && result.RequestedExecutionLevel.empty())
+			{
+				result.RequestedExecutionLevel = tag.Attributes["level"];
+				auto uiAccess = tag.Attributes["uiAccess"];
+				result.UiAccess = uiAccess == "true" || uiAccess == "True" || uiAccess == "TRUE";
+			}
+		}
+
+		return result;
+	}
+}
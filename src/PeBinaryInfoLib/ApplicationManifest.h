@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Helpers.h"
+
+namespace peinfo
+{
+	// What is read from an RT_MANIFEST resource. The manifest is scanned for the elements below
+	// rather than parsed as XML, so a malformed manifest yields what could be found in it.
+	struct ApplicationManifest
+	{
+		// asInvoker, highestAvailable or requireAdministrator; empty when the manifest requests none
+		std::string RequestedExecutionLevel;
+		bool UiAccess = false;
+
+		// The names of the dependentAssembly identities, such as Microsoft.Windows.Common-Controls
+		std::vector<std::string> Dependencies;
+	};
+
+	// Accepts UTF-8, with or without a byte order mark, and UTF-16LE with one.
+	ApplicationManifest ParseApplicationManifest(Span<const std::uint8_t> manifest);
+}
@@ -0,0 +1,405 @@
+#include "stdafx.h"
+#include "PeBinaryInfo.h"
+#include "AsyncHeaderFetcher.h"
+
+#ifdef __linux__
+namespace peinfo
+{
+	namespace
+	{
+		enum FetchOperation : std::uint64_t
+		{
+			OpenOperation,
+			StatOperation,
+			ReadOperation
+		};
+
+		const unsigned OperationBits = 2;
+
+		// Queued submissions are passed to the kernel in batches of this size, or earlier when waiting
+		const unsigned SubmitBatchSize = 32;
+
+		// Linux transfers at most this many bytes in one read, so larger files are never read whole
+		const std::uint64_t MaxReadSize = 0x7ffff000;
+
+		std::uint64_t MakeUserData(std::size_t slot, FetchOperation operation)
+		{
+			return (static_cast<std::uint64_t>(slot) << OperationBits) | operation;
+		}
+
+		template<class T>
+		T* RingPointer(void* ring, std::uint32_t offset)
+		{
+			return AddOffset<T>(ring, offset);
+		}
+	}
+
+	AsyncHeaderFetcher::AsyncHeaderFetcher(std::size_t maxFilesInFlight, std::uint32_t headerSize, const IoOptions& ioOptions, CompletionCallback completionCallback)
+		: sqRing_(MAP_FAILED), sqRingSize_(0), cqRing_(MAP_FAILED), cqRingSize_(0), sqes_(nullptr),
+		sqLocalTail_(0), sqSubmittedTail_(0),
+		maxFilesInFlight_(std::max<std::size_t>(maxFilesInFlight, 1)), headerSize_(headerSize), ioOptions_(ioOptions), completionCallback_(completionCallback)
+	{
+		ioOptions_.SmallFileThreshold = std::min(ioOptions_.SmallFileThreshold, MaxReadSize);
+
+		// Every file has at most two operations queued at a time
+		io_uring_params params{};
+		ringFd_ = static_cast<int>(syscall(__NR_io_uring_setup, static_cast<unsigned>(maxFilesInFlight_ * 2), &params));
+		HandlePosixError(ringFd_ < 0);
+
+		sqEntries_ = params.sq_entries;
+		sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (singleMapping)
+		{
+			sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+		}
+
+		sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+		cqRing_ = singleMapping
+			? sqRing_
+			: mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+		void* sqes = mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+		if (sqRing_ == MAP_FAILED || cqRing_ == MAP_FAILED || sqes == MAP_FAILED)
+		{
+			int error = errno;
+			if (sqes != MAP_FAILED)
+			{
+				munmap(sqes, params.sq_entries * sizeof(io_uring_sqe));
+			}
+
+			if (!singleMapping && cqRing_ != MAP_FAILED)
+			{
+				munmap(cqRing_, cqRingSize_);
+			}
+
+			if (sqRing_ != MAP_FAILED)
+			{
+				munmap(sqRing_, sqRingSize_);
+			}
+
+			close(ringFd_);
+			errno = error;
+			HandlePosixError(true);
+		}
+
+		sqes_ = static_cast<io_uring_sqe*>(sqes);
+		sqHead_ = RingPointer<unsigned>(sqRing_, params.sq_off.head);
+		sqTail_ = RingPointer<unsigned>(sqRing_, params.sq_off.tail);
+		sqMask_ = RingPointer<unsigned>(sqRing_, params.sq_off.ring_mask);
+		sqArray_ = RingPointer<unsigned>(sqRing_, params.sq_off.array);
+		cqHead_ = RingPointer<unsigned>(cqRing_, params.cq_off.head);
+		cqTail_ = RingPointer<unsigned>(cqRing_, params.cq_off.tail);
+		cqMask_ = RingPointer<unsigned>(cqRing_, params.cq_off.ring_mask);
+		cqes_ = RingPointer<io_uring_cqe>(cqRing_, params.cq_off.cqes);
+		sqLocalTail_ = sqSubmittedTail_ = *sqTail_;
+
+		for (std::size_t slot = 0; slot < maxFilesInFlight_; ++slot)
+		{
+			slots_.push_back(std::make_unique<PendingFile>());
+			freeSlots_.push_back(maxFilesInFlight_ - slot - 1);
+		}
+	}
+
+	AsyncHeaderFetcher::~AsyncHeaderFetcher()
+	{
+		// The kernel may still write into the buffers of files in flight, so they are waited for
+		// before the buffers are released. Their images are closed without being reported.
+		completionCallback_ = nullptr;
+		try
+		{
+			Drain();
+		}
+		catch (const std::exception&)
+		{
+		}
+
+		munmap(sqes_, sqEntries_ * sizeof(io_uring_sqe));
+		if (cqRing_ != sqRing_)
+		{
+			munmap(cqRing_, cqRingSize_);
+		}
+
+		munmap(sqRing_, sqRingSize_);
+		close(ringFd_);
+	}
+
+	bool AsyncHeaderFetcher::IsSupported()
+	{
+		static const bool isSupported = []
+		{
+			io_uring_params params{};
+			int ringFd = static_cast<int>(syscall(__NR_io_uring_setup, 1, &params));
+			if (ringFd < 0)
+			{
+				return false;
+			}
+
+			const unsigned probeOperationCount = 256;
+			std::vector<std::uint8_t> probeBuffer(sizeof(io_uring_probe) + probeOperationCount * sizeof(io_uring_probe_op));
+			auto probe = reinterpret_cast<io_uring_probe*>(probeBuffer.data());
+			long result = syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, probeOperationCount);
+			close(ringFd);
+			if (result < 0)
+			{
+				return false;
+			}
+
+			auto isOperationSupported = [probe](unsigned operation)
+			{
+				return operation <= probe->last_op && (probe->ops[operation].flags & IO_URING_OP_SUPPORTED) != 0;
+			};
+
+			return isOperationSupported(IORING_OP_OPENAT) && isOperationSupported(IORING_OP_STATX) && isOperationSupported(IORING_OP_READ);
+		}();
+
+		return isSupported;
+	}
+
+	void AsyncHeaderFetcher::Add(const std::wstring& filePath)
+	{
+		while (freeSlots_.empty())
+		{
+			Submit(1);
+			ReapCompletions();
+		}
+
+		auto slot = freeSlots_.back();
+		freeSlots_.pop_back();
+
+		auto& file = *slots_[slot];
+		file.FilePath = filePath;
+		file.NativePath = utf16_to_native_path(filePath);
+		file.Stat = {};
+		file.Buffer.clear();
+		file.Fd = -1;
+		file.Error = 0;
+		file.OutstandingCount = 2;
+		file.IsReadQueued = false;
+
+		// The size is queried by path alongside the open, so the two do not wait for each other
+		auto sqe = GetSqe();
+		sqe->opcode = IORING_OP_OPENAT;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = reinterpret_cast<std::uint64_t>(file.NativePath.c_str());
+		sqe->open_flags = O_RDONLY | O_CLOEXEC;
+		sqe->user_data = MakeUserData(slot, OpenOperation);
+
+		sqe = GetSqe();
+		sqe->opcode = IORING_OP_STATX;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = reinterpret_cast<std::uint64_t>(file.NativePath.c_str());
+		sqe->len = STATX_BASIC_STATS;
+		sqe->off = reinterpret_cast<std::uint64_t>(&file.Stat);
+		sqe->user_data = MakeUserData(slot, StatOperation);
+
+		if (sqLocalTail_ - sqSubmittedTail_ >= SubmitBatchSize)
+		{
+			Submit(0);
+		}
+	}
+
+	void AsyncHeaderFetcher::Drain()
+	{
+		while (freeSlots_.size() < maxFilesInFlight_)
+		{
+			Submit(1);
+			ReapCompletions();
+		}
+	}
+
+	io_uring_sqe* AsyncHeaderFetcher::GetSqe()
+	{
+		if (sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+		{
+			Submit(0);
+		}
+
+		auto index = sqLocalTail_ & *sqMask_;
+		sqArray_[index] = index;
+		++sqLocalTail_;
+
+		auto sqe = &sqes_[index];
+		std::memset(sqe, 0, sizeof(*sqe));
+		return sqe;
+	}
+
+	void AsyncHeaderFetcher::Submit(unsigned waitCount)
+	{
+		__atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+
+		auto submitCount = sqLocalTail_ - sqSubmittedTail_;
+		if (submitCount == 0 && waitCount == 0)
+		{
+			return;
+		}
+
+		long result;
+		do
+		{
+			result = syscall(__NR_io_uring_enter, ringFd_, submitCount, waitCount, waitCount != 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+		} while (result < 0 && errno == EINTR);
+
+		HandlePosixError(result < 0);
+		sqSubmittedTail_ += static_cast<unsigned>(result);
+	}
+
+	void AsyncHeaderFetcher::ReapCompletions()
+	{
+		auto head = *cqHead_;
+		while (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE))
+		{
+			const auto& cqe = cqes_[head & *cqMask_];
+			auto userData = cqe.user_data;
+			auto result = cqe.res;
+
+			++head;
+			__atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+
+			OnCompletion(userData, result);
+		}
+	}
+
+	void AsyncHeaderFetcher::OnCompletion(std::uint64_t userData, int result)
+	{
+		auto slot = static_cast<std::size_t>(userData >> OperationBits);
+		auto operation = static_cast<FetchOperation>(userData & ((1 << OperationBits) - 1));
+		auto& file = *slots_[slot];
+
+		if (result < 0 && file.Error == 0)
+		{
+			file.Error = -result;
+		}
+
+		switch (operation)
+		{
+		case OpenOperation:
+			if (result >= 0)
+			{
+				file.Fd = result;
+			}
+			break;
+		case ReadOperation:
+			if (result >= 0)
+			{
+				file.Buffer.resize(static_cast<std::size_t>(result));
+			}
+			break;
+		case StatOperation:
+			break;
+		}
+
+		if (--file.OutstandingCount != 0)
+		{
+			return;
+		}
+
+		// What is read depends on the size, so the read waits for both the descriptor and the size
+		if (file.Error == 0 && !file.IsReadQueued)
+		{
+			file.IsReadQueued = true;
+			QueueRead(slot);
+			if (file.OutstandingCount != 0)
+			{
+				return;
+			}
+		}
+
+		Complete(slot);
+	}
+
+	void AsyncHeaderFetcher::QueueRead(std::size_t slot)
+	{
+		auto& file = *slots_[slot];
+		auto size = file.Stat.stx_size;
+		if (size <= ioOptions_.SmallFileThreshold)
+		{
+			file.Buffer.resize(static_cast<std::size_t>(size));
+		}
+		else if (size >= ioOptions_.LargeFileThreshold)
+		{
+			file.Buffer.resize(headerSize_);
+		}
+		else
+		{
+			// A medium file is mapped and needs no read
+			return;
+		}
+
+		if (file.Buffer.empty())
+		{
+			return;
+		}
+
+		auto sqe = GetSqe();
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = file.Fd;
+		sqe->addr = reinterpret_cast<std::uint64_t>(file.Buffer.data());
+		sqe->len = static_cast<std::uint32_t>(file.Buffer.size());
+		sqe->off = 0;
+		sqe->user_data = MakeUserData(slot, ReadOperation);
+		++file.OutstandingCount;
+	}
+
+	void AsyncHeaderFetcher::Complete(std::size_t slot)
+	{
+		auto& file = *slots_[slot];
+
+		FetchedFile fetchedFile{ std::move(file.FilePath), nullptr, file.Error, FileIdentity() };
+		if (file.Error == 0)
+		{
+			auto statistics = ioOptions_.Statistics;
+			if (statistics != nullptr && file.IsReadQueued && !file.Buffer.empty())
+			{
+				++statistics->ReadCalls;
+				statistics->BytesRead += file.Buffer.size();
+			}
+
+			fetchedFile.Identity = MakeFileIdentity(file.Stat);
+			auto size = file.Stat.stx_size;
+			try
+			{
+				if (size == 0)
+				{
+					// Empty files get no image, as OpenPeImage rejects them
+				}
+				else if (size <= ioOptions_.SmallFileThreshold)
+				{
+					// A file that shrank since the statx is served as far as it was read
+					fetchedFile.Image = std::make_unique<BufferedPeFile>(std::move(file.Buffer), statistics);
+				}
+				else if (size >= ioOptions_.LargeFileThreshold)
+				{
+					fetchedFile.Image = std::make_unique<RangedPeFile>(file.Fd, size, std::move(file.Buffer), statistics);
+					file.Fd = -1;
+				}
+				else
+				{
+					fetchedFile.Image = std::make_unique<MappedPeFile>(file.Fd, size);
+					if (statistics != nullptr)
+					{
+						++statistics->MappedFiles;
+					}
+				}
+			}
+			catch (const std::exception&)
+			{
+				fetchedFile.Error = errno != 0 ? errno : EIO;
+			}
+		}
+
+		if (file.Fd != -1)
+		{
+			close(file.Fd);
+		}
+
+		file.Fd = -1;
+		freeSlots_.push_back(slot);
+
+		if (completionCallback_)
+		{
+			completionCallback_(fetchedFile);
+		}
+	}
+}
+#endif
@@ -0,0 +1,96 @@
+#pragma once
+#include <functional>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#endif
+
+#include "PeImageSource.h"
+#include "ExtractionCache.h"
+
+namespace peinfo
+{
+#ifdef __linux__
+	struct FetchedFile
+	{
+		std::wstring FilePath;
+		std::unique_ptr<PeImageSource> Image;  // null when the file could not be opened or read
+		int Error;                              // errno value of the failed operation
+		FileIdentity Identity;                  // set with Image
+	};
+
+	// Opens files and reads them through io_uring, keeping many files in flight so that cold
+	// caches and network file systems are waited on in parallel rather than one file at a time.
+	// Once the size is known, the image is picked like OpenPeImage picks it: a small file is read
+	// whole, a medium one is mapped without any read, and of a large one only the first bytes are
+	// read. The header buffer usually covers the DOS header, the NT headers and the section table;
+	// anything past it is read from the returned image only when the extractor asks for it.
+	class AsyncHeaderFetcher
+	{
+	public:
+		using CompletionCallback = std::function<void(FetchedFile&)>;
+
+		AsyncHeaderFetcher(std::size_t maxFilesInFlight, std::uint32_t headerSize, const IoOptions& ioOptions, CompletionCallback completionCallback);
+		~AsyncHeaderFetcher();
+
+		AsyncHeaderFetcher(const AsyncHeaderFetcher&) = delete;
+		AsyncHeaderFetcher& operator=(const AsyncHeaderFetcher&) = delete;
+
+		// True when the kernel supports io_uring with the openat, statx and read operations.
+		static bool IsSupported();
+
+		// Queues the file. When the maximum number of files is in flight, waits for completions first.
+		// The callback is invoked on the calling thread.
+		void Add(const std::wstring& filePath);
+
+		// Waits until every added file has completed.
+		void Drain();
+
+	private:
+		struct PendingFile
+		{
+			std::wstring FilePath;
+			std::string NativePath;
+			struct statx Stat;
+			std::vector<std::uint8_t> Buffer;  // the whole file when it is small, else its header
+			int Fd;
+			int Error;
+			unsigned OutstandingCount;
+			bool IsReadQueued;
+		};
+
+		io_uring_sqe* GetSqe();
+		void Submit(unsigned waitCount);
+		void ReapCompletions();
+		void OnCompletion(std::uint64_t userData, int result);
+		void QueueRead(std::size_t slot);
+		void Complete(std::size_t slot);
+
+		int ringFd_;
+		unsigned sqEntries_;
+		void* sqRing_;
+		std::size_t sqRingSize_;
+		void* cqRing_;
+		std::size_t cqRingSize_;
+		io_uring_sqe* sqes_;
+
+		unsigned* sqHead_;
+		unsigned* sqTail_;
+		unsigned* sqMask_;
+		unsigned* sqArray_;
+		unsigned* cqHead_;
+		unsigned* cqTail_;
+		unsigned* cqMask_;
+		io_uring_cqe* cqes_;
+		unsigned sqLocalTail_;
+		unsigned sqSubmittedTail_;
+
+		std::size_t maxFilesInFlight_;
+		std::uint32_t headerSize_;
+		IoOptions ioOptions_;
+		CompletionCallback completionCallback_;
+		std::vector<std::unique_ptr<PendingFile>> slots_;
+		std::vector<std::size_t> freeSlots_;
+	};
+#endif
+}
@@ -0,0 +1,545 @@
+#include "stdafx.h"
+#include "BatchScanner.h"
+#include "AsyncHeaderFetcher.h"
+#include "ExtractionCache.h"
+#include "ContentHash.h"
+#include "FilesystemPath.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		// Files queued per worker before AddFile blocks
+		const std::size_t QueuedFilesPerThread = 64;
+
+		// Enough to keep a slow volume busy; each file in flight holds its header, or the whole
+		// file when it is below the small file threshold
+		const std::size_t MaxFilesInFlight = 256;
+
+		// Covers the DOS header, the NT headers and the section table of almost every image
+		const std::uint32_t HeaderFetchSize = 4096;
+
+		// Sorts the indexes by key and calls groupCallback with each run of indexes of equal keys.
+		// The sort is stable, so every group keeps the order in which its files were added.
+		template<class KeyFunction, class GroupCallback>
+		void ForEachGroup(std::vector<std::size_t>& indexes, KeyFunction key, GroupCallback groupCallback)
+		{
+			std::stable_sort(indexes.begin(), indexes.end(), [&key](std::size_t left, std::size_t right) { return key(left) < key(right); });
+			for (auto first = indexes.begin(); first != indexes.end();)
+			{
+				auto last = std::find_if(first, indexes.end(), [&key, first](std::size_t index) { return key(index) != key(*first); });
+				groupCallback(std::vector<std::size_t>(first, last));
+				first = last;
+			}
+		}
+	}
+
+	struct BatchScanner::DeduplicatedFile
+	{
+		std::wstring FilePath;
+		FileIdentity Identity;
+		bool IsCandidate;           // a readable PE image whose ContentHash is set
+		bool IsHashComplete;        // ContentHash covers the whole file rather than its ends
+		std::uint64_t ContentHash;
+	};
+
+	struct BatchScanner::Deduplication
+	{
+		std::vector<DeduplicatedFile> Files;
+	};
+
+	BatchScanner::BatchScanner(const BatchScanOptions& options, ResultCallback resultCallback)
+		: ioOptions_(options.Io), plan_(options.Plan), resultCallback_(resultCallback), imageVisitor_(options.ImageVisitor), queuedCount_(0), threadPool_(options.ThreadCount)
+	{
+		maxQueuedCount_ = threadPool_.GetThreadCount() * QueuedFilesPerThread;
+
+		if (plan_.GetCost() <= InfoFieldCost::ClrHeader)
+		{
+			ioOptions_.SmallFileThreshold = 0;
+			ioOptions_.LargeFileThreshold = 0;
+		}
+
+		if (!options.CachePath.empty() && plan_.SelectsAllFields() && !plan_.HasPredicates() && !imageVisitor_)
+		{
+			cache_ = std::make_unique<ExtractionCache>(options.CachePath, options.CacheMaxSize != 0 ? options.CacheMaxSize : ExtractionCache::DefaultMaxSize);
+		}
+
+		if (options.Deduplicate)
+		{
+			deduplication_ = std::make_unique<Deduplication>();
+		}
+
+#ifdef __linux__
+		if (options.UseAsyncIo && AsyncHeaderFetcher::IsSupported())
+		{
+			headerFetcher_ = std::make_unique<AsyncHeaderFetcher>(MaxFilesInFlight, HeaderFetchSize, ioOptions_, [this](FetchedFile& fetchedFile)
+			{
+				if (!fetchedFile.Image)
+				{
+					Skip();
+					return;
+				}
+
+				// std::function needs a copyable task, so the image travels in a shared holder
+				auto holder = std::make_shared<FetchedFile>(std::move(fetchedFile));
+				Enqueue(holder->FilePath, [this, holder] { ScanImage(holder->FilePath, std::move(holder->Image), cache_ ? &holder->Identity : nullptr); });
+			});
+		}
+#endif
+	}
+
+	BatchScanner::~BatchScanner()
+	{
+	}
+
+	void BatchScanner::AddFile(const std::wstring& filePath)
+	{
+		FileIdentity identity{};
+		bool hasIdentity = (cache_ || deduplication_) && TryGetFileIdentity(filePath, identity);
+		if (cache_ && hasIdentity && TryReportCached(filePath, identity))
+		{
+			return;
+		}
+
+		if (deduplication_)
+		{
+			// A file that cannot be stat'ed could not be opened either
+			if (!hasIdentity)
+			{
+				Skip();
+				return;
+			}
+
+			deduplication_->Files.push_back(DeduplicatedFile{ filePath, identity, false, false, 0 });
+			return;
+		}
+
+		Scan(filePath, hasIdentity ? &identity : nullptr);
+	}
+
+	void BatchScanner::Scan(const std::wstring& filePath, const FileIdentity* identity)
+	{
+#ifdef __linux__
+		if (headerFetcher_)
+		{
+			headerFetcher_->Add(filePath);
+			return;
+		}
+#endif
+
+		bool hasIdentity = identity != nullptr;
+		FileIdentity identityCopy = hasIdentity ? *identity : FileIdentity();
+		Enqueue(filePath, [this, filePath, identityCopy, hasIdentity] { ScanFile(filePath, hasIdentity ? &identityCopy : nullptr); });
+	}
+
+	void BatchScanner::Enqueue(const std::wstring& filePath, std::function<void()> scan)
+	{
+		{
+			std::unique_lock<std::mutex> lock(queueMutex_);
+			queueCondition_.wait(lock, [this] { return queuedCount_ < maxQueuedCount_; });
+			++queuedCount_;
+		}
+
+		threadPool_.Submit([this, filePath, scan]
+		{
+			Guard(filePath, scan);
+
+			{
+				std::lock_guard<std::mutex> lock(queueMutex_);
+				--queuedCount_;
+			}
+
+			queueCondition_.notify_one();
+		});
+	}
+
+	void BatchScanner::Guard(const std::wstring& filePath, const std::function<void()>& action)
+	{
+		// Extraction errors are reported by the scan itself; anything else that escapes, such as
+		// bad_alloc or an error of the result callback, fails the file instead of losing it
+		try
+		{
+			action();
+		}
+		catch (const std::exception& e)
+		{
+			ReportFailure(filePath, e.what());
+		}
+		catch (...)
+		{
+			ReportFailure(filePath, "Unknown exception");
+		}
+	}
+
+	void BatchScanner::AddDirectory(const std::wstring& directoryPath)
+	{
+		std::error_code error;
+		std::filesystem::recursive_directory_iterator iterator(
+			ToFilesystemPath(directoryPath), std::filesystem::directory_options::skip_permission_denied, error);
+
+		for (std::filesystem::recursive_directory_iterator end; !error && iterator != end; iterator.increment(error))
+		{
+			std::error_code statusError;
+			if (iterator->is_regular_file(statusError))
+			{
+				AddFile(FromFilesystemPath(iterator->path()));
+			}
+		}
+
+		if (error)
+		{
+			Report(BatchScanResult{ directoryPath, false, PeFileFormattedInfo(), error.message() });
+		}
+	}
+
+	BatchScanStatistics BatchScanner::Finish()
+	{
+		if (deduplication_)
+		{
+			ScanDeduplicated();
+		}
+
+#ifdef __linux__
+		if (headerFetcher_)
+		{
+			headerFetcher_->Drain();
+		}
+#endif
+
+		threadPool_.Wait();
+
+		std::lock_guard<std::mutex> lock(resultMutex_);
+		statistics_.Unreported += threadPool_.GetFailedTaskCount();
+		return statistics_;
+	}
+
+	bool BatchScanner::HasPeSignature(PeImageSource& image)
+	{
+		try
+		{
+			auto size = image.GetSize();
+			if (size < sizeof(IMAGE_DOS_HEADER))
+			{
+				return false;
+			}
+
+			auto dosHeader = static_cast<const IMAGE_DOS_HEADER*>(image.GetData(0, sizeof(IMAGE_DOS_HEADER)));
+			if (dosHeader->e_magic != IMAGE_DOS_SIGNATURE || dosHeader->e_lfanew < 0 || static_cast<std::uint64_t>(dosHeader->e_lfanew) + sizeof(DWORD) > size)
+			{
+				return false;
+			}
+
+			DWORD ntSignature = 0;
+			std::memcpy(&ntSignature, image.GetData(dosHeader->e_lfanew, sizeof(DWORD)), sizeof(DWORD));
+			return ntSignature == IMAGE_NT_SIGNATURE;
+		}
+		catch (const std::exception&)
+		{
+			return false;
+		}
+	}
+
+	bool BatchScanner::TryReportCached(const std::wstring& filePath, const FileIdentity& identity)
+	{
+		CachedResult cachedResult;
+		if (!cache_->TryGet(identity, cachedResult))
+		{
+			return false;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(resultMutex_);
+			++statistics_.CacheHits;
+		}
+
+		if (cachedResult.Kind == CachedResultKind::NotPe)
+		{
+			Skip();
+			return true;
+		}
+
+		bool succeeded = cachedResult.Kind == CachedResultKind::Extracted;
+		Report(BatchScanResult{ filePath, succeeded, std::move(cachedResult.Info), std::move(cachedResult.Error) });
+		return true;
+	}
+
+	CachedResult BatchScanner::ScanFile(const std::wstring& filePath, const FileIdentity* identity)
+	{
+		// Files that cannot be opened are skipped like files that fail the signature check
+		std::unique_ptr<PeImageSource> image;
+		try
+		{
+			image = OpenPeImage(filePath, ioOptions_);
+		}
+		catch (const std::exception&)
+		{
+			Skip();
+			return CachedResult{ CachedResultKind::NotPe, PeFileFormattedInfo(), std::string() };
+		}
+
+		return ScanImage(filePath, std::move(image), identity);
+	}
+
+	CachedResult BatchScanner::ScanImage(const std::wstring& filePath, std::unique_ptr<PeImageSource> image, const FileIdentity* identity)
+	{
+		CachedResult cachedResult{ CachedResultKind::NotPe, PeFileFormattedInfo(), std::string() };
+		if (!HasPeSignature(*image))
+		{
+			Skip();
+		}
+		else
+		{
+			BatchScanResult result{ filePath, false, PeFileFormattedInfo(), std::string() };
+			bool isFiltered = false;
+			try
+			{
+				PeFileFormattedInfoExtractor extractor(std::move(image));
+				isFiltered = !extractor.TryExtract(plan_, result.Info);
+				if (!isFiltered && imageVisitor_)
+				{
+					imageVisitor_(filePath, extractor.GetInfoExtractor());
+				}
+
+				result.Succeeded = true;
+			}
+			catch (const std::exception& e)
+			{
+				result.Error = e.what();
+			}
+
+			if (isFiltered)
+			{
+				Filter();
+				return CachedResult{ CachedResultKind::Filtered, PeFileFormattedInfo(), std::string() };
+			}
+
+			Report(result);
+
+			cachedResult.Kind = result.Succeeded ? CachedResultKind::Extracted : CachedResultKind::Failed;
+			cachedResult.Info = std::move(result.Info);
+			cachedResult.Error = std::move(result.Error);
+		}
+
+		StoreInCache(identity, cachedResult);
+		return cachedResult;
+	}
+
+	void BatchScanner::ScanDeduplicated()
+	{
+		auto& files = deduplication_->Files;
+		std::vector<std::size_t> indexes;
+		for (std::size_t i = 0; i < files.size(); ++i)
+		{
+			indexes.push_back(i);
+		}
+
+		// Files of a size no other file has cannot share their content and are not hashed at all
+		std::vector<std::size_t> uniqueFiles;
+		std::vector<std::size_t> sampledFiles;
+		ForEachGroup(indexes, [&files](std::size_t index) { return files[index].Identity.Size; }, [&](std::vector<std::size_t> group)
+		{
+			auto& target = group.size() == 1 ? uniqueFiles : sampledFiles;
+			target.insert(target.end(), group.begin(), group.end());
+		});
+
+		for (auto index : sampledFiles)
+		{
+			Enqueue(files[index].FilePath, [this, &file = files[index]] { SampleFile(file); });
+		}
+
+		threadPool_.Wait();
+
+		// Files whose size and sample match are confirmed by hashing their whole content, unless
+		// the sample already covered it
+		auto contentKey = [&files](std::size_t index) { return std::make_pair(files[index].Identity.Size, files[index].ContentHash); };
+		std::vector<std::vector<std::size_t>> contents;
+		std::vector<std::size_t> candidates;
+		std::vector<std::size_t> hashedFiles;
+		std::copy_if(sampledFiles.begin(), sampledFiles.end(), std::back_inserter(candidates), [&files](std::size_t index) { return files[index].IsCandidate; });
+		ForEachGroup(candidates, contentKey, [&](std::vector<std::size_t> group)
+		{
+			if (group.size() > 1 && !files[group[0]].IsHashComplete)
+			{
+				hashedFiles.insert(hashedFiles.end(), group.begin(), group.end());
+			}
+			else
+			{
+				contents.push_back(std::move(group));
+			}
+		});
+
+		for (auto index : hashedFiles)
+		{
+			Enqueue(files[index].FilePath, [this, &file = files[index]] { HashFile(file); });
+		}
+
+		threadPool_.Wait();
+
+		candidates.clear();
+		std::copy_if(hashedFiles.begin(), hashedFiles.end(), std::back_inserter(candidates), [&files](std::size_t index) { return files[index].IsCandidate; });
+		ForEachGroup(candidates, contentKey, [&](std::vector<std::size_t> group) { contents.push_back(std::move(group)); });
+
+		for (auto& content : contents)
+		{
+			ScanContent(std::move(content));
+		}
+
+		for (auto index : uniqueFiles)
+		{
+			Scan(files[index].FilePath, cache_ ? &files[index].Identity : nullptr);
+		}
+	}
+
+	void BatchScanner::SampleFile(DeduplicatedFile& file)
+	{
+		// Only the ends are hashed, so anything larger than the sample is read in ranges
+		IoOptions sampleOptions = ioOptions_;
+		sampleOptions.SmallFileThreshold = 2 * ContentSampleSize;
+		sampleOptions.LargeFileThreshold = 2 * ContentSampleSize + 1;
+
+		try
+		{
+			auto image = OpenPeImage(file.FilePath, sampleOptions);
+			if (!HasPeSignature(*image))
+			{
+				Skip();
+				StoreInCache(cache_ ? &file.Identity : nullptr, CachedResult{ CachedResultKind::NotPe, PeFileFormattedInfo(), std::string() });
+				return;
+			}
+
+			file.ContentHash = HashImageSample(*image);
+			file.IsHashComplete = IsSampleComplete(image->GetSize());
+			file.IsCandidate = true;
+		}
+		catch (const std::exception&)
+		{
+			Skip();
+		}
+	}
+
+	void BatchScanner::HashFile(DeduplicatedFile& file)
+	{
+		try
+		{
+			file.ContentHash = HashFileContent(file.FilePath, ioOptions_.Statistics);
+			file.IsHashComplete = true;
+		}
+		catch (const std::exception&)
+		{
+			file.IsCandidate = false;
+			Skip();
+		}
+	}
+
+	void BatchScanner::ScanContent(std::vector<std::size_t> fileIndexes)
+	{
+		const auto& files = deduplication_->Files;
+		Enqueue(files[fileIndexes[0]].FilePath, [this, &files, fileIndexes]
+		{
+			const auto& firstFile = files[fileIndexes[0]];
+			CachedResult result;
+			try
+			{
+				result = ScanFile(firstFile.FilePath, cache_ ? &firstFile.Identity : nullptr);
+			}
+			catch (const std::exception& e)
+			{
+				// Nothing is known about the content, so the duplicates fail with the first file
+				for (auto index : fileIndexes)
+				{
+					ReportFailure(files[index].FilePath, e.what());
+				}
+
+				return;
+			}
+
+			for (std::size_t i = 1; i < fileIndexes.size(); ++i)
+			{
+				const auto& file = files[fileIndexes[i]];
+				Guard(file.FilePath, [&] { ReportDuplicate(file, result); });
+			}
+		});
+	}
+
+	void BatchScanner::ReportDuplicate(const DeduplicatedFile& file, const CachedResult& result)
+	{
+		{
+			std::lock_guard<std::mutex> lock(resultMutex_);
+			++statistics_.Duplicates;
+		}
+
+		// The first file could not be read again after it was hashed, so nothing is known about its content
+		if (result.Kind == CachedResultKind::NotPe)
+		{
+			Skip();
+			return;
+		}
+
+		if (result.Kind == CachedResultKind::Filtered)
+		{
+			Filter();
+			return;
+		}
+
+		Report(BatchScanResult{ file.FilePath, result.Kind == CachedResultKind::Extracted, result.Info, result.Error });
+		StoreInCache(cache_ ? &file.Identity : nullptr, result);
+	}
+
+	void BatchScanner::StoreInCache(const FileIdentity* identity, const CachedResult& result)
+	{
+		if (identity == nullptr)
+		{
+			return;
+		}
+
+		// The cache only saves work, so failing to write to it does not fail the scan
+		try
+		{
+			cache_->Put(*identity, result);
+		}
+		catch (const std::exception&)
+		{
+		}
+	}
+
+	void BatchScanner::Skip()
+	{
+		std::lock_guard<std::mutex> lock(resultMutex_);
+		++statistics_.Skipped;
+	}
+
+	void BatchScanner::Filter()
+	{
+		std::lock_guard<std::mutex> lock(resultMutex_);
+		++statistics_.Filtered;
+	}
+
+	void BatchScanner::Report(const BatchScanResult& result)
+	{
+		// A result the callback throws on is counted by ReportFailure instead
+		std::lock_guard<std::mutex> lock(resultMutex_);
+		resultCallback_(result);
+		if (result.Succeeded)
+		{
+			++statistics_.Extracted;
+		}
+		else
+		{
+			++statistics_.Failed;
+		}
+	}
+
+	void BatchScanner::ReportFailure(const std::wstring& filePath, const std::string& error)
+	{
+		std::lock_guard<std::mutex> lock(resultMutex_);
+		++statistics_.Failed;
+		try
+		{
+			resultCallback_(BatchScanResult{ filePath, false, PeFileFormattedInfo(), error });
+		}
+		catch (...)
+		{
+			++statistics_.Unreported;
+		}
+	}
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include "PeBinaryInfo.h"
+#include "ThreadPool.h"
+
+namespace peinfo
+{
+	class AsyncHeaderFetcher;
+	class ExtractionCache;
+	struct FileIdentity;
+	struct CachedResult;
+
+	struct BatchScanResult
+	{
+		std::wstring FilePath;
+		bool Succeeded;
+		PeFileFormattedInfo Info;
+		std::string Error;
+	};
+
+	struct BatchScanStatistics
+	{
+		std::uint64_t Extracted = 0;
+		std::uint64_t Failed = 0;
+		std::uint64_t Skipped = 0;  // unreadable, or rejected by the MZ/PE signature check before extraction
+		std::uint64_t CacheHits = 0;  // answered from the cache; also counted above
+		std::uint64_t Duplicates = 0;  // answered from another file with the same content; also counted above
+		std::uint64_t Filtered = 0;   // rejected by a predicate of the extraction plan; not reported
+		std::uint64_t Unreported = 0;  // failed, and the result callback threw on the failure as well
+	};
+
+	struct BatchScanOptions
+	{
+		std::size_t ThreadCount = 0;  // 0 uses one thread per hardware thread
+		bool UseAsyncIo = true;
+		IoOptions Io;
+		std::wstring CachePath;       // empty disables the extraction cache
+		std::uint64_t CacheMaxSize = 0;  // 0 uses ExtractionCache::DefaultMaxSize
+		bool Deduplicate = false;     // extract files with the same content once
+		ExtractionPlan Plan;
+
+		// Called on the scanning thread with every image that was extracted, before its result is
+		// reported, for parts of the image the formatted info does not hold. An exception fails the result.
+		std::function<void(const std::wstring& filePath, PeFileInfoExtractor& extractor)> ImageVisitor;
+	};
+
+	// Runs PeFileFormattedInfoExtractor over many files on a ThreadPool. Every result is passed to
+	// the callback as soon as its file is done; callback calls are serialized but come in completion
+	// order. Adding files blocks while too many are queued, so arbitrarily long inputs use bounded memory.
+	// Where io_uring is available and useAsyncIo is set, files are opened and their headers read
+	// asynchronously on the adding thread before extraction is queued. Files are added from one thread.
+	// With a cache path, files whose identity is in the ExtractionCache are answered without being
+	// opened, and every other result, including files that are not PE images, is added to the cache.
+	// With deduplication, added files are only stat'ed until Finish, which groups them by content:
+	// files of a size no other file has are scanned directly, the others are compared by a hash of
+	// their ends and then of their whole content, and each distinct content is extracted once with
+	// the result reported for every path that has it.
+	// Files are extracted with the ExtractionPlan; the cache only holds full results, so it is not
+	// used with a plan that selects some fields or has predicates, or with an image visitor, which
+	// needs the image. A plan that needs nothing past the CLR header reads every file in ranges,
+	// which are usually just its first page. Only the first file of a content is visited.
+	class BatchScanner
+	{
+	public:
+		using ResultCallback = std::function<void(const BatchScanResult&)>;
+
+		BatchScanner(const BatchScanOptions& options, ResultCallback resultCallback);
+		~BatchScanner();
+
+		BatchScanner(const BatchScanner&) = delete;
+		BatchScanner& operator=(const BatchScanner&) = delete;
+
+		void AddFile(const std::wstring& filePath);
+
+		// Adds every regular file below the directory. Unreadable subdirectories are skipped.
+		void AddDirectory(const std::wstring& directoryPath);
+
+		// Waits for all added files.
+		BatchScanStatistics Finish();
+
+		// Reads the DOS header and the PE signature only.
+		static bool HasPeSignature(PeImageSource& image);
+
+	private:
+		struct Deduplication;
+		struct DeduplicatedFile;
+
+		void Enqueue(const std::wstring& filePath, std::function<void()> scan);
+		void Guard(const std::wstring& filePath, const std::function<void()>& action);
+		void Scan(const std::wstring& filePath, const FileIdentity* identity);
+		bool TryReportCached(const std::wstring& filePath, const FileIdentity& identity);
+		CachedResult ScanFile(const std::wstring& filePath, const FileIdentity* identity);
+		CachedResult ScanImage(const std::wstring& filePath, std::unique_ptr<PeImageSource> image, const FileIdentity* identity);
+		void ScanDeduplicated();
+		void SampleFile(DeduplicatedFile& file);
+		void HashFile(DeduplicatedFile& file);
+		void ScanContent(std::vector<std::size_t> fileIndexes);
+		void ReportDuplicate(const DeduplicatedFile& file, const CachedResult& result);
+		void StoreInCache(const FileIdentity* identity, const CachedResult& result);
+		void Skip();
+		void Filter();
+		void Report(const BatchScanResult& result);
+		void ReportFailure(const std::wstring& filePath, const std::string& error);
+
+		IoOptions ioOptions_;
+		ExtractionPlan plan_;
+		ResultCallback resultCallback_;
+		std::function<void(const std::wstring&, PeFileInfoExtractor&)> imageVisitor_;
+		std::mutex resultMutex_;
+		BatchScanStatistics statistics_;
+
+		std::mutex queueMutex_;
+		std::condition_variable queueCondition_;
+		std::size_t queuedCount_;
+		std::size_t maxQueuedCount_;
+
+		std::unique_ptr<ExtractionCache> cache_;
+		std::unique_ptr<Deduplication> deduplication_;
+		ThreadPool threadPool_;
+		std::unique_ptr<AsyncHeaderFetcher> headerFetcher_;
+	};
+}
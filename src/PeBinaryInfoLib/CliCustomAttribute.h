@@ -0,0 +1,429 @@
+#pragma once
+#include "stdafx.h"
+#include "Helpers.h"
+#include "CliMetadata.h"
+
+namespace peinfo
+{
+	enum class CustomAttributeArgumentKind
+	{
+		Fixed,
+		Field,
+		Property
+	};
+
+	struct CustomAttributeArgument
+	{
+		CustomAttributeArgumentKind Kind;
+		std::uint32_t Index;           // position among the fixed or among the named arguments
+		std::string_view Name;         // named arguments only
+		std::uint32_t ArrayIndex;      // NotArrayElement unless the value is an element of an array argument
+
+		static const std::uint32_t NotArrayElement = ~0u;
+	};
+
+	// One decoded value. Strings and type names are views into the attribute blob.
+	struct CustomAttributeValue
+	{
+		ElementType Type;              // a primitive, String, Type, Enum or SzArray
+		ElementType PrimitiveType;     // Type for primitives, the underlying type for Enum
+		std::uint64_t Bits;            // little-endian payload of primitives and enums
+		std::string_view Text;         // String and Type values, the enum type name of named enum arguments
+		std::uint32_t ArrayLength;     // SzArray only; the elements follow as separate values
+		bool IsNull;                   // null String, Type or SzArray
+		bool IsBoxed;                  // the argument was declared as System.Object
+
+		bool AsBool() const
+		{
+			return Bits != 0;
+		}
+
+		std::uint64_t AsUInt64() const
+		{
+			return Bits;
+		}
+
+		std::int64_t AsInt64() const
+		{
+			switch (PrimitiveType)
+			{
+			case ElementType::I1: return static_cast<std::int8_t>(Bits);
+			case ElementType::I2: return static_cast<std::int16_t>(Bits);
+			case ElementType::I4: return static_cast<std::int32_t>(Bits);
+			default: return static_cast<std::int64_t>(Bits);
+			}
+		}
+
+		double AsDouble() const
+		{
+			if (PrimitiveType == ElementType::R4)
+			{
+				float value;
+				auto bits = static_cast<std::uint32_t>(Bits);
+				std::memcpy(&value, &bits, sizeof(value));
+				return value;
+			}
+
+			double value;
+			std::memcpy(&value, &Bits, sizeof(value));
+			return value;
+		}
+	};
+
+	// ECMA-335 II.23.3. Decodes the value blob of a custom attribute against the signature of its
+	// constructor and reports every fixed and named argument to a visitor without allocating:
+	// visitor(const CustomAttributeArgument& argument, const CustomAttributeValue& value).
+	// An array argument is reported once with Type == SzArray, followed by one call per element.
+	class CustomAttributeDecoder
+	{
+	public:
+		explicit CustomAttributeDecoder(const MetadataTables& tables)
+			: tables_(tables)
+		{
+		}
+
+		template<class Visitor>
+		void Decode(std::uint32_t customAttributeTypeIndex, Span<const std::uint8_t> value, Visitor&& visitor) const
+		{
+			MethodSignature constructor(GetConstructorSignature(customAttributeTypeIndex));
+
+			BlobReader reader(value);
+			CheckError(reader.Read<std::uint16_t>() == Prolog, "Invalid custom attribute prolog");
+
+			std::uint32_t fixedIndex = 0;
+			constructor.ForEachParameter([&](const TypeSignature& parameter)
+			{
+				CustomAttributeArgument argument{ CustomAttributeArgumentKind::Fixed, fixedIndex++, std::string_view(), CustomAttributeArgument::NotArrayElement };
+				DecodeValue(reader, GetSerializationType(parameter), argument, false, visitor);
+			});
+
+			auto namedCount = reader.Read<std::uint16_t>();
+			for (std::uint32_t i = 0; i < namedCount; ++i)
+			{
+				auto kind = static_cast<ElementType>(reader.ReadByte());
+				CheckError(kind == ElementType::Field || kind == ElementType::Property, "Invalid named custom attribute argument");
+
+				auto type = ReadFieldOrPropType(reader);
+				std::string_view name;
+				CheckError(TryReadSerString(reader, name), "Named custom attribute argument has no name");
+
+				auto argumentKind = kind == ElementType::Field ? CustomAttributeArgumentKind::Field : CustomAttributeArgumentKind::Property;
+				CustomAttributeArgument argument{ argumentKind, i, name, CustomAttributeArgument::NotArrayElement };
+				DecodeValue(reader, type, argument, false, visitor);
+			}
+		}
+
+		bool TryGetAttributeTypeName(std::uint32_t customAttributeTypeIndex, std::string_view& typeNamespace, std::string_view& typeName) const
+		{
+			RowReference constructor{};
+			if (!TryDecodeIndex(ColumnType::CustomAttributeType, customAttributeTypeIndex, constructor) || constructor.Rid == 0)
+			{
+				return false;
+			}
+
+			if (constructor.Table == TableId::MethodDef)
+			{
+				return TryGetMethodDefOwnerName(constructor.Rid, typeNamespace, typeName);
+			}
+
+			auto memberRefTable = tables_.GetMemberRefTable();
+			CheckError(constructor.Rid <= memberRefTable.GetRowCount(), "Invalid MemberRef index");
+
+			RowReference parent{};
+			if (!TryDecodeIndex(ColumnType::MemberRefParent, memberRefTable.GetParentIndex(constructor.Rid - 1), parent))
+			{
+				return false;
+			}
+
+			return TryGetTypeName(parent, typeNamespace, typeName);
+		}
+
+	private:
+		struct SerializationType
+		{
+			ElementType Type;
+			ElementType EnumUnderlyingType;  // Enum, or SzArray of Enum
+			ElementType ArrayElementType;    // SzArray
+			std::string_view EnumTypeName;   // named arguments only
+		};
+
+		Span<const std::uint8_t> GetConstructorSignature(std::uint32_t customAttributeTypeIndex) const
+		{
+			RowReference constructor{};
+			CheckError(TryDecodeIndex(ColumnType::CustomAttributeType, customAttributeTypeIndex, constructor), "Invalid custom attribute type");
+			CheckError(constructor.Rid != 0 && constructor.Rid <= tables_.GetTable(constructor.Table).GetRowCount(), "Invalid custom attribute constructor");
+
+			if (constructor.Table == TableId::MethodDef)
+			{
+				return tables_.GetRow<TableId::MethodDef>(constructor.Rid - 1).GetBlob(MethodDefSchema::Signature);
+			}
+
+			return tables_.GetRow<TableId::MemberRef>(constructor.Rid - 1).GetBlob(MemberRefSchema::Signature);
+		}
+
+		template<class Visitor>
+		void DecodeValue(BlobReader& reader, const SerializationType& type, CustomAttributeArgument argument, bool isBoxed, Visitor& visitor) const
+		{
+			if (type.Type == ElementType::Boxed)
+			{
+				auto boxedType = ReadFieldOrPropType(reader);
+				CheckError(boxedType.Type != ElementType::Boxed, "Invalid boxed custom attribute argument");
+				DecodeValue(reader, boxedType, argument, true, visitor);
+				return;
+			}
+
+			if (type.Type != ElementType::SzArray)
+			{
+				visitor(argument, ReadScalar(reader, type, isBoxed));
+				return;
+			}
+
+			auto length = reader.Read<std::uint32_t>();
+			CustomAttributeValue array{};
+			array.Type = ElementType::SzArray;
+			array.PrimitiveType = type.ArrayElementType;
+			array.IsNull = length == NullArrayLength;
+			array.ArrayLength = array.IsNull ? 0 : length;
+			array.IsBoxed = isBoxed;
+			visitor(argument, array);
+
+			SerializationType elementType{ type.ArrayElementType, type.EnumUnderlyingType, ElementType::End, type.EnumTypeName };
+			CheckError(elementType.Type != ElementType::SzArray, "Nested arrays are not allowed in custom attributes");
+			for (std::uint32_t i = 0; i < array.ArrayLength; ++i)
+			{
+				argument.ArrayIndex = i;
+				DecodeValue(reader, elementType, argument, false, visitor);
+			}
+		}
+
+		CustomAttributeValue ReadScalar(BlobReader& reader, const SerializationType& type, bool isBoxed) const
+		{
+			CustomAttributeValue value{};
+			value.Type = type.Type;
+			value.PrimitiveType = type.Type == ElementType::Enum ? type.EnumUnderlyingType : type.Type;
+			value.IsBoxed = isBoxed;
+
+			if (type.Type == ElementType::String || type.Type == ElementType::Type)
+			{
+				value.PrimitiveType = ElementType::End;
+				value.IsNull = !TryReadSerString(reader, value.Text);
+				return value;
+			}
+
+			if (type.Type == ElementType::Enum)
+			{
+				value.Text = type.EnumTypeName;
+			}
+
+			auto size = GetPrimitiveSize(value.PrimitiveType);
+			CheckError(size != 0, "Unsupported custom attribute argument type");
+			auto bytes = reader.ReadBytes(size);
+			std::memcpy(&value.Bits, bytes.data(), size);
+			return value;
+		}
+
+		// ECMA-335 II.23.3 FieldOrPropType
+		SerializationType ReadFieldOrPropType(BlobReader& reader) const
+		{
+			auto type = static_cast<ElementType>(reader.ReadByte());
+			if (type == ElementType::SzArray)
+			{
+				auto elementType = ReadFieldOrPropType(reader);
+				CheckError(elementType.Type != ElementType::SzArray, "Nested arrays are not allowed in custom attributes");
+				return SerializationType{ ElementType::SzArray, elementType.EnumUnderlyingType, elementType.Type, elementType.EnumTypeName };
+			}
+
+			if (type == ElementType::Enum)
+			{
+				std::string_view enumTypeName;
+				CheckError(TryReadSerString(reader, enumTypeName), "Enum custom attribute argument has no type name");
+				return SerializationType{ ElementType::Enum, GetEnumUnderlyingType(enumTypeName), ElementType::End, enumTypeName };
+			}
+
+			CheckError(type == ElementType::String || type == ElementType::Type || type == ElementType::Boxed || GetPrimitiveSize(type) != 0,
+				"Invalid custom attribute argument type");
+			return SerializationType{ type, ElementType::End, ElementType::End, std::string_view() };
+		}
+
+		SerializationType GetSerializationType(const TypeSignature& parameter) const
+		{
+			auto type = parameter.GetElementType();
+			switch (type)
+			{
+			case ElementType::Object:
+				return SerializationType{ ElementType::Boxed, ElementType::End, ElementType::End, std::string_view() };
+			case ElementType::Class:
+			{
+				std::string_view typeNamespace;
+				std::string_view typeName;
+				CheckError(TryGetTypeName(parameter.GetTypeReference(), typeNamespace, typeName)
+					&& typeNamespace == "System" && typeName == "Type", "Unsupported custom attribute parameter type");
+				return SerializationType{ ElementType::Type, ElementType::End, ElementType::End, std::string_view() };
+			}
+			case ElementType::ValueType:
+				// Enums are the only value types allowed in attribute constructors
+				return SerializationType{ ElementType::Enum, GetEnumUnderlyingType(parameter.GetTypeReference()), ElementType::End, std::string_view() };
+			case ElementType::SzArray:
+			{
+				auto elementType = GetSerializationType(parameter.GetElementTypeSignature());
+				CheckError(elementType.Type != ElementType::SzArray, "Nested arrays are not allowed in custom attributes");
+				return SerializationType{ ElementType::SzArray, elementType.EnumUnderlyingType, elementType.Type, std::string_view() };
+			}
+			default:
+				CheckError(type == ElementType::String || GetPrimitiveSize(type) != 0, "Unsupported custom attribute parameter type");
+				return SerializationType{ type, ElementType::End, ElementType::End, std::string_view() };
+			}
+		}
+
+		// The underlying type is only known for enums declared in this module; enums of referenced
+		// assemblies are assumed to be int, which is what the C# and VB compilers default to.
+		ElementType GetEnumUnderlyingType(RowReference enumType) const
+		{
+			if (enumType.Table == TableId::TypeRef)
+			{
+				std::string_view typeNamespace;
+				std::string_view typeName;
+				if (TryGetTypeName(enumType, typeNamespace, typeName))
+				{
+					enumType = RowReference{ TableId::TypeDef, tables_.GetTypeDefNameIndex().Find(typeNamespace, typeName) };
+				}
+			}
+
+			if (enumType.Table != TableId::TypeDef || enumType.Rid == 0)
+			{
+				return ElementType::I4;
+			}
+
+			auto typeDefTable = tables_.GetTypeDefTable();
+			auto fieldCount = tables_.GetTable(TableId::Field).GetRowCount();
+			CheckError(enumType.Rid <= typeDefTable.GetRowCount(), "Invalid TypeDef index");
+
+			auto firstField = tables_.GetRow<TableId::TypeDef>(enumType.Rid - 1).Get(TypeDefSchema::FieldList);
+			auto lastField = enumType.Rid < typeDefTable.GetRowCount()
+				? tables_.GetRow<TableId::TypeDef>(enumType.Rid).Get(TypeDefSchema::FieldList)
+				: fieldCount + 1;
+
+			// value__ is the only instance field of an enum
+			for (auto field = firstField; field < lastField && field <= fieldCount; ++field)
+			{
+				auto fieldRow = tables_.GetRow<TableId::Field>(field - 1);
+				if ((fieldRow.Get(FieldSchema::Flags) & FieldAttributesStatic) == 0)
+				{
+					return FieldSignature(fieldRow.GetBlob(FieldSchema::Signature)).GetType().GetElementType();
+				}
+			}
+
+			return ElementType::I4;
+		}
+
+		// Enum type names of named arguments are serialized as "Namespace.Name[, Assembly]"
+		ElementType GetEnumUnderlyingType(std::string_view serializedTypeName) const
+		{
+			auto typeName = serializedTypeName.substr(0, serializedTypeName.find(','));
+			if (typeName.find('+') != std::string_view::npos)
+			{
+				return ElementType::I4;
+			}
+
+			auto separator = typeName.rfind('.');
+			auto typeNamespace = separator == std::string_view::npos ? std::string_view() : typeName.substr(0, separator);
+			typeName = separator == std::string_view::npos ? typeName : typeName.substr(separator + 1);
+			return GetEnumUnderlyingType(RowReference{ TableId::TypeDef, tables_.GetTypeDefNameIndex().Find(typeNamespace, typeName) });
+		}
+
+		bool TryGetTypeName(RowReference type, std::string_view& typeNamespace, std::string_view& typeName) const
+		{
+			if (type.Rid == 0 || (type.Table != TableId::TypeRef && type.Table != TableId::TypeDef))
+			{
+				return false;
+			}
+
+			CheckError(type.Rid <= tables_.GetTable(type.Table).GetRowCount(), "Invalid type index");
+			if (type.Table == TableId::TypeRef)
+			{
+				auto row = tables_.GetRow<TableId::TypeRef>(type.Rid - 1);
+				typeNamespace = row.GetString(TypeRefSchema::TypeNamespace);
+				typeName = row.GetString(TypeRefSchema::TypeName);
+				return true;
+			}
+
+			auto row = tables_.GetRow<TableId::TypeDef>(type.Rid - 1);
+			typeNamespace = row.GetString(TypeDefSchema::TypeNamespace);
+			typeName = row.GetString(TypeDefSchema::TypeName);
+			return true;
+		}
+
+		// An attribute declared in the assembly itself is referenced by its MethodDef constructor.
+		// The owning type is the last TypeDef whose method list starts at or before the method.
+		bool TryGetMethodDefOwnerName(std::uint32_t methodDefIndex, std::string_view& typeNamespace, std::string_view& typeName) const
+		{
+			std::uint32_t ownerRowIndex = 0;
+			bool ownerFound = false;
+			ForEachRow<TableId::TypeDef>(tables_, [&](const auto& row)
+			{
+				if (row.Get(TypeDefSchema::MethodList) > methodDefIndex)
+				{
+					return false;
+				}
+
+				ownerRowIndex = row.GetIndex();
+				ownerFound = true;
+				return true;
+			});
+
+			if (!ownerFound)
+			{
+				return false;
+			}
+
+			return TryGetTypeName(RowReference{ TableId::TypeDef, ownerRowIndex + 1 }, typeNamespace, typeName);
+		}
+
+		// ECMA-335 II.23.3 SerString; returns false for the null string
+		static bool TryReadSerString(BlobReader& reader, std::string_view& value)
+		{
+			if (reader.PeekByte() == NullString)
+			{
+				reader.ReadByte();
+				value = std::string_view();
+				return false;
+			}
+
+			auto bytes = reader.ReadBytes(reader.ReadCompressedUInt32());
+			value = std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+			return true;
+		}
+
+		static std::uint32_t GetPrimitiveSize(ElementType type)
+		{
+			switch (type)
+			{
+			case ElementType::Boolean:
+			case ElementType::I1:
+			case ElementType::U1:
+				return 1;
+			case ElementType::Char:
+			case ElementType::I2:
+			case ElementType::U2:
+				return 2;
+			case ElementType::I4:
+			case ElementType::U4:
+			case ElementType::R4:
+				return 4;
+			case ElementType::I8:
+			case ElementType::U8:
+			case ElementType::R8:
+				return 8;
+			default:
+				return 0;
+			}
+		}
+
+		static const std::uint16_t Prolog = 0x0001;
+		static const std::uint8_t NullString = 0xFF;
+		static const std::uint32_t NullArrayLength = 0xFFFFFFFF;
+		static const std::uint32_t FieldAttributesStatic = 0x0010;
+
+		const MetadataTables& tables_;
+	};
+}
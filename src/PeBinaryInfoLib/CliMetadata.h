@@ -1,86 +1,19 @@
 #pragma once
 #include "stdafx.h"
 #include "Helpers.h"
+#include "CliMetadataSchema.h"
+#include "CliSignature.h"
 
 namespace peinfo
 {
-	enum class TableId
-	{
-		MinTableId = 0,
-		Module = 0,
-		TypeRef = 1,
-		TypeDef = 2,
-		Field = 4,
-		MethodDef = 6,
-		Param = 8,
-		InterfaceImpl = 9,
-		MemberRef = 10,
-		Constant = 11,
-		CustomAttribute = 12,
-		FieldMarshal = 13,
-		DeclSecurity = 14,
-		ClassLayout = 15,
-		FieldLayout = 16,
-		StandAloneSig = 17,
-		EventMap = 18,
-		Event = 20,
-		PropertyMap = 21,
-		Property = 23,
-		MethodSemantics = 24,
-		MethodImpl = 25,
-		ModuleRef = 26,
-		TypeSpec = 27,
-		ImplMap = 28,
-		FieldRVA = 29,
-		Assembly = 32,
-		AssemblyProcessor = 33,
-		AssemblyOS = 34,
-		AssemblyRef = 35,
-		AssemblyRefProcessor = 36,
-		AssemblyRefOS = 37,
-		File = 38,
-		ExportedType = 39,
-		ManifestResource = 40,
-		NestedClass = 41,
-		GenericParam = 42,
-		MethodSpec = 43,
-		GenericParamConstraint = 44,
-
-		MaxTableId = 63,
-		NotUsed = 64
-	};
-
-	enum class ColumnType
-	{
-		Byte,
-		Word,
-		Dword,
-		String,
-		Guid,
-		Blob,
-		
-		// single table indicies
-		TypeDef,
-		Field,
-		MethodDef,
-		Param,
-
-		// coded indicies
-		ResolutionScope,
-		TypeDefOrRef,
-		MemberRefParent,
-		HasConstant,
-		HasCustomAttribute,
-		CustomAttributeType
-	};
-
 	class SchemaInfoProvider
 	{
 		DECLARE_NONCOPYABLE(SchemaInfoProvider);
 	public:
-		SchemaInfoProvider(std::array<std::uint32_t, 64> tableRowCounts, BYTE heapIndexSizes)
-			: tableRowCounts_(tableRowCounts), heapIndexSizes_(heapIndexSizes)
+		SchemaInfoProvider(std::array<std::uint32_t, 64> tableRowCounts, BYTE heapIndexSizes, ULONG64 sortedTables)
+			: tableRowCounts_(tableRowCounts), heapIndexSizes_(heapIndexSizes), sortedTables_(sortedTables)
 		{
+			ComputeLayout();
 		}
 
 		std::uint32_t GetRowCount(TableId tableId) const
@@ -90,54 +23,114 @@ namespace peinfo
 			return tableRowCounts_[static_cast<int>(tableId)];
 		}
 
+		bool IsSorted(TableId tableId) const
+		{
+			return sortedTables_.test(static_cast<std::size_t>(tableId));
+		}
+
+		std::uint32_t GetColumnCount(TableId tableId) const
+		{
+			return tableLayouts_[static_cast<int>(tableId)].ColumnCount;
+		}
+
 		std::uint32_t GetColumnTypeSize(TableId tableId, std::uint32_t columnIndex) const
 		{
-			auto columnType = GetColumnTypesByTableId(tableId).at(columnIndex);
-			return GetColumnSizeByType(columnType);
+			// check
+
+			return tableLayouts_[static_cast<int>(tableId)].ColumnSizes[columnIndex];
 		}
 
 		std::uint32_t GetColumnOffset(TableId tableId, std::uint32_t columnIndex) const
 		{
 			// check
 
-			std::uint32_t resultSize = 0;
-			auto columnTypes = GetColumnTypesByTableId(tableId);
-			for (std::uint32_t i = 0; i < columnIndex; ++i)
-			{
-				auto columnType = columnTypes[i];
-				resultSize += GetColumnSizeByType(columnType);
-			}
-
-			return resultSize;
+			return tableLayouts_[static_cast<int>(tableId)].ColumnOffsets[columnIndex];
 		}
 
 		std::uint32_t GetRowSize(TableId tableId) const
 		{
-			std::uint32_t resultSize = 0;
-			for (auto columnType : GetColumnTypesByTableId(tableId))
-			{
-				resultSize += GetColumnSizeByType(columnType);
-			}
-
-			return resultSize;
+			return tableLayouts_[static_cast<int>(tableId)].RowSize;
 		}
 
 		std::uint32_t GetTableOffset(TableId tableId) const
 		{
-			std::uint32_t tableOffset = 0;
-			auto tableIndex = static_cast<std::uint32_t>(tableId);
-			for (uint32_t i = 0; i < tableIndex; i++)
-			{
-				auto currentTableId = static_cast<TableId>(i);
-				tableOffset += GetTableSize(currentTableId);
-			}
+			return tableOffsets_[static_cast<int>(tableId)];
+		}
 
-			return tableOffset;
+		std::uint64_t GetTableSize(TableId tableId) const
+		{
+			return static_cast<std::uint64_t>(GetRowCount(tableId)) * GetRowSize(tableId);
 		}
 
-		std::uint32_t GetTableSize(TableId tableId) const
+		std::uint32_t GetTablesSize() const
 		{
-			return GetRowCount(tableId) * GetRowSize(tableId);
+			return tableOffsets_[TableCount];
+		}
+
+		static const std::uint32_t TableCount = 64;
+		static const std::uint32_t MaxColumnCount = 9;
+
+		struct TableLayout
+		{
+			std::uint32_t RowSize;
+			std::uint32_t ColumnCount;
+			std::uint32_t WideMask;
+			std::array<std::uint8_t, MaxColumnCount> ColumnOffsets;
+			std::array<std::uint8_t, MaxColumnCount> ColumnSizes;
+		};
+
+		const TableLayout& GetTableLayout(TableId tableId) const
+		{
+			return tableLayouts_[static_cast<int>(tableId)];
+		}
+
+	private:
+
+		// Everything below depends only on the row counts and heap sizes, so it is computed
+		// once per module. Cell reads are then a multiply and an add with no allocation.
+		void ComputeLayout()
+		{
+			for (std::size_t i = 0; i < columnTypeSizes_.size(); ++i)
+			{
+				columnTypeSizes_[i] = static_cast<std::uint8_t>(GetColumnSizeByType(static_cast<ColumnType>(i)));
+			}
+
+			// Row counts come from the image, so the sum is taken in 64 bits and must fit the 32-bit
+			// offsets the tables are read with; the reader then checks it against the metadata size
+			std::uint64_t tableOffset = 0;
+			for (std::uint32_t i = 0; i < TableCount; ++i)
+			{
+				auto tableId = static_cast<TableId>(i);
+				auto& layout = tableLayouts_[i];
+				layout = TableLayout{};
+
+				VisitTableSchema(tableId, [this, &layout](auto schema)
+				{
+					std::uint32_t wideMask = 0;
+					for (auto columnType : decltype(schema)::Columns)
+					{
+						auto columnSize = columnTypeSizes_[static_cast<std::size_t>(columnType)];
+						layout.ColumnOffsets[layout.ColumnCount] = static_cast<std::uint8_t>(layout.RowSize);
+						layout.ColumnSizes[layout.ColumnCount] = columnSize;
+						layout.RowSize += columnSize;
+
+						if (!IsFixedSizeColumnType(columnType) && columnSize == sizeof(std::uint32_t))
+						{
+							wideMask |= 1u << TableTraits<decltype(schema)::Id>::GetWidthClass(layout.ColumnCount);
+						}
+
+						++layout.ColumnCount;
+					}
+
+					layout.WideMask = wideMask;
+				});
+
+				tableOffsets_[i] = static_cast<std::uint32_t>(tableOffset);
+				tableOffset += GetTableSize(tableId);
+				CheckError(tableOffset <= std::numeric_limits<std::uint32_t>::max(), "Metadata tables are too large");
+			}
+
+			tableOffsets_[TableCount] = static_cast<std::uint32_t>(tableOffset);
 		}
 
 	private:
@@ -151,301 +144,123 @@ namespace peinfo
 			case ColumnType::String: return ((heapIndexSizes_ & 1) == 0) ? 2 : 4;
 			case ColumnType::Guid: return ((heapIndexSizes_ & 2) == 0) ? 2 : 4;
 			case ColumnType::Blob: return ((heapIndexSizes_ & 4) == 0) ? 2 : 4;
-			case ColumnType::ResolutionScope: 
-				return GetCodedIndexSize(
-				{ 
-					TableId::Module, 
-					TableId::ModuleRef, 
-					TableId::AssemblyRef, 
-					TableId::TypeRef 
-				});
-			case ColumnType::TypeDefOrRef: 
-				return GetCodedIndexSize(
-				{ 
-					TableId::TypeDef, 
-					TableId::TypeRef, 
-					TableId::TypeSpec 
-				});
-			case ColumnType::MemberRefParent: 
-				return GetCodedIndexSize(
-				{
-					TableId::TypeRef, 
-					TableId::ModuleRef, 
-					TableId::MethodDef, 
-					TableId::TypeSpec, 
-					TableId::TypeDef
-				});
-			case ColumnType::HasConstant:
-				return GetCodedIndexSize(
-				{
-					TableId::Param,
-					TableId::Field,
-					TableId::Property
-				});
-			case ColumnType::HasCustomAttribute:
-				return GetCodedIndexSize(
-					{
-						TableId::MethodDef,
-						TableId::Field,
-						TableId::TypeRef,
-						TableId::TypeDef,
-						TableId::Param,
-						TableId::InterfaceImpl,
-						TableId::MemberRef,
-						TableId::Module,
-						TableId::DeclSecurity,
-						TableId::Property,
-						TableId::Event,
-						TableId::StandAloneSig,
-						TableId::ModuleRef,
-						TableId::TypeSpec,
-						TableId::Assembly,
-						TableId::AssemblyRef,
-						TableId::File,
-						TableId::ExportedType,
-						TableId::ManifestResource,
-						TableId::GenericParam,
-						TableId::GenericParamConstraint,
-						TableId::MethodSpec
-					});
-			case ColumnType::CustomAttributeType:
-				return GetCodedIndexSize(
-					{
-						TableId::NotUsed,
-						TableId::NotUsed,
-						TableId::MethodDef,
-						TableId::MemberRef,
-						TableId::NotUsed
-					});
-			case ColumnType::TypeDef:
-				return GetCodedIndexSize({ TableId::TypeDef });
-			case ColumnType::Field:
-				return GetCodedIndexSize({ TableId::Field });
-			case ColumnType::MethodDef:
-				return GetCodedIndexSize({ TableId::MethodDef });
-			case ColumnType::Param:
-				return GetCodedIndexSize({ TableId::Param });
 			default:
+				if (IsIndexColumnType(columnType))
+				{
+					return GetIndexSize(GetIndexSchema(columnType));
+				}
+
 				throw std::logic_error("not implemented");
 			}
 		}
 
-		std::vector<ColumnType> GetColumnTypesByTableId(TableId tableId) const
+		std::uint32_t GetIndexSize(const IndexSchema& indexSchema) const
 		{
-			switch (tableId)
+			std::uint32_t maxRowCount = 0;
+			for (std::uint32_t i = 0; i < indexSchema.TableCount; ++i)
 			{
-			case TableId::Module:
-				return
-				{
-					ColumnType::Word,
-					ColumnType::String,
-					ColumnType::Guid,
-					ColumnType::Guid,
-					ColumnType::Guid
-				};
-			case TableId::TypeRef:
-				return
-				{
-					ColumnType::ResolutionScope,
-					ColumnType::String,
-					ColumnType::String
-				};
-			case TableId::TypeDef:
-				return
-				{
-					ColumnType::Dword,
-					ColumnType::String,
-					ColumnType::String,
-					ColumnType::TypeDefOrRef,
-					ColumnType::Field,
-					ColumnType::MethodDef
-				};
-			case TableId::Field: 
-				return
-				{
-					ColumnType::Word,
-					ColumnType::String,
-					ColumnType::Blob
-				};
-			case TableId::MethodDef: 
-				return 
-				{
-					ColumnType::Dword,
-					ColumnType::Word,
-					ColumnType::Word,
-					ColumnType::String,
-					ColumnType::Blob,
-					ColumnType::Param
-				};
-			case TableId::Param: 
-				return
+				if (indexSchema.Tables[i] != TableId::NotUsed)
 				{
-					ColumnType::Word,
-					ColumnType::Word,
-					ColumnType::String
-				};
-			case TableId::InterfaceImpl:
-				return
-				{
-					ColumnType::TypeDef,
-					ColumnType::TypeDefOrRef
-				};
-			case TableId::MemberRef:
-				return
-				{
-					ColumnType::MemberRefParent,
-					ColumnType::String,
-					ColumnType::Blob
-				};
-			case TableId::Constant: 
-				return
-				{
-					ColumnType::Byte,
-					ColumnType::HasConstant,
-					ColumnType::Blob
-				};
-			case TableId::CustomAttribute: 
-				return
-				{
-					ColumnType::HasCustomAttribute,
-					ColumnType::CustomAttributeType,
-					ColumnType::Blob
-				};
-			case TableId::ModuleRef: break;
-			case TableId::TypeSpec: break;
-			case TableId::AssemblyRef: break;
-			default:
-			{
-				return {};
-			}
+					maxRowCount = std::max(maxRowCount, GetRowCount(indexSchema.Tables[i]));
+				}
 			}
 
-			return {};
-		}
-
-		constexpr std::uint32_t BitsNeeded(std::uint32_t n) const
-		{
-			return n <= 1 ? 0 : 1 + BitsNeeded((n + 1) / 2);
-		}
-
-		bool CompareRowCount(TableId left, TableId right) const
-		{
-			return GetRowCount(left) < GetRowCount(right);
-		}
-
-		std::uint32_t GetMaxRowCount(std::vector<TableId> tableIds) const
-		{
-			// check tableIds.empty() == false
-
-			std::vector<TableId> validTableIds(tableIds.size());
-			auto validTableIdsEnd = std::remove_copy(tableIds.begin(), tableIds.end(), validTableIds.begin(), TableId::NotUsed);
-			if (validTableIdsEnd != validTableIds.end())
-			{
-				validTableIds.erase(validTableIdsEnd, validTableIds.end());
-			}			
-
-			auto tableIdWithMaxRowCount = *std::max_element(
-				validTableIds.begin(),
-				validTableIds.end(),
-				[this](TableId left, TableId right) { return CompareRowCount(left, right); });
-			return GetRowCount(tableIdWithMaxRowCount);
-		}
-
-		std::uint32_t GetCodedIndexSize(std::vector<TableId> indexedTableIds) const
-		{
-			auto indexedTableCount = indexedTableIds.size();
-			auto maxRowCount = GetMaxRowCount(indexedTableIds);
-			auto wordIsEnough = BitsNeeded(indexedTableCount) + BitsNeeded(maxRowCount) <= std::numeric_limits<std::uint16_t>::digits;
+			auto rowIndexBits = std::numeric_limits<std::uint16_t>::digits - indexSchema.TagBits;
+			auto wordIsEnough = maxRowCount < (1u << rowIndexBits);
 			return wordIsEnough ? 2 : 4;
 		}
 
 		std::array<std::uint32_t, 64>  tableRowCounts_;
 		BYTE heapIndexSizes_;
+		std::bitset<TableCount> sortedTables_;
+		std::array<std::uint8_t, ColumnTypeCount> columnTypeSizes_;
+		std::array<TableLayout, TableCount> tableLayouts_;
+		std::array<std::uint32_t, TableCount + 1> tableOffsets_;
 	};
 
 	class StringHeap
 	{
 		DECLARE_NONCOPYABLE(StringHeap);
 	public:
-		StringHeap(void* startAddress)
-			: startAddress_(startAddress)
+		StringHeap(void* startAddress, std::uint32_t size)
+			: startAddress_(startAddress), size_(size)
 		{
 		}
 
 		std::string_view GetString(std::uint32_t index) const
 		{
-			return std::string_view(AddOffset<char>(startAddress_, index));
+			CheckError(index < size_, "String index is outside of the #Strings heap");
+
+			auto string = AddOffset<const char>(startAddress_, index);
+			auto end = static_cast<const char*>(std::memchr(string, 0, size_ - index));
+			CheckError(end != nullptr, "String is not terminated in the #Strings heap");
+			return std::string_view(string, static_cast<std::size_t>(end - string));
 		}
 
 	private:
 		void* startAddress_;
+		std::uint32_t size_;
 	};
 
 	class GuidHeap
 	{
 		DECLARE_NONCOPYABLE(GuidHeap);
 	public:
-		GuidHeap(void* startAddress)
-			: startAddress_(startAddress)
+		GuidHeap(void* startAddress, std::uint32_t size)
+			: startAddress_(startAddress), size_(size)
 		{
 		}
 
+		// ECMA-335 II.24.2.5: the index counts GUIDs from 1; 0 is the null GUID.
 		GUID GetGuid(std::uint32_t index) const
 		{
-			return *AddOffset<GUID>(startAddress_, index);
+			if (index == 0)
+			{
+				return GUID{};
+			}
+
+			CheckError(index - 1 < size_ / sizeof(GUID), "GUID index is outside of the #GUID heap");
+
+			GUID guid;
+			std::memcpy(&guid, AddOffset<const std::uint8_t>(startAddress_, static_cast<ptrdiff_t>((index - 1) * sizeof(GUID))), sizeof(GUID));
+			return guid;
 		}
 
 	private:
 		void* startAddress_;
+		std::uint32_t size_;
 	};
 
 	class BlobHeap
 	{
 		DECLARE_NONCOPYABLE(BlobHeap);
 	public:
-		BlobHeap(void* startAddress)
-			: startAddress_(startAddress)
+		BlobHeap(void* startAddress, std::uint32_t size)
+			: startAddress_(startAddress), size_(size)
 		{
 		}
 
-		std::vector<std::uint8_t> GetBlob(std::uint32_t index) const
+		// ECMA-335 II.24.2.4: every blob is prefixed with its size as a compressed unsigned integer.
+		Span<const std::uint8_t> GetBlob(std::uint32_t index) const
 		{
-			std::uint32_t size = 0;
-			std::uint8_t* data = nullptr;
-			std::bitset<8> firstByte = *AddOffset<std::uint8_t>(startAddress_, index);
+			CheckError(index < size_, "Blob index is outside of the #Blob heap");
 
-			if (firstByte.test(7))
-			{
-				if (firstByte.test(6))
-				{
-					size = *AddOffset<std::uint32_t>(startAddress_, index);
-					data = AddOffset<std::uint8_t>(startAddress_, index + sizeof(std::uint32_t));
-				}
-				else
-				{
-					size = *AddOffset<std::uint16_t>(startAddress_, index);
-					data = AddOffset<std::uint8_t>(startAddress_, index + sizeof(std::uint16_t));
-				}
-			}
-			else
-			{
-				size = *AddOffset<std::uint8_t>(startAddress_, index);
-				data = AddOffset<std::uint8_t>(startAddress_, index + sizeof(std::uint8_t));
-			}
-
-			return std::vector<std::uint8_t>(data, data + size);
+			BlobReader reader(Span<const std::uint8_t>(AddOffset<const std::uint8_t>(startAddress_, index), size_ - index));
+			auto blobSize = reader.ReadCompressedUInt32();
+			return reader.ReadBytes(blobSize);
 		}
 
 	private:
 		void* startAddress_;
+		std::uint32_t size_;
 	};
 
 	class Heaps
 	{
 		DECLARE_NONCOPYABLE(Heaps);
 	public:
-		Heaps(void* stringHeapAddress, void* guidHeapAddress, void* blobHeapAddress)
-			: stringHeap_(stringHeapAddress), guidHeap_(guidHeapAddress), blobHeap_(blobHeapAddress)
+		Heaps(void* stringHeapAddress, std::uint32_t stringHeapSize, void* guidHeapAddress, std::uint32_t guidHeapSize, void* blobHeapAddress, std::uint32_t blobHeapSize)
+			: stringHeap_(stringHeapAddress, stringHeapSize), guidHeap_(guidHeapAddress, guidHeapSize), blobHeap_(blobHeapAddress, blobHeapSize)
 		{
 		}
 
@@ -470,6 +285,124 @@ namespace peinfo
 		BlobHeap blobHeap_;
 	};
 
+	template<std::uint32_t Size>
+	std::uint32_t LoadColumnValue(const std::uint8_t* address)
+	{
+		static_assert(Size == sizeof(std::uint8_t) || Size == sizeof(std::uint16_t) || Size == sizeof(std::uint32_t), "invalid column size");
+
+		typename std::conditional<Size == sizeof(std::uint8_t), std::uint8_t,
+			typename std::conditional<Size == sizeof(std::uint16_t), std::uint16_t, std::uint32_t>::type>::type value;
+		std::memcpy(&value, address, Size);
+		return value;
+	}
+
+	inline std::uint32_t LoadColumnValue(const std::uint8_t* address, std::uint32_t size)
+	{
+		switch (size)
+		{
+		case sizeof(std::uint8_t):
+			return LoadColumnValue<sizeof(std::uint8_t)>(address);
+		case sizeof(std::uint16_t):
+			return LoadColumnValue<sizeof(std::uint16_t)>(address);
+		default:
+			return LoadColumnValue<sizeof(std::uint32_t)>(address);
+		}
+	}
+
+	const std::uint32_t DynamicLayout = ~0u;
+
+	// Typed accessors shared by both row flavours. Derived::Get(column) returns the raw cell value.
+	template<class Derived, TableId Id>
+	class RowAccessors
+	{
+	public:
+		std::uint32_t GetIndex() const
+		{
+			return rowIndex_;
+		}
+
+		// 1-based row identifier as used by metadata tokens and indices into this table
+		std::uint32_t GetRid() const
+		{
+			return rowIndex_ + 1;
+		}
+
+		template<std::uint32_t Column>
+		std::string_view GetString(ColumnTag<Id, Column> column) const
+		{
+			static_assert(TableSchema<Id>::Columns[Column] == ColumnType::String, "column is not a #Strings index");
+			return heaps_->GetStringHeap().GetString(static_cast<const Derived*>(this)->Get(column));
+		}
+
+		template<std::uint32_t Column>
+		GUID GetGuid(ColumnTag<Id, Column> column) const
+		{
+			static_assert(TableSchema<Id>::Columns[Column] == ColumnType::Guid, "column is not a #GUID index");
+			return heaps_->GetGuidHeap().GetGuid(static_cast<const Derived*>(this)->Get(column));
+		}
+
+		template<std::uint32_t Column>
+		Span<const std::uint8_t> GetBlob(ColumnTag<Id, Column> column) const
+		{
+			static_assert(TableSchema<Id>::Columns[Column] == ColumnType::Blob, "column is not a #Blob index");
+			return heaps_->GetBlobHeap().GetBlob(static_cast<const Derived*>(this)->Get(column));
+		}
+
+	protected:
+		RowAccessors(const std::uint8_t* address, std::uint32_t rowIndex, const Heaps& heaps)
+			: address_(address), rowIndex_(rowIndex), heaps_(&heaps)
+		{
+		}
+
+		const std::uint8_t* address_;
+		std::uint32_t rowIndex_;
+		const Heaps* heaps_;
+	};
+
+	// Row whose column widths are fixed at compile time by WideMask (see TableTraits), so every
+	// accessor compiles down to a single load at a constant offset.
+	template<TableId Id, std::uint32_t WideMask = DynamicLayout>
+	class Row : public RowAccessors<Row<Id, WideMask>, Id>
+	{
+	public:
+		using Traits = TableTraits<Id>;
+
+		static constexpr std::uint32_t Size = Traits::GetRowSize(WideMask);
+
+		Row(const std::uint8_t* address, std::uint32_t rowIndex, const Heaps& heaps)
+			: RowAccessors<Row<Id, WideMask>, Id>(address, rowIndex, heaps)
+		{
+		}
+
+		template<std::uint32_t Column>
+		std::uint32_t Get(ColumnTag<Id, Column>) const
+		{
+			constexpr auto offset = Traits::GetColumnOffset(Column, WideMask);
+			constexpr auto size = Traits::GetColumnSize(Column, WideMask);
+			return LoadColumnValue<size>(this->address_ + offset);
+		}
+	};
+
+	// Row whose column widths are looked up in the module's precomputed layout. Used for random access.
+	template<TableId Id>
+	class Row<Id, DynamicLayout> : public RowAccessors<Row<Id, DynamicLayout>, Id>
+	{
+	public:
+		Row(const std::uint8_t* address, std::uint32_t rowIndex, const SchemaInfoProvider::TableLayout& layout, const Heaps& heaps)
+			: RowAccessors<Row<Id, DynamicLayout>, Id>(address, rowIndex, heaps), layout_(&layout)
+		{
+		}
+
+		template<std::uint32_t Column>
+		std::uint32_t Get(ColumnTag<Id, Column>) const
+		{
+			return LoadColumnValue(this->address_ + layout_->ColumnOffsets[Column], layout_->ColumnSizes[Column]);
+		}
+
+	private:
+		const SchemaInfoProvider::TableLayout* layout_;
+	};
+
 	class Table
 	{
 	public:
@@ -478,7 +411,8 @@ namespace peinfo
 			TableId tableId, 
 			std::shared_ptr<SchemaInfoProvider> schemaInfoProvider, 
 			std::shared_ptr<Heaps> heaps)
-		: startAddress_(startAddress), tableId_(tableId), schemaInfoProvider_(schemaInfoProvider), heaps_(heaps)
+		: startAddress_(startAddress), tableId_(tableId), schemaInfoProvider_(schemaInfoProvider), heaps_(heaps),
+			rowSize_(schemaInfoProvider->GetRowSize(tableId))
 		{			
 		}
 
@@ -487,17 +421,52 @@ namespace peinfo
 			return schemaInfoProvider_->GetRowCount(tableId_);
 		}
 
+		const void* GetStartAddress() const
+		{
+			return startAddress_;
+		}
+
+		const SchemaInfoProvider::TableLayout& GetLayout() const
+		{
+			return schemaInfoProvider_->GetTableLayout(tableId_);
+		}
+
+		const Heaps& GetHeaps() const
+		{
+			return *heaps_;
+		}
+
+		bool IsSorted() const
+		{
+			return schemaInfoProvider_->IsSorted(tableId_);
+		}
+
+		template<TableId Id>
+		Row<Id> GetRow(std::uint32_t rowIndex) const
+		{
+			// check rowIndex
+
+			auto address = AddOffset<const std::uint8_t>(startAddress_, static_cast<ptrdiff_t>(rowIndex) * rowSize_);
+			return Row<Id>(address, rowIndex, GetLayout(), *heaps_);
+		}
+
 		std::string_view GetString(std::uint32_t rowIndex, std::uint32_t columnIndex) const
 		{
 			auto stringValueIndex = GetValue(rowIndex, columnIndex);
 			return heaps_->GetStringHeap().GetString(stringValueIndex);
 		}
 
+		Span<const std::uint8_t> GetBlob(std::uint32_t rowIndex, std::uint32_t columnIndex) const
+		{
+			auto blobValueIndex = GetValue(rowIndex, columnIndex);
+			return heaps_->GetBlobHeap().GetBlob(blobValueIndex);
+		}
+
 		std::uint32_t GetValue(std::uint32_t rowIndex, std::uint32_t columnIndex) const
 		{
 			// check rowIndex, columnIndex
 
-			auto offset = rowIndex * schemaInfoProvider_->GetRowSize(tableId_) + schemaInfoProvider_->GetColumnOffset(tableId_, columnIndex);
+			auto offset = rowIndex * rowSize_ + schemaInfoProvider_->GetColumnOffset(tableId_, columnIndex);
 			auto valueSize = schemaInfoProvider_->GetColumnTypeSize(tableId_, columnIndex);
 			return ReadValue(offset, valueSize);
 		}
@@ -522,19 +491,14 @@ namespace peinfo
 		TableId tableId_;
 		std::shared_ptr<SchemaInfoProvider> schemaInfoProvider_;
 		std::shared_ptr<Heaps> heaps_;
+		std::uint32_t rowSize_;
 	};
 
-	enum TypeDefTableColumns : std::uint32_t
-	{
-		TypeName = 1,
-		Namespace = 2,
-		MethodList = 5
-	};
-
+	template<TableId Id>
 	class TableWrapper
 	{
 	public:
-		TableWrapper(Table table)
+		TableWrapper(const Table& table)
 			: table_(table)
 		{
 		}
@@ -544,22 +508,16 @@ namespace peinfo
 			return table_.GetRowCount();
 		}
 
-	protected:
-		std::uint32_t GetValue(std::uint32_t rowIndex, std::uint32_t columnIndex) const
+		Row<Id> GetRow(std::uint32_t rowIndex) const
 		{
-			return table_.GetValue(rowIndex, columnIndex);
-		}
-
-		std::string_view GetString(std::uint32_t rowIndex, std::uint32_t columnIndex) const
-		{
-			return table_.GetString(rowIndex, columnIndex);
+			return table_.GetRow<Id>(rowIndex);
 		}
 
 	private:
 		Table table_;
 	};
 
-	class ModuleTable : public TableWrapper
+	class ModuleTable : public TableWrapper<TableId::Module>
 	{
 	public:
 		ModuleTable(const Table& table)
@@ -569,14 +527,11 @@ namespace peinfo
 
 		std::string_view GetName(std::uint32_t rowIndex) const
 		{
-			return GetString(rowIndex, NameColumnIndex);
+			return GetRow(rowIndex).GetString(ModuleSchema::Name);
 		}
-
-	private:
-		const std::uint32_t NameColumnIndex = 1;
 	};
 
-	class TypeDefTable : public TableWrapper
+	class TypeDefTable : public TableWrapper<TableId::TypeDef>
 	{
 	public:
 		TypeDefTable(const Table& table)
@@ -584,27 +539,23 @@ namespace peinfo
 		{
 		}
 
-		std::string_view GetTypeName(std::uint32_t rowIndex)
+		std::string_view GetTypeName(std::uint32_t rowIndex) const
 		{
-			return GetString(rowIndex, TypeNameColumnIndex);
+			return GetRow(rowIndex).GetString(TypeDefSchema::TypeName);
 		}
 
-		std::string_view GetTypeNamespace(std::uint32_t rowIndex)
+		std::string_view GetTypeNamespace(std::uint32_t rowIndex) const
 		{
-			return GetString(rowIndex, TypeNamespaceColumnIndex);
+			return GetRow(rowIndex).GetString(TypeDefSchema::TypeNamespace);
 		}
 
-		std::uint32_t GetMethodListIndex(std::uint32_t rowIndex)
+		std::uint32_t GetMethodListIndex(std::uint32_t rowIndex) const
 		{
-			return GetValue(rowIndex, MethodListIndex);
+			return GetRow(rowIndex).Get(TypeDefSchema::MethodList);
 		}
-
-		const std::uint32_t TypeNameColumnIndex = 1;
-		const std::uint32_t TypeNamespaceColumnIndex = 2;
-		const std::uint32_t MethodListIndex = 5;
 	};
 
-	class TypeRefTable : public TableWrapper
+	class TypeRefTable : public TableWrapper<TableId::TypeRef>
 	{
 	public:
 		TypeRefTable(const Table& table)
@@ -612,21 +563,18 @@ namespace peinfo
 		{
 		}
 
-		std::string_view GetTypeName(std::uint32_t rowIndex)
+		std::string_view GetTypeName(std::uint32_t rowIndex) const
 		{
-			return GetString(rowIndex, TypeNameColumnIndex);
+			return GetRow(rowIndex).GetString(TypeRefSchema::TypeName);
 		}
 
-		std::string_view GetTypeNamespace(std::uint32_t rowIndex)
+		std::string_view GetTypeNamespace(std::uint32_t rowIndex) const
 		{
-			return GetString(rowIndex, TypeNamespaceColumnIndex);
+			return GetRow(rowIndex).GetString(TypeRefSchema::TypeNamespace);
 		}
-
-		const std::uint32_t TypeNameColumnIndex = 1;
-		const std::uint32_t TypeNamespaceColumnIndex = 2;
 	};
 
-	class MethodDefTable : public TableWrapper
+	class MethodDefTable : public TableWrapper<TableId::MethodDef>
 	{
 	public:
 		MethodDefTable(const Table& table)
@@ -634,15 +582,18 @@ namespace peinfo
 		{
 		}
 
-		std::string_view GetMethodName(std::uint32_t rowIndex)
+		std::string_view GetMethodName(std::uint32_t rowIndex) const
 		{
-			return GetString(rowIndex, MethodNameColumnIndex);
+			return GetRow(rowIndex).GetString(MethodDefSchema::Name);
 		}
 
-		const std::uint32_t MethodNameColumnIndex = 3;
+		Span<const std::uint8_t> GetSignature(std::uint32_t rowIndex) const
+		{
+			return GetRow(rowIndex).GetBlob(MethodDefSchema::Signature);
+		}
 	};
 
-	class MemberRefTable : public TableWrapper
+	class MemberRefTable : public TableWrapper<TableId::MemberRef>
 	{
 	public:
 		MemberRefTable(const Table& table)
@@ -650,21 +601,47 @@ namespace peinfo
 		{
 		}
 		
-		std::uint32_t GetParentIndex(std::uint32_t rowIndex)
+		std::uint32_t GetParentIndex(std::uint32_t rowIndex) const
 		{
-			return GetValue(rowIndex, ParentIndexColumnIndex);
+			return GetRow(rowIndex).Get(MemberRefSchema::Class);
 		}
 
-		std::string_view GetMethodName(std::uint32_t rowIndex)
+		std::string_view GetMethodName(std::uint32_t rowIndex) const
 		{
-			return GetString(rowIndex, MethodNameColumnIndex);
+			return GetRow(rowIndex).GetString(MemberRefSchema::Name);
 		}
 
-		const std::uint32_t ParentIndexColumnIndex = 0;
-		const std::uint32_t MethodNameColumnIndex = 1;
+		Span<const std::uint8_t> GetSignature(std::uint32_t rowIndex) const
+		{
+			return GetRow(rowIndex).GetBlob(MemberRefSchema::Signature);
+		}
 	};
 
-	class AssemblyTable : public TableWrapper
+	class CustomAttributeTable : public TableWrapper<TableId::CustomAttribute>
+	{
+	public:
+		CustomAttributeTable(const Table& table)
+			: TableWrapper(table)
+		{
+		}
+
+		std::uint32_t GetParentIndex(std::uint32_t rowIndex) const
+		{
+			return GetRow(rowIndex).Get(CustomAttributeSchema::Parent);
+		}
+
+		std::uint32_t GetTypeIndex(std::uint32_t rowIndex) const
+		{
+			return GetRow(rowIndex).Get(CustomAttributeSchema::Type);
+		}
+
+		Span<const std::uint8_t> GetValueBlob(std::uint32_t rowIndex) const
+		{
+			return GetRow(rowIndex).GetBlob(CustomAttributeSchema::Value);
+		}
+	};
+
+	class AssemblyTable : public TableWrapper<TableId::Assembly>
 	{
 	public:
 		AssemblyTable(const Table& table)
@@ -672,7 +649,137 @@ namespace peinfo
 		{
 		}
 
+		std::uint16_t GetMajorVersion(std::uint32_t rowIndex) const
+		{
+			return static_cast<std::uint16_t>(GetRow(rowIndex).Get(AssemblySchema::MajorVersion));
+		}
+
+		std::uint16_t GetMinorVersion(std::uint32_t rowIndex) const
+		{
+			return static_cast<std::uint16_t>(GetRow(rowIndex).Get(AssemblySchema::MinorVersion));
+		}
+
+		std::uint16_t GetBuildNumber(std::uint32_t rowIndex) const
+		{
+			return static_cast<std::uint16_t>(GetRow(rowIndex).Get(AssemblySchema::BuildNumber));
+		}
+
+		std::uint16_t GetRevisionNumber(std::uint32_t rowIndex) const
+		{
+			return static_cast<std::uint16_t>(GetRow(rowIndex).Get(AssemblySchema::RevisionNumber));
+		}
+
+		std::string_view GetName(std::uint32_t rowIndex) const
+		{
+			return GetRow(rowIndex).GetString(AssemblySchema::Name);
+		}
+	};
+
+	// Open-addressed hash index from (namespace, name) to the first TypeRef or TypeDef row with
+	// that name. Keys are read from the #Strings heap in place, so building it copies no strings.
+	template<TableId Id>
+	class TypeNameIndex
+	{
+		DECLARE_NONCOPYABLE(TypeNameIndex);
+	public:
+		explicit TypeNameIndex(const Table& table)
+			: table_(table)
+		{
+			auto rowCount = table.GetRowCount();
+			if (rowCount == 0)
+			{
+				return;
+			}
+
+			std::size_t capacity = 1;
+			while (capacity < static_cast<std::size_t>(rowCount) * 2)
+			{
+				capacity *= 2;
+			}
+
+			slots_.resize(capacity);
+			for (std::uint32_t i = 0; i < rowCount; ++i)
+			{
+				auto row = table.GetRow<Id>(i);
+				auto typeNamespace = row.GetString(Schema::TypeNamespace);
+				auto typeName = row.GetString(Schema::TypeName);
+				auto hash = GetHash(typeNamespace, typeName);
+				auto& slot = slots_[FindSlot(typeNamespace, typeName, hash)];
+				if (slot.Rid == 0)
+				{
+					slot = Slot{ hash, row.GetRid() };
+				}
+			}
+		}
+
+		// Returns the 1-based row id of the type or 0 if the table has no such type.
+		std::uint32_t Find(std::string_view typeNamespace, std::string_view typeName) const
+		{
+			if (slots_.empty())
+			{
+				return 0;
+			}
+
+			return slots_[FindSlot(typeNamespace, typeName, GetHash(typeNamespace, typeName))].Rid;
+		}
+
 	private:
+		using Schema = TableSchema<Id>;
+
+		struct Slot
+		{
+			std::uint32_t Hash;
+			std::uint32_t Rid;
+		};
+
+		// Linear probing; the table is at most half full, so an empty slot always ends the probe.
+		std::size_t FindSlot(std::string_view typeNamespace, std::string_view typeName, std::uint32_t hash) const
+		{
+			auto mask = slots_.size() - 1;
+			for (auto i = hash & mask; ; i = (i + 1) & mask)
+			{
+				const auto& slot = slots_[i];
+				if (slot.Rid == 0)
+				{
+					return i;
+				}
+
+				if (slot.Hash == hash)
+				{
+					auto row = table_.GetRow<Id>(slot.Rid - 1);
+					if (row.GetString(Schema::TypeName) == typeName && row.GetString(Schema::TypeNamespace) == typeNamespace)
+					{
+						return i;
+					}
+				}
+			}
+		}
+
+		// FNV-1a over "namespace\0name"
+		static std::uint32_t GetHash(std::string_view typeNamespace, std::string_view typeName)
+		{
+			std::uint32_t hash = 2166136261u;
+			auto append = [&hash](std::uint8_t value)
+			{
+				hash = (hash ^ value) * 16777619u;
+			};
+
+			for (auto c : typeNamespace)
+			{
+				append(static_cast<std::uint8_t>(c));
+			}
+
+			append(0);
+			for (auto c : typeName)
+			{
+				append(static_cast<std::uint8_t>(c));
+			}
+
+			return hash;
+		}
+
+		const Table& table_;
+		std::vector<Slot> slots_;
 	};
 
 	class MetadataTables
@@ -684,12 +791,11 @@ namespace peinfo
 			std::shared_ptr<SchemaInfoProvider> schemaInfoProvider, 
 			std::shared_ptr<Heaps> heaps)
 		{
-			auto currentTableStartAddress = tablesStartAddress;
-			for (size_t i = 0; i < 64; i++)
+			for (size_t i = 0; i < SchemaInfoProvider::TableCount; i++)
 			{
 				TableId tableId = static_cast<TableId>(i);
-				tables_.emplace_back(std::make_unique<Table>(currentTableStartAddress, tableId, schemaInfoProvider, heaps));
-				currentTableStartAddress = AddOffset<void>(currentTableStartAddress, schemaInfoProvider->GetTableSize(tableId));
+				auto tableStartAddress = AddOffset<void>(tablesStartAddress, schemaInfoProvider->GetTableOffset(tableId));
+				tables_.emplace_back(std::make_unique<Table>(tableStartAddress, tableId, schemaInfoProvider, heaps));
 			}
 		}
 
@@ -713,15 +819,216 @@ namespace peinfo
 			return MethodDefTable(GetTableById(TableId::MethodDef));
 		}
 
+		MemberRefTable GetMemberRefTable() const
+		{
+			return MemberRefTable(GetTableById(TableId::MemberRef));
+		}
+
+		CustomAttributeTable GetCustomAttributeTable() const
+		{
+			return CustomAttributeTable(GetTableById(TableId::CustomAttribute));
+		}
+
+		AssemblyTable GetAssemblyTable() const
+		{
+			return AssemblyTable(GetTableById(TableId::Assembly));
+		}
+
+		const Table& GetTable(TableId tableId) const
+		{
+			return *tables_[static_cast<size_t>(tableId)];
+		}
+
+		template<TableId Id>
+		Row<Id> GetRow(std::uint32_t rowIndex) const
+		{
+			return GetTable(Id).GetRow<Id>(rowIndex);
+		}
+
+		// Built on first use
+		const TypeNameIndex<TableId::TypeRef>& GetTypeRefNameIndex() const
+		{
+			if (!typeRefNameIndex_)
+			{
+				typeRefNameIndex_ = std::make_unique<TypeNameIndex<TableId::TypeRef>>(GetTable(TableId::TypeRef));
+			}
+
+			return *typeRefNameIndex_;
+		}
+
+		// Built on first use
+		const TypeNameIndex<TableId::TypeDef>& GetTypeDefNameIndex() const
+		{
+			if (!typeDefNameIndex_)
+			{
+				typeDefNameIndex_ = std::make_unique<TypeNameIndex<TableId::TypeDef>>(GetTable(TableId::TypeDef));
+			}
+
+			return *typeDefNameIndex_;
+		}
+
 	private:
 		const Table& GetTableById(TableId tableId) const
 		{
-			return *tables_[static_cast<size_t>(tableId)];
+			return GetTable(tableId);
 		}
 
 		std::vector<std::unique_ptr<Table>> tables_;
+		mutable std::unique_ptr<TypeNameIndex<TableId::TypeRef>> typeRefNameIndex_;
+		mutable std::unique_ptr<TypeNameIndex<TableId::TypeDef>> typeDefNameIndex_;
+	};
+
+	template<TableId Id, std::uint32_t WideMask, class Visitor>
+	bool ForEachRowWithLayout(const Table& table, Visitor& visitor)
+	{
+		auto address = static_cast<const std::uint8_t*>(table.GetStartAddress());
+		auto rowCount = table.GetRowCount();
+		const Heaps& heaps = table.GetHeaps();
+
+		for (std::uint32_t i = 0; i < rowCount; ++i, address += Row<Id, WideMask>::Size)
+		{
+			Row<Id, WideMask> row(address, i, heaps);
+			if constexpr (std::is_same<decltype(visitor(row)), bool>::value)
+			{
+				if (!visitor(row))
+				{
+					return false;
+				}
+			}
+			else
+			{
+				visitor(row);
+			}
+		}
+
+		return true;
+	}
+
+	template<TableId Id, class Visitor, std::uint32_t... WideMasks>
+	bool ForEachRowDispatch(const Table& table, Visitor& visitor, std::integer_sequence<std::uint32_t, WideMasks...>)
+	{
+		auto wideMask = table.GetLayout().WideMask;
+		bool completed = true;
+		((wideMask == WideMasks && (completed = ForEachRowWithLayout<Id, WideMasks>(table, visitor), true)) || ...);
+		return completed;
+	}
+
+	// Visits every row of a table with a Row<Id, WideMask> whose layout matches the module, so the
+	// loop body is compiled once per possible layout and reads columns at constant offsets.
+	// The visitor may return false to stop the iteration; ForEachRow then returns false as well.
+	template<TableId Id, class Visitor>
+	bool ForEachRow(const MetadataTables& tables, Visitor&& visitor)
+	{
+		return ForEachRowDispatch<Id>(
+			tables.GetTable(Id),
+			visitor,
+			std::make_integer_sequence<std::uint32_t, TableTraits<Id>::LayoutCount>());
+	}
+
+	// Half-open range [Begin, End) of 0-based row indices.
+	struct RowRange
+	{
+		std::uint32_t Begin;
+		std::uint32_t End;
 	};
 
+	// Rows of a sorted table whose sort key equals keyValue, found by binary search.
+	template<TableId Id>
+	RowRange EqualRange(const MetadataTables& tables, std::uint32_t keyValue)
+	{
+		static_assert(SortKey<Id>::IsDefined, "table has no sort key");
+
+		const auto& table = tables.GetTable(Id);
+		CheckError(table.IsSorted(), "Metadata table is not sorted");
+
+		auto keyLess = [&table](std::uint32_t rowIndex, std::uint32_t value)
+		{
+			return table.GetRow<Id>(rowIndex).Get(SortKey<Id>::Column) < value;
+		};
+
+		auto lowerBound = [&table, &keyLess](std::uint32_t value)
+		{
+			std::uint32_t first = 0;
+			std::uint32_t count = table.GetRowCount();
+			while (count > 0)
+			{
+				auto step = count / 2;
+				if (keyLess(first + step, value))
+				{
+					first += step + 1;
+					count -= step + 1;
+				}
+				else
+				{
+					count = step;
+				}
+			}
+
+			return first;
+		};
+
+		auto begin = lowerBound(keyValue);
+		auto end = keyValue == std::numeric_limits<std::uint32_t>::max() ? table.GetRowCount() : lowerBound(keyValue + 1);
+		return RowRange{ begin, end };
+	}
+
+	// Visits the rows whose sort key equals keyValue. Uses EqualRange when the module declares the
+	// table sorted and falls back to a full scan otherwise. Visitor semantics match ForEachRow.
+	template<TableId Id, class Visitor>
+	bool ForEachRowWithKey(const MetadataTables& tables, std::uint32_t keyValue, Visitor&& visitor)
+	{
+		static_assert(SortKey<Id>::IsDefined, "table has no sort key");
+
+		const auto& table = tables.GetTable(Id);
+		if (!table.IsSorted())
+		{
+			return ForEachRow<Id>(tables, [&visitor, keyValue](const auto& row)
+			{
+				if (row.Get(SortKey<Id>::Column) != keyValue)
+				{
+					return true;
+				}
+
+				if constexpr (std::is_same<decltype(visitor(row)), bool>::value)
+				{
+					return visitor(row);
+				}
+				else
+				{
+					visitor(row);
+					return true;
+				}
+			});
+		}
+
+		auto range = EqualRange<Id>(tables, keyValue);
+		for (auto i = range.Begin; i < range.End; ++i)
+		{
+			auto row = table.GetRow<Id>(i);
+			if constexpr (std::is_same<decltype(visitor(row)), bool>::value)
+			{
+				if (!visitor(row))
+				{
+					return false;
+				}
+			}
+			else
+			{
+				visitor(row);
+			}
+		}
+
+		return true;
+	}
+
+	// Equivalent of IMetaDataImport::EnumCustomAttributes for the given parent.
+	template<class Visitor>
+	bool ForEachCustomAttribute(const MetadataTables& tables, RowReference parent, Visitor&& visitor)
+	{
+		auto parentIndex = EncodeIndex(ColumnType::HasCustomAttribute, parent);
+		return ForEachRowWithKey<TableId::CustomAttribute>(tables, parentIndex, std::forward<Visitor>(visitor));
+	}
+
 	class MetadataDirectoryFacade
 	{
 		DECLARE_NONCOPYABLE(MetadataDirectoryFacade);
@@ -778,11 +1085,19 @@ namespace peinfo
 	public:
 		std::unique_ptr<MetadataDirectoryFacade> Read(void* startAddress, std::uint32_t size)
 		{
+			CheckError(size >= sizeof(MetadataStorageSignature), "Metadata is too small");
+
 			auto storageSignature = static_cast<MetadataStorageSignature*>(startAddress);
+			CheckError(storageSignature->lSignature == MetadataSignature, "Invalid metadata signature");
 
-			auto versionStringStart = AddOffset<char>(storageSignature, sizeof(MetadataStorageSignature));
+			CheckError(static_cast<std::uint64_t>(sizeof(MetadataStorageSignature)) + storageSignature->iVersionString + sizeof(MetadataStorageHeader) <= size,
+				"Metadata storage header is outside of the metadata");
 
-			std::string_view versionString(versionStringStart);
+			// The version string is padded with zeros up to iVersionString bytes
+			auto versionStringStart = AddOffset<char>(storageSignature, sizeof(MetadataStorageSignature));
+			auto versionStringEnd = static_cast<const char*>(std::memchr(versionStringStart, 0, storageSignature->iVersionString));
+			std::string_view versionString(versionStringStart,
+				versionStringEnd != nullptr ? static_cast<std::size_t>(versionStringEnd - versionStringStart) : storageSignature->iVersionString);
 
 			auto storageHeader = AddOffset<MetadataStorageHeader>(versionStringStart, storageSignature->iVersionString);
 
@@ -790,39 +1105,60 @@ namespace peinfo
 
 			MetadataTableStreamHeader* metadataTableStreamHeader = nullptr;
 			void* blobStream = nullptr;
+			std::uint32_t blobStreamSize = 0;
 			void* stringStream = nullptr;
+			std::uint32_t stringStreamSize = 0;
 			void* guidStream = nullptr;
+			std::uint32_t guidStreamSize = 0;
+			std::uint32_t tableStreamSize = 0;
 
 			for (auto i = 0; i < storageHeader->iStreams; ++i)
 			{
-				std::string currentStreamName = AddOffset<char>(currentStreamHeader, sizeof(MetadataStreamHeader));
-				if (currentStreamName == "#~"s)
+				auto streamHeaderOffset = static_cast<std::uint64_t>(AddressDifference(currentStreamHeader, startAddress));
+				CheckError(streamHeaderOffset + sizeof(MetadataStreamHeader) <= size, "Metadata stream header is outside of the metadata");
+
+				auto streamNameStart = AddOffset<char>(currentStreamHeader, sizeof(MetadataStreamHeader));
+				auto streamNameEnd = static_cast<const char*>(std::memchr(streamNameStart, 0, size - streamHeaderOffset - sizeof(MetadataStreamHeader)));
+				CheckError(streamNameEnd != nullptr, "Metadata stream name is outside of the metadata");
+				std::string_view currentStreamName(streamNameStart, static_cast<std::size_t>(streamNameEnd - streamNameStart));
+
+				CheckError(currentStreamHeader->iOffset < size && currentStreamHeader->iSize <= size - currentStreamHeader->iOffset,
+					"Metadata stream is outside of the metadata");
+
+				if (currentStreamName == "#~" || currentStreamName == "#-")
 				{
 					metadataTableStreamHeader = AddOffset<MetadataTableStreamHeader>(startAddress, currentStreamHeader->iOffset);
+					tableStreamSize = currentStreamHeader->iSize;
 				}
-				else if (currentStreamName == "#Blob"s)
+				else if (currentStreamName == "#Blob")
 				{
 					blobStream = AddOffset<void>(startAddress, currentStreamHeader->iOffset);
+					blobStreamSize = currentStreamHeader->iSize;
 				}
-				else if (currentStreamName == "#Strings"s)
+				else if (currentStreamName == "#Strings")
 				{
 					stringStream = AddOffset<void>(startAddress, currentStreamHeader->iOffset);
+					stringStreamSize = currentStreamHeader->iSize;
 				}
-				else if (currentStreamName == "#GUID"s)
+				else if (currentStreamName == "#GUID")
 				{
 					guidStream = AddOffset<void>(startAddress, currentStreamHeader->iOffset);
+					guidStreamSize = currentStreamHeader->iSize;
 				}
 
-				auto currentHeaderSize = sizeof(MetadataStreamHeader) + currentStreamName.size() + 1;
-				currentHeaderSize = ((currentHeaderSize + 3) / 4) * 4; // TODO: extract func
+				auto currentHeaderSize = RoundUpToMultiple(sizeof(MetadataStreamHeader) + currentStreamName.size() + 1, sizeof(std::uint32_t));
 				currentStreamHeader = AddOffset<MetadataStreamHeader>(currentStreamHeader, currentHeaderSize);
 			}
 
+			CheckError(metadataTableStreamHeader != nullptr, "No metadata table stream present");
+			CheckError(tableStreamSize >= sizeof(MetadataTableStreamHeader), "Metadata table stream is too small");
+
 			auto recordNumbersStart = AddOffset<std::uint32_t>(metadataTableStreamHeader, sizeof(MetadataTableStreamHeader));
 
 			std::array<std::uint32_t, 64> recordNumberByTable{};
 
 			std::bitset<64> maskValid(metadataTableStreamHeader->MaksValid);
+			CheckError(maskValid.count() <= (tableStreamSize - sizeof(MetadataTableStreamHeader)) / sizeof(std::uint32_t), "Metadata table stream is too small");
 
 			auto currentRecordNumber = recordNumbersStart;
 			for (size_t i = 0; i < maskValid.size(); ++i)
@@ -834,84 +1170,25 @@ namespace peinfo
 				}
 			}
 
-			auto heaps = std::make_shared<Heaps>(stringStream, guidStream, blobStream);
-			auto schemaInfoProvider = std::make_shared<SchemaInfoProvider>(recordNumberByTable, metadataTableStreamHeader->HeapOffsetSizes);
+			auto heaps = std::make_shared<Heaps>(stringStream, stringStreamSize, guidStream, guidStreamSize, blobStream, blobStreamSize);
+			auto schemaInfoProvider = std::make_shared<SchemaInfoProvider>(
+				recordNumberByTable, metadataTableStreamHeader->HeapOffsetSizes, metadataTableStreamHeader->Sorted);
 			void* tablesStartAddress = AddOffset<void>(recordNumbersStart, maskValid.count() * sizeof(std::uint32_t));
+			if ((metadataTableStreamHeader->HeapOffsetSizes & ExtraDataHeapFlag) != 0)
+			{
+				tablesStartAddress = AddOffset<void>(tablesStartAddress, sizeof(std::uint32_t));
+			}
 			
+			auto tablesEndOffset = static_cast<std::uint64_t>(AddressDifference(tablesStartAddress, startAddress)) + schemaInfoProvider->GetTablesSize();
+			CheckError(tablesEndOffset <= size, "Metadata tables are outside of the metadata");
+
 			auto tables = std::make_shared<MetadataTables>(tablesStartAddress, schemaInfoProvider, heaps);
 
 			return std::make_unique<MetadataDirectoryFacade>(tables);
 		}
-	};
 
-	void Test0(ModuleTable moduleTable, TypeRefTable typeRefTable)
-	{
-		auto name = moduleTable.GetName(0);
-		auto rowCount = moduleTable.GetRowCount();
-
-		std::cout << name << ":" << rowCount << std::endl;
-
-		auto typeRefRowCount = typeRefTable.GetRowCount();
-		for (size_t i = 0; i < typeRefRowCount; i++)
-		{
-			auto typeName = typeRefTable.GetTypeName(i);
-			auto namespaceName = typeRefTable.GetTypeNamespace(i);
-
-			std::cout << namespaceName << "." << typeName << std::endl;
-		}
-	}
-
-	void Test1(TypeDefTable typeDefTable)
-	{
-		for (size_t i = 0; i < typeDefTable.GetRowCount(); ++i)
-		{
-			auto typeName = typeDefTable.GetTypeName(i);
-			auto namespaceName = typeDefTable.GetTypeNamespace(i);
-
-			std::cout << namespaceName << "." << typeName << std::endl;
-		}
-	}
-
-	void Test2(MethodDefTable methodDefTable)
-	{
-		for (size_t i = 0; i < methodDefTable.GetRowCount(); ++i)
-		{
-			auto methodName = methodDefTable.GetMethodName(i);
-
-			std::cout << methodName << std::endl;
-		}
-	}
-
-	//std::string GetAssemblyVersion(TypeRefTable typeRefTable, MemberRefTable memberRefTable)
-	//{
-	//	auto typeName = "AssemblyVersionAttribute";
-	//	auto namespaceName = "System.Reflection";
-	//	
-	//	for (std::uint32_t i = 0; i < typeRefTable.GetRowCount(); ++i)
-	//	{
-	//		auto currentTypeName = typeRefTable.GetTypeName(i);
-	//		if (currentTypeName != typeName)
-	//		{
-	//			continue;
-	//		}
-
-	//		auto currentNamespace = typeRefTable.GetTypeNamespace(i);
-	//		if (currentNamespace != namespaceName)
-	//		{
-	//			continue;
-	//		}
-	//	}
-
-	//	for (std::uint32_t i = 0; i < memberRefTable.GetRowCount(); ++i)
-	//	{
-	//		memberRefTable.GetParentIndex();
-	//	}
-
-	//	return "";
-	//}
-
-	//std::string GetTargetFramework()
-	//{
-	//	return "";
-	//}
+	private:
+		static const DWORD MetadataSignature = 0x424A5342; // "BSJB"
+		static const BYTE ExtraDataHeapFlag = 0x40;
+	};
 }
@@ -0,0 +1,1195 @@
+#pragma once
+#include "stdafx.h"
+#include "Helpers.h"
+
+namespace peinfo
+{
+	enum class TableId
+	{
+		MinTableId = 0,
+		Module = 0,
+		TypeRef = 1,
+		TypeDef = 2,
+		FieldPtr = 3,
+		Field = 4,
+		MethodPtr = 5,
+		MethodDef = 6,
+		ParamPtr = 7,
+		Param = 8,
+		InterfaceImpl = 9,
+		MemberRef = 10,
+		Constant = 11,
+		CustomAttribute = 12,
+		FieldMarshal = 13,
+		DeclSecurity = 14,
+		ClassLayout = 15,
+		FieldLayout = 16,
+		StandAloneSig = 17,
+		EventMap = 18,
+		EventPtr = 19,
+		Event = 20,
+		PropertyMap = 21,
+		PropertyPtr = 22,
+		Property = 23,
+		MethodSemantics = 24,
+		MethodImpl = 25,
+		ModuleRef = 26,
+		TypeSpec = 27,
+		ImplMap = 28,
+		FieldRVA = 29,
+		EncLog = 30,
+		EncMap = 31,
+		Assembly = 32,
+		AssemblyProcessor = 33,
+		AssemblyOS = 34,
+		AssemblyRef = 35,
+		AssemblyRefProcessor = 36,
+		AssemblyRefOS = 37,
+		File = 38,
+		ExportedType = 39,
+		ManifestResource = 40,
+		NestedClass = 41,
+		GenericParam = 42,
+		MethodSpec = 43,
+		GenericParamConstraint = 44,
+
+		MaxTableId = 63,
+		NotUsed = 64
+	};
+
+	enum class ColumnType
+	{
+		Byte,
+		Word,
+		Dword,
+		String,
+		Guid,
+		Blob,
+		
+		// single table indicies
+		TypeDef,
+		Field,
+		MethodDef,
+		Param,
+		Event,
+		Property,
+		ModuleRef,
+		AssemblyRef,
+		GenericParam,
+
+		// coded indicies
+		ResolutionScope,
+		TypeDefOrRef,
+		MemberRefParent,
+		HasConstant,
+		HasCustomAttribute,
+		CustomAttributeType,
+		HasFieldMarshal,
+		HasDeclSecurity,
+		HasSemantics,
+		MethodDefOrRef,
+		MemberForwarded,
+		Implementation,
+		TypeOrMethodDef
+	};
+
+	const std::size_t ColumnTypeCount = static_cast<std::size_t>(ColumnType::TypeOrMethodDef) + 1;
+
+	constexpr bool IsFixedSizeColumnType(ColumnType columnType)
+	{
+		return columnType == ColumnType::Byte || columnType == ColumnType::Word || columnType == ColumnType::Dword;
+	}
+
+	template<TableId TableIdValue, std::uint32_t ColumnIndex>
+	struct ColumnTag
+	{
+		static constexpr TableId Table = TableIdValue;
+		static constexpr std::uint32_t Index = ColumnIndex;
+
+		constexpr operator std::uint32_t() const
+		{
+			return ColumnIndex;
+		}
+	};
+
+	// ECMA-335 II.22. Each schema lists the column types in storage order and names every column
+	// with a ColumnTag, so that rows can be read as row.Get(TypeDefSchema::TypeName).
+	struct ModuleSchema
+	{
+		static constexpr TableId Id = TableId::Module;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Word,
+			ColumnType::String,
+			ColumnType::Guid,
+			ColumnType::Guid,
+			ColumnType::Guid
+		};
+
+		static constexpr ColumnTag<Id, 0> Generation{};
+		static constexpr ColumnTag<Id, 1> Name{};
+		static constexpr ColumnTag<Id, 2> Mvid{};
+		static constexpr ColumnTag<Id, 3> EncId{};
+		static constexpr ColumnTag<Id, 4> EncBaseId{};
+	};
+
+	struct TypeRefSchema
+	{
+		static constexpr TableId Id = TableId::TypeRef;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::ResolutionScope,
+			ColumnType::String,
+			ColumnType::String
+		};
+
+		static constexpr ColumnTag<Id, 0> ResolutionScope{};
+		static constexpr ColumnTag<Id, 1> TypeName{};
+		static constexpr ColumnTag<Id, 2> TypeNamespace{};
+	};
+
+	struct TypeDefSchema
+	{
+		static constexpr TableId Id = TableId::TypeDef;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Dword,
+			ColumnType::String,
+			ColumnType::String,
+			ColumnType::TypeDefOrRef,
+			ColumnType::Field,
+			ColumnType::MethodDef
+		};
+
+		static constexpr ColumnTag<Id, 0> Flags{};
+		static constexpr ColumnTag<Id, 1> TypeName{};
+		static constexpr ColumnTag<Id, 2> TypeNamespace{};
+		static constexpr ColumnTag<Id, 3> Extends{};
+		static constexpr ColumnTag<Id, 4> FieldList{};
+		static constexpr ColumnTag<Id, 5> MethodList{};
+	};
+
+	struct FieldPtrSchema
+	{
+		static constexpr TableId Id = TableId::FieldPtr;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Field
+		};
+
+		static constexpr ColumnTag<Id, 0> Field{};
+	};
+
+	struct FieldSchema
+	{
+		static constexpr TableId Id = TableId::Field;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Word,
+			ColumnType::String,
+			ColumnType::Blob
+		};
+
+		static constexpr ColumnTag<Id, 0> Flags{};
+		static constexpr ColumnTag<Id, 1> Name{};
+		static constexpr ColumnTag<Id, 2> Signature{};
+	};
+
+	struct MethodPtrSchema
+	{
+		static constexpr TableId Id = TableId::MethodPtr;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::MethodDef
+		};
+
+		static constexpr ColumnTag<Id, 0> Method{};
+	};
+
+	struct MethodDefSchema
+	{
+		static constexpr TableId Id = TableId::MethodDef;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Dword,
+			ColumnType::Word,
+			ColumnType::Word,
+			ColumnType::String,
+			ColumnType::Blob,
+			ColumnType::Param
+		};
+
+		static constexpr ColumnTag<Id, 0> Rva{};
+		static constexpr ColumnTag<Id, 1> ImplFlags{};
+		static constexpr ColumnTag<Id, 2> Flags{};
+		static constexpr ColumnTag<Id, 3> Name{};
+		static constexpr ColumnTag<Id, 4> Signature{};
+		static constexpr ColumnTag<Id, 5> ParamList{};
+	};
+
+	struct ParamPtrSchema
+	{
+		static constexpr TableId Id = TableId::ParamPtr;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Param
+		};
+
+		static constexpr ColumnTag<Id, 0> Param{};
+	};
+
+	struct ParamSchema
+	{
+		static constexpr TableId Id = TableId::Param;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Word,
+			ColumnType::Word,
+			ColumnType::String
+		};
+
+		static constexpr ColumnTag<Id, 0> Flags{};
+		static constexpr ColumnTag<Id, 1> Sequence{};
+		static constexpr ColumnTag<Id, 2> Name{};
+	};
+
+	struct InterfaceImplSchema
+	{
+		static constexpr TableId Id = TableId::InterfaceImpl;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::TypeDef,
+			ColumnType::TypeDefOrRef
+		};
+
+		static constexpr ColumnTag<Id, 0> Class{};
+		static constexpr ColumnTag<Id, 1> Interface{};
+	};
+
+	struct MemberRefSchema
+	{
+		static constexpr TableId Id = TableId::MemberRef;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::MemberRefParent,
+			ColumnType::String,
+			ColumnType::Blob
+		};
+
+		static constexpr ColumnTag<Id, 0> Class{};
+		static constexpr ColumnTag<Id, 1> Name{};
+		static constexpr ColumnTag<Id, 2> Signature{};
+	};
+
+	struct ConstantSchema
+	{
+		static constexpr TableId Id = TableId::Constant;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Word, // 1-byte type followed by 1-byte padding
+			ColumnType::HasConstant,
+			ColumnType::Blob
+		};
+
+		static constexpr ColumnTag<Id, 0> Type{};
+		static constexpr ColumnTag<Id, 1> Parent{};
+		static constexpr ColumnTag<Id, 2> Value{};
+	};
+
+	struct CustomAttributeSchema
+	{
+		static constexpr TableId Id = TableId::CustomAttribute;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::HasCustomAttribute,
+			ColumnType::CustomAttributeType,
+			ColumnType::Blob
+		};
+
+		static constexpr ColumnTag<Id, 0> Parent{};
+		static constexpr ColumnTag<Id, 1> Type{};
+		static constexpr ColumnTag<Id, 2> Value{};
+	};
+
+	struct FieldMarshalSchema
+	{
+		static constexpr TableId Id = TableId::FieldMarshal;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::HasFieldMarshal,
+			ColumnType::Blob
+		};
+
+		static constexpr ColumnTag<Id, 0> Parent{};
+		static constexpr ColumnTag<Id, 1> NativeType{};
+	};
+
+	struct DeclSecuritySchema
+	{
+		static constexpr TableId Id = TableId::DeclSecurity;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Word,
+			ColumnType::HasDeclSecurity,
+			ColumnType::Blob
+		};
+
+		static constexpr ColumnTag<Id, 0> Action{};
+		static constexpr ColumnTag<Id, 1> Parent{};
+		static constexpr ColumnTag<Id, 2> PermissionSet{};
+	};
+
+	struct ClassLayoutSchema
+	{
+		static constexpr TableId Id = TableId::ClassLayout;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Word,
+			ColumnType::Dword,
+			ColumnType::TypeDef
+		};
+
+		static constexpr ColumnTag<Id, 0> PackingSize{};
+		static constexpr ColumnTag<Id, 1> ClassSize{};
+		static constexpr ColumnTag<Id, 2> Parent{};
+	};
+
+	struct FieldLayoutSchema
+	{
+		static constexpr TableId Id = TableId::FieldLayout;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Dword,
+			ColumnType::Field
+		};
+
+		static constexpr ColumnTag<Id, 0> Offset{};
+		static constexpr ColumnTag<Id, 1> Field{};
+	};
+
+	struct StandAloneSigSchema
+	{
+		static constexpr TableId Id = TableId::StandAloneSig;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Blob
+		};
+
+		static constexpr ColumnTag<Id, 0> Signature{};
+	};
+
+	struct EventMapSchema
+	{
+		static constexpr TableId Id = TableId::EventMap;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::TypeDef,
+			ColumnType::Event
+		};
+
+		static constexpr ColumnTag<Id, 0> Parent{};
+		static constexpr ColumnTag<Id, 1> EventList{};
+	};
+
+	struct EventPtrSchema
+	{
+		static constexpr TableId Id = TableId::EventPtr;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Event
+		};
+
+		static constexpr ColumnTag<Id, 0> Event{};
+	};
+
+	struct EventSchema
+	{
+		static constexpr TableId Id = TableId::Event;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Word,
+			ColumnType::String,
+			ColumnType::TypeDefOrRef
+		};
+
+		static constexpr ColumnTag<Id, 0> EventFlags{};
+		static constexpr ColumnTag<Id, 1> Name{};
+		static constexpr ColumnTag<Id, 2> EventType{};
+	};
+
+	struct PropertyMapSchema
+	{
+		static constexpr TableId Id = TableId::PropertyMap;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::TypeDef,
+			ColumnType::Property
+		};
+
+		static constexpr ColumnTag<Id, 0> Parent{};
+		static constexpr ColumnTag<Id, 1> PropertyList{};
+	};
+
+	struct PropertyPtrSchema
+	{
+		static constexpr TableId Id = TableId::PropertyPtr;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Property
+		};
+
+		static constexpr ColumnTag<Id, 0> Property{};
+	};
+
+	struct PropertySchema
+	{
+		static constexpr TableId Id = TableId::Property;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Word,
+			ColumnType::String,
+			ColumnType::Blob
+		};
+
+		static constexpr ColumnTag<Id, 0> Flags{};
+		static constexpr ColumnTag<Id, 1> Name{};
+		static constexpr ColumnTag<Id, 2> Type{};
+	};
+
+	struct MethodSemanticsSchema
+	{
+		static constexpr TableId Id = TableId::MethodSemantics;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Word,
+			ColumnType::MethodDef,
+			ColumnType::HasSemantics
+		};
+
+		static constexpr ColumnTag<Id, 0> Semantics{};
+		static constexpr ColumnTag<Id, 1> Method{};
+		static constexpr ColumnTag<Id, 2> Association{};
+	};
+
+	struct MethodImplSchema
+	{
+		static constexpr TableId Id = TableId::MethodImpl;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::TypeDef,
+			ColumnType::MethodDefOrRef,
+			ColumnType::MethodDefOrRef
+		};
+
+		static constexpr ColumnTag<Id, 0> Class{};
+		static constexpr ColumnTag<Id, 1> MethodBody{};
+		static constexpr ColumnTag<Id, 2> MethodDeclaration{};
+	};
+
+	struct ModuleRefSchema
+	{
+		static constexpr TableId Id = TableId::ModuleRef;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::String
+		};
+
+		static constexpr ColumnTag<Id, 0> Name{};
+	};
+
+	struct TypeSpecSchema
+	{
+		static constexpr TableId Id = TableId::TypeSpec;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Blob
+		};
+
+		static constexpr ColumnTag<Id, 0> Signature{};
+	};
+
+	struct ImplMapSchema
+	{
+		static constexpr TableId Id = TableId::ImplMap;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Word,
+			ColumnType::MemberForwarded,
+			ColumnType::String,
+			ColumnType::ModuleRef
+		};
+
+		static constexpr ColumnTag<Id, 0> MappingFlags{};
+		static constexpr ColumnTag<Id, 1> MemberForwarded{};
+		static constexpr ColumnTag<Id, 2> ImportName{};
+		static constexpr ColumnTag<Id, 3> ImportScope{};
+	};
+
+	struct FieldRVASchema
+	{
+		static constexpr TableId Id = TableId::FieldRVA;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Dword,
+			ColumnType::Field
+		};
+
+		static constexpr ColumnTag<Id, 0> Rva{};
+		static constexpr ColumnTag<Id, 1> Field{};
+	};
+
+	struct EncLogSchema
+	{
+		static constexpr TableId Id = TableId::EncLog;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Dword,
+			ColumnType::Dword
+		};
+
+		static constexpr ColumnTag<Id, 0> Token{};
+		static constexpr ColumnTag<Id, 1> FuncCode{};
+	};
+
+	struct EncMapSchema
+	{
+		static constexpr TableId Id = TableId::EncMap;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Dword
+		};
+
+		static constexpr ColumnTag<Id, 0> Token{};
+	};
+
+	struct AssemblySchema
+	{
+		static constexpr TableId Id = TableId::Assembly;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Dword,
+			ColumnType::Word,
+			ColumnType::Word,
+			ColumnType::Word,
+			ColumnType::Word,
+			ColumnType::Dword,
+			ColumnType::Blob,
+			ColumnType::String,
+			ColumnType::String
+		};
+
+		static constexpr ColumnTag<Id, 0> HashAlgId{};
+		static constexpr ColumnTag<Id, 1> MajorVersion{};
+		static constexpr ColumnTag<Id, 2> MinorVersion{};
+		static constexpr ColumnTag<Id, 3> BuildNumber{};
+		static constexpr ColumnTag<Id, 4> RevisionNumber{};
+		static constexpr ColumnTag<Id, 5> Flags{};
+		static constexpr ColumnTag<Id, 6> PublicKey{};
+		static constexpr ColumnTag<Id, 7> Name{};
+		static constexpr ColumnTag<Id, 8> Culture{};
+	};
+
+	struct AssemblyProcessorSchema
+	{
+		static constexpr TableId Id = TableId::AssemblyProcessor;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Dword
+		};
+
+		static constexpr ColumnTag<Id, 0> Processor{};
+	};
+
+	struct AssemblyOSSchema
+	{
+		static constexpr TableId Id = TableId::AssemblyOS;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Dword,
+			ColumnType::Dword,
+			ColumnType::Dword
+		};
+
+		static constexpr ColumnTag<Id, 0> OSPlatformId{};
+		static constexpr ColumnTag<Id, 1> OSMajorVersion{};
+		static constexpr ColumnTag<Id, 2> OSMinorVersion{};
+	};
+
+	struct AssemblyRefSchema
+	{
+		static constexpr TableId Id = TableId::AssemblyRef;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Word,
+			ColumnType::Word,
+			ColumnType::Word,
+			ColumnType::Word,
+			ColumnType::Dword,
+			ColumnType::Blob,
+			ColumnType::String,
+			ColumnType::String,
+			ColumnType::Blob
+		};
+
+		static constexpr ColumnTag<Id, 0> MajorVersion{};
+		static constexpr ColumnTag<Id, 1> MinorVersion{};
+		static constexpr ColumnTag<Id, 2> BuildNumber{};
+		static constexpr ColumnTag<Id, 3> RevisionNumber{};
+		static constexpr ColumnTag<Id, 4> Flags{};
+		static constexpr ColumnTag<Id, 5> PublicKeyOrToken{};
+		static constexpr ColumnTag<Id, 6> Name{};
+		static constexpr ColumnTag<Id, 7> Culture{};
+		static constexpr ColumnTag<Id, 8> HashValue{};
+	};
+
+	struct AssemblyRefProcessorSchema
+	{
+		static constexpr TableId Id = TableId::AssemblyRefProcessor;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Dword,
+			ColumnType::AssemblyRef
+		};
+
+		static constexpr ColumnTag<Id, 0> Processor{};
+		static constexpr ColumnTag<Id, 1> AssemblyRef{};
+	};
+
+	struct AssemblyRefOSSchema
+	{
+		static constexpr TableId Id = TableId::AssemblyRefOS;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Dword,
+			ColumnType::Dword,
+			ColumnType::Dword,
+			ColumnType::AssemblyRef
+		};
+
+		static constexpr ColumnTag<Id, 0> OSPlatformId{};
+		static constexpr ColumnTag<Id, 1> OSMajorVersion{};
+		static constexpr ColumnTag<Id, 2> OSMinorVersion{};
+		static constexpr ColumnTag<Id, 3> AssemblyRef{};
+	};
+
+	struct FileSchema
+	{
+		static constexpr TableId Id = TableId::File;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Dword,
+			ColumnType::String,
+			ColumnType::Blob
+		};
+
+		static constexpr ColumnTag<Id, 0> Flags{};
+		static constexpr ColumnTag<Id, 1> Name{};
+		static constexpr ColumnTag<Id, 2> HashValue{};
+	};
+
+	struct ExportedTypeSchema
+	{
+		static constexpr TableId Id = TableId::ExportedType;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Dword,
+			ColumnType::Dword,
+			ColumnType::String,
+			ColumnType::String,
+			ColumnType::Implementation
+		};
+
+		static constexpr ColumnTag<Id, 0> Flags{};
+		static constexpr ColumnTag<Id, 1> TypeDefId{};
+		static constexpr ColumnTag<Id, 2> TypeName{};
+		static constexpr ColumnTag<Id, 3> TypeNamespace{};
+		static constexpr ColumnTag<Id, 4> Implementation{};
+	};
+
+	struct ManifestResourceSchema
+	{
+		static constexpr TableId Id = TableId::ManifestResource;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Dword,
+			ColumnType::Dword,
+			ColumnType::String,
+			ColumnType::Implementation
+		};
+
+		static constexpr ColumnTag<Id, 0> Offset{};
+		static constexpr ColumnTag<Id, 1> Flags{};
+		static constexpr ColumnTag<Id, 2> Name{};
+		static constexpr ColumnTag<Id, 3> Implementation{};
+	};
+
+	struct NestedClassSchema
+	{
+		static constexpr TableId Id = TableId::NestedClass;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::TypeDef,
+			ColumnType::TypeDef
+		};
+
+		static constexpr ColumnTag<Id, 0> NestedClass{};
+		static constexpr ColumnTag<Id, 1> EnclosingClass{};
+	};
+
+	struct GenericParamSchema
+	{
+		static constexpr TableId Id = TableId::GenericParam;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::Word,
+			ColumnType::Word,
+			ColumnType::TypeOrMethodDef,
+			ColumnType::String
+		};
+
+		static constexpr ColumnTag<Id, 0> Number{};
+		static constexpr ColumnTag<Id, 1> Flags{};
+		static constexpr ColumnTag<Id, 2> Owner{};
+		static constexpr ColumnTag<Id, 3> Name{};
+	};
+
+	struct MethodSpecSchema
+	{
+		static constexpr TableId Id = TableId::MethodSpec;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::MethodDefOrRef,
+			ColumnType::Blob
+		};
+
+		static constexpr ColumnTag<Id, 0> Method{};
+		static constexpr ColumnTag<Id, 1> Instantiation{};
+	};
+
+	struct GenericParamConstraintSchema
+	{
+		static constexpr TableId Id = TableId::GenericParamConstraint;
+		static constexpr ColumnType Columns[] =
+		{
+			ColumnType::GenericParam,
+			ColumnType::TypeDefOrRef
+		};
+
+		static constexpr ColumnTag<Id, 0> Owner{};
+		static constexpr ColumnTag<Id, 1> Constraint{};
+	};
+
+	template<TableId Id>
+	struct TableSchema;
+
+#define DECLARE_TABLE_SCHEMA(Name) \
+	template<> struct TableSchema<TableId::Name> : Name##Schema {}
+
+	DECLARE_TABLE_SCHEMA(Module);
+	DECLARE_TABLE_SCHEMA(TypeRef);
+	DECLARE_TABLE_SCHEMA(TypeDef);
+	DECLARE_TABLE_SCHEMA(FieldPtr);
+	DECLARE_TABLE_SCHEMA(Field);
+	DECLARE_TABLE_SCHEMA(MethodPtr);
+	DECLARE_TABLE_SCHEMA(MethodDef);
+	DECLARE_TABLE_SCHEMA(ParamPtr);
+	DECLARE_TABLE_SCHEMA(Param);
+	DECLARE_TABLE_SCHEMA(InterfaceImpl);
+	DECLARE_TABLE_SCHEMA(MemberRef);
+	DECLARE_TABLE_SCHEMA(Constant);
+	DECLARE_TABLE_SCHEMA(CustomAttribute);
+	DECLARE_TABLE_SCHEMA(FieldMarshal);
+	DECLARE_TABLE_SCHEMA(DeclSecurity);
+	DECLARE_TABLE_SCHEMA(ClassLayout);
+	DECLARE_TABLE_SCHEMA(FieldLayout);
+	DECLARE_TABLE_SCHEMA(StandAloneSig);
+	DECLARE_TABLE_SCHEMA(EventMap);
+	DECLARE_TABLE_SCHEMA(EventPtr);
+	DECLARE_TABLE_SCHEMA(Event);
+	DECLARE_TABLE_SCHEMA(PropertyMap);
+	DECLARE_TABLE_SCHEMA(PropertyPtr);
+	DECLARE_TABLE_SCHEMA(Property);
+	DECLARE_TABLE_SCHEMA(MethodSemantics);
+	DECLARE_TABLE_SCHEMA(MethodImpl);
+	DECLARE_TABLE_SCHEMA(ModuleRef);
+	DECLARE_TABLE_SCHEMA(TypeSpec);
+	DECLARE_TABLE_SCHEMA(ImplMap);
+	DECLARE_TABLE_SCHEMA(FieldRVA);
+	DECLARE_TABLE_SCHEMA(EncLog);
+	DECLARE_TABLE_SCHEMA(EncMap);
+	DECLARE_TABLE_SCHEMA(Assembly);
+	DECLARE_TABLE_SCHEMA(AssemblyProcessor);
+	DECLARE_TABLE_SCHEMA(AssemblyOS);
+	DECLARE_TABLE_SCHEMA(AssemblyRef);
+	DECLARE_TABLE_SCHEMA(AssemblyRefProcessor);
+	DECLARE_TABLE_SCHEMA(AssemblyRefOS);
+	DECLARE_TABLE_SCHEMA(File);
+	DECLARE_TABLE_SCHEMA(ExportedType);
+	DECLARE_TABLE_SCHEMA(ManifestResource);
+	DECLARE_TABLE_SCHEMA(NestedClass);
+	DECLARE_TABLE_SCHEMA(GenericParam);
+	DECLARE_TABLE_SCHEMA(MethodSpec);
+	DECLARE_TABLE_SCHEMA(GenericParamConstraint);
+
+#undef DECLARE_TABLE_SCHEMA
+
+	// Calls visitor with the schema of a table selected at run time. Returns false for the
+	// table ids that ECMA-335 leaves unused.
+	template<class Visitor>
+	bool VisitTableSchema(TableId tableId, Visitor&& visitor)
+	{
+		switch (tableId)
+		{
+		case TableId::Module: visitor(ModuleSchema{}); return true;
+		case TableId::TypeRef: visitor(TypeRefSchema{}); return true;
+		case TableId::TypeDef: visitor(TypeDefSchema{}); return true;
+		case TableId::FieldPtr: visitor(FieldPtrSchema{}); return true;
+		case TableId::Field: visitor(FieldSchema{}); return true;
+		case TableId::MethodPtr: visitor(MethodPtrSchema{}); return true;
+		case TableId::MethodDef: visitor(MethodDefSchema{}); return true;
+		case TableId::ParamPtr: visitor(ParamPtrSchema{}); return true;
+		case TableId::Param: visitor(ParamSchema{}); return true;
+		case TableId::InterfaceImpl: visitor(InterfaceImplSchema{}); return true;
+		case TableId::MemberRef: visitor(MemberRefSchema{}); return true;
+		case TableId::Constant: visitor(ConstantSchema{}); return true;
+		case TableId::CustomAttribute: visitor(CustomAttributeSchema{}); return true;
+		case TableId::FieldMarshal: visitor(FieldMarshalSchema{}); return true;
+		case TableId::DeclSecurity: visitor(DeclSecuritySchema{}); return true;
+		case TableId::ClassLayout: visitor(ClassLayoutSchema{}); return true;
+		case TableId::FieldLayout: visitor(FieldLayoutSchema{}); return true;
+		case TableId::StandAloneSig: visitor(StandAloneSigSchema{}); return true;
+		case TableId::EventMap: visitor(EventMapSchema{}); return true;
+		case TableId::EventPtr: visitor(EventPtrSchema{}); return true;
+		case TableId::Event: visitor(EventSchema{}); return true;
+		case TableId::PropertyMap: visitor(PropertyMapSchema{}); return true;
+		case TableId::PropertyPtr: visitor(PropertyPtrSchema{}); return true;
+		case TableId::Property: visitor(PropertySchema{}); return true;
+		case TableId::MethodSemantics: visitor(MethodSemanticsSchema{}); return true;
+		case TableId::MethodImpl: visitor(MethodImplSchema{}); return true;
+		case TableId::ModuleRef: visitor(ModuleRefSchema{}); return true;
+		case TableId::TypeSpec: visitor(TypeSpecSchema{}); return true;
+		case TableId::ImplMap: visitor(ImplMapSchema{}); return true;
+		case TableId::FieldRVA: visitor(FieldRVASchema{}); return true;
+		case TableId::EncLog: visitor(EncLogSchema{}); return true;
+		case TableId::EncMap: visitor(EncMapSchema{}); return true;
+		case TableId::Assembly: visitor(AssemblySchema{}); return true;
+		case TableId::AssemblyProcessor: visitor(AssemblyProcessorSchema{}); return true;
+		case TableId::AssemblyOS: visitor(AssemblyOSSchema{}); return true;
+		case TableId::AssemblyRef: visitor(AssemblyRefSchema{}); return true;
+		case TableId::AssemblyRefProcessor: visitor(AssemblyRefProcessorSchema{}); return true;
+		case TableId::AssemblyRefOS: visitor(AssemblyRefOSSchema{}); return true;
+		case TableId::File: visitor(FileSchema{}); return true;
+		case TableId::ExportedType: visitor(ExportedTypeSchema{}); return true;
+		case TableId::ManifestResource: visitor(ManifestResourceSchema{}); return true;
+		case TableId::NestedClass: visitor(NestedClassSchema{}); return true;
+		case TableId::GenericParam: visitor(GenericParamSchema{}); return true;
+		case TableId::MethodSpec: visitor(MethodSpecSchema{}); return true;
+		case TableId::GenericParamConstraint: visitor(GenericParamConstraintSchema{}); return true;
+		default: return false;
+		}
+	}
+
+	// Compile-time layout of a table row. Column widths that depend on heap sizes or table row
+	// counts are grouped by column type; bit N of a "wide mask" says that the N-th distinct
+	// variable-width column type of the table is 4 bytes wide instead of 2.
+	template<TableId Id>
+	struct TableTraits
+	{
+		using Schema = TableSchema<Id>;
+
+		static constexpr std::uint32_t ColumnCount = static_cast<std::uint32_t>(std::extent<decltype(Schema::Columns)>::value);
+
+		static constexpr std::uint32_t GetWidthClass(std::uint32_t column)
+		{
+			std::uint32_t widthClass = 0;
+			for (std::uint32_t i = 0; i < column; ++i)
+			{
+				if (IsFirstOfWidthClass(i))
+				{
+					++widthClass;
+				}
+			}
+
+			for (std::uint32_t i = 0; i < column; ++i)
+			{
+				if (Schema::Columns[i] == Schema::Columns[column])
+				{
+					return GetWidthClass(i);
+				}
+			}
+
+			return widthClass;
+		}
+
+		static constexpr std::uint32_t GetWidthClassCount()
+		{
+			std::uint32_t widthClassCount = 0;
+			for (std::uint32_t i = 0; i < ColumnCount; ++i)
+			{
+				if (IsFirstOfWidthClass(i))
+				{
+					++widthClassCount;
+				}
+			}
+
+			return widthClassCount;
+		}
+
+		static constexpr std::uint32_t GetColumnSize(std::uint32_t column, std::uint32_t wideMask)
+		{
+			switch (Schema::Columns[column])
+			{
+			case ColumnType::Byte: return 1;
+			case ColumnType::Word: return 2;
+			case ColumnType::Dword: return 4;
+			default: return ((wideMask >> GetWidthClass(column)) & 1) != 0 ? 4 : 2;
+			}
+		}
+
+		static constexpr std::uint32_t GetColumnOffset(std::uint32_t column, std::uint32_t wideMask)
+		{
+			std::uint32_t offset = 0;
+			for (std::uint32_t i = 0; i < column; ++i)
+			{
+				offset += GetColumnSize(i, wideMask);
+			}
+
+			return offset;
+		}
+
+		static constexpr std::uint32_t GetRowSize(std::uint32_t wideMask)
+		{
+			return GetColumnOffset(ColumnCount, wideMask);
+		}
+
+		static constexpr std::uint32_t WidthClassCount = GetWidthClassCount();
+		static constexpr std::uint32_t LayoutCount = 1u << WidthClassCount;
+
+	private:
+		static constexpr bool IsFirstOfWidthClass(std::uint32_t column)
+		{
+			if (IsFixedSizeColumnType(Schema::Columns[column]))
+			{
+				return false;
+			}
+
+			for (std::uint32_t i = 0; i < column; ++i)
+			{
+				if (Schema::Columns[i] == Schema::Columns[column])
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+	};
+
+	constexpr std::uint32_t BitsNeeded(std::uint32_t n)
+	{
+		return n <= 1 ? 0 : 1 + BitsNeeded((n + 1) / 2);
+	}
+
+	// ECMA-335 II.24.2.6. The low TagBits of an index select one of Tables and the remaining bits
+	// hold the 1-based row id. Single table indices are described the same way with no tag bits.
+	struct IndexSchema
+	{
+		const TableId* Tables;
+		std::uint32_t TableCount;
+		std::uint32_t TagBits;
+	};
+
+	struct IndexedTables
+	{
+		static constexpr TableId TypeDef[] = { TableId::TypeDef };
+		static constexpr TableId Field[] = { TableId::Field };
+		static constexpr TableId MethodDef[] = { TableId::MethodDef };
+		static constexpr TableId Param[] = { TableId::Param };
+		static constexpr TableId Event[] = { TableId::Event };
+		static constexpr TableId Property[] = { TableId::Property };
+		static constexpr TableId ModuleRef[] = { TableId::ModuleRef };
+		static constexpr TableId AssemblyRef[] = { TableId::AssemblyRef };
+		static constexpr TableId GenericParam[] = { TableId::GenericParam };
+
+		static constexpr TableId ResolutionScope[] =
+		{
+			TableId::Module,
+			TableId::ModuleRef,
+			TableId::AssemblyRef,
+			TableId::TypeRef
+		};
+
+		static constexpr TableId TypeDefOrRef[] =
+		{
+			TableId::TypeDef,
+			TableId::TypeRef,
+			TableId::TypeSpec
+		};
+
+		static constexpr TableId MemberRefParent[] =
+		{
+			TableId::TypeDef,
+			TableId::TypeRef,
+			TableId::ModuleRef,
+			TableId::MethodDef,
+			TableId::TypeSpec
+		};
+
+		static constexpr TableId HasConstant[] =
+		{
+			TableId::Field,
+			TableId::Param,
+			TableId::Property
+		};
+
+		static constexpr TableId HasCustomAttribute[] =
+		{
+			TableId::MethodDef,
+			TableId::Field,
+			TableId::TypeRef,
+			TableId::TypeDef,
+			TableId::Param,
+			TableId::InterfaceImpl,
+			TableId::MemberRef,
+			TableId::Module,
+			TableId::DeclSecurity,
+			TableId::Property,
+			TableId::Event,
+			TableId::StandAloneSig,
+			TableId::ModuleRef,
+			TableId::TypeSpec,
+			TableId::Assembly,
+			TableId::AssemblyRef,
+			TableId::File,
+			TableId::ExportedType,
+			TableId::ManifestResource,
+			TableId::GenericParam,
+			TableId::GenericParamConstraint,
+			TableId::MethodSpec
+		};
+
+		static constexpr TableId CustomAttributeType[] =
+		{
+			TableId::NotUsed,
+			TableId::NotUsed,
+			TableId::MethodDef,
+			TableId::MemberRef,
+			TableId::NotUsed
+		};
+
+		static constexpr TableId HasFieldMarshal[] = { TableId::Field, TableId::Param };
+		static constexpr TableId HasDeclSecurity[] = { TableId::TypeDef, TableId::MethodDef, TableId::Assembly };
+		static constexpr TableId HasSemantics[] = { TableId::Event, TableId::Property };
+		static constexpr TableId MethodDefOrRef[] = { TableId::MethodDef, TableId::MemberRef };
+		static constexpr TableId MemberForwarded[] = { TableId::Field, TableId::MethodDef };
+		static constexpr TableId Implementation[] = { TableId::File, TableId::AssemblyRef, TableId::ExportedType };
+		static constexpr TableId TypeOrMethodDef[] = { TableId::TypeDef, TableId::MethodDef };
+	};
+
+	template<std::size_t TableCount>
+	constexpr IndexSchema MakeIndexSchema(const TableId (&tables)[TableCount])
+	{
+		return IndexSchema{ tables, static_cast<std::uint32_t>(TableCount), BitsNeeded(static_cast<std::uint32_t>(TableCount)) };
+	}
+
+	constexpr bool IsIndexColumnType(ColumnType columnType)
+	{
+		return columnType >= ColumnType::TypeDef;
+	}
+
+	constexpr IndexSchema GetIndexSchema(ColumnType columnType)
+	{
+		switch (columnType)
+		{
+		case ColumnType::TypeDef: return MakeIndexSchema(IndexedTables::TypeDef);
+		case ColumnType::Field: return MakeIndexSchema(IndexedTables::Field);
+		case ColumnType::MethodDef: return MakeIndexSchema(IndexedTables::MethodDef);
+		case ColumnType::Param: return MakeIndexSchema(IndexedTables::Param);
+		case ColumnType::Event: return MakeIndexSchema(IndexedTables::Event);
+		case ColumnType::Property: return MakeIndexSchema(IndexedTables::Property);
+		case ColumnType::ModuleRef: return MakeIndexSchema(IndexedTables::ModuleRef);
+		case ColumnType::AssemblyRef: return MakeIndexSchema(IndexedTables::AssemblyRef);
+		case ColumnType::GenericParam: return MakeIndexSchema(IndexedTables::GenericParam);
+		case ColumnType::ResolutionScope: return MakeIndexSchema(IndexedTables::ResolutionScope);
+		case ColumnType::TypeDefOrRef: return MakeIndexSchema(IndexedTables::TypeDefOrRef);
+		case ColumnType::MemberRefParent: return MakeIndexSchema(IndexedTables::MemberRefParent);
+		case ColumnType::HasConstant: return MakeIndexSchema(IndexedTables::HasConstant);
+		case ColumnType::HasCustomAttribute: return MakeIndexSchema(IndexedTables::HasCustomAttribute);
+		case ColumnType::CustomAttributeType: return MakeIndexSchema(IndexedTables::CustomAttributeType);
+		case ColumnType::HasFieldMarshal: return MakeIndexSchema(IndexedTables::HasFieldMarshal);
+		case ColumnType::HasDeclSecurity: return MakeIndexSchema(IndexedTables::HasDeclSecurity);
+		case ColumnType::HasSemantics: return MakeIndexSchema(IndexedTables::HasSemantics);
+		case ColumnType::MethodDefOrRef: return MakeIndexSchema(IndexedTables::MethodDefOrRef);
+		case ColumnType::MemberForwarded: return MakeIndexSchema(IndexedTables::MemberForwarded);
+		case ColumnType::Implementation: return MakeIndexSchema(IndexedTables::Implementation);
+		case ColumnType::TypeOrMethodDef: return MakeIndexSchema(IndexedTables::TypeOrMethodDef);
+		default: return IndexSchema{ nullptr, 0, 0 };
+		}
+	}
+
+	static_assert(GetIndexSchema(ColumnType::HasCustomAttribute).TagBits == 5, "HasCustomAttribute uses 5 tag bits");
+	static_assert(GetIndexSchema(ColumnType::CustomAttributeType).TagBits == 3, "CustomAttributeType uses 3 tag bits");
+
+	// ECMA-335 II.22 requires these tables to be sorted by a key column. A module confirms that it
+	// honours the order through the Sorted bit vector of the #~ stream header.
+	template<TableId Id>
+	struct SortKey
+	{
+		static constexpr bool IsDefined = false;
+	};
+
+#define DECLARE_SORT_KEY(Name, KeyColumn) \
+	template<> struct SortKey<TableId::Name> \
+	{ \
+		static constexpr bool IsDefined = true; \
+		static constexpr auto Column = Name##Schema::KeyColumn; \
+	}
+
+	DECLARE_SORT_KEY(InterfaceImpl, Class);
+	DECLARE_SORT_KEY(Constant, Parent);
+	DECLARE_SORT_KEY(CustomAttribute, Parent);
+	DECLARE_SORT_KEY(FieldMarshal, Parent);
+	DECLARE_SORT_KEY(DeclSecurity, Parent);
+	DECLARE_SORT_KEY(ClassLayout, Parent);
+	DECLARE_SORT_KEY(FieldLayout, Field);
+	DECLARE_SORT_KEY(MethodSemantics, Association);
+	DECLARE_SORT_KEY(MethodImpl, Class);
+	DECLARE_SORT_KEY(ImplMap, MemberForwarded);
+	DECLARE_SORT_KEY(FieldRVA, Field);
+	DECLARE_SORT_KEY(NestedClass, NestedClass);
+	DECLARE_SORT_KEY(GenericParam, Owner);
+	DECLARE_SORT_KEY(GenericParamConstraint, Owner);
+
+#undef DECLARE_SORT_KEY
+
+	// A decoded metadata index: the referenced table and the 1-based row id (0 means "no row").
+	struct RowReference
+	{
+		TableId Table;
+		std::uint32_t Rid;
+	};
+
+	inline bool TryDecodeIndex(ColumnType columnType, std::uint32_t value, RowReference& reference)
+	{
+		auto indexSchema = GetIndexSchema(columnType);
+		auto tag = value & ((1u << indexSchema.TagBits) - 1);
+		if (tag >= indexSchema.TableCount || indexSchema.Tables[tag] == TableId::NotUsed)
+		{
+			return false;
+		}
+
+		reference = RowReference{ indexSchema.Tables[tag], value >> indexSchema.TagBits };
+		return true;
+	}
+
+	inline std::uint32_t EncodeIndex(ColumnType columnType, RowReference reference)
+	{
+		auto indexSchema = GetIndexSchema(columnType);
+		auto tablesEnd = indexSchema.Tables + indexSchema.TableCount;
+		auto table = std::find(indexSchema.Tables, tablesEnd, reference.Table);
+		CheckError(table != tablesEnd, "Table cannot be referenced by this index");
+
+		auto tag = static_cast<std::uint32_t>(table - indexSchema.Tables);
+		return (reference.Rid << indexSchema.TagBits) | tag;
+	}
+}
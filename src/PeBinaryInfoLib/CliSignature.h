@@ -0,0 +1,531 @@
+#pragma once
+#include "stdafx.h"
+#include "Helpers.h"
+#include "CliMetadataSchema.h"
+
+namespace peinfo
+{
+	// Forward-only cursor over a blob. Reading past the end throws instead of touching memory
+	// outside of the blob.
+	class BlobReader
+	{
+	public:
+		explicit BlobReader(Span<const std::uint8_t> data)
+			: data_(data), position_(0)
+		{
+		}
+
+		bool IsAtEnd() const
+		{
+			return position_ == data_.size();
+		}
+
+		std::size_t GetPosition() const
+		{
+			return position_;
+		}
+
+		Span<const std::uint8_t> GetRemaining() const
+		{
+			return data_.subspan(position_);
+		}
+
+		std::uint8_t PeekByte() const
+		{
+			CheckError(position_ < data_.size(), "Unexpected end of blob");
+			return data_[position_];
+		}
+
+		std::uint8_t ReadByte()
+		{
+			auto value = PeekByte();
+			++position_;
+			return value;
+		}
+
+		// Little-endian fixed size value
+		template<class T>
+		T Read()
+		{
+			auto bytes = ReadBytes(sizeof(T));
+			T value;
+			std::memcpy(&value, bytes.data(), sizeof(T));
+			return value;
+		}
+
+		Span<const std::uint8_t> ReadBytes(std::size_t size)
+		{
+			CheckError(size <= data_.size() - position_, "Unexpected end of blob");
+			auto bytes = data_.subspan(position_, size);
+			position_ += size;
+			return bytes;
+		}
+
+		// ECMA-335 II.23.2: big-endian, the number of leading 1 bits of the first byte gives the length.
+		std::uint32_t ReadCompressedUInt32()
+		{
+			std::uint32_t size;
+			return ReadCompressedUInt32(size);
+		}
+
+		// ECMA-335 II.23.2: the sign bit is rotated into the least significant bit.
+		std::int32_t ReadCompressedInt32()
+		{
+			std::uint32_t size;
+			auto value = ReadCompressedUInt32(size);
+			if ((value & 1) == 0)
+			{
+				return static_cast<std::int32_t>(value >> 1);
+			}
+
+			std::uint32_t signExtension = size == 1 ? 0xFFFFFFC0u : size == 2 ? 0xFFFFE000u : 0xF0000000u;
+			return static_cast<std::int32_t>((value >> 1) | signExtension);
+		}
+
+		// ECMA-335 II.23.2.8
+		RowReference ReadTypeDefOrRefEncoded()
+		{
+			RowReference reference{};
+			CheckError(TryDecodeIndex(ColumnType::TypeDefOrRef, ReadCompressedUInt32(), reference), "Invalid TypeDefOrRef encoding");
+			return reference;
+		}
+
+	private:
+		std::uint32_t ReadCompressedUInt32(std::uint32_t& size)
+		{
+			auto firstByte = ReadByte();
+			if ((firstByte & 0x80) == 0)
+			{
+				size = 1;
+				return firstByte;
+			}
+
+			if ((firstByte & 0xC0) == 0x80)
+			{
+				size = 2;
+				return ((firstByte & 0x3Fu) << 8) | ReadByte();
+			}
+
+			CheckError((firstByte & 0xE0) == 0xC0, "Invalid compressed integer");
+			size = 4;
+			auto bytes = ReadBytes(3);
+			return ((firstByte & 0x1Fu) << 24) | (bytes[0] << 16) | (bytes[1] << 8) | bytes[2];
+		}
+
+		Span<const std::uint8_t> data_;
+		std::size_t position_;
+	};
+
+	// ECMA-335 II.23.1.16
+	enum class ElementType : std::uint8_t
+	{
+		End = 0x00,
+		Void = 0x01,
+		Boolean = 0x02,
+		Char = 0x03,
+		I1 = 0x04,
+		U1 = 0x05,
+		I2 = 0x06,
+		U2 = 0x07,
+		I4 = 0x08,
+		U4 = 0x09,
+		I8 = 0x0A,
+		U8 = 0x0B,
+		R4 = 0x0C,
+		R8 = 0x0D,
+		String = 0x0E,
+		Ptr = 0x0F,
+		ByRef = 0x10,
+		ValueType = 0x11,
+		Class = 0x12,
+		Var = 0x13,
+		Array = 0x14,
+		GenericInst = 0x15,
+		TypedByRef = 0x16,
+		I = 0x18,
+		U = 0x19,
+		FnPtr = 0x1B,
+		Object = 0x1C,
+		SzArray = 0x1D,
+		MVar = 0x1E,
+		CModReqd = 0x1F,
+		CModOpt = 0x20,
+		Internal = 0x21,
+		Sentinel = 0x41,
+		Pinned = 0x45,
+
+		// custom attribute encoding only (II.23.3)
+		Type = 0x50,
+		Boxed = 0x51,
+		Field = 0x53,
+		Property = 0x54,
+		Enum = 0x55
+	};
+
+	// ECMA-335 II.23.2.1 - II.23.2.6: first byte of a signature
+	struct SignatureHeader
+	{
+		static const std::uint8_t KindMask = 0x0F;
+		static const std::uint8_t VarArg = 0x05;
+		static const std::uint8_t Field = 0x06;
+		static const std::uint8_t LocalSig = 0x07;
+		static const std::uint8_t Property = 0x08;
+		static const std::uint8_t GenericInst = 0x0A;
+		static const std::uint8_t Generic = 0x10;
+		static const std::uint8_t HasThis = 0x20;
+		static const std::uint8_t ExplicitThis = 0x40;
+	};
+
+	// A single type of a signature (II.23.2.12), viewed in place together with its custom modifiers.
+	class TypeSignature
+	{
+	public:
+		explicit TypeSignature(Span<const std::uint8_t> data)
+			: data_(data)
+		{
+		}
+
+		// Consumes exactly one type from the reader.
+		static TypeSignature Read(BlobReader& reader)
+		{
+			auto start = reader.GetRemaining();
+			auto startPosition = reader.GetPosition();
+			Skip(reader, 0);
+			return TypeSignature(start.subspan(0, reader.GetPosition() - startPosition));
+		}
+
+		Span<const std::uint8_t> GetData() const
+		{
+			return data_;
+		}
+
+		// Element type after the custom modifiers
+		ElementType GetElementType() const
+		{
+			return static_cast<ElementType>(GetReaderAfterModifiers().PeekByte());
+		}
+
+		// visitor(bool isRequired, RowReference modifierType)
+		template<class Visitor>
+		void ForEachCustomModifier(Visitor&& visitor) const
+		{
+			BlobReader reader(data_);
+			while (IsCustomModifier(reader.PeekByte()))
+			{
+				auto isRequired = static_cast<ElementType>(reader.ReadByte()) == ElementType::CModReqd;
+				visitor(isRequired, reader.ReadTypeDefOrRefEncoded());
+			}
+		}
+
+		// Class, ValueType and the generic type of GenericInst
+		RowReference GetTypeReference() const
+		{
+			auto reader = GetReaderAfterModifiers();
+			auto elementType = static_cast<ElementType>(reader.ReadByte());
+			if (elementType == ElementType::GenericInst)
+			{
+				elementType = static_cast<ElementType>(reader.ReadByte());
+			}
+
+			CheckError(elementType == ElementType::Class || elementType == ElementType::ValueType, "Type signature does not reference a type");
+			return reader.ReadTypeDefOrRefEncoded();
+		}
+
+		// Ptr, ByRef, Pinned, SzArray and Array
+		TypeSignature GetElementTypeSignature() const
+		{
+			auto reader = GetReaderAfterModifiers();
+			auto elementType = static_cast<ElementType>(reader.ReadByte());
+			CheckError(
+				elementType == ElementType::Ptr || elementType == ElementType::ByRef || elementType == ElementType::Pinned
+				|| elementType == ElementType::SzArray || elementType == ElementType::Array,
+				"Type signature has no element type");
+			return Read(reader);
+		}
+
+		// Var and MVar
+		std::uint32_t GetGenericParameterNumber() const
+		{
+			auto reader = GetReaderAfterModifiers();
+			auto elementType = static_cast<ElementType>(reader.ReadByte());
+			CheckError(elementType == ElementType::Var || elementType == ElementType::MVar, "Type signature is not a generic parameter");
+			return reader.ReadCompressedUInt32();
+		}
+
+		// visitor(const TypeSignature& argument) for every argument of a GenericInst
+		template<class Visitor>
+		void ForEachGenericArgument(Visitor&& visitor) const
+		{
+			auto reader = GetReaderAfterModifiers();
+			CheckError(static_cast<ElementType>(reader.ReadByte()) == ElementType::GenericInst, "Type signature is not a generic instantiation");
+			reader.ReadByte();
+			reader.ReadTypeDefOrRefEncoded();
+
+			auto argumentCount = reader.ReadCompressedUInt32();
+			for (std::uint32_t i = 0; i < argumentCount; ++i)
+			{
+				visitor(Read(reader));
+			}
+		}
+
+		// Skips a MethodDefSig, MethodRefSig or PropertySig
+		static void SkipMethodSignature(BlobReader& reader, std::uint32_t depth)
+		{
+			auto header = reader.ReadByte();
+			if ((header & SignatureHeader::Generic) != 0)
+			{
+				reader.ReadCompressedUInt32();
+			}
+
+			auto parameterCount = reader.ReadCompressedUInt32();
+			Skip(reader, depth + 1);
+			for (std::uint32_t i = 0; i < parameterCount; ++i)
+			{
+				if (static_cast<ElementType>(reader.PeekByte()) == ElementType::Sentinel)
+				{
+					reader.ReadByte();
+				}
+
+				Skip(reader, depth + 1);
+			}
+		}
+
+	private:
+		static bool IsCustomModifier(std::uint8_t value)
+		{
+			auto elementType = static_cast<ElementType>(value);
+			return elementType == ElementType::CModReqd || elementType == ElementType::CModOpt;
+		}
+
+		BlobReader GetReaderAfterModifiers() const
+		{
+			BlobReader reader(data_);
+			while (IsCustomModifier(reader.PeekByte()))
+			{
+				reader.ReadByte();
+				reader.ReadTypeDefOrRefEncoded();
+			}
+
+			return reader;
+		}
+
+		static void Skip(BlobReader& reader, std::uint32_t depth)
+		{
+			CheckError(depth < MaxNestingDepth, "Signature is nested too deeply");
+
+			while (IsCustomModifier(reader.PeekByte()))
+			{
+				reader.ReadByte();
+				reader.ReadTypeDefOrRefEncoded();
+			}
+
+			auto elementType = static_cast<ElementType>(reader.ReadByte());
+			switch (elementType)
+			{
+			case ElementType::Void:
+			case ElementType::Boolean:
+			case ElementType::Char:
+			case ElementType::I1:
+			case ElementType::U1:
+			case ElementType::I2:
+			case ElementType::U2:
+			case ElementType::I4:
+			case ElementType::U4:
+			case ElementType::I8:
+			case ElementType::U8:
+			case ElementType::R4:
+			case ElementType::R8:
+			case ElementType::String:
+			case ElementType::TypedByRef:
+			case ElementType::I:
+			case ElementType::U:
+			case ElementType::Object:
+				return;
+			case ElementType::Ptr:
+			case ElementType::ByRef:
+			case ElementType::Pinned:
+			case ElementType::SzArray:
+				Skip(reader, depth + 1);
+				return;
+			case ElementType::ValueType:
+			case ElementType::Class:
+				reader.ReadTypeDefOrRefEncoded();
+				return;
+			case ElementType::Var:
+			case ElementType::MVar:
+				reader.ReadCompressedUInt32();
+				return;
+			case ElementType::Array:
+				Skip(reader, depth + 1);
+				SkipArrayShape(reader);
+				return;
+			case ElementType::GenericInst:
+			{
+				reader.ReadByte();
+				reader.ReadTypeDefOrRefEncoded();
+				auto argumentCount = reader.ReadCompressedUInt32();
+				for (std::uint32_t i = 0; i < argumentCount; ++i)
+				{
+					Skip(reader, depth + 1);
+				}
+
+				return;
+			}
+			case ElementType::FnPtr:
+				SkipMethodSignature(reader, depth + 1);
+				return;
+			default:
+				throw std::runtime_error("Invalid element type in signature");
+			}
+		}
+
+		// ECMA-335 II.23.2.13
+		static void SkipArrayShape(BlobReader& reader)
+		{
+			reader.ReadCompressedUInt32(); // rank
+
+			auto sizeCount = reader.ReadCompressedUInt32();
+			for (std::uint32_t i = 0; i < sizeCount; ++i)
+			{
+				reader.ReadCompressedUInt32();
+			}
+
+			auto lowerBoundCount = reader.ReadCompressedUInt32();
+			for (std::uint32_t i = 0; i < lowerBoundCount; ++i)
+			{
+				reader.ReadCompressedInt32();
+			}
+		}
+
+		static const std::uint32_t MaxNestingDepth = 64;
+
+		Span<const std::uint8_t> data_;
+	};
+
+	// MethodDefSig, MethodRefSig (II.23.2.1, II.23.2.2) and PropertySig (II.23.2.5), which share the
+	// same layout: header, optional generic parameter count, parameter count, return type, parameters.
+	class MethodSignature
+	{
+	public:
+		explicit MethodSignature(Span<const std::uint8_t> blob)
+			: parameters_(Span<const std::uint8_t>()), returnType_(Span<const std::uint8_t>())
+		{
+			BlobReader reader(blob);
+			header_ = reader.ReadByte();
+
+			auto kind = header_ & SignatureHeader::KindMask;
+			CheckError(kind <= SignatureHeader::VarArg || kind == SignatureHeader::Property, "Not a method or property signature");
+
+			genericParameterCount_ = (header_ & SignatureHeader::Generic) != 0 ? reader.ReadCompressedUInt32() : 0;
+			parameterCount_ = reader.ReadCompressedUInt32();
+			returnType_ = TypeSignature::Read(reader);
+			parameters_ = reader;
+		}
+
+		std::uint8_t GetHeader() const
+		{
+			return header_;
+		}
+
+		bool HasThis() const
+		{
+			return (header_ & SignatureHeader::HasThis) != 0;
+		}
+
+		std::uint32_t GetGenericParameterCount() const
+		{
+			return genericParameterCount_;
+		}
+
+		std::uint32_t GetParameterCount() const
+		{
+			return parameterCount_;
+		}
+
+		const TypeSignature& GetReturnType() const
+		{
+			return returnType_;
+		}
+
+		// visitor(const TypeSignature& parameter). The vararg sentinel of a MethodRefSig is skipped.
+		template<class Visitor>
+		void ForEachParameter(Visitor&& visitor) const
+		{
+			auto reader = parameters_;
+			for (std::uint32_t i = 0; i < parameterCount_; ++i)
+			{
+				if (static_cast<ElementType>(reader.PeekByte()) == ElementType::Sentinel)
+				{
+					reader.ReadByte();
+				}
+
+				visitor(TypeSignature::Read(reader));
+			}
+		}
+
+	private:
+		std::uint8_t header_;
+		std::uint32_t genericParameterCount_;
+		std::uint32_t parameterCount_;
+		BlobReader parameters_;
+		TypeSignature returnType_;
+	};
+
+	// FieldSig (II.23.2.4)
+	class FieldSignature
+	{
+	public:
+		explicit FieldSignature(Span<const std::uint8_t> blob)
+			: type_(Span<const std::uint8_t>())
+		{
+			BlobReader reader(blob);
+			CheckError((reader.ReadByte() & SignatureHeader::KindMask) == SignatureHeader::Field, "Not a field signature");
+			type_ = TypeSignature::Read(reader);
+		}
+
+		const TypeSignature& GetType() const
+		{
+			return type_;
+		}
+
+	private:
+		TypeSignature type_;
+	};
+
+	// LocalVarSig (II.23.2.6). Pinned locals are reported as an ElementType::Pinned type.
+	class LocalVarSignature
+	{
+	public:
+		explicit LocalVarSignature(Span<const std::uint8_t> blob)
+			: locals_(blob)
+		{
+			CheckError((locals_.ReadByte() & SignatureHeader::KindMask) == SignatureHeader::LocalSig, "Not a local variable signature");
+			localCount_ = locals_.ReadCompressedUInt32();
+		}
+
+		std::uint32_t GetLocalCount() const
+		{
+			return localCount_;
+		}
+
+		// visitor(const TypeSignature& local)
+		template<class Visitor>
+		void ForEachLocal(Visitor&& visitor) const
+		{
+			auto reader = locals_;
+			for (std::uint32_t i = 0; i < localCount_; ++i)
+			{
+				visitor(TypeSignature::Read(reader));
+			}
+		}
+
+	private:
+		BlobReader locals_;
+		std::uint32_t localCount_;
+	};
+
+	inline bool IsFieldSignature(Span<const std::uint8_t> blob)
+	{
+		return !blob.empty() && (blob[0] & SignatureHeader::KindMask) == SignatureHeader::Field;
+	}
+}
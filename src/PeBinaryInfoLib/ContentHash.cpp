@@ -0,0 +1,370 @@
+#include "stdafx.h"
+#include "PeBinaryInfo.h"
+#include "ContentHash.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		const std::uint64_t Prime1 = 0x9E3779B185EBCA87;
+		const std::uint64_t Prime2 = 0xC2B2AE3D27D4EB4F;
+		const std::uint64_t Prime3 = 0x165667B19E3779F9;
+		const std::uint64_t Prime4 = 0x85EBCA77C2B2AE63;
+		const std::uint64_t Prime5 = 0x27D4EB2F165667C5;
+
+		const std::size_t StripeSize = 32;
+
+		// Large enough that per-call overhead does not matter, small enough to stay in the cache
+		const std::size_t ContentReadSize = 256 * 1024;
+
+		std::uint64_t RotateLeft(std::uint64_t value, int bits)
+		{
+			return (value << bits) | (value >> (64 - bits));
+		}
+
+		template<class T>
+		T ReadLittleEndian(const std::uint8_t* data)
+		{
+			T value;
+			std::memcpy(&value, data, sizeof(T));
+			return value;
+		}
+
+		std::uint64_t Round(std::uint64_t accumulator, std::uint64_t input)
+		{
+			accumulator += input * Prime2;
+			accumulator = RotateLeft(accumulator, 31);
+			return accumulator * Prime1;
+		}
+
+		const std::size_t Md5BlockSize = 64;
+
+		const std::uint32_t Md5Constants[64] =
+		{
+			0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+			0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+			0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+			0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+			0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+			0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+			0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+			0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+		};
+
+		const int Md5Shifts[64] =
+		{
+			7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+			5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+			4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+			6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+		};
+
+		void ConsumeMd5Block(std::uint32_t (&state)[4], const std::uint8_t* block)
+		{
+			std::uint32_t words[16];
+			for (int i = 0; i < 16; ++i)
+			{
+				words[i] = ReadLittleEndian<std::uint32_t>(block + i * 4);
+			}
+
+			auto a = state[0];
+			auto b = state[1];
+			auto c = state[2];
+			auto d = state[3];
+			for (int i = 0; i < 64; ++i)
+			{
+				std::uint32_t f;
+				int word;
+				if (i < 16)
+				{
+					f = (b & c) | (~b & d);
+					word = i;
+				}
+				else if (i < 32)
+				{
+					f = (d & b) | (~d & c);
+					word = (5 * i + 1) % 16;
+				}
+				else if (i < 48)
+				{
+					f = b ^ c ^ d;
+					word = (3 * i + 5) % 16;
+				}
+				else
+				{
+					f = c ^ (b | ~d);
+					word = (7 * i) % 16;
+				}
+
+				auto sum = a + f + Md5Constants[i] + words[word];
+				a = d;
+				d = c;
+				c = b;
+				b += (sum << Md5Shifts[i]) | (sum >> (32 - Md5Shifts[i]));
+			}
+
+			state[0] += a;
+			state[1] += b;
+			state[2] += c;
+			state[3] += d;
+		}
+
+		std::uint64_t MergeRound(std::uint64_t accumulator, std::uint64_t value)
+		{
+			accumulator ^= Round(0, value);
+			return accumulator * Prime1 + Prime4;
+		}
+
+		void ConsumeStripe(std::uint64_t (&accumulators)[4], const std::uint8_t* stripe)
+		{
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				accumulators[lane] = Round(accumulators[lane], ReadLittleEndian<std::uint64_t>(stripe + lane * 8));
+			}
+		}
+
+		thread_local std::vector<std::uint8_t> contentBuffer;
+	}
+
+	Xxh64::Xxh64(std::uint64_t seed)
+		: seed_(seed), accumulators_{ seed + Prime1 + Prime2, seed + Prime2, seed, seed - Prime1 }, totalSize_(0), pending_{}, pendingSize_(0)
+	{
+	}
+
+	void Xxh64::Update(const void* data, std::size_t size)
+	{
+		auto input = static_cast<const std::uint8_t*>(data);
+		totalSize_ += size;
+
+		if (pendingSize_ + size < StripeSize)
+		{
+			std::memcpy(pending_ + pendingSize_, input, size);
+			pendingSize_ += size;
+			return;
+		}
+
+		if (pendingSize_ > 0)
+		{
+			auto fill = StripeSize - pendingSize_;
+			std::memcpy(pending_ + pendingSize_, input, fill);
+			ConsumeStripe(accumulators_, pending_);
+			input += fill;
+			size -= fill;
+			pendingSize_ = 0;
+		}
+
+		for (; size >= StripeSize; input += StripeSize, size -= StripeSize)
+		{
+			ConsumeStripe(accumulators_, input);
+		}
+
+		std::memcpy(pending_, input, size);
+		pendingSize_ = size;
+	}
+
+	std::uint64_t Xxh64::Digest() const
+	{
+		std::uint64_t hash;
+		if (totalSize_ >= StripeSize)
+		{
+			hash = RotateLeft(accumulators_[0], 1) + RotateLeft(accumulators_[1], 7) + RotateLeft(accumulators_[2], 12) + RotateLeft(accumulators_[3], 18);
+			for (auto accumulator : accumulators_)
+			{
+				hash = MergeRound(hash, accumulator);
+			}
+		}
+		else
+		{
+			hash = seed_ + Prime5;
+		}
+
+		hash += totalSize_;
+
+		const std::uint8_t* input = pending_;
+		std::size_t size = pendingSize_;
+		for (; size >= 8; input += 8, size -= 8)
+		{
+			hash ^= Round(0, ReadLittleEndian<std::uint64_t>(input));
+			hash = RotateLeft(hash, 27) * Prime1 + Prime4;
+		}
+
+		if (size >= 4)
+		{
+			hash ^= ReadLittleEndian<std::uint32_t>(input) * Prime1;
+			hash = RotateLeft(hash, 23) * Prime2 + Prime3;
+			input += 4;
+			size -= 4;
+		}
+
+		for (; size > 0; ++input, --size)
+		{
+			hash ^= *input * Prime5;
+			hash = RotateLeft(hash, 11) * Prime1;
+		}
+
+		hash ^= hash >> 33;
+		hash *= Prime2;
+		hash ^= hash >> 29;
+		hash *= Prime3;
+		hash ^= hash >> 32;
+		return hash;
+	}
+
+	Md5::Md5()
+		: state_{ 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 }, totalSize_(0), pending_{}, pendingSize_(0)
+	{
+	}
+
+	void Md5::Update(const void* data, std::size_t size)
+	{
+		auto input = static_cast<const std::uint8_t*>(data);
+		totalSize_ += size;
+
+		while (size > 0)
+		{
+			auto count = std::min(size, Md5BlockSize - pendingSize_);
+			std::memcpy(pending_ + pendingSize_, input, count);
+			pendingSize_ += count;
+			input += count;
+			size -= count;
+
+			if (pendingSize_ == Md5BlockSize)
+			{
+				ConsumeMd5Block(state_, pending_);
+				pendingSize_ = 0;
+			}
+		}
+	}
+
+	std::string Md5::HexDigest() const
+	{
+		// The padding is a one bit, zeros up to 8 bytes before a block boundary, and the size in bits
+		auto final = *this;
+		const std::uint8_t padding[Md5BlockSize] = { 0x80 };
+		auto bitCount = totalSize_ * 8;
+		final.Update(padding, (final.pendingSize_ < 56 ? 56 : 120) - final.pendingSize_);
+
+		std::uint8_t size[8];
+		std::memcpy(size, &bitCount, sizeof(size));
+		final.Update(size, sizeof(size));
+
+		const char digits[] = "0123456789abcdef";
+		std::string digest;
+		for (auto word : final.state_)
+		{
+			for (int i = 0; i < 4; ++i, word >>= 8)
+			{
+				digest.push_back(digits[(word >> 4) & 0xF]);
+				digest.push_back(digits[word & 0xF]);
+			}
+		}
+
+		return digest;
+	}
+
+	bool IsSampleComplete(std::uint64_t size)
+	{
+		return size <= 2 * ContentSampleSize;
+	}
+
+	std::uint64_t HashImageSample(PeImageSource& image)
+	{
+		auto size = image.GetSize();
+		Xxh64 hash;
+		if (IsSampleComplete(size))
+		{
+			hash.Update(image.GetData(0, size), static_cast<std::size_t>(size));
+		}
+		else
+		{
+			hash.Update(image.GetData(0, ContentSampleSize), static_cast<std::size_t>(ContentSampleSize));
+			hash.Update(image.GetData(size - ContentSampleSize, ContentSampleSize), static_cast<std::size_t>(ContentSampleSize));
+		}
+
+		return hash.Digest();
+	}
+
+#ifdef _WIN32
+	std::uint64_t HashFileContent(const std::wstring& filePath, IoStatistics* statistics)
+	{
+		HANDLE fileHandle = CreateFile(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		HandleWin32Error(fileHandle == INVALID_HANDLE_VALUE);
+
+		contentBuffer.resize(ContentReadSize);
+		Xxh64 hash;
+		try
+		{
+			for (;;)
+			{
+				DWORD bytesRead = 0;
+				BOOL result = ReadFile(fileHandle, contentBuffer.data(), static_cast<DWORD>(contentBuffer.size()), &bytesRead, nullptr);
+				HandleWin32Error(result == FALSE);
+				if (bytesRead == 0)
+				{
+					break;
+				}
+
+				if (statistics != nullptr)
+				{
+					++statistics->ReadCalls;
+					statistics->BytesRead += bytesRead;
+				}
+
+				hash.Update(contentBuffer.data(), bytesRead);
+			}
+		}
+		catch (...)
+		{
+			CloseHandle(fileHandle);
+			throw;
+		}
+
+		CloseHandle(fileHandle);
+		return hash.Digest();
+	}
+#else
+	std::uint64_t HashFileContent(const std::wstring& filePath, IoStatistics* statistics)
+	{
+		int fd = open(utf16_to_native_path(filePath).c_str(), O_RDONLY | O_CLOEXEC);
+		HandlePosixError(fd == -1);
+
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+		contentBuffer.resize(ContentReadSize);
+		Xxh64 hash;
+		try
+		{
+			for (;;)
+			{
+				ssize_t bytesRead = read(fd, contentBuffer.data(), contentBuffer.size());
+				if (bytesRead == -1 && errno == EINTR)
+				{
+					continue;
+				}
+
+				HandlePosixError(bytesRead == -1);
+				if (bytesRead == 0)
+				{
+					break;
+				}
+
+				if (statistics != nullptr)
+				{
+					++statistics->ReadCalls;
+					statistics->BytesRead += static_cast<std::uint64_t>(bytesRead);
+				}
+
+				hash.Update(contentBuffer.data(), static_cast<std::size_t>(bytesRead));
+			}
+		}
+		catch (...)
+		{
+			close(fd);
+			throw;
+		}
+
+		close(fd);
+		return hash.Digest();
+	}
+#endif
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "PeImageSource.h"
+
+namespace peinfo
+{
+	// Streaming XXH64. Fast enough that hashing a file costs little more than reading it.
+	class Xxh64
+	{
+	public:
+		explicit Xxh64(std::uint64_t seed = 0);
+
+		void Update(const void* data, std::size_t size);
+		std::uint64_t Digest() const;
+
+	private:
+		std::uint64_t seed_;
+		std::uint64_t accumulators_[4];
+		std::uint64_t totalSize_;
+		std::uint8_t pending_[32];
+		std::size_t pendingSize_;
+	};
+
+	// MD5, only for identifiers that are defined by it, such as the imphash. Not used to compare content.
+	class Md5
+	{
+	public:
+		Md5();
+
+		void Update(const void* data, std::size_t size);
+
+		// Lowercase hex of the 16 byte digest
+		std::string HexDigest() const;
+
+	private:
+		std::uint32_t state_[4];
+		std::uint64_t totalSize_;
+		std::uint8_t pending_[64];
+		std::size_t pendingSize_;
+	};
+
+	// Bytes hashed at each end of an image by HashImageSample
+	const std::uint64_t ContentSampleSize = 64 * 1024;
+
+	// True when HashImageSample of an image of this size covers every byte.
+	bool IsSampleComplete(std::uint64_t size);
+
+	// Hash of the first and last ContentSampleSize bytes. Images with equal content have equal
+	// samples, so comparing sizes and samples rules out most different files after two reads. When
+	// the sample is complete, the hash equals HashFileContent of the same bytes.
+	std::uint64_t HashImageSample(PeImageSource& image);
+
+	// Hash of the whole file, read sequentially.
+	std::uint64_t HashFileContent(const std::wstring& filePath, IoStatistics* statistics);
+}
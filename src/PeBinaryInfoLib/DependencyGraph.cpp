@@ -0,0 +1,140 @@
+#include "stdafx.h"
+#include "DependencyGraph.h"
+#include "FilesystemPath.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		std::wstring ToLowerAscii(std::wstring text)
+		{
+			for (auto& character : text)
+			{
+				if (character >= L'A' && character <= L'Z')
+				{
+					character = static_cast<wchar_t>(character - L'A' + L'a');
+				}
+			}
+
+			return text;
+		}
+
+		std::wstring GetFileName(const std::wstring& filePath)
+		{
+			auto separator = filePath.find_last_of(L"/\\");
+			return separator == std::wstring::npos ? filePath : filePath.substr(separator + 1);
+		}
+	}
+
+	std::wstring GetDirectoryName(const std::wstring& filePath)
+	{
+		auto separator = filePath.find_last_of(L"/\\");
+		return separator == std::wstring::npos ? std::wstring() : filePath.substr(0, separator);
+	}
+
+	bool IsApiSetName(const std::wstring& moduleName)
+	{
+		auto prefix = ToLowerAscii(moduleName.substr(0, 7));
+		return prefix == L"api-ms-" || prefix == L"ext-ms-";
+	}
+
+	DependencyGraph::DependencyGraph(const std::vector<std::wstring>& searchDirectories)
+	{
+		for (const auto& directory : searchDirectories)
+		{
+			std::error_code error;
+			std::filesystem::directory_iterator iterator(ToFilesystemPath(directory), std::filesystem::directory_options::skip_permission_denied, error);
+			for (std::filesystem::directory_iterator end; !error && iterator != end; iterator.increment(error))
+			{
+				std::error_code statusError;
+				if (iterator->is_regular_file(statusError))
+				{
+					auto filePath = FromFilesystemPath(iterator->path());
+					listedByName_.emplace(ToLowerAscii(GetFileName(filePath)), filePath);
+				}
+			}
+
+			if (error)
+			{
+				throw std::runtime_error("Failed to list a search directory: " + error.message());
+			}
+		}
+	}
+
+	void DependencyGraph::AddModule(const std::wstring& filePath, std::vector<std::wstring> imports, std::vector<std::wstring> delayImports)
+	{
+		scannedByName_[ToLowerAscii(GetFileName(filePath))].push_back(filePath);
+		modules_.push_back(Module{ filePath, std::move(imports), std::move(delayImports) });
+	}
+
+	std::size_t DependencyGraph::GetModuleCount() const
+	{
+		return modules_.size();
+	}
+
+	void DependencyGraph::Resolve(const DependencyCallback& callback)
+	{
+		for (const auto& module : modules_)
+		{
+			auto directory = GetDirectoryName(module.FilePath);
+			for (const auto& name : module.Imports)
+			{
+				const auto& resolved = ResolveName(directory, name);
+				callback(ModuleDependency{ module.FilePath, name, false, resolved.Resolution, resolved.Path });
+			}
+
+			for (const auto& name : module.DelayImports)
+			{
+				const auto& resolved = ResolveName(directory, name);
+				callback(ModuleDependency{ module.FilePath, name, true, resolved.Resolution, resolved.Path });
+			}
+		}
+	}
+
+	const DependencyGraph::Resolved& DependencyGraph::ResolveName(const std::wstring& directory, const std::wstring& name)
+	{
+		auto lowercaseName = ToLowerAscii(name);
+		auto key = ToLowerAscii(directory) + L'\n' + lowercaseName;
+		auto cached = cache_.find(key);
+		if (cached != cache_.end())
+		{
+			return cached->second;
+		}
+
+		Resolved resolved{ DependencyResolution::Missing, std::wstring() };
+		auto scanned = scannedByName_.find(lowercaseName);
+		auto listed = listedByName_.find(lowercaseName);
+		if (IsApiSetName(lowercaseName))
+		{
+			resolved.Resolution = DependencyResolution::ApiSet;
+		}
+		else if (scanned != scannedByName_.end())
+		{
+			// Another scanned module of the name only counts once the search directories have no match
+			auto lowercaseDirectory = ToLowerAscii(directory);
+			auto sameDirectory = std::find_if(scanned->second.begin(), scanned->second.end(), [&lowercaseDirectory](const std::wstring& filePath)
+			{
+				return ToLowerAscii(GetDirectoryName(filePath)) == lowercaseDirectory;
+			});
+
+			if (sameDirectory != scanned->second.end())
+			{
+				resolved = Resolved{ DependencyResolution::Scanned, *sameDirectory };
+			}
+			else if (listed != listedByName_.end())
+			{
+				resolved = Resolved{ DependencyResolution::Listed, listed->second };
+			}
+			else
+			{
+				resolved = Resolved{ DependencyResolution::Scanned, *std::min_element(scanned->second.begin(), scanned->second.end()) };
+			}
+		}
+		else if (listed != listedByName_.end())
+		{
+			resolved = Resolved{ DependencyResolution::Listed, listed->second };
+		}
+
+		return cache_.emplace(std::move(key), std::move(resolved)).first->second;
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace peinfo
+{
+	enum class DependencyResolution
+	{
+		Scanned,   // a module that was scanned
+		Listed,    // a file in one of the search directories, which are listed but not scanned
+		ApiSet,    // an api-ms- or ext-ms- API set contract, which the loader maps to a system module
+		Missing
+	};
+
+	struct ModuleDependency
+	{
+		const std::wstring& Importer;
+		const std::wstring& Name;   // as imported
+		bool IsDelayLoaded;
+		DependencyResolution Resolution;
+		const std::wstring& ResolvedPath;  // empty unless Scanned or Listed
+	};
+
+	// The DLL dependency graph of a set of scanned modules. Imported names are resolved in the
+	// order the loader searches, as far as a static scan can follow it: a scanned module in the
+	// directory of the importer, then a file in the search directories in order, then a scanned
+	// module anywhere else. Names compare ignoring ASCII case. A fleet imports the same few hundred
+	// names many times, so each name is resolved once per importing directory and then cached.
+	class DependencyGraph
+	{
+	public:
+		using DependencyCallback = std::function<void(const ModuleDependency&)>;
+
+		// Lists the search directories, such as the system directory, without descending into them
+		explicit DependencyGraph(const std::vector<std::wstring>& searchDirectories);
+
+		// Not thread-safe; BatchScanner already serializes its callback calls.
+		void AddModule(const std::wstring& filePath, std::vector<std::wstring> imports, std::vector<std::wstring> delayImports);
+
+		std::size_t GetModuleCount() const;
+
+		// Resolves every import of every module, in the order the modules were added. Call once
+		// all modules are added.
+		void Resolve(const DependencyCallback& callback);
+
+	private:
+		struct Module
+		{
+			std::wstring FilePath;
+			std::vector<std::wstring> Imports;
+			std::vector<std::wstring> DelayImports;
+		};
+
+		struct Resolved
+		{
+			DependencyResolution Resolution;
+			std::wstring Path;
+		};
+
+		const Resolved& ResolveName(const std::wstring& directory, const std::wstring& name);
+
+		std::vector<Module> modules_;
+		std::unordered_map<std::wstring, std::vector<std::wstring>> scannedByName_;
+		std::unordered_map<std::wstring, std::wstring> listedByName_;
+		std::unordered_map<std::wstring, Resolved> cache_;
+	};
+
+	// The directory part of a path, without the separator; empty when there is none
+	std::wstring GetDirectoryName(const std::wstring& filePath);
+
+	// Whether the module name is an api-ms- or ext-ms- API set contract, ignoring ASCII case
+	bool IsApiSetName(const std::wstring& moduleName);
+}
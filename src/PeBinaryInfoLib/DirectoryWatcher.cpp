@@ -0,0 +1,410 @@
+#include "stdafx.h"
+#include "DirectoryWatcher.h"
+#include "FilesystemPath.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		// Large enough that a burst of events from a copy rarely needs more than one read
+		const std::size_t EventBufferSize = 64 * 1024;
+
+		std::wstring TrimTrailingSeparators(std::wstring path)
+		{
+			while (path.size() > 1 && (path.back() == L'/' || path.back() == L'\\'))
+			{
+				path.pop_back();
+			}
+
+			return path;
+		}
+
+		bool IsDirectory(const std::wstring& path)
+		{
+			std::error_code error;
+			return std::filesystem::is_directory(std::filesystem::symlink_status(ToFilesystemPath(path), error));
+		}
+	}
+
+#ifdef __linux__
+	namespace
+	{
+		// IN_MODIFY keeps a file that is being written from settling; IN_CLOSE_WRITE ends the last write
+		const std::uint32_t WatchMask = IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ONLYDIR | IN_DONT_FOLLOW;
+	}
+
+	struct DirectoryWatcher::Subscription
+	{
+		int InotifyFd = -1;
+		std::unordered_map<int, std::wstring> Directories;  // by watch descriptor
+
+		~Subscription()
+		{
+			if (InotifyFd != -1)
+			{
+				close(InotifyFd);
+			}
+		}
+
+		// Watches the directory and every directory below it. Only a failure on the directory
+		// itself is an error; subdirectories that cannot be watched are left out.
+		void AddDirectory(const std::wstring& directoryPath, bool isRoot)
+		{
+			int watch = inotify_add_watch(InotifyFd, utf16_to_native_path(directoryPath).c_str(), WatchMask);
+			if (watch == -1)
+			{
+				HandlePosixError(isRoot);
+				return;
+			}
+
+			Directories[watch] = directoryPath;
+
+			std::error_code error;
+			std::filesystem::recursive_directory_iterator iterator(
+				ToFilesystemPath(directoryPath), std::filesystem::directory_options::skip_permission_denied, error);
+
+			for (std::filesystem::recursive_directory_iterator end; !error && iterator != end; iterator.increment(error))
+			{
+				std::error_code statusError;
+				if (iterator->is_directory(statusError) && !iterator->is_symlink(statusError))
+				{
+					watch = inotify_add_watch(InotifyFd, iterator->path().c_str(), WatchMask);
+					if (watch != -1)
+					{
+						Directories[watch] = FromFilesystemPath(iterator->path());
+					}
+				}
+			}
+		}
+
+		// A directory renamed out of the tree keeps its watches, which would report the old paths
+		void RemoveDirectory(const std::wstring& directoryPath)
+		{
+			for (auto i = Directories.begin(); i != Directories.end();)
+			{
+				const auto& path = i->second;
+				if (path.compare(0, directoryPath.size(), directoryPath) == 0 && (path.size() == directoryPath.size() || path[directoryPath.size()] == L'/'))
+				{
+					inotify_rm_watch(InotifyFd, i->first);
+					i = Directories.erase(i);
+				}
+				else
+				{
+					++i;
+				}
+			}
+		}
+	};
+
+	DirectoryWatcher::DirectoryWatcher(const std::vector<std::wstring>& directories, std::chrono::milliseconds settleTime)
+		: settleTime_(settleTime), overflowed_(false), subscription_(std::make_unique<Subscription>())
+	{
+		subscription_->InotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		HandlePosixError(subscription_->InotifyFd == -1);
+
+		for (const auto& directory : directories)
+		{
+			subscription_->AddDirectory(TrimTrailingSeparators(directory), true);
+		}
+	}
+
+	void DirectoryWatcher::ReadEvents(std::chrono::milliseconds timeout)
+	{
+		pollfd pollFd{ subscription_->InotifyFd, POLLIN, 0 };
+		int ready = poll(&pollFd, 1, static_cast<int>(std::min<std::chrono::milliseconds::rep>(timeout.count(), std::numeric_limits<int>::max())));
+		if (ready == -1 && errno == EINTR)
+		{
+			return;
+		}
+
+		HandlePosixError(ready == -1);
+
+		alignas(inotify_event) char buffer[EventBufferSize];
+		for (;;)
+		{
+			auto size = read(subscription_->InotifyFd, buffer, sizeof(buffer));
+			if (size == -1 && (errno == EAGAIN || errno == EINTR))
+			{
+				return;
+			}
+
+			HandlePosixError(size == -1);
+
+			for (ssize_t offset = 0; offset < size;)
+			{
+				auto event = reinterpret_cast<const inotify_event*>(buffer + offset);
+				offset += sizeof(inotify_event) + event->len;
+
+				if ((event->mask & IN_Q_OVERFLOW) != 0)
+				{
+					overflowed_ = true;
+					continue;
+				}
+
+				auto directory = subscription_->Directories.find(event->wd);
+				if ((event->mask & IN_IGNORED) != 0)
+				{
+					if (directory != subscription_->Directories.end())
+					{
+						subscription_->Directories.erase(directory);
+					}
+
+					continue;
+				}
+
+				if (directory == subscription_->Directories.end() || event->len == 0)
+				{
+					continue;
+				}
+
+				auto path = directory->second + L"/" + native_path_to_utf16(event->name);
+				bool isDirectory = (event->mask & IN_ISDIR) != 0;
+				if ((event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0)
+				{
+					if (isDirectory && (event->mask & IN_MOVED_FROM) != 0)
+					{
+						subscription_->RemoveDirectory(path);
+					}
+
+					AddPendingChange(DirectoryChangeKind::Removed, path);
+				}
+				else
+				{
+					if (isDirectory && (event->mask & (IN_CREATE | IN_MOVED_TO)) != 0)
+					{
+						subscription_->AddDirectory(path, false);
+					}
+
+					AddPendingChange(DirectoryChangeKind::Changed, path);
+				}
+			}
+		}
+	}
+#elif defined(_WIN32)
+	struct DirectoryWatcher::Subscription
+	{
+		struct WatchedDirectory
+		{
+			std::wstring Path;
+			HANDLE Directory = INVALID_HANDLE_VALUE;
+			OVERLAPPED Overlapped{};
+			std::vector<DWORD> Buffer;  // DWORD-aligned, as ReadDirectoryChangesW requires
+		};
+
+		std::vector<std::unique_ptr<WatchedDirectory>> Directories;
+
+		~Subscription()
+		{
+			for (auto& directory : Directories)
+			{
+				if (directory->Directory != INVALID_HANDLE_VALUE)
+				{
+					// The buffer must outlive the cancelled read
+					DWORD size = 0;
+					CancelIo(directory->Directory);
+					GetOverlappedResult(directory->Directory, &directory->Overlapped, &size, TRUE);
+					CloseHandle(directory->Directory);
+				}
+
+				if (directory->Overlapped.hEvent != nullptr)
+				{
+					CloseHandle(directory->Overlapped.hEvent);
+				}
+			}
+		}
+
+		static void StartRead(WatchedDirectory& directory)
+		{
+			const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE;
+			BOOL result = ReadDirectoryChangesW(directory.Directory, directory.Buffer.data(), static_cast<DWORD>(directory.Buffer.size() * sizeof(DWORD)),
+				TRUE, filter, nullptr, &directory.Overlapped, nullptr);
+			HandleWin32Error(result == FALSE);
+		}
+	};
+
+	DirectoryWatcher::DirectoryWatcher(const std::vector<std::wstring>& directories, std::chrono::milliseconds settleTime)
+		: settleTime_(settleTime), overflowed_(false), subscription_(std::make_unique<Subscription>())
+	{
+		if (directories.size() > MAXIMUM_WAIT_OBJECTS)
+		{
+			throw std::runtime_error("Too many directories to watch");
+		}
+
+		for (const auto& directoryPath : directories)
+		{
+			subscription_->Directories.push_back(std::make_unique<Subscription::WatchedDirectory>());
+			auto& directory = *subscription_->Directories.back();
+			directory.Path = TrimTrailingSeparators(directoryPath);
+			directory.Buffer.resize(EventBufferSize / sizeof(DWORD));
+
+			directory.Directory = CreateFile(directory.Path.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+				nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+			HandleWin32Error(directory.Directory == INVALID_HANDLE_VALUE);
+
+			directory.Overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+			HandleWin32Error(directory.Overlapped.hEvent == nullptr);
+
+			Subscription::StartRead(directory);
+		}
+	}
+
+	void DirectoryWatcher::ReadEvents(std::chrono::milliseconds timeout)
+	{
+		std::vector<HANDLE> events;
+		for (const auto& directory : subscription_->Directories)
+		{
+			events.push_back(directory->Overlapped.hEvent);
+		}
+
+		auto waitTime = static_cast<DWORD>(std::min<std::chrono::milliseconds::rep>(timeout.count(), INFINITE - 1));
+		DWORD waitResult = WaitForMultipleObjects(static_cast<DWORD>(events.size()), events.data(), FALSE, waitTime);
+		if (waitResult == WAIT_TIMEOUT)
+		{
+			return;
+		}
+
+		HandleWin32Error(waitResult == WAIT_FAILED);
+
+		// Every directory whose read completed is handled, not only the first one signaled
+		for (auto& directory : subscription_->Directories)
+		{
+			DWORD size = 0;
+			if (!GetOverlappedResult(directory->Directory, &directory->Overlapped, &size, FALSE))
+			{
+				if (GetLastError() == ERROR_IO_INCOMPLETE)
+				{
+					continue;
+				}
+
+				// ERROR_NOTIFY_ENUM_DIR reports more changes than the buffer holds, like an empty read
+				HandleWin32Error(GetLastError() != ERROR_NOTIFY_ENUM_DIR);
+				size = 0;
+			}
+
+			ResetEvent(directory->Overlapped.hEvent);
+
+			// A read that completes without data means the buffer overflowed and events were lost
+			if (size == 0)
+			{
+				overflowed_ = true;
+			}
+
+			auto buffer = reinterpret_cast<const std::uint8_t*>(directory->Buffer.data());
+			for (DWORD offset = 0; size != 0;)
+			{
+				auto information = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(buffer + offset);
+				auto path = directory->Path + L"\\" + std::wstring(information->FileName, information->FileNameLength / sizeof(WCHAR));
+				switch (information->Action)
+				{
+				case FILE_ACTION_REMOVED:
+				case FILE_ACTION_RENAMED_OLD_NAME:
+					AddPendingChange(DirectoryChangeKind::Removed, path);
+					break;
+				default:
+					AddPendingChange(DirectoryChangeKind::Changed, path);
+					break;
+				}
+
+				if (information->NextEntryOffset == 0)
+				{
+					break;
+				}
+
+				offset += information->NextEntryOffset;
+			}
+
+			Subscription::StartRead(*directory);
+		}
+	}
+#else
+	struct DirectoryWatcher::Subscription
+	{
+	};
+
+	DirectoryWatcher::DirectoryWatcher(const std::vector<std::wstring>& directories, std::chrono::milliseconds settleTime)
+		: settleTime_(settleTime), overflowed_(false)
+	{
+		throw std::runtime_error("Watching directories is not supported on this platform");
+	}
+
+	void DirectoryWatcher::ReadEvents(std::chrono::milliseconds timeout)
+	{
+	}
+#endif
+
+	DirectoryWatcher::~DirectoryWatcher()
+	{
+	}
+
+	std::vector<DirectoryChange> DirectoryWatcher::WaitForChanges(std::chrono::milliseconds timeout)
+	{
+		auto deadline = std::chrono::steady_clock::now() + timeout;
+		for (;;)
+		{
+			auto changes = TakeSettledChanges();
+			auto now = std::chrono::steady_clock::now();
+			if (!changes.empty() || now >= deadline)
+			{
+				return changes;
+			}
+
+			// Wake up when the oldest pending change settles, even if no more events come
+			auto wakeUp = deadline;
+			for (const auto& pendingChange : pendingChanges_)
+			{
+				wakeUp = std::min(wakeUp, pendingChange.second.LastEvent + settleTime_);
+			}
+
+			ReadEvents(std::chrono::duration_cast<std::chrono::milliseconds>(wakeUp - now) + std::chrono::milliseconds(1));
+		}
+	}
+
+	void DirectoryWatcher::AddPendingChange(DirectoryChangeKind kind, const std::wstring& path)
+	{
+		auto now = std::chrono::steady_clock::now();
+
+		// A directory that is created and filled settles as one change once its content is quiet,
+		// since rescanning the directory covers every path below it
+		for (auto separator = path.find_last_of(L"/\\"); separator != std::wstring::npos && separator != 0; separator = path.find_last_of(L"/\\", separator - 1))
+		{
+			auto directory = pendingChanges_.find(path.substr(0, separator));
+			if (directory != pendingChanges_.end() && directory->second.Kind == DirectoryChangeKind::Changed)
+			{
+				directory->second.LastEvent = now;
+				return;
+			}
+		}
+
+		// The last event decides: a file removed and created again is changed, a file written and then removed is removed
+		pendingChanges_[path] = PendingChange{ kind, now };
+	}
+
+	std::vector<DirectoryChange> DirectoryWatcher::TakeSettledChanges()
+	{
+		std::vector<DirectoryChange> changes;
+		if (overflowed_)
+		{
+			// Everything is rescanned, which covers the pending changes too
+			overflowed_ = false;
+			pendingChanges_.clear();
+			changes.push_back(DirectoryChange{ DirectoryChangeKind::Overflow, std::wstring(), false });
+			return changes;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		for (auto i = pendingChanges_.begin(); i != pendingChanges_.end();)
+		{
+			if (now - i->second.LastEvent < settleTime_)
+			{
+				++i;
+				continue;
+			}
+
+			bool isDirectory = i->second.Kind == DirectoryChangeKind::Changed && IsDirectory(i->first);
+			changes.push_back(DirectoryChange{ i->second.Kind, i->first, isDirectory });
+			i = pendingChanges_.erase(i);
+		}
+
+		return changes;
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace peinfo
+{
+	enum class DirectoryChangeKind
+	{
+		Changed,   // created, written or renamed into a watched tree
+		Removed,   // deleted or renamed out of a watched tree; covers everything below a directory
+		Overflow   // events were lost, so anything below the watched directories may have changed
+	};
+
+	struct DirectoryChange
+	{
+		DirectoryChangeKind Kind;
+		std::wstring Path;   // empty for Overflow
+		bool IsDirectory;    // set for Changed directories, whose content was not reported file by file
+	};
+
+	// Reports the files that are created, written, renamed or removed below a set of directories,
+	// using inotify on Linux and ReadDirectoryChangesW on Windows. A path is reported once it has
+	// had no events for the settle time, so a file that is still being copied is reported once,
+	// after its last write, rather than once per write. Directories created or renamed into a
+	// watched tree are watched from then on. Not available on other platforms.
+	class DirectoryWatcher
+	{
+	public:
+		DirectoryWatcher(const std::vector<std::wstring>& directories, std::chrono::milliseconds settleTime);
+		~DirectoryWatcher();
+
+		DirectoryWatcher(const DirectoryWatcher&) = delete;
+		DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+		// Blocks until at least one change has settled or the timeout has passed, and returns the
+		// settled changes ordered by path, so a directory comes before the paths below it.
+		std::vector<DirectoryChange> WaitForChanges(std::chrono::milliseconds timeout);
+
+	private:
+		struct PendingChange
+		{
+			DirectoryChangeKind Kind;
+			std::chrono::steady_clock::time_point LastEvent;
+		};
+
+		struct Subscription;
+
+		void ReadEvents(std::chrono::milliseconds timeout);
+		void AddPendingChange(DirectoryChangeKind kind, const std::wstring& path);
+		std::vector<DirectoryChange> TakeSettledChanges();
+
+		std::chrono::milliseconds settleTime_;
+		std::map<std::wstring, PendingChange> pendingChanges_;
+		bool overflowed_;
+		std::unique_ptr<Subscription> subscription_;
+	};
+}
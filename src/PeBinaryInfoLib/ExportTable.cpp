@@ -0,0 +1,230 @@
+#include "stdafx.h"
+#include "ExportTable.h"
+#include "PeBinaryInfo.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		// Most export names fit, so they usually take one read
+		const DWORD NameChunkSize = 64;
+
+		// The order of the name pointer table: bytes compared as unsigned, a prefix first
+		int CompareNames(Span<const char> left, Span<const char> right)
+		{
+			auto result = std::memcmp(left.data(), right.data(), std::min(left.size(), right.size()));
+			if (result != 0)
+			{
+				return result;
+			}
+
+			return left.size() < right.size() ? -1 : (left.size() > right.size() ? 1 : 0);
+		}
+	}
+
+	ExportTable::Iterator::Iterator(const ExportTable* table, std::size_t nameIndex)
+		: table_(table), nameIndex_(nameIndex)
+	{
+	}
+
+	Export ExportTable::Iterator::operator*() const
+	{
+		return table_->GetExport(table_->nameOrdinals_[nameIndex_], table_->GetName(nameIndex_));
+	}
+
+	ExportTable::Iterator& ExportTable::Iterator::operator++()
+	{
+		++nameIndex_;
+		return *this;
+	}
+
+	bool ExportTable::Iterator::operator==(const Iterator& other) const
+	{
+		return nameIndex_ == other.nameIndex_;
+	}
+
+	bool ExportTable::Iterator::operator!=(const Iterator& other) const
+	{
+		return !(*this == other);
+	}
+
+	ExportTable::ExportTable()
+		: image_(nullptr), sectionMap_(nullptr), directory_{}, exportDirectory_{}, functions_(nullptr), names_(nullptr),
+		nameOrdinals_(nullptr), functionCount_(0), forwarderCount_(0)
+	{
+	}
+
+	// The directory, the tables, the names and the forwarders are usually all in the range of the
+	// data directory, which a forwards-only source keeps before they are read in no particular order
+	ExportTable::ExportTable(PeImageSource& image, const SectionMap& sectionMap, IMAGE_DATA_DIRECTORY directory)
+		: ExportTable()
+	{
+		if (directory.VirtualAddress == 0)
+		{
+			return;
+		}
+
+		image_ = &image;
+		sectionMap_ = &sectionMap;
+		directory_ = directory;
+
+		DWORD fileOffset = 0;
+		DWORD availableSize = 0;
+		HandleFormatError(sectionMap.RvaToFileOffset(directory.VirtualAddress, fileOffset, availableSize) != RvaLookupStatus::Success, "Failed to convert RVA");
+		image.PrepareRandomAccess(fileOffset, std::min(std::max<DWORD>(directory.Size, sizeof(IMAGE_EXPORT_DIRECTORY)), availableSize));
+
+		std::memcpy(&exportDirectory_, ReadTable(directory.VirtualAddress, sizeof(IMAGE_EXPORT_DIRECTORY)), sizeof(IMAGE_EXPORT_DIRECTORY));
+
+		if (exportDirectory_.NumberOfFunctions != 0)
+		{
+			functions_ = static_cast<const DWORD*>(ReadTable(exportDirectory_.AddressOfFunctions, exportDirectory_.NumberOfFunctions * sizeof(DWORD)));
+		}
+
+		if (exportDirectory_.NumberOfNames != 0)
+		{
+			names_ = static_cast<const DWORD*>(ReadTable(exportDirectory_.AddressOfNames, exportDirectory_.NumberOfNames * sizeof(DWORD)));
+			nameOrdinals_ = static_cast<const WORD*>(ReadTable(exportDirectory_.AddressOfNameOrdinals, exportDirectory_.NumberOfNames * sizeof(WORD)));
+		}
+
+		for (DWORD i = 0; i < exportDirectory_.NumberOfFunctions; ++i)
+		{
+			auto rva = functions_[i];
+			if (rva != 0)
+			{
+				++functionCount_;
+				if (rva - directory_.VirtualAddress < directory_.Size)
+				{
+					++forwarderCount_;
+				}
+			}
+		}
+	}
+
+	bool ExportTable::IsEmpty() const
+	{
+		return image_ == nullptr;
+	}
+
+	Span<const char> ExportTable::GetModuleName() const
+	{
+		return IsEmpty() || exportDirectory_.Name == 0 ? Span<const char>() : ReadName(exportDirectory_.Name);
+	}
+
+	std::size_t ExportTable::GetFunctionCount() const
+	{
+		return functionCount_;
+	}
+
+	std::size_t ExportTable::GetForwarderCount() const
+	{
+		return forwarderCount_;
+	}
+
+	ExportTable::Range ExportTable::GetNamedExports() const
+	{
+		return Range{ Iterator(this, 0), Iterator(this, names_ != nullptr ? exportDirectory_.NumberOfNames : 0) };
+	}
+
+	bool ExportTable::TryFindByName(Span<const char> name, Export& exported) const
+	{
+		std::size_t first = 0;
+		std::size_t last = names_ != nullptr ? exportDirectory_.NumberOfNames : 0;
+		while (first < last)
+		{
+			auto middle = first + (last - first) / 2;
+			auto candidate = GetName(middle);
+			auto comparison = CompareNames(candidate, name);
+			if (comparison == 0)
+			{
+				exported = GetExport(nameOrdinals_[middle], candidate);
+				return exported.Rva != 0 || !exported.Forwarder.empty();
+			}
+
+			if (comparison < 0)
+			{
+				first = middle + 1;
+			}
+			else
+			{
+				last = middle;
+			}
+		}
+
+		return false;
+	}
+
+	bool ExportTable::TryFindByOrdinal(DWORD ordinal, Export& exported) const
+	{
+		auto functionIndex = ordinal - exportDirectory_.Base;
+		if (ordinal < exportDirectory_.Base || functionIndex >= exportDirectory_.NumberOfFunctions || functions_[functionIndex] == 0)
+		{
+			return false;
+		}
+
+		auto nameCount = names_ != nullptr ? exportDirectory_.NumberOfNames : 0;
+		auto named = std::find(nameOrdinals_, nameOrdinals_ + nameCount, functionIndex);
+		exported = GetExport(functionIndex, named != nameOrdinals_ + nameCount ? GetName(named - nameOrdinals_) : Span<const char>());
+		return true;
+	}
+
+	bool ExportTable::TryFind(Span<const char> symbol, Export& exported) const
+	{
+		if (symbol.empty() || symbol[0] != '#')
+		{
+			return TryFindByName(symbol, exported);
+		}
+
+		DWORD ordinal = 0;
+		auto result = std::from_chars(symbol.data() + 1, symbol.end(), ordinal);
+		return result.ec == std::errc() && result.ptr == symbol.end() && symbol.size() > 1 && TryFindByOrdinal(ordinal, exported);
+	}
+
+	// An address inside the export directory is the RVA of a forwarder string rather than of code
+	Export ExportTable::GetExport(DWORD functionIndex, Span<const char> name) const
+	{
+		HandleFormatError(functionIndex >= exportDirectory_.NumberOfFunctions, "Export ordinal is outside of the address table");
+
+		auto rva = functions_[functionIndex];
+		Export exported{ exportDirectory_.Base + functionIndex, name, rva, Span<const char>() };
+		if (rva != 0 && rva - directory_.VirtualAddress < directory_.Size)
+		{
+			exported.Rva = 0;
+			exported.Forwarder = ReadName(rva);
+		}
+
+		return exported;
+	}
+
+	Span<const char> ExportTable::GetName(std::size_t nameIndex) const
+	{
+		return ReadName(names_[nameIndex]);
+	}
+
+	Span<const char> ExportTable::ReadName(DWORD rva) const
+	{
+		DWORD fileOffset = 0;
+		DWORD availableSize = 0;
+		HandleFormatError(sectionMap_->RvaToFileOffset(rva, fileOffset, availableSize) != RvaLookupStatus::Success, "Failed to convert RVA");
+
+		for (DWORD size = std::min(NameChunkSize, availableSize);; size = std::min(size * 4, availableSize))
+		{
+			auto name = static_cast<const char*>(image_->GetData(fileOffset, size));
+			auto end = static_cast<const char*>(std::memchr(name, 0, size));
+			if (end != nullptr)
+			{
+				return Span<const char>(name, static_cast<std::size_t>(end - name));
+			}
+
+			HandleFormatError(size == availableSize, "Export name is not terminated");
+		}
+	}
+
+	const void* ExportTable::ReadTable(DWORD rva, std::size_t size) const
+	{
+		DWORD fileOffset = 0;
+		DWORD availableSize = 0;
+		HandleFormatError(sectionMap_->RvaToFileOffset(rva, fileOffset, availableSize) != RvaLookupStatus::Success, "Failed to convert RVA");
+		HandleFormatError(size > availableSize, "Export table is outside of its section");
+		return image_->GetData(fileOffset, size);
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "PeImageSource.h"
+#include "SectionMap.h"
+
+namespace peinfo
+{
+	// An entry of the export address table. The name and the forwarder point into the image,
+	// without the terminator.
+	struct Export
+	{
+		DWORD Ordinal;              // with the ordinal base added, as importers refer to it
+		Span<const char> Name;      // empty when the function is exported by ordinal only
+		DWORD Rva;                  // of the code or data; 0 for a forwarder
+		Span<const char> Forwarder; // "module.function" or "module.#ordinal"; empty unless forwarded
+	};
+
+	// The export directory of an image. Its tables are views into the image, and names are read
+	// when an export is. The name pointer table is sorted by name, as the loader expects, so names
+	// are looked up by binary search; ordinals index the address table directly.
+	class ExportTable
+	{
+	public:
+		// Walks the exports that have a name, in name order
+		class Iterator
+		{
+		public:
+			Export operator*() const;
+			Iterator& operator++();
+			bool operator==(const Iterator& other) const;
+			bool operator!=(const Iterator& other) const;
+
+		private:
+			friend class ExportTable;
+
+			Iterator(const ExportTable* table, std::size_t nameIndex);
+
+			const ExportTable* table_;
+			std::size_t nameIndex_;
+		};
+
+		struct Range
+		{
+			Iterator First;
+			Iterator Last;
+
+			Iterator begin() const { return First; }
+			Iterator end() const { return Last; }
+		};
+
+		// An empty table
+		ExportTable();
+
+		// The image and the section map must outlive the table. The table is empty when the
+		// directory has no address.
+		ExportTable(PeImageSource& image, const SectionMap& sectionMap, IMAGE_DATA_DIRECTORY directory);
+
+		bool IsEmpty() const;
+
+		// The name the DLL was linked as, which need not be its file name
+		Span<const char> GetModuleName() const;
+
+		// Used entries of the address table, and those of them that are forwarders
+		std::size_t GetFunctionCount() const;
+		std::size_t GetForwarderCount() const;
+
+		Range GetNamedExports() const;
+
+		// Names compare byte by byte, as GetProcAddress does
+		bool TryFindByName(Span<const char> name, Export& exported) const;
+
+		// The name, when there is one, is found by a scan of the name ordinal table
+		bool TryFindByOrdinal(DWORD ordinal, Export& exported) const;
+
+		// Looks up "name" or "#ordinal", the way forwarders and GetProcAddress callers write them
+		bool TryFind(Span<const char> symbol, Export& exported) const;
+
+	private:
+		Export GetExport(DWORD functionIndex, Span<const char> name) const;
+		Span<const char> GetName(std::size_t nameIndex) const;
+		Span<const char> ReadName(DWORD rva) const;
+		const void* ReadTable(DWORD rva, std::size_t size) const;
+
+		PeImageSource* image_;
+		const SectionMap* sectionMap_;
+		IMAGE_DATA_DIRECTORY directory_;
+		IMAGE_EXPORT_DIRECTORY exportDirectory_;
+		const DWORD* functions_;
+		const DWORD* names_;
+		const WORD* nameOrdinals_;
+		std::size_t functionCount_;
+		std::size_t forwarderCount_;
+	};
+}
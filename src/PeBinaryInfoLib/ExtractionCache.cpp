@@ -0,0 +1,827 @@
+#include "stdafx.h"
+#include "ExtractionCache.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		const char CacheMagic[8] = { 'P', 'E', 'I', 'N', 'F', 'O', 'C', 'C' };
+		const std::uint32_t CacheFormatVersion = 6;
+
+		struct CacheHeader
+		{
+			char Magic[8];
+			std::uint32_t FormatVersion;
+			std::uint32_t SlotCount;
+			std::uint64_t FileSize;
+			std::uint64_t DataOffset;
+			std::atomic<std::uint64_t> DataEnd;  // relative to DataOffset
+			std::atomic<std::uint64_t> EntryCount;
+			std::atomic<std::uint32_t> Generation;
+		};
+
+		struct CacheSlot
+		{
+			std::atomic<std::uint64_t> Hash;  // 0 while the slot is empty; stored last
+			FileIdentity Identity;
+			std::uint64_t RecordOffset;       // relative to DataOffset
+			std::uint32_t RecordSize;
+			std::atomic<std::uint32_t> LastUsed;
+		};
+
+		const std::uint64_t SlotsOffset = 64;
+		static_assert(sizeof(CacheHeader) <= SlotsOffset, "CacheHeader must fit before the slot table");
+		static_assert(sizeof(CacheSlot) == 64, "CacheSlot must stay one cache line");
+
+		// The slot table is dimensioned for records of about this size
+		const std::uint64_t ExpectedRecordSize = 1024;
+		const std::uint32_t MinimumSlotCount = 1024;
+		const std::uint64_t MinimumFileSize = 1024 * 1024;
+
+		CacheHeader* GetHeader(void* base)
+		{
+			return static_cast<CacheHeader*>(base);
+		}
+
+		CacheSlot* GetSlots(void* base)
+		{
+			return AddOffset<CacheSlot>(base, SlotsOffset);
+		}
+
+		std::uint64_t HashIdentity(const FileIdentity& identity)
+		{
+			std::uint64_t hash = 0x9E3779B97F4A7C15;
+			for (auto value : { identity.Device, identity.Inode, identity.Size, identity.ModificationTime, identity.ChangeTime })
+			{
+				hash = (hash ^ value) * 0xFF51AFD7ED558CCD;
+				hash ^= hash >> 32;
+			}
+
+			return hash != 0 ? hash : 1;
+		}
+
+		bool IsTableFull(const CacheHeader& header, std::uint64_t entryCount)
+		{
+			return entryCount + 1 > header.SlotCount / 4 * 3;
+		}
+
+		// Bits of the flags byte that follows the raw values of a record
+		const std::uint8_t RawIsDll = 1;
+		const std::uint8_t RawIsPe32Plus = 2;
+		const std::uint8_t RawIsClr = 4;
+
+		void WriteUInt32(std::vector<std::uint8_t>& record, std::uint32_t value)
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				record.push_back(static_cast<std::uint8_t>(value >> (i * 8)));
+			}
+		}
+
+		void WriteString(std::vector<std::uint8_t>& record, const std::string& value)
+		{
+			WriteUInt32(record, static_cast<std::uint32_t>(value.size()));
+			record.insert(record.end(), value.begin(), value.end());
+		}
+
+		std::vector<std::uint8_t> SerializeResult(const CachedResult& result)
+		{
+			std::vector<std::uint8_t> record;
+			record.push_back(static_cast<std::uint8_t>(result.Kind));
+
+			if (result.Kind == CachedResultKind::Extracted)
+			{
+				WriteUInt32(record, static_cast<std::uint32_t>(result.Info.Categories.size()));
+				for (const auto& category : result.Info.Categories)
+				{
+					WriteString(record, utf16_to_utf8(category.Name));
+					WriteUInt32(record, static_cast<std::uint32_t>(category.Items.size()));
+					for (const auto& item : category.Items)
+					{
+						WriteString(record, utf16_to_utf8(item.Name));
+						WriteString(record, utf16_to_utf8(item.Value));
+					}
+				}
+
+				const auto& raw = result.Info.Raw;
+				WriteUInt32(record, raw.Machine);
+				WriteUInt32(record, raw.TimeDateStamp);
+				WriteUInt32(record, raw.Subsystem);
+				WriteUInt32(record, raw.LinkerVersion);
+				WriteUInt32(record, raw.DllCharacteristics);
+				WriteUInt32(record, raw.ClrFlags);
+				record.push_back(static_cast<std::uint8_t>(raw.BuildConfiguration));
+				record.push_back(static_cast<std::uint8_t>((raw.IsDll ? RawIsDll : 0) | (raw.IsPe32Plus ? RawIsPe32Plus : 0) | (raw.IsClr ? RawIsClr : 0)));
+			}
+			else if (result.Kind == CachedResultKind::Failed)
+			{
+				WriteString(record, result.Error);
+			}
+
+			return record;
+		}
+
+		// Records come from a file other processes write, so every read is bounds-checked
+		class RecordReader
+		{
+		public:
+			RecordReader(const std::uint8_t* data, std::size_t size)
+				: data_(data), size_(size), position_(0)
+			{
+			}
+
+			bool ReadByte(std::uint8_t& value)
+			{
+				if (size_ - position_ < 1)
+				{
+					return false;
+				}
+
+				value = data_[position_++];
+				return true;
+			}
+
+			bool ReadUInt32(std::uint32_t& value)
+			{
+				if (size_ - position_ < 4)
+				{
+					return false;
+				}
+
+				value = 0;
+				for (int i = 0; i < 4; ++i)
+				{
+					value |= static_cast<std::uint32_t>(data_[position_++]) << (i * 8);
+				}
+
+				return true;
+			}
+
+			bool ReadString(std::string& value)
+			{
+				std::uint32_t length = 0;
+				if (!ReadUInt32(length) || size_ - position_ < length)
+				{
+					return false;
+				}
+
+				value.assign(reinterpret_cast<const char*>(data_ + position_), length);
+				position_ += length;
+				return true;
+			}
+
+			bool ReadWideString(std::wstring& value)
+			{
+				std::string utf8Value;
+				if (!ReadString(utf8Value))
+				{
+					return false;
+				}
+
+				value = utf8_to_utf16(utf8Value);
+				return true;
+			}
+
+		private:
+			const std::uint8_t* data_;
+			std::size_t size_;
+			std::size_t position_;
+		};
+
+		bool TryDeserializeResult(const std::uint8_t* data, std::size_t size, CachedResult& result)
+		{
+			RecordReader reader(data, size);
+
+			std::uint8_t kind = 0;
+			if (!reader.ReadByte(kind) || kind > static_cast<std::uint8_t>(CachedResultKind::NotPe))
+			{
+				return false;
+			}
+
+			result = CachedResult{ static_cast<CachedResultKind>(kind), PeFileFormattedInfo(), std::string() };
+			if (result.Kind == CachedResultKind::Failed)
+			{
+				return reader.ReadString(result.Error);
+			}
+
+			std::uint32_t categoryCount = 0;
+			if (result.Kind == CachedResultKind::Extracted && !reader.ReadUInt32(categoryCount))
+			{
+				return false;
+			}
+
+			for (std::uint32_t i = 0; i < categoryCount; ++i)
+			{
+				PeFileFormattedInfoCategory category;
+				std::uint32_t itemCount = 0;
+				if (!reader.ReadWideString(category.Name) || !reader.ReadUInt32(itemCount))
+				{
+					return false;
+				}
+
+				for (std::uint32_t j = 0; j < itemCount; ++j)
+				{
+					PeFileFormattedInfoItem item;
+					if (!reader.ReadWideString(item.Name) || !reader.ReadWideString(item.Value))
+					{
+						return false;
+					}
+
+					category.Items.push_back(std::move(item));
+				}
+
+				result.Info.Categories.push_back(std::move(category));
+			}
+
+			if (result.Kind == CachedResultKind::NotPe)
+			{
+				return true;
+			}
+
+			auto& raw = result.Info.Raw;
+			std::uint32_t machine = 0;
+			std::uint32_t timeDateStamp = 0;
+			std::uint32_t subsystem = 0;
+			std::uint32_t linkerVersion = 0;
+			std::uint32_t dllCharacteristics = 0;
+			std::uint32_t clrFlags = 0;
+			std::uint8_t buildConfiguration = 0;
+			std::uint8_t flags = 0;
+			if (!reader.ReadUInt32(machine) || !reader.ReadUInt32(timeDateStamp) || !reader.ReadUInt32(subsystem)
+				|| !reader.ReadUInt32(linkerVersion) || !reader.ReadUInt32(dllCharacteristics) || !reader.ReadUInt32(clrFlags)
+				|| !reader.ReadByte(buildConfiguration) || !reader.ReadByte(flags)
+				|| buildConfiguration > static_cast<std::uint8_t>(BuildConfiguration::Release))
+			{
+				return false;
+			}
+
+			raw.Machine = static_cast<WORD>(machine);
+			raw.TimeDateStamp = timeDateStamp;
+			raw.DllCharacteristics = dllCharacteristics;
+			raw.ClrFlags = clrFlags;
+			raw.Subsystem = static_cast<WORD>(subsystem);
+			raw.LinkerVersion = static_cast<WORD>(linkerVersion);
+			raw.BuildConfiguration = static_cast<BuildConfiguration>(buildConfiguration);
+			raw.IsDll = (flags & RawIsDll) != 0;
+			raw.IsPe32Plus = (flags & RawIsPe32Plus) != 0;
+			raw.IsClr = (flags & RawIsClr) != 0;
+			return true;
+		}
+
+#ifdef _WIN32
+		const NativeFileHandle InvalidFileHandle = INVALID_HANDLE_VALUE;
+
+		NativeFileHandle OpenLockFile(const std::wstring& path)
+		{
+			HANDLE file = CreateFile(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, 0, nullptr);
+			HandleWin32Error(file == INVALID_HANDLE_VALUE);
+			return file;
+		}
+
+		void CloseFile(NativeFileHandle file)
+		{
+			CloseHandle(file);
+		}
+
+		class FileLock
+		{
+		public:
+			FileLock(NativeFileHandle file)
+				: file_(file)
+			{
+				OVERLAPPED overlapped{};
+				HandleWin32Error(LockFileEx(file_, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped) == FALSE);
+			}
+
+			~FileLock()
+			{
+				OVERLAPPED overlapped{};
+				UnlockFileEx(file_, 0, 1, 0, &overlapped);
+			}
+
+		private:
+			NativeFileHandle file_;
+		};
+
+		bool IsSameFile(NativeFileHandle file, const std::wstring& path)
+		{
+			HANDLE pathFile = CreateFile(path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 0, nullptr);
+			if (pathFile == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+
+			BY_HANDLE_FILE_INFORMATION fileInformation{};
+			BY_HANDLE_FILE_INFORMATION pathInformation{};
+			bool isSame = GetFileInformationByHandle(file, &fileInformation) != FALSE
+				&& GetFileInformationByHandle(pathFile, &pathInformation) != FALSE
+				&& fileInformation.dwVolumeSerialNumber == pathInformation.dwVolumeSerialNumber
+				&& fileInformation.nFileIndexHigh == pathInformation.nFileIndexHigh
+				&& fileInformation.nFileIndexLow == pathInformation.nFileIndexLow;
+
+			CloseHandle(pathFile);
+			return isSame;
+		}
+
+		void RemoveFile(const std::wstring& path)
+		{
+			DeleteFile(path.c_str());
+		}
+
+		bool ReplaceFile(const std::wstring& source, const std::wstring& target)
+		{
+			return MoveFileEx(source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+		}
+#else
+		const NativeFileHandle InvalidFileHandle = -1;
+
+		NativeFileHandle OpenLockFile(const std::wstring& path)
+		{
+			int fd = open(utf16_to_native_path(path).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+			HandlePosixError(fd == -1);
+			return fd;
+		}
+
+		void CloseFile(NativeFileHandle file)
+		{
+			close(file);
+		}
+
+		class FileLock
+		{
+		public:
+			FileLock(NativeFileHandle file)
+				: file_(file)
+			{
+				int result;
+				do
+				{
+					result = flock(file_, LOCK_EX);
+				} while (result == -1 && errno == EINTR);
+
+				HandlePosixError(result == -1);
+			}
+
+			~FileLock()
+			{
+				flock(file_, LOCK_UN);
+			}
+
+		private:
+			NativeFileHandle file_;
+		};
+
+		bool IsSameFile(NativeFileHandle file, const std::wstring& path)
+		{
+			struct stat fileStat{};
+			struct stat pathStat{};
+			return fstat(file, &fileStat) == 0 && stat(utf16_to_native_path(path).c_str(), &pathStat) == 0
+				&& fileStat.st_dev == pathStat.st_dev && fileStat.st_ino == pathStat.st_ino;
+		}
+
+		void RemoveFile(const std::wstring& path)
+		{
+			unlink(utf16_to_native_path(path).c_str());
+		}
+
+		bool ReplaceFile(const std::wstring& source, const std::wstring& target)
+		{
+			return rename(utf16_to_native_path(source).c_str(), utf16_to_native_path(target).c_str()) == 0;
+		}
+#endif
+	}
+
+#ifdef _WIN32
+	bool TryGetFileIdentity(const std::wstring& filePath, FileIdentity& identity)
+	{
+		HANDLE file = CreateFile(filePath.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		BY_HANDLE_FILE_INFORMATION fileInformation{};
+		FILE_BASIC_INFO basicInformation{};
+		bool result = GetFileInformationByHandle(file, &fileInformation) != FALSE
+			&& GetFileInformationByHandleEx(file, FileBasicInfo, &basicInformation, sizeof(basicInformation)) != FALSE;
+		CloseHandle(file);
+
+		if (result)
+		{
+			// FILETIME values count 100 ns intervals
+			identity.Device = fileInformation.dwVolumeSerialNumber;
+			identity.Inode = (static_cast<std::uint64_t>(fileInformation.nFileIndexHigh) << 32) | fileInformation.nFileIndexLow;
+			identity.Size = (static_cast<std::uint64_t>(fileInformation.nFileSizeHigh) << 32) | fileInformation.nFileSizeLow;
+			identity.ModificationTime = static_cast<std::uint64_t>(basicInformation.LastWriteTime.QuadPart) * 100;
+			identity.ChangeTime = static_cast<std::uint64_t>(basicInformation.ChangeTime.QuadPart) * 100;
+		}
+
+		return result;
+	}
+#elif defined(__linux__)
+	FileIdentity MakeFileIdentity(const struct statx& fileStat)
+	{
+		auto toNanoseconds = [](const statx_timestamp& timestamp)
+		{
+			return static_cast<std::uint64_t>(timestamp.tv_sec) * 1000000000 + timestamp.tv_nsec;
+		};
+
+		FileIdentity identity;
+		identity.Device = (static_cast<std::uint64_t>(fileStat.stx_dev_major) << 32) | fileStat.stx_dev_minor;
+		identity.Inode = fileStat.stx_ino;
+		identity.Size = fileStat.stx_size;
+		identity.ModificationTime = toNanoseconds(fileStat.stx_mtime);
+		identity.ChangeTime = toNanoseconds(fileStat.stx_ctime);
+		return identity;
+	}
+
+	bool TryGetFileIdentity(const std::wstring& filePath, FileIdentity& identity)
+	{
+		struct statx fileStat{};
+		if (statx(AT_FDCWD, utf16_to_native_path(filePath).c_str(), AT_STATX_SYNC_AS_STAT, STATX_BASIC_STATS, &fileStat) != 0)
+		{
+			return false;
+		}
+
+		identity = MakeFileIdentity(fileStat);
+		return true;
+	}
+#else
+	bool TryGetFileIdentity(const std::wstring& filePath, FileIdentity& identity)
+	{
+		struct stat fileStat{};
+		if (stat(utf16_to_native_path(filePath).c_str(), &fileStat) != 0)
+		{
+			return false;
+		}
+
+		identity.Device = static_cast<std::uint64_t>(fileStat.st_dev);
+		identity.Inode = static_cast<std::uint64_t>(fileStat.st_ino);
+		identity.Size = static_cast<std::uint64_t>(fileStat.st_size);
+		identity.ModificationTime = static_cast<std::uint64_t>(fileStat.st_mtime) * 1000000000;
+		identity.ChangeTime = static_cast<std::uint64_t>(fileStat.st_ctime) * 1000000000;
+		return true;
+	}
+#endif
+
+	ExtractionCache::ExtractionCache(const std::wstring& cachePath, std::uint64_t maxSize)
+		: cachePath_(cachePath), fileSize_(std::max(maxSize, MinimumFileSize)), cacheFile_{ InvalidFileHandle, nullptr, 0 }, generation_(0)
+	{
+		lockFile_ = OpenLockFile(cachePath_ + L".lock");
+
+		try
+		{
+			FileLock lock(lockFile_);
+			cacheFile_ = OpenCacheFile(cachePath_, fileSize_);
+			if (!IsCacheFileValid(cacheFile_))
+			{
+				Compact();
+			}
+
+			generation_ = GetHeader(cacheFile_.Base)->Generation.fetch_add(1) + 1;
+		}
+		catch (...)
+		{
+			CloseCacheFile(cacheFile_);
+			CloseFile(lockFile_);
+			throw;
+		}
+	}
+
+	ExtractionCache::~ExtractionCache()
+	{
+		CloseCacheFile(cacheFile_);
+		CloseFile(lockFile_);
+	}
+
+	bool ExtractionCache::TryGet(const FileIdentity& identity, CachedResult& result)
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex_);
+
+		auto header = GetHeader(cacheFile_.Base);
+		auto slots = GetSlots(cacheFile_.Base);
+		auto hash = HashIdentity(identity);
+		auto mask = header->SlotCount - 1;
+
+		for (std::uint32_t probe = 0, index = static_cast<std::uint32_t>(hash & mask); probe < header->SlotCount; ++probe, index = (index + 1) & mask)
+		{
+			auto& slot = slots[index];
+			auto slotHash = slot.Hash.load(std::memory_order_acquire);
+			if (slotHash == 0)
+			{
+				return false;
+			}
+
+			if (slotHash == hash && slot.Identity == identity)
+			{
+				auto dataSize = header->FileSize - header->DataOffset;
+				if (slot.RecordOffset > dataSize || slot.RecordSize > dataSize - slot.RecordOffset)
+				{
+					return false;
+				}
+
+				auto record = AddOffset<const std::uint8_t>(cacheFile_.Base, static_cast<ptrdiff_t>(header->DataOffset + slot.RecordOffset));
+				if (!TryDeserializeResult(record, slot.RecordSize, result))
+				{
+					return false;
+				}
+
+				slot.LastUsed.store(generation_, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void ExtractionCache::Put(const FileIdentity& identity, const CachedResult& result)
+	{
+		auto record = SerializeResult(result);
+		auto hash = HashIdentity(identity);
+
+		std::unique_lock<std::shared_mutex> lock(mutex_);
+		FileLock fileLock(lockFile_);
+		ReopenIfReplaced();
+
+		if (!Insert(cacheFile_, hash, identity, record, generation_))
+		{
+			// A record that does not fit even after eviction is not cached
+			Compact();
+			Insert(cacheFile_, hash, identity, record, generation_);
+		}
+	}
+
+#ifdef _WIN32
+	ExtractionCache::CacheFile ExtractionCache::OpenCacheFile(const std::wstring& path, std::uint64_t size)
+	{
+		HANDLE file = CreateFile(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, 0, nullptr);
+		HandleWin32Error(file == INVALID_HANDLE_VALUE);
+
+		// An existing file keeps its size, since other processes may have it mapped
+		LARGE_INTEGER fileSize{};
+		if (GetFileSizeEx(file, &fileSize) != FALSE && fileSize.QuadPart > 0)
+		{
+			size = static_cast<std::uint64_t>(fileSize.QuadPart);
+		}
+
+		HANDLE fileMappingHandle = CreateFileMapping(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+		void* base = fileMappingHandle != nullptr ? MapViewOfFile(fileMappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, 0) : nullptr;
+		DWORD error = GetLastError();
+		if (fileMappingHandle != nullptr)
+		{
+			CloseHandle(fileMappingHandle);
+		}
+
+		if (base == nullptr)
+		{
+			CloseHandle(file);
+			SetLastError(error);
+		}
+
+		HandleWin32Error(base == nullptr);
+		return CacheFile{ file, base, size };
+	}
+
+	void ExtractionCache::CloseCacheFile(CacheFile& cacheFile)
+	{
+		if (cacheFile.Base != nullptr)
+		{
+			UnmapViewOfFile(cacheFile.Base);
+		}
+
+		if (cacheFile.File != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(cacheFile.File);
+		}
+
+		cacheFile = CacheFile{ INVALID_HANDLE_VALUE, nullptr, 0 };
+	}
+#else
+	ExtractionCache::CacheFile ExtractionCache::OpenCacheFile(const std::wstring& path, std::uint64_t size)
+	{
+		int fd = open(utf16_to_native_path(path).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		HandlePosixError(fd == -1);
+
+		// An existing file keeps its size, since other processes may have it mapped
+		struct stat fileStat{};
+		int result = fstat(fd, &fileStat);
+		if (result == 0 && fileStat.st_size > 0)
+		{
+			size = static_cast<std::uint64_t>(fileStat.st_size);
+		}
+		else if (result == 0)
+		{
+			result = ftruncate(fd, static_cast<off_t>(size));
+		}
+
+		void* base = MAP_FAILED;
+		if (result == 0)
+		{
+			base = mmap(nullptr, static_cast<size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+
+		if (base == MAP_FAILED)
+		{
+			int error = errno;
+			close(fd);
+			errno = error;
+		}
+
+		HandlePosixError(base == MAP_FAILED);
+		return CacheFile{ fd, base, size };
+	}
+
+	void ExtractionCache::CloseCacheFile(CacheFile& cacheFile)
+	{
+		if (cacheFile.Base != nullptr)
+		{
+			munmap(cacheFile.Base, static_cast<size_t>(cacheFile.Size));
+		}
+
+		if (cacheFile.File != -1)
+		{
+			close(cacheFile.File);
+		}
+
+		cacheFile = CacheFile{ -1, nullptr, 0 };
+	}
+#endif
+
+	void ExtractionCache::InitializeCacheFile(CacheFile& cacheFile)
+	{
+		std::uint32_t slotCount = MinimumSlotCount;
+		while (static_cast<std::uint64_t>(slotCount) * 2 * (ExpectedRecordSize + sizeof(CacheSlot)) <= cacheFile.Size)
+		{
+			slotCount *= 2;
+		}
+
+		auto header = GetHeader(cacheFile.Base);
+		std::memset(cacheFile.Base, 0, static_cast<std::size_t>(SlotsOffset + slotCount * sizeof(CacheSlot)));
+		header->FormatVersion = CacheFormatVersion;
+		header->SlotCount = slotCount;
+		header->FileSize = cacheFile.Size;
+		header->DataOffset = SlotsOffset + slotCount * sizeof(CacheSlot);
+
+		// The magic is written last, so an interrupted initialization leaves an invalid file
+		std::atomic_thread_fence(std::memory_order_release);
+		std::memcpy(header->Magic, CacheMagic, sizeof(CacheMagic));
+	}
+
+	bool ExtractionCache::IsCacheFileValid(const CacheFile& cacheFile)
+	{
+		auto header = GetHeader(cacheFile.Base);
+		return cacheFile.Size >= MinimumFileSize
+			&& std::memcmp(header->Magic, CacheMagic, sizeof(CacheMagic)) == 0
+			&& header->FormatVersion == CacheFormatVersion
+			&& header->FileSize == cacheFile.Size
+			&& header->SlotCount >= MinimumSlotCount
+			&& (header->SlotCount & (header->SlotCount - 1)) == 0
+			&& header->DataOffset == SlotsOffset + static_cast<std::uint64_t>(header->SlotCount) * sizeof(CacheSlot)
+			&& header->DataOffset < header->FileSize
+			&& header->DataEnd.load() <= header->FileSize - header->DataOffset;
+	}
+
+	bool ExtractionCache::Insert(CacheFile& cacheFile, std::uint64_t hash, const FileIdentity& identity, const std::vector<std::uint8_t>& record, std::uint32_t lastUsed)
+	{
+		auto header = GetHeader(cacheFile.Base);
+		auto slots = GetSlots(cacheFile.Base);
+		auto mask = header->SlotCount - 1;
+
+		auto entryCount = header->EntryCount.load(std::memory_order_relaxed);
+		auto dataEnd = header->DataEnd.load(std::memory_order_relaxed);
+		auto alignedSize = (record.size() + 7) / 8 * 8;
+		if (IsTableFull(*header, entryCount) || alignedSize > header->FileSize - header->DataOffset - dataEnd)
+		{
+			return false;
+		}
+
+		auto index = hash & mask;
+		for (;; index = (index + 1) & mask)
+		{
+			auto& slot = slots[index];
+			auto slotHash = slot.Hash.load(std::memory_order_relaxed);
+			if (slotHash == 0)
+			{
+				break;
+			}
+
+			if (slotHash == hash && slot.Identity == identity)
+			{
+				return true;
+			}
+		}
+
+		std::memcpy(AddOffset<void>(cacheFile.Base, static_cast<ptrdiff_t>(header->DataOffset + dataEnd)), record.data(), record.size());
+		header->DataEnd.store(dataEnd + alignedSize, std::memory_order_relaxed);
+
+		auto& slot = slots[index];
+		slot.Identity = identity;
+		slot.RecordOffset = dataEnd;
+		slot.RecordSize = static_cast<std::uint32_t>(record.size());
+		slot.LastUsed.store(lastUsed, std::memory_order_relaxed);
+		slot.Hash.store(hash, std::memory_order_release);
+
+		header->EntryCount.store(entryCount + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	void ExtractionCache::ReopenIfReplaced()
+	{
+		if (IsSameFile(cacheFile_.File, cachePath_))
+		{
+			return;
+		}
+
+		CloseCacheFile(cacheFile_);
+		cacheFile_ = OpenCacheFile(cachePath_, fileSize_);
+		if (!IsCacheFileValid(cacheFile_))
+		{
+			Compact();
+		}
+	}
+
+	void ExtractionCache::Compact()
+	{
+		struct Entry
+		{
+			const CacheSlot* Slot;
+			std::uint32_t LastUsed;
+		};
+
+		std::vector<Entry> entries;
+		bool isValid = IsCacheFileValid(cacheFile_);
+		if (isValid)
+		{
+			auto header = GetHeader(cacheFile_.Base);
+			auto slots = GetSlots(cacheFile_.Base);
+			for (std::uint32_t i = 0; i < header->SlotCount; ++i)
+			{
+				if (slots[i].Hash.load(std::memory_order_acquire) != 0)
+				{
+					entries.push_back(Entry{ &slots[i], slots[i].LastUsed.load(std::memory_order_relaxed) });
+				}
+			}
+
+			std::sort(entries.begin(), entries.end(), [](const Entry& left, const Entry& right)
+			{
+				return left.LastUsed > right.LastUsed;
+			});
+		}
+
+		auto temporaryPath = cachePath_ + L".tmp";
+		RemoveFile(temporaryPath);
+
+		CacheFile newFile = OpenCacheFile(temporaryPath, fileSize_);
+		InitializeCacheFile(newFile);
+
+		// Evicting down to half leaves room for a full run of new entries before the next compaction
+		auto newHeader = GetHeader(newFile.Base);
+		newHeader->Generation.store(isValid ? GetHeader(cacheFile_.Base)->Generation.load() : 0);
+		auto keptDataLimit = (newHeader->FileSize - newHeader->DataOffset) / 2;
+		auto keptEntryLimit = newHeader->SlotCount / 8 * 3;
+
+		std::vector<std::uint8_t> record;
+		for (const auto& entry : entries)
+		{
+			if (newHeader->EntryCount.load() >= keptEntryLimit || newHeader->DataEnd.load() >= keptDataLimit)
+			{
+				break;
+			}
+
+			const auto& slot = *entry.Slot;
+			auto header = GetHeader(cacheFile_.Base);
+			auto dataSize = header->FileSize - header->DataOffset;
+			if (slot.RecordOffset > dataSize || slot.RecordSize > dataSize - slot.RecordOffset)
+			{
+				continue;
+			}
+
+			auto recordStart = AddOffset<const std::uint8_t>(cacheFile_.Base, static_cast<ptrdiff_t>(header->DataOffset + slot.RecordOffset));
+			record.assign(recordStart, recordStart + slot.RecordSize);
+			Insert(newFile, slot.Hash.load(std::memory_order_relaxed), slot.Identity, record, entry.LastUsed);
+		}
+
+#ifdef _WIN32
+		// A mapped file cannot be replaced on Windows, so both files are closed around the rename
+		CloseCacheFile(newFile);
+		CloseCacheFile(cacheFile_);
+		ReplaceFile(temporaryPath, cachePath_);
+		cacheFile_ = OpenCacheFile(cachePath_, fileSize_);
+		if (!IsCacheFileValid(cacheFile_))
+		{
+			InitializeCacheFile(cacheFile_);
+		}
+#else
+		if (!ReplaceFile(temporaryPath, cachePath_))
+		{
+			int error = errno;
+			CloseCacheFile(newFile);
+			errno = error;
+			HandlePosixError(true);
+		}
+
+		CloseCacheFile(cacheFile_);
+		cacheFile_ = newFile;
+#endif
+	}
+}
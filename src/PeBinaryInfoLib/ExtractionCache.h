@@ -0,0 +1,101 @@
+#pragma once
+#include <shared_mutex>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#endif
+
+#include "PeBinaryInfo.h"
+
+namespace peinfo
+{
+	// Identifies one version of a file without reading it. Writing to a file updates its modification
+	// and change times, and replacing it gives it a new inode (file index on Windows).
+	struct FileIdentity
+	{
+		std::uint64_t Device;
+		std::uint64_t Inode;
+		std::uint64_t Size;
+		std::uint64_t ModificationTime;  // nanoseconds
+		std::uint64_t ChangeTime;        // nanoseconds
+	};
+
+	inline bool operator==(const FileIdentity& left, const FileIdentity& right)
+	{
+		return left.Device == right.Device && left.Inode == right.Inode && left.Size == right.Size
+			&& left.ModificationTime == right.ModificationTime && left.ChangeTime == right.ChangeTime;
+	}
+
+	// One statx on Linux; an open without data access and two queries on Windows.
+	bool TryGetFileIdentity(const std::wstring& filePath, FileIdentity& identity);
+
+#ifdef __linux__
+	FileIdentity MakeFileIdentity(const struct statx& fileStat);
+#endif
+
+	enum class CachedResultKind : std::uint8_t
+	{
+		Extracted,
+		Failed,
+		NotPe,
+		Filtered  // rejected by the ExtractionPlan; only used while scanning, never stored
+	};
+
+	struct CachedResult
+	{
+		CachedResultKind Kind;
+		PeFileFormattedInfo Info;  // set for Extracted
+		std::string Error;         // set for Failed
+	};
+
+	// Extraction results persisted in a memory-mapped hash table keyed by FileIdentity, so that
+	// unchanged files are answered from the file metadata alone.
+	//
+	// The file is a header, a fixed open-addressing slot table and an append-only record area.
+	// A record is written before its slot, and the slot's hash is published last with a release
+	// store, so lookups need no lock and never see a partially written entry. Published slots and
+	// records are never modified. Writers are serialized by a lock on a sibling ".lock" file.
+	// When the table or the record area fills up, the most recently used half of the entries is
+	// copied into a new file that is renamed over the old one; processes still reading the old
+	// file keep their mapping and pick up the new one on their next write.
+	class ExtractionCache
+	{
+	public:
+		static constexpr std::uint64_t DefaultMaxSize = 256 * 1024 * 1024;
+
+		ExtractionCache(const std::wstring& cachePath, std::uint64_t maxSize = DefaultMaxSize);
+		~ExtractionCache();
+
+		ExtractionCache(const ExtractionCache&) = delete;
+		ExtractionCache& operator=(const ExtractionCache&) = delete;
+
+		bool TryGet(const FileIdentity& identity, CachedResult& result);
+		void Put(const FileIdentity& identity, const CachedResult& result);
+
+	private:
+		struct CacheFile
+		{
+			NativeFileHandle File;
+			void* Base;
+			std::uint64_t Size;
+		};
+
+		static CacheFile OpenCacheFile(const std::wstring& path, std::uint64_t size);
+		static void CloseCacheFile(CacheFile& cacheFile);
+		static void InitializeCacheFile(CacheFile& cacheFile);
+		static bool IsCacheFileValid(const CacheFile& cacheFile);
+		static bool Insert(CacheFile& cacheFile, std::uint64_t hash, const FileIdentity& identity, const std::vector<std::uint8_t>& record, std::uint32_t lastUsed);
+
+		void ReopenIfReplaced();
+		void Compact();
+
+		std::wstring cachePath_;
+		std::uint64_t fileSize_;
+		CacheFile cacheFile_;
+		NativeFileHandle lockFile_;
+		std::uint32_t generation_;
+
+		// Shared by lookups, exclusive while a write may remap the file
+		std::shared_mutex mutex_;
+	};
+}
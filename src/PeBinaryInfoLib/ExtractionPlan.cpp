@@ -0,0 +1,179 @@
+#include "stdafx.h"
+#include "ExtractionPlan.h"
+#include "PeBinaryInfo.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		struct InfoFieldDefinition
+		{
+			InfoField Field;
+			const wchar_t* Name;
+			InfoFieldKind Kind;
+			InfoFieldCost Cost;
+		};
+
+		// Configuration comes from the metadata of managed images and from the version resource
+		// of native ones, so it is planned for the more expensive of the two.
+		const InfoFieldDefinition InfoFieldDefinitions[] =
+		{
+			{ InfoField::Description, L"description", InfoFieldKind::Text, InfoFieldCost::Headers },
+			{ InfoField::Machine, L"machine", InfoFieldKind::Text, InfoFieldCost::Headers },
+			{ InfoField::Platform, L"platform", InfoFieldKind::Text, InfoFieldCost::ClrHeader },
+			{ InfoField::Toolset, L"toolset", InfoFieldKind::Text, InfoFieldCost::Headers },
+			{ InfoField::Framework, L"framework", InfoFieldKind::Text, InfoFieldCost::ClrMetadata },
+			{ InfoField::AssemblyVersion, L"assemblyversion", InfoFieldKind::Text, InfoFieldCost::ClrMetadata },
+			{ InfoField::Configuration, L"configuration", InfoFieldKind::Text, InfoFieldCost::Resources },
+			{ InfoField::Dep, L"dep", InfoFieldKind::Flag, InfoFieldCost::Headers },
+			{ InfoField::Aslr, L"aslr", InfoFieldKind::Flag, InfoFieldCost::Headers },
+			{ InfoField::HighEntropyVa, L"highentropyva", InfoFieldKind::Flag, InfoFieldCost::Headers },
+			{ InfoField::Cfg, L"cfg", InfoFieldKind::Flag, InfoFieldCost::Headers },
+			{ InfoField::Dll, L"dll", InfoFieldKind::Flag, InfoFieldCost::Headers },
+			{ InfoField::Clr, L"clr", InfoFieldKind::Flag, InfoFieldCost::ClrHeader },
+			{ InfoField::Pe32Plus, L"pe32plus", InfoFieldKind::Flag, InfoFieldCost::Headers },
+			{ InfoField::Timestamp, L"timestamp", InfoFieldKind::Number, InfoFieldCost::Headers },
+			{ InfoField::Subsystem, L"subsystem", InfoFieldKind::Number, InfoFieldCost::Headers },
+			{ InfoField::Linker, L"linker", InfoFieldKind::Number, InfoFieldCost::Headers },
+			{ InfoField::FileVersion, L"fileversion", InfoFieldKind::Text, InfoFieldCost::Resources },
+			{ InfoField::ProductVersion, L"productversion", InfoFieldKind::Text, InfoFieldCost::Resources },
+			{ InfoField::Company, L"company", InfoFieldKind::Text, InfoFieldCost::Resources },
+			{ InfoField::Product, L"product", InfoFieldKind::Text, InfoFieldCost::Resources },
+			{ InfoField::ExecutionLevel, L"executionlevel", InfoFieldKind::Text, InfoFieldCost::Resources },
+			{ InfoField::ResourceCount, L"resourcecount", InfoFieldKind::Number, InfoFieldCost::Resources },
+			{ InfoField::ResourceSize, L"resourcesize", InfoFieldKind::Number, InfoFieldCost::Resources },
+			{ InfoField::Imports, L"imports", InfoFieldKind::Text, InfoFieldCost::Imports },
+			{ InfoField::DelayImports, L"delayimports", InfoFieldKind::Text, InfoFieldCost::Imports },
+			{ InfoField::Imphash, L"imphash", InfoFieldKind::Text, InfoFieldCost::Imports },
+			{ InfoField::ImportCount, L"importcount", InfoFieldKind::Number, InfoFieldCost::Imports },
+			{ InfoField::Exports, L"exports", InfoFieldKind::Text, InfoFieldCost::Exports },
+			{ InfoField::ExportName, L"exportname", InfoFieldKind::Text, InfoFieldCost::Exports },
+			{ InfoField::ExportCount, L"exportcount", InfoFieldKind::Number, InfoFieldCost::Exports },
+			{ InfoField::ForwarderCount, L"forwardercount", InfoFieldKind::Number, InfoFieldCost::Exports }
+		};
+
+		const InfoFieldDefinition& GetDefinition(InfoField field)
+		{
+			return InfoFieldDefinitions[static_cast<std::size_t>(field)];
+		}
+
+		InfoField ParseInfoField(const std::wstring& name)
+		{
+			InfoField field;
+			if (!TryParseInfoField(name, field))
+			{
+				throw std::runtime_error("Unknown field: " + utf16_to_utf8(name));
+			}
+
+			return field;
+		}
+
+		PlannedPredicate PlanPredicate(const FieldPredicate& predicate)
+		{
+			PlannedPredicate plannedPredicate{ ParseInfoField(predicate.Field), predicate.Operator, false, 0, std::string() };
+			switch (GetInfoFieldKind(plannedPredicate.Field))
+			{
+			case InfoFieldKind::Flag:
+				if ((predicate.Operator != PredicateOperator::Equal && predicate.Operator != PredicateOperator::NotEqual)
+					|| !TryParseFlagValue(predicate.Value, plannedPredicate.Flag))
+				{
+					throw std::runtime_error("Expected =yes, =no, !=yes or !=no for field: " + utf16_to_utf8(predicate.Field));
+				}
+				break;
+			case InfoFieldKind::Number:
+				if (predicate.Operator == PredicateOperator::Contains || !TryParseNumberValue(predicate.Value, plannedPredicate.Number))
+				{
+					throw std::runtime_error("Expected a number and a comparison for field: " + utf16_to_utf8(predicate.Field));
+				}
+				break;
+			case InfoFieldKind::Text:
+				plannedPredicate.Text = utf16_to_utf8(predicate.Value);
+				break;
+			}
+
+			return plannedPredicate;
+		}
+	}
+
+	bool TryParseInfoField(const std::wstring& name, InfoField& field)
+	{
+		for (const auto& definition : InfoFieldDefinitions)
+		{
+			if (name == definition.Name)
+			{
+				field = definition.Field;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	const wchar_t* GetInfoFieldName(InfoField field)
+	{
+		return GetDefinition(field).Name;
+	}
+
+	InfoFieldKind GetInfoFieldKind(InfoField field)
+	{
+		return GetDefinition(field).Kind;
+	}
+
+	InfoFieldCost GetInfoFieldCost(InfoField field)
+	{
+		return GetDefinition(field).Cost;
+	}
+
+	ExtractionPlan::ExtractionPlan()
+		: cost_(InfoFieldCost::Resources)
+	{
+	}
+
+	ExtractionPlan::ExtractionPlan(const std::vector<std::wstring>& fieldNames, const std::vector<FieldPredicate>& predicates)
+		: cost_(fieldNames.empty() ? InfoFieldCost::Resources : InfoFieldCost::Headers)
+	{
+		for (const auto& name : fieldNames)
+		{
+			auto field = ParseInfoField(name);
+			fields_.push_back(field);
+			cost_ = std::max(cost_, GetInfoFieldCost(field));
+		}
+
+		for (const auto& predicate : predicates)
+		{
+			predicates_.push_back(PlanPredicate(predicate));
+			cost_ = std::max(cost_, GetInfoFieldCost(predicates_.back().Field));
+		}
+
+		// Stable, so predicates of the same cost are checked in the order they were given
+		std::stable_sort(predicates_.begin(), predicates_.end(), [](const PlannedPredicate& left, const PlannedPredicate& right)
+		{
+			return GetInfoFieldCost(left.Field) < GetInfoFieldCost(right.Field);
+		});
+	}
+
+	bool ExtractionPlan::SelectsAllFields() const
+	{
+		return fields_.empty();
+	}
+
+	bool ExtractionPlan::HasPredicates() const
+	{
+		return !predicates_.empty();
+	}
+
+	const std::vector<InfoField>& ExtractionPlan::GetFields() const
+	{
+		return fields_;
+	}
+
+	const std::vector<PlannedPredicate>& ExtractionPlan::GetPredicates() const
+	{
+		return predicates_;
+	}
+
+	InfoFieldCost ExtractionPlan::GetCost() const
+	{
+		return cost_;
+	}
+}
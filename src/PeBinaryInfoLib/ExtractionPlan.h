@@ -0,0 +1,112 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Predicate.h"
+
+namespace peinfo
+{
+	// The fields an ExtractionPlan selects and filters on. Their names are the ScanIndex column
+	// names, plus description, assemblyversion, the version resource strings fileversion,
+	// productversion, company and product, the resource fields executionlevel, resourcecount
+	// and resourcesize, the import fields imports, delayimports, imphash and importcount, and the
+	// export fields exports, exportname, exportcount and forwardercount. imports and delayimports
+	// are the module names separated by ", ", and exports the exported names in name order. As a
+	// predicate, exports=<name> or exports=#<ordinal> is a lookup of one export, which compares
+	// names with case, as GetProcAddress does; exports!= is its negation.
+	enum class InfoField
+	{
+		Description,
+		Machine,
+		Platform,
+		Toolset,
+		Framework,
+		AssemblyVersion,
+		Configuration,
+		Dep,
+		Aslr,
+		HighEntropyVa,
+		Cfg,
+		Dll,
+		Clr,
+		Pe32Plus,
+		Timestamp,
+		Subsystem,
+		Linker,
+		FileVersion,
+		ProductVersion,
+		Company,
+		Product,
+		ExecutionLevel,
+		ResourceCount,
+		ResourceSize,
+		Imports,
+		DelayImports,
+		Imphash,
+		ImportCount,
+		Exports,
+		ExportName,
+		ExportCount,
+		ForwarderCount
+	};
+
+	enum class InfoFieldKind
+	{
+		Text,
+		Flag,
+		Number
+	};
+
+	// What has to be read to get a field, cheapest first
+	enum class InfoFieldCost
+	{
+		Headers,      // the DOS and NT headers, read when the extractor is created
+		ClrHeader,    // the IMAGE_COR20_HEADER
+		Exports,      // the export directory and its tables; a lookup reads the names it compares
+		Imports,      // the import descriptors, their name tables and the names
+		ClrMetadata,  // the metadata streams and the assembly custom attributes
+		Resources     // the resource tree, for the version resource and the manifest
+	};
+
+	bool TryParseInfoField(const std::wstring& name, InfoField& field);
+	const wchar_t* GetInfoFieldName(InfoField field);
+	InfoFieldKind GetInfoFieldKind(InfoField field);
+	InfoFieldCost GetInfoFieldCost(InfoField field);
+
+	// A predicate whose value is already converted for the kind of its field
+	struct PlannedPredicate
+	{
+		InfoField Field;
+		PredicateOperator Operator;
+		bool Flag;
+		std::uint64_t Number;
+		std::string Text;  // UTF-8
+	};
+
+	// Which fields PeFileFormattedInfoExtractor::TryExtract produces and which predicates an image
+	// has to match for it to produce them. Predicates are checked cheapest first, so an image that
+	// fails one is rejected before the reads of the more expensive fields; a plan that only needs
+	// the headers never reads past them.
+	class ExtractionPlan
+	{
+	public:
+		// Selects every field and accepts every image, like Extract
+		ExtractionPlan();
+
+		// An empty field list selects every field. Throws for unknown fields and for operators or
+		// values that do not apply to the field.
+		ExtractionPlan(const std::vector<std::wstring>& fieldNames, const std::vector<FieldPredicate>& predicates);
+
+		bool SelectsAllFields() const;
+		bool HasPredicates() const;
+		const std::vector<InfoField>& GetFields() const;
+		const std::vector<PlannedPredicate>& GetPredicates() const;
+
+		// The most expensive read the plan can need
+		InfoFieldCost GetCost() const;
+
+	private:
+		std::vector<InfoField> fields_;
+		std::vector<PlannedPredicate> predicates_;
+		InfoFieldCost cost_;
+	};
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <filesystem>
+#include "PeBinaryInfo.h"
+
+namespace peinfo
+{
+	// Paths are UTF-16 throughout the library; std::filesystem takes them natively on Windows and
+	// as bytes elsewhere, where names that are not UTF-8 round-trip through native_path_to_utf16
+	inline std::filesystem::path ToFilesystemPath(const std::wstring& filePath)
+	{
+#ifdef _WIN32
+		return std::filesystem::path(filePath);
+#else
+		return std::filesystem::path(utf16_to_native_path(filePath));
+#endif
+	}
+
+	inline std::wstring FromFilesystemPath(const std::filesystem::path& filePath)
+	{
+#ifdef _WIN32
+		return filePath.wstring();
+#else
+		return native_path_to_utf16(filePath.native());
+#endif
+	}
+}
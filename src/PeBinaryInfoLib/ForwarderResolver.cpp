@@ -0,0 +1,174 @@
+#include "stdafx.h"
+#include "ForwarderResolver.h"
+#include "DependencyGraph.h"
+#include "FilesystemPath.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		// The loader gives up on longer chains; a longer one is a cycle
+		const std::size_t MaxHops = 32;
+
+		std::wstring ToLowerAscii(std::wstring text)
+		{
+			for (auto& character : text)
+			{
+				if (character >= L'A' && character <= L'Z')
+				{
+					character = static_cast<wchar_t>(character - L'A' + L'a');
+				}
+			}
+
+			return text;
+		}
+
+		std::string FormatSymbol(const Export& exported)
+		{
+			return exported.Name.empty() ? "#" + std::to_string(exported.Ordinal) : std::string(exported.Name.begin(), exported.Name.end());
+		}
+	}
+
+	ForwarderResolver::ForwarderResolver(std::vector<std::wstring> searchDirectories)
+		: searchDirectories_(std::move(searchDirectories))
+	{
+	}
+
+	ForwarderResolver::~ForwarderResolver() = default;
+
+	ResolvedForwarder ForwarderResolver::Resolve(const std::wstring& filePath, const Export& exported)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		ResolvedForwarder resolved{ ForwarderResolution::Exported, filePath, std::string(), FormatSymbol(exported), exported.Rva, 0 };
+		Export current = exported;
+		while (!current.Forwarder.empty())
+		{
+			if (resolved.Hops == MaxHops)
+			{
+				resolved.Resolution = ForwarderResolution::TooLong;
+				resolved.FilePath.clear();
+				resolved.Rva = 0;
+				return resolved;
+			}
+
+			++resolved.Hops;
+
+			// The function name follows the last dot, since module names may have dots of their own
+			std::string forwarder(current.Forwarder.begin(), current.Forwarder.end());
+			auto separator = forwarder.rfind('.');
+			resolved.Module = forwarder.substr(0, separator == std::string::npos ? forwarder.size() : separator);
+			resolved.Symbol = separator == std::string::npos ? std::string() : forwarder.substr(separator + 1);
+			resolved.Rva = 0;
+
+			auto moduleName = utf8_to_utf16(resolved.Module);
+			if (IsApiSetName(moduleName))
+			{
+				resolved.Resolution = ForwarderResolution::ApiSet;
+				resolved.FilePath.clear();
+				return resolved;
+			}
+
+			auto fileName = ToLowerAscii(moduleName);
+			if (fileName.size() < 4 || fileName.compare(fileName.size() - 4, 4, L".dll") != 0)
+			{
+				fileName += L".dll";
+			}
+
+			std::wstring modulePath;
+			auto exports = FindModule(GetDirectoryName(resolved.FilePath), fileName, modulePath);
+			if (exports == nullptr)
+			{
+				resolved.Resolution = ForwarderResolution::ModuleMissing;
+				resolved.FilePath.clear();
+				return resolved;
+			}
+
+			resolved.FilePath = modulePath;
+			if (!exports->TryFind(Span<const char>(resolved.Symbol.data(), resolved.Symbol.size()), current))
+			{
+				resolved.Resolution = ForwarderResolution::ExportMissing;
+				return resolved;
+			}
+
+			resolved.Rva = current.Rva;
+		}
+
+		return resolved;
+	}
+
+	std::size_t ForwarderResolver::GetLoadedModuleCount()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return modules_.size();
+	}
+
+	const ExportTable* ForwarderResolver::FindModule(const std::wstring& directory, const std::wstring& fileName, std::wstring& filePath)
+	{
+		auto findIn = [&](const std::wstring& candidateDirectory) -> const ExportTable*
+		{
+			const auto& files = ListDirectory(candidateDirectory);
+			auto file = files.find(fileName);
+			if (file == files.end())
+			{
+				return nullptr;
+			}
+
+			filePath = file->second;
+			return LoadModule(file->second);
+		};
+
+		auto exports = findIn(directory);
+		for (auto searchDirectory = searchDirectories_.begin(); exports == nullptr && searchDirectory != searchDirectories_.end(); ++searchDirectory)
+		{
+			exports = findIn(*searchDirectory);
+		}
+
+		return exports;
+	}
+
+	const ExportTable* ForwarderResolver::LoadModule(const std::wstring& filePath)
+	{
+		auto inserted = modules_.emplace(ToLowerAscii(filePath), nullptr);
+		auto& module = inserted.first->second;
+		if (inserted.second)
+		{
+			try
+			{
+				module = std::make_unique<PeFileInfoExtractor>(filePath);
+				module->GetExports();
+			}
+			catch (const std::exception&)
+			{
+				module.reset();
+			}
+		}
+
+		return module != nullptr ? &module->GetExports() : nullptr;
+	}
+
+	// A directory that cannot be listed has no modules
+	const std::unordered_map<std::wstring, std::wstring>& ForwarderResolver::ListDirectory(const std::wstring& directory)
+	{
+		auto inserted = directories_.emplace(ToLowerAscii(directory), std::unordered_map<std::wstring, std::wstring>());
+		auto& files = inserted.first->second;
+		if (!inserted.second)
+		{
+			return files;
+		}
+
+		std::error_code error;
+		std::filesystem::directory_iterator iterator(ToFilesystemPath(directory.empty() ? L"." : directory), std::filesystem::directory_options::skip_permission_denied, error);
+		for (std::filesystem::directory_iterator end; !error && iterator != end; iterator.increment(error))
+		{
+			std::error_code statusError;
+			if (iterator->is_regular_file(statusError))
+			{
+				auto path = FromFilesystemPath(iterator->path());
+				files.emplace(ToLowerAscii(path.substr(path.find_last_of(L"/\\") + 1)), path);
+			}
+		}
+
+		return files;
+	}
+}
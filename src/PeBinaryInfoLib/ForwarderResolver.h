@@ -0,0 +1,59 @@
+#pragma once
+#include <mutex>
+#include <unordered_map>
+#include "PeBinaryInfo.h"
+
+namespace peinfo
+{
+	enum class ForwarderResolution
+	{
+		Exported,       // the chain ends at an export that is not forwarded
+		ApiSet,         // the chain reaches an API set contract, which only the loader can map
+		ModuleMissing,
+		ExportMissing,
+		TooLong         // the chain is longer than any the loader would follow, usually a cycle
+	};
+
+	struct ResolvedForwarder
+	{
+		ForwarderResolution Resolution;
+		std::wstring FilePath;   // the module the chain ends in; empty unless Exported or ExportMissing
+		std::string Module;      // the module as the last forwarder names it; empty when not forwarded
+		std::string Symbol;      // the export the chain ends at, as a name or #ordinal
+		DWORD Rva;               // only set when Exported
+		std::size_t Hops;        // forwarders followed
+	};
+
+	// Follows forwarder chains across DLLs. A forwarder names its module without the extension;
+	// the module is looked up in the directory of the forwarding DLL, then in the search
+	// directories, ignoring ASCII case. Forwarders of a fleet lead to the same few modules, so
+	// every module is opened and its export table parsed once and then kept for later lookups,
+	// and every directory is listed once. Thread-safe.
+	class ForwarderResolver
+	{
+	public:
+		explicit ForwarderResolver(std::vector<std::wstring> searchDirectories);
+		~ForwarderResolver();
+
+		DECLARE_NONCOPYABLE(ForwarderResolver);
+
+		// The export must be one of the module at the path
+		ResolvedForwarder Resolve(const std::wstring& filePath, const Export& exported);
+
+		std::size_t GetLoadedModuleCount();
+
+	private:
+		const ExportTable* FindModule(const std::wstring& directory, const std::wstring& fileName, std::wstring& filePath);
+		const ExportTable* LoadModule(const std::wstring& filePath);
+		const std::unordered_map<std::wstring, std::wstring>& ListDirectory(const std::wstring& directory);
+
+		std::vector<std::wstring> searchDirectories_;
+		std::mutex mutex_;
+
+		// By lowercase path; null for files that are not PE images
+		std::unordered_map<std::wstring, std::unique_ptr<PeFileInfoExtractor>> modules_;
+
+		// Lowercase file names to paths, by lowercase directory
+		std::unordered_map<std::wstring, std::unordered_map<std::wstring, std::wstring>> directories_;
+	};
+}
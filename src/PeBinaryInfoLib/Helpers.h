@@ -1,4 +1,8 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
 
 template<class R, class T>
 R* AddOffset(T* p, ptrdiff_t offset)
@@ -10,13 +14,86 @@ R* AddOffset(T* p, ptrdiff_t offset)
 	return static_cast<R*>(p5);
 }
 
+template<class T, class U>
+ptrdiff_t AddressDifference(T* p, U* base)
+{
+	return AddOffset<const std::uint8_t>(p, 0) - AddOffset<const std::uint8_t>(base, 0);
+}
+
+// Rounds the value up to a multiple of the alignment, which must be a power of two
+template<class T>
+T RoundUpToMultiple(T value, T alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Non-owning view of a contiguous range, a subset of C++20 std::span
+template<class T>
+class Span
+{
+public:
+	Span()
+		: data_(nullptr), size_(0)
+	{
+	}
+
+	Span(T* data, std::size_t size)
+		: data_(data), size_(size)
+	{
+	}
+
+	T* data() const
+	{
+		return data_;
+	}
+
+	std::size_t size() const
+	{
+		return size_;
+	}
+
+	bool empty() const
+	{
+		return size_ == 0;
+	}
+
+	T* begin() const
+	{
+		return data_;
+	}
+
+	T* end() const
+	{
+		return data_ + size_;
+	}
+
+	T& operator[](std::size_t index) const
+	{
+		return data_[index];
+	}
+
+	Span subspan(std::size_t offset) const
+	{
+		return Span(data_ + offset, size_ - offset);
+	}
+
+	Span subspan(std::size_t offset, std::size_t count) const
+	{
+		return Span(data_ + offset, count);
+	}
+
+private:
+	T* data_;
+	std::size_t size_;
+};
+
 template<class R, class T>
 R ReadAtOffset(T* p, ptrdiff_t offset)
 {
 	return *AddOffset<R>(p, offset);
 }
 
-bool IsFlagSet(DWORD flags, DWORD flagToCheck)
+inline bool IsFlagSet(DWORD flags, DWORD flagToCheck)
 {
 	return (flags & flagToCheck) != 0;
 }
@@ -25,7 +102,7 @@ bool IsFlagSet(DWORD flags, DWORD flagToCheck)
   ClassName(const ClassName&) = delete; \
   ClassName& operator=(const ClassName&) = delete
 
-void CheckError(bool condition, const char* message)
+inline void CheckError(bool condition, const char* message)
 {
 	if (!condition)
 	{
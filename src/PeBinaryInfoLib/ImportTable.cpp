@@ -0,0 +1,264 @@
+#include "stdafx.h"
+#include "ImportTable.h"
+#include "PeBinaryInfo.h"
+#include "ContentHash.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		// Thunks read per call, so a long array costs a few reads on a ranged source
+		const std::size_t ThunkChunkSize = 64;
+
+		// Most names fit, so they usually take one read
+		const DWORD NameChunkSize = 128;
+
+		const DWORD DelayLoadRvaBased = 0x1;
+
+		char ToLowerAscii(char character)
+		{
+			return character >= 'A' && character <= 'Z' ? static_cast<char>(character - 'A' + 'a') : character;
+		}
+
+		std::string ToLowerAscii(Span<const char> text)
+		{
+			std::string result(text.data(), text.size());
+			std::transform(result.begin(), result.end(), result.begin(), [](char character) { return ToLowerAscii(character); });
+			return result;
+		}
+	}
+
+	ImportTable::ImportTable()
+		: image_(nullptr), sectionMap_(nullptr), isPe32Plus_(false)
+	{
+	}
+
+	ImportTable::ImportTable(PeImageSource& image, const SectionMap& sectionMap, const ImportDirectories& directories, bool isPe32Plus, ULONGLONG imageBase)
+		: image_(&image), sectionMap_(&sectionMap), isPe32Plus_(isPe32Plus)
+	{
+		ReadImports(directories.Imports);
+		ReadDelayImports(directories.DelayImports, imageBase);
+		ReadBoundImports(directories.BoundImports);
+	}
+
+	const std::vector<ImportedModule>& ImportTable::GetModules() const
+	{
+		return modules_;
+	}
+
+	const std::vector<BoundImport>& ImportTable::GetBoundImports() const
+	{
+		return boundImports_;
+	}
+
+	std::size_t ImportTable::GetFunctionCount() const
+	{
+		std::size_t count = 0;
+		for (const auto& module : modules_)
+		{
+			count += module.Functions.size();
+		}
+
+		return count;
+	}
+
+	std::string ImportTable::GetImphash() const
+	{
+		Md5 md5;
+		bool isFirst = true;
+		for (const auto& module : modules_)
+		{
+			if (module.IsDelayLoaded)
+			{
+				continue;
+			}
+
+			auto moduleName = ToLowerAscii(module.Name);
+			auto extension = moduleName.rfind('.');
+			if (extension != std::string::npos)
+			{
+				auto suffix = moduleName.substr(extension + 1);
+				if (suffix == "dll" || suffix == "ocx" || suffix == "sys")
+				{
+					moduleName.erase(extension);
+				}
+			}
+
+			for (const auto& function : module.Functions)
+			{
+				auto entry = moduleName + "." + (function.IsOrdinal ? "ord" + std::to_string(function.Ordinal) : ToLowerAscii(function.Name));
+				if (!isFirst)
+				{
+					md5.Update(",", 1);
+				}
+
+				md5.Update(entry.data(), entry.size());
+				isFirst = false;
+			}
+		}
+
+		return isFirst ? std::string() : md5.HexDigest();
+	}
+
+	// The descriptors end with one whose name or IAT is zero, which is where the loader stops
+	void ImportTable::ReadImports(IMAGE_DATA_DIRECTORY directory)
+	{
+		if (directory.VirtualAddress == 0)
+		{
+			return;
+		}
+
+		PrepareDirectory(directory);
+		for (DWORD rva = directory.VirtualAddress;; rva += sizeof(IMAGE_IMPORT_DESCRIPTOR))
+		{
+			IMAGE_IMPORT_DESCRIPTOR descriptor;
+			std::memcpy(&descriptor, ReadEntry(rva, sizeof(descriptor)), sizeof(descriptor));
+			if (descriptor.Name == 0 || descriptor.FirstThunk == 0)
+			{
+				break;
+			}
+
+			// Bound images overwrite the IAT with addresses, so the names are taken from the INT when there is one
+			ImportedModule module{ ReadName(descriptor.Name), false, {} };
+			ReadFunctions(descriptor.OriginalFirstThunk != 0 ? descriptor.OriginalFirstThunk : descriptor.FirstThunk, 0, module.Functions);
+			modules_.push_back(std::move(module));
+		}
+	}
+
+	// Descriptors of linkers before Visual C++ 7 hold VAs instead of RVAs, and so do their name tables
+	void ImportTable::ReadDelayImports(IMAGE_DATA_DIRECTORY directory, ULONGLONG imageBase)
+	{
+		if (directory.VirtualAddress == 0)
+		{
+			return;
+		}
+
+		PrepareDirectory(directory);
+		for (DWORD rva = directory.VirtualAddress;; rva += sizeof(IMAGE_DELAYLOAD_DESCRIPTOR))
+		{
+			IMAGE_DELAYLOAD_DESCRIPTOR descriptor;
+			std::memcpy(&descriptor, ReadEntry(rva, sizeof(descriptor)), sizeof(descriptor));
+			if (descriptor.DllNameRVA == 0)
+			{
+				break;
+			}
+
+			ULONGLONG addressBase = IsFlagSet(descriptor.Attributes.AllAttributes, DelayLoadRvaBased) ? 0 : imageBase;
+			ImportedModule module{ ReadName(static_cast<DWORD>(descriptor.DllNameRVA - addressBase)), true, {} };
+			if (descriptor.ImportNameTableRVA != 0)
+			{
+				ReadFunctions(static_cast<DWORD>(descriptor.ImportNameTableRVA - addressBase), addressBase, module.Functions);
+			}
+
+			modules_.push_back(std::move(module));
+		}
+	}
+
+	// Each descriptor is followed by the forwarder references it counts. Name offsets are from the
+	// start of the directory, which usually lies in the headers.
+	void ImportTable::ReadBoundImports(IMAGE_DATA_DIRECTORY directory)
+	{
+		if (directory.VirtualAddress == 0)
+		{
+			return;
+		}
+
+		for (DWORD rva = directory.VirtualAddress;; rva += sizeof(IMAGE_BOUND_IMPORT_DESCRIPTOR))
+		{
+			IMAGE_BOUND_IMPORT_DESCRIPTOR descriptor;
+			std::memcpy(&descriptor, ReadEntry(rva, sizeof(descriptor)), sizeof(descriptor));
+			if (descriptor.TimeDateStamp == 0 && descriptor.OffsetModuleName == 0)
+			{
+				break;
+			}
+
+			boundImports_.push_back(BoundImport{ ReadName(directory.VirtualAddress + descriptor.OffsetModuleName), descriptor.TimeDateStamp, false });
+
+			for (WORD i = 0; i < descriptor.NumberOfModuleForwarderRefs; ++i)
+			{
+				rva += sizeof(IMAGE_BOUND_FORWARDER_REF);
+				IMAGE_BOUND_FORWARDER_REF forwarder;
+				std::memcpy(&forwarder, ReadEntry(rva, sizeof(forwarder)), sizeof(forwarder));
+				boundImports_.push_back(BoundImport{ ReadName(directory.VirtualAddress + forwarder.OffsetModuleName), forwarder.TimeDateStamp, true });
+			}
+		}
+	}
+
+	// A thunk is the RVA of an IMAGE_IMPORT_BY_NAME, a WORD hint followed by the name, or an
+	// ordinal with the top bit set. The array ends with a zero thunk.
+	void ImportTable::ReadFunctions(DWORD thunksRva, ULONGLONG addressBase, std::vector<ImportedFunction>& functions)
+	{
+		std::size_t thunkSize = isPe32Plus_ ? sizeof(ULONGLONG) : sizeof(DWORD);
+		ULONGLONG ordinalFlag = isPe32Plus_ ? IMAGE_ORDINAL_FLAG64 : IMAGE_ORDINAL_FLAG32;
+
+		DWORD fileOffset = 0;
+		DWORD availableSize = 0;
+		HandleFormatError(sectionMap_->RvaToFileOffset(thunksRva, fileOffset, availableSize) != RvaLookupStatus::Success, "Failed to convert RVA");
+
+		for (std::size_t position = 0;;)
+		{
+			auto count = std::min<std::size_t>(ThunkChunkSize, (availableSize - position) / thunkSize);
+			HandleFormatError(count == 0, "Import thunks are not terminated");
+
+			auto thunks = static_cast<const std::uint8_t*>(image_->GetData(fileOffset + position, count * thunkSize));
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				ULONGLONG thunk = 0;
+				std::memcpy(&thunk, thunks + i * thunkSize, thunkSize);
+				if (thunk == 0)
+				{
+					return;
+				}
+
+				if ((thunk & ordinalFlag) != 0)
+				{
+					functions.push_back(ImportedFunction{ true, static_cast<WORD>(thunk), 0, Span<const char>() });
+					continue;
+				}
+
+				auto importByNameRva = static_cast<DWORD>((thunk - addressBase) & 0x7FFFFFFF);
+				auto hint = ReadAtOffset<WORD>(ReadEntry(importByNameRva, sizeof(WORD)), 0);
+				functions.push_back(ImportedFunction{ false, 0, hint, ReadName(importByNameRva + sizeof(WORD)) });
+			}
+
+			position += count * thunkSize;
+		}
+	}
+
+	Span<const char> ImportTable::ReadName(DWORD rva)
+	{
+		DWORD fileOffset = 0;
+		DWORD availableSize = 0;
+		HandleFormatError(sectionMap_->RvaToFileOffset(rva, fileOffset, availableSize) != RvaLookupStatus::Success, "Failed to convert RVA");
+
+		for (DWORD size = std::min(NameChunkSize, availableSize);; size = std::min(size * 4, availableSize))
+		{
+			auto name = static_cast<const char*>(image_->GetData(fileOffset, size));
+			auto end = static_cast<const char*>(std::memchr(name, 0, size));
+			if (end != nullptr)
+			{
+				return Span<const char>(name, static_cast<std::size_t>(end - name));
+			}
+
+			HandleFormatError(size == availableSize, "Import name is not terminated");
+		}
+	}
+
+	const void* ImportTable::ReadEntry(DWORD rva, std::size_t size)
+	{
+		DWORD fileOffset = 0;
+		HandleFormatError(sectionMap_->RvaToFileOffset(rva, fileOffset) != RvaLookupStatus::Success, "Failed to convert RVA");
+		return image_->GetData(fileOffset, size);
+	}
+
+	// The descriptors, name tables and names are read back and forth, mostly in the rest of the section
+	void ImportTable::PrepareDirectory(IMAGE_DATA_DIRECTORY directory)
+	{
+		DWORD fileOffset = 0;
+		DWORD availableSize = 0;
+		if (sectionMap_->RvaToFileOffset(directory.VirtualAddress, fileOffset, availableSize) == RvaLookupStatus::Success)
+		{
+			image_->PrepareRandomAccess(fileOffset, availableSize);
+		}
+	}
+}
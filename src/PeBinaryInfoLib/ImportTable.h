@@ -0,0 +1,79 @@
+#pragma once
+#include "PeImageSource.h"
+#include "SectionMap.h"
+
+namespace peinfo
+{
+	// A function imported by name or by ordinal. The name points into the image, without the terminator.
+	struct ImportedFunction
+	{
+		bool IsOrdinal;
+		WORD Ordinal;   // only set when imported by ordinal
+		WORD Hint;      // only set when imported by name
+		Span<const char> Name;
+	};
+
+	struct ImportedModule
+	{
+		Span<const char> Name;
+		bool IsDelayLoaded;
+		std::vector<ImportedFunction> Functions;
+	};
+
+	// An entry of the bound import directory: a module the imports were bound to, or a module it
+	// forwards to, with the timestamp the module had when the image was bound.
+	struct BoundImport
+	{
+		Span<const char> Name;
+		DWORD TimeDateStamp;
+		bool IsForwarder;
+	};
+
+	struct ImportDirectories
+	{
+		IMAGE_DATA_DIRECTORY Imports;
+		IMAGE_DATA_DIRECTORY DelayImports;
+		IMAGE_DATA_DIRECTORY BoundImports;
+	};
+
+	// The import, delay import and bound import directories of an image. Names are views into the
+	// image rather than copies; the thunk arrays are read in chunks, and each name is read in one
+	// piece when it fits in the first bytes asked for.
+	class ImportTable
+	{
+	public:
+		// An empty table
+		ImportTable();
+
+		// The image must outlive the table. The image base turns the addresses of old delay import
+		// descriptors, which hold VAs rather than RVAs, into RVAs.
+		ImportTable(PeImageSource& image, const SectionMap& sectionMap, const ImportDirectories& directories, bool isPe32Plus, ULONGLONG imageBase);
+
+		// The modules of the import directory in order, then those of the delay import directory
+		const std::vector<ImportedModule>& GetModules() const;
+		const std::vector<BoundImport>& GetBoundImports() const;
+		std::size_t GetFunctionCount() const;
+
+		// The imphash of the import directory: the MD5 of the comma-separated "module.function" of
+		// every import, lowercase and with the .dll, .ocx or .sys extension dropped from the module.
+		// Functions imported by ordinal are written as ord<N>; pefile also names the ordinals of
+		// ws2_32, wsock32 and oleaut32, so its hash differs for images that import those by ordinal.
+		// Empty when the image imports nothing.
+		std::string GetImphash() const;
+
+	private:
+		void ReadImports(IMAGE_DATA_DIRECTORY directory);
+		void ReadDelayImports(IMAGE_DATA_DIRECTORY directory, ULONGLONG imageBase);
+		void ReadBoundImports(IMAGE_DATA_DIRECTORY directory);
+		void ReadFunctions(DWORD thunksRva, ULONGLONG addressBase, std::vector<ImportedFunction>& functions);
+		Span<const char> ReadName(DWORD rva);
+		const void* ReadEntry(DWORD rva, std::size_t size);
+		void PrepareDirectory(IMAGE_DATA_DIRECTORY directory);
+
+		PeImageSource* image_;
+		const SectionMap* sectionMap_;
+		bool isPe32Plus_;
+		std::vector<ImportedModule> modules_;
+		std::vector<BoundImport> boundImports_;
+	};
+}
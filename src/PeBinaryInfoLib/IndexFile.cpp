@@ -0,0 +1,114 @@
+#include "stdafx.h"
+#include "IndexFile.h"
+#include "PeBinaryInfo.h"
+#include "FilesystemPath.h"
+
+namespace peinfo
+{
+#ifdef _WIN32
+	namespace
+	{
+		const void* MapFile(const std::wstring& indexPath, bool isSequential, bool isOptional, std::uint64_t& size)
+		{
+			HANDLE file = CreateFile(indexPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+				isSequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS, nullptr);
+			if (isOptional && file == INVALID_HANDLE_VALUE && GetLastError() == ERROR_FILE_NOT_FOUND)
+			{
+				return nullptr;
+			}
+
+			HandleWin32Error(file == INVALID_HANDLE_VALUE);
+
+			LARGE_INTEGER fileSize{};
+			BOOL result = GetFileSizeEx(file, &fileSize);
+			HANDLE fileMappingHandle = result != FALSE && fileSize.QuadPart > 0 ? CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+			void* base = fileMappingHandle != nullptr ? MapViewOfFile(fileMappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+			DWORD error = GetLastError();
+			if (fileMappingHandle != nullptr)
+			{
+				CloseHandle(fileMappingHandle);
+			}
+
+			CloseHandle(file);
+			HandleFormatError(result != FALSE && fileSize.QuadPart == 0, "Not an index file");
+			SetLastError(error);
+			HandleWin32Error(base == nullptr);
+
+			size = static_cast<std::uint64_t>(fileSize.QuadPart);
+			return base;
+		}
+	}
+
+	void UnmapIndexFile(const void* base, std::uint64_t)
+	{
+		UnmapViewOfFile(base);
+	}
+#else
+	namespace
+	{
+		const void* MapFile(const std::wstring& indexPath, bool isSequential, bool isOptional, std::uint64_t& size)
+		{
+			int fd = open(utf16_to_native_path(indexPath).c_str(), O_RDONLY | O_CLOEXEC);
+			if (isOptional && fd == -1 && errno == ENOENT)
+			{
+				return nullptr;
+			}
+
+			HandlePosixError(fd == -1);
+
+			struct stat fileStat{};
+			void* base = MAP_FAILED;
+			int result = fstat(fd, &fileStat);
+			if (result == 0 && fileStat.st_size > 0)
+			{
+				base = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_SHARED, fd, 0);
+			}
+
+			int error = errno;
+			close(fd);
+			HandleFormatError(result == 0 && fileStat.st_size == 0, "Not an index file");
+			errno = error;
+			HandlePosixError(base == MAP_FAILED);
+
+			size = static_cast<std::uint64_t>(fileStat.st_size);
+			madvise(base, static_cast<size_t>(size), isSequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+			return base;
+		}
+	}
+
+	void UnmapIndexFile(const void* base, std::uint64_t size)
+	{
+		munmap(const_cast<void*>(base), static_cast<size_t>(size));
+	}
+#endif
+
+	const void* MapIndexFile(const std::wstring& indexPath, bool isSequential, std::uint64_t& size)
+	{
+		return MapFile(indexPath, isSequential, false, size);
+	}
+
+	const void* TryMapIndexFile(const std::wstring& indexPath, bool isSequential, std::uint64_t& size)
+	{
+		return MapFile(indexPath, isSequential, true, size);
+	}
+
+	void ReplaceIndexFile(const std::wstring& temporaryPath, const std::wstring& indexPath)
+	{
+		std::error_code error;
+		std::filesystem::rename(ToFilesystemPath(temporaryPath), ToFilesystemPath(indexPath), error);
+		if (error)
+		{
+			throw std::system_error(error);
+		}
+	}
+
+	void RemoveIndexFile(const std::wstring& indexPath)
+	{
+		std::error_code error;
+		std::filesystem::remove(ToFilesystemPath(indexPath), error);
+		if (error)
+		{
+			throw std::system_error(error);
+		}
+	}
+}
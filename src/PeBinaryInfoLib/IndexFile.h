@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace peinfo
+{
+	// Maps an index file, such as a ScanIndex or a SymbolIndex, read-only. Throws for an empty
+	// file, which no index is. Indexes whose queries read whole columns ask for sequential access;
+	// the others are read where their lookups land.
+	const void* MapIndexFile(const std::wstring& indexPath, bool isSequential, std::uint64_t& size);
+	// Returns null when the file does not exist.
+	const void* TryMapIndexFile(const std::wstring& indexPath, bool isSequential, std::uint64_t& size);
+	void UnmapIndexFile(const void* base, std::uint64_t size);
+
+	// Renames the temporary file an index was written to over the index, so readers never map a
+	// partially written file
+	void ReplaceIndexFile(const std::wstring& temporaryPath, const std::wstring& indexPath);
+
+	// Removes the index file if it exists
+	void RemoveIndexFile(const std::wstring& indexPath);
+}
@@ -1,139 +1,148 @@
 #pragma once
 #include "stdafx.h"
 #include "Helpers.h"
+#include "CliMetadata.h"
+#include "CliCustomAttribute.h"
 
 namespace peinfo
 {
-	void CheckComError(HRESULT hr)
-	{
-		if (FAILED(hr))
-		{
-			throw std::runtime_error("");
-		}
-	}
-
 	class CustomAttributeReader
 	{
 	public:
-		CustomAttributeReader(void* metadata, ULONG metadataSize)
+		CustomAttributeReader(void* metadata, std::uint32_t metadataSize)
+			: metadataDirectory_(MetadataDirectoryReader().Read(metadata, metadataSize)),
+			decoder_(metadataDirectory_->GetMetadataTables())
 		{
-			CComPtr<IMetaDataDispenser> metadataDispenser;
-			HRESULT hr = CoCreateInstance(CLSID_CorMetaDataDispenser, nullptr, CLSCTX_INPROC_SERVER, IID_IMetaDataDispenser, (void**)&metadataDispenser);
-			CheckComError(hr);
-
-			CComPtr<IUnknown> metadataImportUnknown;
-			hr = metadataDispenser->OpenScopeOnMemory(
-				metadata,
-				metadataSize,
-				CorOpenFlags::ofReadOnly,
-				IID_IMetaDataImport2,
-				&metadataImportUnknown);
-			CheckComError(hr);
-
-			CComQIPtr<IMetaDataImport2, &IID_IMetaDataImport2> metadataImport(metadataImportUnknown);
-			metadataImport_ = metadataImport;
 		}
 
 		std::string GetTargetFramework()
 		{
-			LPCWSTR TargetFrameworkAttribute = L"System.Runtime.Versioning.TargetFrameworkAttribute";
-			const void* blob = 0;
-			ULONG blobSize = 0;
-			HRESULT hr = metadataImport_->GetCustomAttributeByName(TokenFromRid(1, mdtAssembly), TargetFrameworkAttribute, &blob, &blobSize);
-			if (hr == S_FALSE)
+			std::string_view frameworkName;
+			auto found = TryDecodeAssemblyAttribute("System.Runtime.Versioning", "TargetFrameworkAttribute",
+				[&frameworkName](const CustomAttributeArgument& argument, const CustomAttributeValue& value)
+			{
+				// TargetFrameworkAttribute(string frameworkName)
+				if (argument.Kind == CustomAttributeArgumentKind::Fixed && argument.Index == 0 && value.Type == ElementType::String)
+				{
+					frameworkName = value.Text;
+				}
+			});
+
+			if (!found)
 			{
 				return ".NET v3.5 or less";
 			}
-			CheckComError(hr);
-			
-			auto customAttributrMarker = ReadAtOffset<std::uint16_t>(blob, 0);
-			CheckError(customAttributrMarker == 1, "customAttributrMarker");
-
-			auto packedLengthAddress = AddOffset<void>(blob, sizeof(std::uint16_t));
-			auto packedLength = ReadPackedLength(packedLengthAddress);
 
-			auto stringAddress = AddOffset<char>(packedLengthAddress, packedLength.size);
-			return std::string(stringAddress, packedLength.value);
+			return std::string(frameworkName);
 		}
 
 		std::string GetAssemblyVersion()
 		{
-			CComPtr<IMetaDataAssemblyImport> metadataAssemblyImport;
-			HRESULT hr = metadataImport_->QueryInterface(IID_IMetaDataAssemblyImport, (void**)&metadataAssemblyImport);
-			CheckComError(hr);
-
-			ASSEMBLYMETADATA assemblyMetadata{};
-			DWORD flags = 0;
-			hr = metadataAssemblyImport->GetAssemblyProps(
-				TokenFromRid(1, mdtAssembly),
-				NULL,
-				NULL,
-				NULL,
-				NULL,
-				0,
-				NULL,
-				&assemblyMetadata,
-				&flags);
-			CheckComError(hr);
-
-			return std::to_string(assemblyMetadata.usMajorVersion) + "." 
-				+ std::to_string(assemblyMetadata.usMinorVersion) + "." 
-				+ std::to_string(assemblyMetadata.usBuildNumber) + "."
-				+ std::to_string(assemblyMetadata.usRevisionNumber);
-		}
-
-		bool AreOptimizationsDisabled()
-		{
-			LPCWSTR DebuggableAttribute = L"System.Diagnostics.DebuggableAttribute";
-			const void* blob = 0;
-			ULONG blobSize = 0;
-			HRESULT hr = metadataImport_->GetCustomAttributeByName(TokenFromRid(1, mdtAssembly), DebuggableAttribute, &blob, &blobSize);
-			if (hr == S_FALSE)
+			auto assemblyTable = metadataDirectory_->GetMetadataTables().GetAssemblyTable();
+			if (assemblyTable.GetRowCount() == 0)
 			{
-				return false;
+				return std::string();
 			}
-			CheckComError(hr);
 
-			auto customAttributrMarker = ReadAtOffset<std::uint16_t>(blob, 0);
-			CheckError(customAttributrMarker == 1, "customAttributrMarker");
+			return std::to_string(assemblyTable.GetMajorVersion(0)) + "."
+				+ std::to_string(assemblyTable.GetMinorVersion(0)) + "."
+				+ std::to_string(assemblyTable.GetBuildNumber(0)) + "."
+				+ std::to_string(assemblyTable.GetRevisionNumber(0));
+		}
 
+		bool AreOptimizationsDisabled()
+		{
 			const std::uint32_t DisableOptimizations = 1u << 8; // System.Diagnostics.DebuggingModes.DisableOptimizations
-			auto debuggingModes = ReadAtOffset<std::uint32_t>(blob, 2);
-			return IsFlagSet(debuggingModes, DisableOptimizations);
+
+			bool optimizationsDisabled = false;
+			TryDecodeAssemblyAttribute("System.Diagnostics", "DebuggableAttribute",
+				[&optimizationsDisabled](const CustomAttributeArgument& argument, const CustomAttributeValue& value)
+			{
+				if (argument.Kind != CustomAttributeArgumentKind::Fixed)
+				{
+					return;
+				}
+
+				// DebuggableAttribute(DebuggingModes modes)
+				if (argument.Index == 0 && value.Type == ElementType::Enum)
+				{
+					optimizationsDisabled = (value.AsUInt64() & DisableOptimizations) != 0;
+				}
+
+				// DebuggableAttribute(bool isJITTrackingEnabled, bool isJITOptimizerDisabled)
+				if (argument.Index == 1 && value.Type == ElementType::Boolean)
+				{
+					optimizationsDisabled = value.AsBool();
+				}
+			});
+
+			return optimizationsDisabled;
 		}
 
-	private:
-		struct PackedLength
+		// Decodes every assembly level attribute in one pass:
+		// visitor(typeNamespace, typeName, const CustomAttributeArgument&, const CustomAttributeValue&).
+		template<class Visitor>
+		void DecodeAssemblyAttributes(Visitor&& visitor)
 		{
-			std::uint32_t value;
-			std::uint32_t size;
-		};
+			const auto& tables = metadataDirectory_->GetMetadataTables();
+			ForEachCustomAttribute(tables, RowReference{ TableId::Assembly, 1 }, [&](const auto& row)
+			{
+				std::string_view typeNamespace;
+				std::string_view typeName;
+				auto typeIndex = row.Get(CustomAttributeSchema::Type);
+				if (!decoder_.TryGetAttributeTypeName(typeIndex, typeNamespace, typeName))
+				{
+					return;
+				}
+
+				decoder_.Decode(typeIndex, row.GetBlob(CustomAttributeSchema::Value),
+					[&](const CustomAttributeArgument& argument, const CustomAttributeValue& value)
+				{
+					visitor(typeNamespace, typeName, argument, value);
+				});
+			});
+		}
 
-		PackedLength ReadPackedLength(void* address)
+	private:
+		// Equivalent of IMetaDataImport::GetCustomAttributeByName(TokenFromRid(1, mdtAssembly), ...)
+		// followed by decoding the arguments of the first matching attribute.
+		template<class Visitor>
+		bool TryDecodeAssemblyAttribute(std::string_view typeNamespace, std::string_view typeName, Visitor&& visitor)
 		{
-			auto firstByte = ReadAtOffset<std::uint8_t>(address, 0);
-			if ((firstByte & 0x80) == 0)
-			{
-				return PackedLength { firstByte, sizeof(std::uint8_t) };
-			}
+			const auto& tables = metadataDirectory_->GetMetadataTables();
 
-			if ((firstByte & 0xC0) == 0x80)
+			// The attribute type is referenced through a TypeRef, or a TypeDef when the assembly declares it itself.
+			if (tables.GetTypeRefNameIndex().Find(typeNamespace, typeName) == 0
+				&& tables.GetTypeDefNameIndex().Find(typeNamespace, typeName) == 0)
 			{
-				auto value = ReadAtOffset<std::uint16_t>(address, 0);
-				return PackedLength{ value, sizeof(std::uint16_t) };
+				return false;
 			}
 
-			if ((firstByte & 0xE0) == 0xC0)
+			bool found = false;
+			ForEachCustomAttribute(tables, RowReference{ TableId::Assembly, 1 }, [&](const auto& row)
 			{
-				auto value = ReadAtOffset<std::uint32_t>(address, 0);
-				return PackedLength{ value, sizeof(std::uint32_t) };
-			}
-
-			throw std::runtime_error("invalid packed length");
+				std::string_view currentNamespace;
+				std::string_view currentName;
+				auto typeIndex = row.Get(CustomAttributeSchema::Type);
+				if (!decoder_.TryGetAttributeTypeName(typeIndex, currentNamespace, currentName))
+				{
+					return true;
+				}
+
+				if (currentName == typeName && currentNamespace == typeNamespace)
+				{
+					decoder_.Decode(typeIndex, row.GetBlob(CustomAttributeSchema::Value), visitor);
+					found = true;
+					return false;
+				}
+
+				return true;
+			});
+
+			return found;
 		}
 
-
-
-		CComPtr<IMetaDataImport2> metadataImport_;
+		std::unique_ptr<MetadataDirectoryFacade> metadataDirectory_;
+		CustomAttributeDecoder decoder_;
 	};
-}
\ No newline at end of file
+}
@@ -13,6 +13,7 @@ namespace peinfo
 		}
 	}
 
+#ifdef _WIN32
 	void HandleWin32Error(bool errorOccurred)
 	{
 		if (errorOccurred)
@@ -20,88 +21,254 @@ namespace peinfo
 			throw std::system_error(std::error_code(GetLastError(), std::system_category()));
 		}
 	}
+#else
+	void HandlePosixError(bool errorOccurred)
+	{
+		if (errorOccurred)
+		{
+			throw std::system_error(std::error_code(errno, std::generic_category()));
+		}
+	}
+#endif
 
 	void HandleFormatError(bool errorOccurred, const char* message)
 	{
 		if (errorOccurred)
 		{
-			throw std::runtime_error(message);
+			throw FormatException(message);
 		}
 	}
 
-	MappedPeFile::MappedPeFile(std::wstring filePath)
+	std::wstring utf8_to_utf16(const std::string &source)
 	{
-		HANDLE fileHandle = CreateFile(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
-		HandleWin32Error(fileHandle == INVALID_HANDLE_VALUE);
+		if (source.empty()) 
+		{ 
+			return std::wstring(); 
+		}
+
+#ifdef _WIN32
+		int sizeNeeded = MultiByteToWideChar(CP_UTF8, 0, &source[0], (int)source.size(), NULL, 0);
+		CheckError(sizeNeeded != 0, "MultiByteToWideChar failed");
 
-		LARGE_INTEGER fileSize{};
-		BOOL result = GetFileSizeEx(fileHandle, &fileSize);
-		HandleWin32Error(result == FALSE);
+		std::wstring result(sizeNeeded, 0);
+		auto charsWritten = MultiByteToWideChar(CP_UTF8, 0, &source[0], (int)source.size(), &result[0], sizeNeeded);
+		CheckError(charsWritten != 0, "MultiByteToWideChar failed");
 
-		HANDLE fileMappingHandle = CreateFileMapping(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
-		HandleWin32Error(fileMappingHandle == nullptr);
+		return result;
+#else
+		std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
+		return converter.from_bytes(source);
+#endif
+	}
+
+	std::string utf16_to_utf8(const std::wstring &source)
+	{
+		if (source.empty())
+		{
+			return std::string();
+		}
 
-		base_ = MapViewOfFile(fileMappingHandle, FILE_MAP_READ, 0, 0, 0);
-		HandleWin32Error(base_ == nullptr);
+#ifdef _WIN32
+		int sizeNeeded = WideCharToMultiByte(CP_UTF8, 0, &source[0], (int)source.size(), NULL, 0, NULL, NULL);
+		CheckError(sizeNeeded != 0, "WideCharToMultiByte failed");
 
-		result = CloseHandle(fileMappingHandle);
-		HandleWin32Error(result == FALSE);
+		std::string result(sizeNeeded, 0);
+		auto bytesWritten = WideCharToMultiByte(CP_UTF8, 0, &source[0], (int)source.size(), &result[0], sizeNeeded, NULL, NULL);
+		CheckError(bytesWritten != 0, "WideCharToMultiByte failed");
 
-		result = CloseHandle(fileHandle);
-		HandleWin32Error(result == FALSE);
+		return result;
+#else
+		std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
+		return converter.to_bytes(source);
+#endif
+	}
+
+#ifdef _WIN32
+	std::wstring native_path_to_utf16(const std::string& source)
+	{
+		return utf8_to_utf16(source);
 	}
 
-	MappedPeFile::~MappedPeFile()
+	std::string utf16_to_native_path(const std::wstring& source)
+	{
+		return utf16_to_utf8(source);
+	}
+#else
+	std::wstring native_path_to_utf16(const std::string& source)
 	{
-		if (base_ != nullptr)
+		std::wstring result;
+		result.reserve(source.size());
+		for (std::size_t i = 0; i < source.size();)
 		{
-			UnmapViewOfFile(base_);
+			auto byte = static_cast<unsigned char>(source[i]);
+			if (byte < 0x80)
+			{
+				result.push_back(static_cast<wchar_t>(byte));
+				++i;
+				continue;
+			}
+
+			// The range of the second byte excludes overlong forms, surrogates and code points past U+10FFFF
+			std::size_t length = 0;
+			std::uint32_t codePoint = 0;
+			unsigned char secondMin = 0x80;
+			unsigned char secondMax = 0xBF;
+			if (byte >= 0xC2 && byte <= 0xDF)
+			{
+				length = 2;
+				codePoint = byte & 0x1F;
+			}
+			else if (byte >= 0xE0 && byte <= 0xEF)
+			{
+				length = 3;
+				codePoint = byte & 0x0F;
+				secondMin = byte == 0xE0 ? 0xA0 : 0x80;
+				secondMax = byte == 0xED ? 0x9F : 0xBF;
+			}
+			else if (byte >= 0xF0 && byte <= 0xF4)
+			{
+				length = 4;
+				codePoint = byte & 0x07;
+				secondMin = byte == 0xF0 ? 0x90 : 0x80;
+				secondMax = byte == 0xF4 ? 0x8F : 0xBF;
+			}
+
+			bool isValid = length != 0 && source.size() - i >= length;
+			for (std::size_t j = 1; isValid && j < length; ++j)
+			{
+				auto continuation = static_cast<unsigned char>(source[i + j]);
+				isValid = j == 1 ? continuation >= secondMin && continuation <= secondMax : (continuation & 0xC0) == 0x80;
+				codePoint = (codePoint << 6) | (continuation & 0x3F);
+			}
+
+			if (isValid)
+			{
+				result.push_back(static_cast<wchar_t>(codePoint));
+				i += length;
+			}
+			else
+			{
+				result.push_back(static_cast<wchar_t>(0xDC00 + byte));
+				++i;
+			}
 		}
+
+		return result;
 	}
 
-	LPVOID MappedPeFile::GetBaseAddress()
+	std::string utf16_to_native_path(const std::wstring& source)
 	{
-		return base_;
+		std::string result;
+		result.reserve(source.size());
+		for (auto character : source)
+		{
+			auto codePoint = static_cast<std::uint32_t>(character);
+			if (codePoint >= 0xDC80 && codePoint <= 0xDCFF)
+			{
+				result.push_back(static_cast<char>(codePoint - 0xDC00));
+				continue;
+			}
+
+			if ((codePoint >= 0xD800 && codePoint < 0xE000) || codePoint > 0x10FFFF)
+			{
+				codePoint = 0xFFFD;
+			}
+
+			if (codePoint < 0x80)
+			{
+				result.push_back(static_cast<char>(codePoint));
+			}
+			else if (codePoint < 0x800)
+			{
+				result.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+				result.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+			}
+			else if (codePoint < 0x10000)
+			{
+				result.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+				result.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+				result.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+			}
+			else
+			{
+				result.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+				result.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+				result.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+				result.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+			}
+		}
+
+		return result;
 	}
+#endif
 
 	PeFileInfoExtractor::PeFileInfoExtractor(std::wstring filePath)
-		: filePath_(filePath), mappedPeFile_(filePath)
+		: PeFileInfoExtractor(OpenPeImage(filePath, IoOptions()))
 	{
-		PIMAGE_DOS_HEADER imageDosHeader = (PIMAGE_DOS_HEADER)mappedPeFile_.GetBaseAddress();
+	}
+
+	PeFileInfoExtractor::PeFileInfoExtractor(Span<const std::uint8_t> image)
+		: PeFileInfoExtractor(std::make_unique<MemoryPeImage>(image))
+	{
+	}
+
+	PeFileInfoExtractor::PeFileInfoExtractor(std::unique_ptr<PeImageSource> image)
+		: image_(std::move(image))
+	{
+		auto fileSize = image_->GetSize();
+		HandleFormatError(fileSize < sizeof(IMAGE_DOS_HEADER), "File is too small to contain IMAGE_DOS_HEADER");
+
+		auto imageDosHeader = static_cast<const IMAGE_DOS_HEADER*>(image_->GetData(0, sizeof(IMAGE_DOS_HEADER)));
 		HandleFormatError(imageDosHeader->e_magic != IMAGE_DOS_SIGNATURE, "No IMAGE_DOS_SIGNATURE present");
 
-		imageNtHeaders_ = (IMAGE_NT_HEADERS_3264*)(((uint8_t*)imageDosHeader) + imageDosHeader->e_lfanew);
-		HandleFormatError(imageNtHeaders_->Signature != IMAGE_NT_SIGNATURE, "No IMAGE_NT_SIGNATURE present");
+		auto ntHeadersOffset = static_cast<std::uint64_t>(imageDosHeader->e_lfanew);
+		auto ntHeadersEnd = ntHeadersOffset + offsetof(IMAGE_NT_HEADERS_3264, OptionalHeader32) + sizeof(IMAGE_OPTIONAL_HEADER32);
+		HandleFormatError(imageDosHeader->e_lfanew < 0 || ntHeadersEnd > fileSize, "IMAGE_NT_HEADERS is outside of the file");
+
+		// A PE32+ optional header is longer than the minimum checked above; bytes past the end
+		// of the file are left zeroed rather than read.
+		auto ntHeadersSize = std::min<std::uint64_t>(sizeof(IMAGE_NT_HEADERS_3264), fileSize - ntHeadersOffset);
+		std::memcpy(&imageNtHeaders_, image_->GetData(ntHeadersOffset, ntHeadersSize), static_cast<std::size_t>(ntHeadersSize));
+		HandleFormatError(imageNtHeaders_.Signature != IMAGE_NT_SIGNATURE, "No IMAGE_NT_SIGNATURE present");
+
+		const auto& fileHeader = imageNtHeaders_.FileHeader;
+		auto sectionsOffset = ntHeadersOffset + offsetof(IMAGE_NT_HEADERS_3264, OptionalHeader32) + fileHeader.SizeOfOptionalHeader;
+		auto sectionsSize = fileHeader.NumberOfSections * sizeof(IMAGE_SECTION_HEADER);
+		HandleFormatError(sectionsOffset + sectionsSize > fileSize, "Section table is outside of the file");
+
+		auto sections = static_cast<const IMAGE_SECTION_HEADER*>(image_->GetData(sectionsOffset, sectionsSize));
+		const auto& optionalHeader = imageNtHeaders_.OptionalHeader32;
+		sectionMap_ = SectionMap(sections, fileHeader.NumberOfSections, optionalHeader.SizeOfHeaders, optionalHeader.FileAlignment, fileSize);
 	}
 
 	WORD PeFileInfoExtractor::GetMachine()
 	{
-		return imageNtHeaders_->FileHeader.Machine;
+		return imageNtHeaders_.FileHeader.Machine;
 	}
 
 	DWORD PeFileInfoExtractor::GetTimeDateStamp()
 	{
-		return imageNtHeaders_->FileHeader.TimeDateStamp;
+		return imageNtHeaders_.FileHeader.TimeDateStamp;
 	}
 
 	WORD PeFileInfoExtractor::GetSubsystem()
 	{
-		return imageNtHeaders_->OptionalHeader32.Subsystem;
+		return imageNtHeaders_.OptionalHeader32.Subsystem;
 	}
 
 	WORD PeFileInfoExtractor::GetLinkerVersion()
 	{
-		return MAKEWORD(imageNtHeaders_->OptionalHeader32.MinorLinkerVersion, imageNtHeaders_->OptionalHeader32.MajorLinkerVersion);
+		return MAKEWORD(imageNtHeaders_.OptionalHeader32.MinorLinkerVersion, imageNtHeaders_.OptionalHeader32.MajorLinkerVersion);
 	}
 
 	bool PeFileInfoExtractor::IsDll()
 	{
-		return (imageNtHeaders_->FileHeader.Characteristics & IMAGE_FILE_DLL) != 0;
+		return (imageNtHeaders_.FileHeader.Characteristics & IMAGE_FILE_DLL) != 0;
 	}
 
 	bool PeFileInfoExtractor::IsPe32Plus()
 	{
-		switch (imageNtHeaders_->OptionalHeader32.Magic)
+		switch (imageNtHeaders_.OptionalHeader32.Magic)
 		{
 		case IMAGE_NT_OPTIONAL_HDR32_MAGIC:
 			return false;
@@ -114,124 +281,248 @@ namespace peinfo
 
 	BuildConfiguration PeFileInfoExtractor::GetBuildConfiguration()
 	{
-		ClrHeaderInfo clrHeaderInfo = GetClrHeaderInfo();
-		if (clrHeaderInfo.IsPresent)
+		if (!buildConfigurationLoaded_)
 		{
-			return clrHeaderInfo.AreOptimizationsDisabled ? BuildConfiguration::Debug : BuildConfiguration::Release;
+			if (HasClrHeader())
+			{
+				buildConfiguration_ = GetClrHeaderInfo().AreOptimizationsDisabled ? BuildConfiguration::Debug : BuildConfiguration::Release;
+			}
+			else
+			{
+				auto versionResource = GetVersionResource();
+				if (versionResource != nullptr && versionResource->HasFixedFileInfo() && IsFlagSet(versionResource->GetFixedFileInfo().dwFileFlagsMask, VS_FF_DEBUG))
+				{
+					buildConfiguration_ = IsFlagSet(versionResource->GetFixedFileInfo().dwFileFlags, VS_FF_DEBUG) ? BuildConfiguration::Debug : BuildConfiguration::Release;
+				}
+			}
+
+			buildConfigurationLoaded_ = true;
 		}
 
-		return peFileVersionInfoProvider_.GetVersionInfo(filePath_).BuildConfiguration;
+		return buildConfiguration_;
 	}
 
-	ClrHeaderInfo PeFileInfoExtractor::GetClrHeaderInfo()
+	const ClrHeaderInfo& PeFileInfoExtractor::GetClrHeaderInfo()
 	{
-		PIMAGE_COR20_HEADER clrHeader;
-		if (!TryGetClrHeader(clrHeader))
+		if (!clrHeaderInfoLoaded_)
 		{
-			return ClrHeaderInfo();
+			clrHeaderInfo_ = ReadClrHeaderInfo();
+			clrHeaderInfoLoaded_ = true;
 		}
 
-		ClrHeaderInfo clrHeaderInfo;
-		clrHeaderInfo.IsPresent = true;
-		clrHeaderInfo.Flags = clrHeader->Flags;
-		clrHeaderInfo.TargetFramework = GetTargetFramework(clrHeader);
-		clrHeaderInfo.AssemblyVersion = GetAssemblyVersion(clrHeader);
-		clrHeaderInfo.AreOptimizationsDisabled = AreOptimizationsDisabled(clrHeader);
-		return clrHeaderInfo;
+		return clrHeaderInfo_;
 	}
 
 	DWORD PeFileInfoExtractor::GetDllCharacteristics()
 	{
-		return imageNtHeaders_->OptionalHeader32.DllCharacteristics;
+		return imageNtHeaders_.OptionalHeader32.DllCharacteristics;
 	}
 
-	PIMAGE_DATA_DIRECTORY PeFileInfoExtractor::GetDataDirectory()
+	bool PeFileInfoExtractor::HasClrHeader()
 	{
-		return IsPe32Plus() ? imageNtHeaders_->OptionalHeader64.DataDirectory : imageNtHeaders_->OptionalHeader32.DataDirectory;
+		return GetClrHeader() != nullptr;
 	}
 
-	PIMAGE_SECTION_HEADER PeFileInfoExtractor::GetSectionHeader()
+	DWORD PeFileInfoExtractor::GetClrFlags()
 	{
-		return (PIMAGE_SECTION_HEADER)((uint8_t*)GetDataDirectory() + IMAGE_NUMBEROF_DIRECTORY_ENTRIES * sizeof(IMAGE_DATA_DIRECTORY));
+		auto clrHeader = GetClrHeader();
+		return clrHeader != nullptr ? clrHeader->Flags : 0;
 	}
 
-	bool PeFileInfoExtractor::TryGetClrHeader(PIMAGE_COR20_HEADER& clrHeader)
+	const ImportTable& PeFileInfoExtractor::GetImports()
 	{
-		IMAGE_DATA_DIRECTORY clrDirectory = GetDataDirectory()[IMAGE_DIRECTORY_ENTRY_COM_DESCRIPTOR];
-		if (clrDirectory.VirtualAddress == 0)
+		if (!importsLoaded_)
 		{
-			clrHeader = nullptr;
-			return false;
+			ImportDirectories directories
+			{
+				GetDataDirectoryEntry(IMAGE_DIRECTORY_ENTRY_IMPORT),
+				GetDataDirectoryEntry(IMAGE_DIRECTORY_ENTRY_DELAY_IMPORT),
+				GetDataDirectoryEntry(IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT)
+			};
+
+			auto imageBase = IsPe32Plus() ? imageNtHeaders_.OptionalHeader64.ImageBase : imageNtHeaders_.OptionalHeader32.ImageBase;
+			imports_ = ImportTable(*image_, sectionMap_, directories, IsPe32Plus(), imageBase);
+			importsLoaded_ = true;
 		}
 
-		clrHeader = (IMAGE_COR20_HEADER*)(((uint8_t*)mappedPeFile_.GetBaseAddress()) + RvaToFileOffset(clrDirectory.VirtualAddress));
+		return imports_;
+	}
 
-		return true;
+	const ExportTable& PeFileInfoExtractor::GetExports()
+	{
+		if (!exportsLoaded_)
+		{
+			exports_ = ExportTable(*image_, sectionMap_, GetDataDirectoryEntry(IMAGE_DIRECTORY_ENTRY_EXPORT));
+			exportsLoaded_ = true;
+		}
+
+		return exports_;
 	}
 
-	std::wstring utf8_to_utf16(const std::string &source)
+	// The directories can be in any order, and the data they refer to can come before them, such as
+	// the module names of delay imports placed at the end of .text, or the CLR metadata of an image
+	// whose resources start its only section. Linkers keep that data in the section of its
+	// directory, so the sections are announced whole, in file order, before any directory is
+	// parsed. The headers are read already.
+	void PeFileInfoExtractor::PrepareDirectorySections()
 	{
-		if (source.empty()) 
-		{ 
-			return std::wstring(); 
+		const DWORD directoryIndexes[] =
+		{
+			IMAGE_DIRECTORY_ENTRY_EXPORT,
+			IMAGE_DIRECTORY_ENTRY_IMPORT,
+			IMAGE_DIRECTORY_ENTRY_RESOURCE,
+			IMAGE_DIRECTORY_ENTRY_DELAY_IMPORT,
+			IMAGE_DIRECTORY_ENTRY_COM_DESCRIPTOR
+		};
+
+		std::vector<std::pair<DWORD, DWORD>> sections;
+		for (auto index : directoryIndexes)
+		{
+			DWORD fileOffset = 0;
+			DWORD size = 0;
+			auto rva = GetDataDirectoryEntry(index).VirtualAddress;
+			if (rva != 0 && sectionMap_.GetSectionRange(rva, fileOffset, size) == RvaLookupStatus::Success && fileOffset != 0)
+			{
+				sections.emplace_back(fileOffset, size);
+			}
 		}
-		
-		int sizeNeeded = MultiByteToWideChar(CP_UTF8, 0, &source[0], (int)source.size(), NULL, 0);
-		CheckError(sizeNeeded != 0, "MultiByteToWideChar failed");
 
-		std::wstring result(sizeNeeded, 0);
-		auto charsWritten = MultiByteToWideChar(CP_UTF8, 0, &source[0], (int)source.size(), &result[0], sizeNeeded);
-		CheckError(charsWritten != 0, "MultiByteToWideChar failed");
+		std::sort(sections.begin(), sections.end());
+		for (const auto& section : sections)
+		{
+			image_->PrepareRandomAccess(section.first, section.second);
+		}
+	}
 
-		return result;
+	const ResourceTree& PeFileInfoExtractor::GetResources()
+	{
+		if (!resourcesLoaded_)
+		{
+			resources_ = ResourceTree(*image_, sectionMap_, GetDataDirectoryEntry(IMAGE_DIRECTORY_ENTRY_RESOURCE));
+			resourcesLoaded_ = true;
+		}
+
+		return resources_;
 	}
 
-	std::wstring PeFileInfoExtractor::GetTargetFramework(PIMAGE_COR20_HEADER clrHeader)
+	const ResourceSummary& PeFileInfoExtractor::GetResourceSummary()
 	{
-		auto metadataStartAddress = AddOffset<void>(mappedPeFile_.GetBaseAddress(), RvaToFileOffset(clrHeader->MetaData.VirtualAddress));
+		if (!resourceSummaryLoaded_)
+		{
+			for (const auto& resource : GetResources().GetResources())
+			{
+				++resourceSummary_.Count;
+				resourceSummary_.TotalSize += resource.Size;
+				if (resource.Size > resourceSummary_.Largest.Size)
+				{
+					resourceSummary_.Largest = resource;
+				}
+			}
+
+			resourceSummaryLoaded_ = true;
+		}
 
-		CustomAttributeReader reader(metadataStartAddress, clrHeader->MetaData.Size);
+		return resourceSummary_;
+	}
 
-		auto targetFramework = reader.GetTargetFramework();
+	const VersionResource* PeFileInfoExtractor::GetVersionResource()
+	{
+		if (!versionResourceLoaded_)
+		{
+			Resource resource;
+			if (GetResources().TryFindFirst(ResourceTypeVersion, resource))
+			{
+				versionResource_ = std::make_unique<VersionResource>(GetResources().GetData(resource));
+			}
 
-		return utf8_to_utf16(targetFramework);
+			versionResourceLoaded_ = true;
+		}
+
+		return versionResource_.get();
 	}
 
-	std::wstring PeFileInfoExtractor::GetAssemblyVersion(PIMAGE_COR20_HEADER clrHeader)
+	const ApplicationManifest* PeFileInfoExtractor::GetManifest()
 	{
-		auto metadataStartAddress = AddOffset<void>(mappedPeFile_.GetBaseAddress(), RvaToFileOffset(clrHeader->MetaData.VirtualAddress));
+		if (!manifestLoaded_)
+		{
+			Resource resource;
+			if (GetResources().TryFindFirst(ResourceTypeManifest, resource))
+			{
+				manifest_ = std::make_unique<ApplicationManifest>(ParseApplicationManifest(GetResources().GetData(resource)));
+			}
 
-		CustomAttributeReader reader(metadataStartAddress, clrHeader->MetaData.Size);
+			manifestLoaded_ = true;
+		}
 
-		auto assemblyVersion = reader.GetAssemblyVersion();
+		return manifest_.get();
+	}
 
-		return utf8_to_utf16(assemblyVersion);
+	PIMAGE_DATA_DIRECTORY PeFileInfoExtractor::GetDataDirectory()
+	{
+		return IsPe32Plus() ? imageNtHeaders_.OptionalHeader64.DataDirectory : imageNtHeaders_.OptionalHeader32.DataDirectory;
 	}
 
-	bool PeFileInfoExtractor::AreOptimizationsDisabled(PIMAGE_COR20_HEADER clrHeader)
+	// Directories past NumberOfRvaAndSizes are not part of the header
+	IMAGE_DATA_DIRECTORY PeFileInfoExtractor::GetDataDirectoryEntry(DWORD index)
 	{
-		auto metadataStartAddress = AddOffset<void>(mappedPeFile_.GetBaseAddress(), RvaToFileOffset(clrHeader->MetaData.VirtualAddress));
+		auto directoryCount = IsPe32Plus() ? imageNtHeaders_.OptionalHeader64.NumberOfRvaAndSizes : imageNtHeaders_.OptionalHeader32.NumberOfRvaAndSizes;
+		return index < directoryCount ? GetDataDirectory()[index] : IMAGE_DATA_DIRECTORY{};
+	}
 
-		CustomAttributeReader reader(metadataStartAddress, clrHeader->MetaData.Size);
+	bool PeFileInfoExtractor::TryGetClrHeader(const IMAGE_COR20_HEADER*& clrHeader)
+	{
+		IMAGE_DATA_DIRECTORY clrDirectory = GetDataDirectoryEntry(IMAGE_DIRECTORY_ENTRY_COM_DESCRIPTOR);
+		if (clrDirectory.VirtualAddress == 0)
+		{
+			clrHeader = nullptr;
+			return false;
+		}
 
-		return reader.AreOptimizationsDisabled();
+		clrHeader = static_cast<const IMAGE_COR20_HEADER*>(image_->GetData(RvaToFileOffset(clrDirectory.VirtualAddress), sizeof(IMAGE_COR20_HEADER)));
+
+		return true;
 	}
 
-	DWORD PeFileInfoExtractor::RvaToFileOffset(DWORD rva)
+	const IMAGE_COR20_HEADER* PeFileInfoExtractor::GetClrHeader()
 	{
-		PIMAGE_SECTION_HEADER sectionsHeader = GetSectionHeader();
+		if (!clrHeaderLoaded_)
+		{
+			TryGetClrHeader(clrHeader_);
+			clrHeaderLoaded_ = true;
+		}
 
-		DWORD fileOffset = 0;
-		for (WORD i = 0; i < imageNtHeaders_->FileHeader.NumberOfSections; i++, sectionsHeader++)
+		return clrHeader_;
+	}
+
+	ClrHeaderInfo PeFileInfoExtractor::ReadClrHeaderInfo()
+	{
+		auto clrHeader = GetClrHeader();
+		if (clrHeader == nullptr)
 		{
-			if (rva >= sectionsHeader->VirtualAddress && rva < (sectionsHeader->VirtualAddress + sectionsHeader->SizeOfRawData))
-			{
-				fileOffset = rva - sectionsHeader->VirtualAddress + sectionsHeader->PointerToRawData;
-				break;
-			}
+			return ClrHeaderInfo();
 		}
 
-		HandleFormatError(fileOffset == 0, "Failed to convert RVA");
+		ClrHeaderInfo clrHeaderInfo;
+		clrHeaderInfo.IsPresent = true;
+		clrHeaderInfo.Flags = clrHeader->Flags;
+
+		auto metadataOffset = RvaToFileOffset(clrHeader->MetaData.VirtualAddress);
+		HandleFormatError(metadataOffset + static_cast<std::uint64_t>(clrHeader->MetaData.Size) > image_->GetSize(), "Metadata is outside of the file");
+
+		auto metadataStartAddress = image_->GetData(metadataOffset, clrHeader->MetaData.Size);
+		// The metadata readers never write through this pointer
+		CustomAttributeReader reader(const_cast<void*>(metadataStartAddress), clrHeader->MetaData.Size);
+
+		clrHeaderInfo.TargetFramework = utf8_to_utf16(reader.GetTargetFramework());
+		clrHeaderInfo.AssemblyVersion = utf8_to_utf16(reader.GetAssemblyVersion());
+		clrHeaderInfo.AreOptimizationsDisabled = reader.AreOptimizationsDisabled();
+		return clrHeaderInfo;
+	}
+
+	DWORD PeFileInfoExtractor::RvaToFileOffset(DWORD rva)
+	{
+		DWORD fileOffset = 0;
+		HandleFormatError(sectionMap_.RvaToFileOffset(rva, fileOffset) != RvaLookupStatus::Success, "Failed to convert RVA");
 		return fileOffset;
 	}
 
@@ -240,8 +531,31 @@ namespace peinfo
 	{
 	}
 
+	PeFileFormattedInfoExtractor::PeFileFormattedInfoExtractor(Span<const std::uint8_t> image)
+		: peFileInfoExtractor_(image)
+	{
+	}
+
+	PeFileFormattedInfoExtractor::PeFileFormattedInfoExtractor(std::unique_ptr<PeImageSource> image)
+		: peFileInfoExtractor_(std::move(image))
+	{
+	}
+
 	PeFileFormattedInfo PeFileFormattedInfoExtractor::Extract()
 	{
+		PeFileRawInfo raw;
+		raw.Machine = peFileInfoExtractor_.GetMachine();
+		raw.TimeDateStamp = peFileInfoExtractor_.GetTimeDateStamp();
+		raw.Subsystem = peFileInfoExtractor_.GetSubsystem();
+		raw.LinkerVersion = peFileInfoExtractor_.GetLinkerVersion();
+		raw.DllCharacteristics = peFileInfoExtractor_.GetDllCharacteristics();
+		raw.IsDll = peFileInfoExtractor_.IsDll();
+		raw.IsPe32Plus = peFileInfoExtractor_.IsPe32Plus();
+
+		// A StreamPeImage only reads forwards, so the sections the directories are in are kept first
+		peFileInfoExtractor_.PrepareDirectorySections();
+		raw.BuildConfiguration = peFileInfoExtractor_.GetBuildConfiguration();
+
 		std::vector<PeFileFormattedInfoCategory> categories;
 
 		PeFileFormattedInfoItem description = { L"Description", GetDescription() };
@@ -249,13 +563,15 @@ namespace peinfo
 		categories.push_back(generalCategory);
 
 		PeFileFormattedInfoItem buildTime = { L"Build time", GetTimeDateStamp() };
-		PeFileFormattedInfoItem configuration = { L"Configuration", GetConfiguration() };
+		PeFileFormattedInfoItem configuration = { L"Configuration", GetConfiguration(raw.BuildConfiguration) };
 		PeFileFormattedInfoItem platform = { L"Platform", GetPlatform() };
 		PeFileFormattedInfoItem toolset = { L"Toolset", GetToolset() };
 		PeFileFormattedInfoCategory buildCategory = { L"Build", { buildTime, configuration, platform, toolset } };
 		categories.push_back(buildCategory);
 
-		ClrHeaderInfo clrHeaderInfo = peFileInfoExtractor_.GetClrHeaderInfo();
+		const ClrHeaderInfo& clrHeaderInfo = peFileInfoExtractor_.GetClrHeaderInfo();
+		raw.IsClr = clrHeaderInfo.IsPresent;
+		raw.ClrFlags = clrHeaderInfo.Flags;
 		if (clrHeaderInfo.IsPresent)
 		{
 			PeFileFormattedInfoItem targetFramework = { L"Target Framework", clrHeaderInfo.TargetFramework };
@@ -264,13 +580,308 @@ namespace peinfo
 			categories.push_back(dotNetCategory);
 		}
 
+		// A malformed directory leaves only its own category empty instead of failing the whole file
+		try
+		{
+			const auto& imports = peFileInfoExtractor_.GetImports();
+			if (!imports.GetModules().empty() || !imports.GetBoundImports().empty())
+			{
+				PeFileFormattedInfoCategory importsCategory = { L"Imports", {} };
+				const std::pair<const wchar_t*, std::wstring> importItems[] =
+				{
+					{ L"Imported Modules", GetImportedModules(false) },
+					{ L"Delay-Loaded Modules", GetImportedModules(true) },
+					{ L"Bound Modules", GetBoundImports() },
+					{ L"Imported Functions", std::to_wstring(imports.GetFunctionCount()) },
+					{ L"Imphash", utf8_to_utf16(imports.GetImphash()) }
+				};
+
+				for (const auto& importItem : importItems)
+				{
+					if (!importItem.second.empty())
+					{
+						importsCategory.Items.push_back(PeFileFormattedInfoItem{ importItem.first, importItem.second });
+					}
+				}
+
+				categories.push_back(importsCategory);
+			}
+		}
+		catch (const FormatException&)
+		{
+			categories.push_back(PeFileFormattedInfoCategory{ L"Imports", {} });
+		}
+
+		try
+		{
+			const auto& exports = peFileInfoExtractor_.GetExports();
+			if (!exports.IsEmpty())
+			{
+				PeFileFormattedInfoCategory exportsCategory = { L"Exports", {} };
+				auto moduleName = exports.GetModuleName();
+				if (!moduleName.empty())
+				{
+					exportsCategory.Items.push_back(PeFileFormattedInfoItem{ L"Export Name", utf8_to_utf16(std::string(moduleName.begin(), moduleName.end())) });
+				}
+
+				exportsCategory.Items.push_back(PeFileFormattedInfoItem{ L"Exported Functions", std::to_wstring(exports.GetFunctionCount()) });
+				exportsCategory.Items.push_back(PeFileFormattedInfoItem{ L"Forwarded Functions", std::to_wstring(exports.GetForwarderCount()) });
+				categories.push_back(exportsCategory);
+			}
+		}
+		catch (const FormatException&)
+		{
+			categories.push_back(PeFileFormattedInfoCategory{ L"Exports", {} });
+		}
+
+		try
+		{
+			auto versionResource = peFileInfoExtractor_.GetVersionResource();
+			if (versionResource != nullptr)
+			{
+				PeFileFormattedInfoCategory versionCategory = { L"Version", {} };
+				if (versionResource->HasFixedFileInfo())
+				{
+					versionCategory.Items.push_back(PeFileFormattedInfoItem{ L"File Version", GetFileVersion(versionResource->GetFixedFileInfo()) });
+				}
+
+				const std::pair<const char16_t*, const wchar_t*> versionStrings[] =
+				{
+					{ u"ProductVersion", L"Product Version" },
+					{ u"CompanyName", L"Company Name" },
+					{ u"ProductName", L"Product Name" },
+					{ u"FileDescription", L"File Description" },
+					{ u"OriginalFilename", L"Original Filename" }
+				};
+
+				for (const auto& versionString : versionStrings)
+				{
+					auto value = GetVersionString(versionString.first);
+					if (!value.empty())
+					{
+						versionCategory.Items.push_back(PeFileFormattedInfoItem{ versionString.second, value });
+					}
+				}
+
+				if (!versionCategory.Items.empty())
+				{
+					categories.push_back(versionCategory);
+				}
+			}
+		}
+		catch (const FormatException&)
+		{
+			categories.push_back(PeFileFormattedInfoCategory{ L"Version", {} });
+		}
+
+		try
+		{
+			const auto& resourceSummary = peFileInfoExtractor_.GetResourceSummary();
+			if (resourceSummary.Count != 0)
+			{
+				PeFileFormattedInfoItem resourceCount = { L"Resource Count", std::to_wstring(resourceSummary.Count) };
+				PeFileFormattedInfoItem resourceSize = { L"Resource Size", std::to_wstring(resourceSummary.TotalSize) + L" bytes" };
+				PeFileFormattedInfoItem largestResource = { L"Largest Resource", GetLargestResource() };
+				PeFileFormattedInfoCategory resourcesCategory = { L"Resources", { resourceCount, resourceSize, largestResource } };
+
+				// A malformed manifest only leaves out the items read from it
+				try
+				{
+					if (peFileInfoExtractor_.GetManifest() != nullptr)
+					{
+						auto executionLevel = GetExecutionLevel();
+						if (!executionLevel.empty())
+						{
+							resourcesCategory.Items.push_back(PeFileFormattedInfoItem{ L"Execution Level", executionLevel });
+						}
+
+						auto dependencies = GetDependencies();
+						if (!dependencies.empty())
+						{
+							resourcesCategory.Items.push_back(PeFileFormattedInfoItem{ L"Dependencies", dependencies });
+						}
+					}
+				}
+				catch (const FormatException&)
+				{
+				}
+
+				categories.push_back(resourcesCategory);
+			}
+		}
+		catch (const FormatException&)
+		{
+			categories.push_back(PeFileFormattedInfoCategory{ L"Resources", {} });
+		}
+
 		PeFileFormattedInfoItem depStatus = { L"DEP", GetDepStatus() };
 		PeFileFormattedInfoItem aslrStatus = { L"ASLR", GetAslrStatus() };
 		PeFileFormattedInfoItem cfgStatus = { L"CFG", GetCfgStatus() };
 		PeFileFormattedInfoCategory securityCategory = { L"Security", { depStatus, aslrStatus, cfgStatus } };
 		categories.push_back(securityCategory);
 
-		return PeFileFormattedInfo { categories };
+		return PeFileFormattedInfo { categories, raw };
+	}
+
+	bool PeFileFormattedInfoExtractor::TryExtract(const ExtractionPlan& plan, PeFileFormattedInfo& info)
+	{
+		for (const auto& predicate : plan.GetPredicates())
+		{
+			if (!Matches(predicate))
+			{
+				return false;
+			}
+		}
+
+		if (plan.SelectsAllFields())
+		{
+			info = Extract();
+			return true;
+		}
+
+		PeFileFormattedInfoCategory fieldsCategory = { L"Fields", {} };
+		for (auto field : plan.GetFields())
+		{
+			fieldsCategory.Items.push_back(PeFileFormattedInfoItem{ GetInfoFieldName(field), FormatField(field) });
+		}
+
+		info = PeFileFormattedInfo{ { fieldsCategory }, PeFileRawInfo(), true };
+		return true;
+	}
+
+	bool PeFileFormattedInfoExtractor::Matches(const PlannedPredicate& predicate)
+	{
+		// exports=<symbol> asks whether the image exports the symbol, which is a lookup rather than a comparison with the list
+		if (predicate.Field == InfoField::Exports && (predicate.Operator == PredicateOperator::Equal || predicate.Operator == PredicateOperator::NotEqual))
+		{
+			Export exported;
+			auto isExported = peFileInfoExtractor_.GetExports().TryFind(Span<const char>(predicate.Text.data(), predicate.Text.size()), exported);
+			return isExported == (predicate.Operator == PredicateOperator::Equal);
+		}
+
+		switch (GetInfoFieldKind(predicate.Field))
+		{
+		case InfoFieldKind::Flag:
+			return MatchesFlag(GetFlagField(predicate.Field), predicate.Operator, predicate.Flag);
+		case InfoFieldKind::Number:
+			return MatchesNumber(GetNumberField(predicate.Field), predicate.Operator, predicate.Number);
+		default:
+		{
+			auto text = utf16_to_utf8(GetTextField(predicate.Field));
+			return MatchesText(Span<const char>(text.data(), text.size()), predicate.Operator, Span<const char>(predicate.Text.data(), predicate.Text.size()));
+		}
+		}
+	}
+
+	std::wstring PeFileFormattedInfoExtractor::GetTextField(InfoField field)
+	{
+		switch (field)
+		{
+		case InfoField::Description:
+			return GetDescription();
+		case InfoField::Machine:
+			return GetMachine();
+		case InfoField::Platform:
+			return GetPlatform();
+		case InfoField::Toolset:
+			return GetToolset();
+		case InfoField::Framework:
+			return peFileInfoExtractor_.HasClrHeader() ? peFileInfoExtractor_.GetClrHeaderInfo().TargetFramework : std::wstring();
+		case InfoField::AssemblyVersion:
+			return peFileInfoExtractor_.HasClrHeader() ? peFileInfoExtractor_.GetClrHeaderInfo().AssemblyVersion : std::wstring();
+		case InfoField::Configuration:
+			return GetConfiguration(peFileInfoExtractor_.GetBuildConfiguration());
+		case InfoField::FileVersion:
+		{
+			auto versionResource = peFileInfoExtractor_.GetVersionResource();
+			return versionResource != nullptr && versionResource->HasFixedFileInfo() ? GetFileVersion(versionResource->GetFixedFileInfo()) : std::wstring();
+		}
+		case InfoField::ProductVersion:
+			return GetVersionString(u"ProductVersion");
+		case InfoField::Company:
+			return GetVersionString(u"CompanyName");
+		case InfoField::Product:
+			return GetVersionString(u"ProductName");
+		case InfoField::ExecutionLevel:
+			return GetExecutionLevel();
+		case InfoField::Imports:
+			return GetImportedModules(false);
+		case InfoField::DelayImports:
+			return GetImportedModules(true);
+		case InfoField::Imphash:
+			return utf8_to_utf16(peFileInfoExtractor_.GetImports().GetImphash());
+		case InfoField::Exports:
+			return GetExportedNames();
+		case InfoField::ExportName:
+		{
+			auto moduleName = peFileInfoExtractor_.GetExports().GetModuleName();
+			return utf8_to_utf16(std::string(moduleName.begin(), moduleName.end()));
+		}
+		default:
+			throw std::logic_error("Not a text field");
+		}
+	}
+
+	bool PeFileFormattedInfoExtractor::GetFlagField(InfoField field)
+	{
+		auto dllCharacteristics = peFileInfoExtractor_.GetDllCharacteristics();
+		switch (field)
+		{
+		case InfoField::Dep:
+			return IsFlagSet(dllCharacteristics, IMAGE_DLLCHARACTERISTICS_NX_COMPAT);
+		case InfoField::Aslr:
+			return IsFlagSet(dllCharacteristics, IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE);
+		case InfoField::HighEntropyVa:
+			return IsFlagSet(dllCharacteristics, IMAGE_DLLCHARACTERISTICS_HIGH_ENTROPY_VA);
+		case InfoField::Cfg:
+			return IsFlagSet(dllCharacteristics, IMAGE_DLLCHARACTERISTICS_GUARD_CF);
+		case InfoField::Dll:
+			return peFileInfoExtractor_.IsDll();
+		case InfoField::Clr:
+			return peFileInfoExtractor_.HasClrHeader();
+		case InfoField::Pe32Plus:
+			return peFileInfoExtractor_.IsPe32Plus();
+		default:
+			throw std::logic_error("Not a flag field");
+		}
+	}
+
+	std::uint64_t PeFileFormattedInfoExtractor::GetNumberField(InfoField field)
+	{
+		switch (field)
+		{
+		case InfoField::Timestamp:
+			return peFileInfoExtractor_.GetTimeDateStamp();
+		case InfoField::Subsystem:
+			return peFileInfoExtractor_.GetSubsystem();
+		case InfoField::Linker:
+			return peFileInfoExtractor_.GetLinkerVersion();
+		case InfoField::ImportCount:
+			return peFileInfoExtractor_.GetImports().GetFunctionCount();
+		case InfoField::ExportCount:
+			return peFileInfoExtractor_.GetExports().GetFunctionCount();
+		case InfoField::ForwarderCount:
+			return peFileInfoExtractor_.GetExports().GetForwarderCount();
+		case InfoField::ResourceCount:
+			return peFileInfoExtractor_.GetResourceSummary().Count;
+		case InfoField::ResourceSize:
+			return peFileInfoExtractor_.GetResourceSummary().TotalSize;
+		default:
+			throw std::logic_error("Not a number field");
+		}
+	}
+
+	std::wstring PeFileFormattedInfoExtractor::FormatField(InfoField field)
+	{
+		switch (GetInfoFieldKind(field))
+		{
+		case InfoFieldKind::Flag:
+			return GetFlagField(field) ? L"Yes" : L"No";
+		case InfoFieldKind::Number:
+			return std::to_wstring(GetNumberField(field));
+		default:
+			return GetTextField(field);
+		}
 	}
 
 	std::wstring PeFileFormattedInfoExtractor::GetDescription()
@@ -305,9 +916,18 @@ namespace peinfo
 		return GetSubsystem();		
 	}
 
+	PeFileInfoExtractor& PeFileFormattedInfoExtractor::GetInfoExtractor()
+	{
+		return peFileInfoExtractor_;
+	}
+
 	std::wstring PeFileFormattedInfoExtractor::GetMachine()
 	{
-		WORD machine = peFileInfoExtractor_.GetMachine();
+		return FormatMachine(peFileInfoExtractor_.GetMachine());
+	}
+
+	std::wstring PeFileFormattedInfoExtractor::FormatMachine(WORD machine)
+	{
 		switch (machine)
 		{
 		case IMAGE_FILE_MACHINE_I386:
@@ -381,15 +1001,15 @@ namespace peinfo
 			return L"64-bit (" + GetMachine() + L")";
 		}
 
-		ClrHeaderInfo clrHeaderInfo = peFileInfoExtractor_.GetClrHeaderInfo();
-		if (clrHeaderInfo.IsPresent && IsFlagSet(clrHeaderInfo.Flags, COMIMAGE_FLAGS_ILONLY))
+		auto clrFlags = peFileInfoExtractor_.GetClrFlags();
+		if (peFileInfoExtractor_.HasClrHeader() && IsFlagSet(clrFlags, COMIMAGE_FLAGS_ILONLY))
 		{
-			if (IsFlagSet(clrHeaderInfo.Flags, COMIMAGE_FLAGS_32BITPREFERRED))
+			if (IsFlagSet(clrFlags, COMIMAGE_FLAGS_32BITPREFERRED))
 			{
 				return L"Any CPU 32-bit preferred";
 			}
 
-			if (!IsFlagSet(clrHeaderInfo.Flags, COMIMAGE_FLAGS_32BITREQUIRED))
+			if (!IsFlagSet(clrFlags, COMIMAGE_FLAGS_32BITREQUIRED))
 			{
 				return L"Any CPU";
 			}			
@@ -402,8 +1022,12 @@ namespace peinfo
 	{
 		time_t timeDateStamp = peFileInfoExtractor_.GetTimeDateStamp();
 		std::tm tm{};
+#ifdef _WIN32
 		errno_t e = localtime_s(&tm, &timeDateStamp);
 		if (e != 0)
+#else
+		if (localtime_r(&timeDateStamp, &tm) == nullptr)
+#endif
 		{
 			return L"INVALID";
 		}
@@ -526,9 +1150,8 @@ namespace peinfo
 		return versionString + L" (" + toolsetName + L")";
 	}
 
-	std::wstring PeFileFormattedInfoExtractor::GetConfiguration()
+	std::wstring PeFileFormattedInfoExtractor::GetConfiguration(BuildConfiguration configuration)
 	{
-		BuildConfiguration configuration = peFileInfoExtractor_.GetBuildConfiguration();
 		switch (configuration)
 		{
 		case BuildConfiguration::Debug:
@@ -540,6 +1163,129 @@ namespace peinfo
 		}
 	}
 
+	std::wstring PeFileFormattedInfoExtractor::GetFileVersion(const VS_FIXEDFILEINFO& fixedFileInfo)
+	{
+		return std::to_wstring(fixedFileInfo.dwFileVersionMS >> 16) + L"." + std::to_wstring(fixedFileInfo.dwFileVersionMS & 0xFFFF) + L"."
+			+ std::to_wstring(fixedFileInfo.dwFileVersionLS >> 16) + L"." + std::to_wstring(fixedFileInfo.dwFileVersionLS & 0xFFFF);
+	}
+
+	std::wstring PeFileFormattedInfoExtractor::GetVersionString(const char16_t* key)
+	{
+		auto versionResource = peFileInfoExtractor_.GetVersionResource();
+		return versionResource != nullptr ? Utf16ToWString(versionResource->GetString(key)) : std::wstring();
+	}
+
+	// Module names are ASCII in practice; other bytes are taken as Latin-1
+	std::wstring PeFileFormattedInfoExtractor::GetImportedModules(bool isDelayLoaded)
+	{
+		std::wstring modules;
+		for (const auto& module : peFileInfoExtractor_.GetImports().GetModules())
+		{
+			if (module.IsDelayLoaded != isDelayLoaded)
+			{
+				continue;
+			}
+
+			if (!modules.empty())
+			{
+				modules += L", ";
+			}
+
+			std::transform(module.Name.begin(), module.Name.end(), std::back_inserter(modules), [](char c)
+			{
+				return static_cast<wchar_t>(static_cast<unsigned char>(c));
+			});
+		}
+
+		return modules;
+	}
+
+	std::wstring PeFileFormattedInfoExtractor::GetBoundImports()
+	{
+		std::wstring modules;
+		for (const auto& boundImport : peFileInfoExtractor_.GetImports().GetBoundImports())
+		{
+			if (!modules.empty())
+			{
+				modules += L", ";
+			}
+
+			std::transform(boundImport.Name.begin(), boundImport.Name.end(), std::back_inserter(modules), [](char c)
+			{
+				return static_cast<wchar_t>(static_cast<unsigned char>(c));
+			});
+		}
+
+		return modules;
+	}
+
+	// Export names are ASCII in practice; other bytes are taken as Latin-1
+	std::wstring PeFileFormattedInfoExtractor::GetExportedNames()
+	{
+		std::wstring names;
+		for (const auto& exported : peFileInfoExtractor_.GetExports().GetNamedExports())
+		{
+			if (!names.empty())
+			{
+				names += L", ";
+			}
+
+			std::transform(exported.Name.begin(), exported.Name.end(), std::back_inserter(names), [](char c)
+			{
+				return static_cast<wchar_t>(static_cast<unsigned char>(c));
+			});
+		}
+
+		return names;
+	}
+
+	std::wstring PeFileFormattedInfoExtractor::GetLargestResource()
+	{
+		const wchar_t* const typeNames[] =
+		{
+			nullptr, L"RT_CURSOR", L"RT_BITMAP", L"RT_ICON", L"RT_MENU", L"RT_DIALOG", L"RT_STRING", L"RT_FONTDIR", L"RT_FONT",
+			L"RT_ACCELERATOR", L"RT_RCDATA", L"RT_MESSAGETABLE", L"RT_GROUP_CURSOR", nullptr, L"RT_GROUP_ICON", nullptr,
+			L"RT_VERSION", L"RT_DLGINCLUDE", nullptr, L"RT_PLUGPLAY", L"RT_VXD", L"RT_ANICURSOR", L"RT_ANIICON", L"RT_HTML", L"RT_MANIFEST"
+		};
+
+		auto formatKey = [](const ResourceKey& key) { return key.IsName ? L"\"" + Utf16ToWString(key.Name) + L"\"" : std::to_wstring(key.Id); };
+
+		const auto& largest = peFileInfoExtractor_.GetResourceSummary().Largest;
+		auto type = !largest.Type.IsName && largest.Type.Id < std::size(typeNames) && typeNames[largest.Type.Id] != nullptr
+			? std::wstring(typeNames[largest.Type.Id]) : formatKey(largest.Type);
+
+		return type + L" " + formatKey(largest.Name) + L", " + std::to_wstring(largest.Size) + L" bytes";
+	}
+
+	std::wstring PeFileFormattedInfoExtractor::GetExecutionLevel()
+	{
+		auto manifest = peFileInfoExtractor_.GetManifest();
+		if (manifest == nullptr || manifest->RequestedExecutionLevel.empty())
+		{
+			return std::wstring();
+		}
+
+		auto executionLevel = utf8_to_utf16(manifest->RequestedExecutionLevel);
+		return manifest->UiAccess ? executionLevel + L" (UI Access)" : executionLevel;
+	}
+
+	std::wstring PeFileFormattedInfoExtractor::GetDependencies()
+	{
+		auto manifest = peFileInfoExtractor_.GetManifest();
+		std::wstring dependencies;
+		for (const auto& dependency : manifest != nullptr ? manifest->Dependencies : std::vector<std::string>())
+		{
+			if (!dependencies.empty())
+			{
+				dependencies += L", ";
+			}
+
+			dependencies += utf8_to_utf16(dependency);
+		}
+
+		return dependencies;
+	}
+
 	std::wstring PeFileFormattedInfoExtractor::GetDepStatus()
 	{
 		return IsFlagSet(peFileInfoExtractor_.GetDllCharacteristics(), IMAGE_DLLCHARACTERISTICS_NX_COMPAT)
@@ -568,39 +1314,4 @@ namespace peinfo
 			? L"Yes"
 			: L"No";
 	}
-
-	PeFileVersionInfo PeFileVersionInfoProvider::GetVersionInfo(std::wstring filePath)
-	{
-		PeFileVersionInfo versionInfo;
-
-		DWORD versionInfoSize = GetFileVersionInfoSize(filePath.c_str(), nullptr);
-		if (versionInfoSize == 0)
-		{
-			return versionInfo;
-		}
-
-		std::vector<std::uint8_t> buffer(versionInfoSize);
-		BOOL result = GetFileVersionInfo(filePath.c_str(), 0, versionInfoSize, buffer.data());
-		if (result == FALSE)
-		{
-			return versionInfo;
-		}
-
-		VS_FIXEDFILEINFO* pFixedFileInfo = nullptr;
-		UINT fixedFileInfoSize = 0;
-		result = VerQueryValue(buffer.data(), L"\\", (LPVOID*)&pFixedFileInfo, &fixedFileInfoSize);
-		if (result == FALSE || fixedFileInfoSize == 0)
-		{
-			return versionInfo;
-		}
-
-		if (pFixedFileInfo->dwFileFlagsMask & VS_FF_DEBUG)
-		{
-			versionInfo.BuildConfiguration = ((pFixedFileInfo->dwFileFlags & VS_FF_DEBUG) != 0) 
-				? BuildConfiguration::Debug 
-				: BuildConfiguration::Release;
-		}
-
-		return versionInfo;
-	}
 }
@@ -1,4 +1,16 @@
 #pragma once
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "SectionMap.h"
+#include "PeImageSource.h"
+#include "ExtractionPlan.h"
+#include "VersionResource.h"
+#include "ResourceTree.h"
+#include "ApplicationManifest.h"
+#include "ImportTable.h"
+#include "ExportTable.h"
 
 namespace peinfo
 {
@@ -14,21 +26,33 @@ namespace peinfo
 
 	void HandleLogicError(bool errorOccurred, const char* message);
 
+#ifdef _WIN32
 	void HandleWin32Error(bool errorOccurred);
+#else
+	void HandlePosixError(bool errorOccurred);
+#endif
 
-	void HandleFormatError(bool errorOccurred, const char* message);
-
-	class MappedPeFile
+	// Thrown by HandleFormatError for malformed input, as opposed to failures to read it
+	class FormatException : public std::runtime_error
 	{
 	public:
-		MappedPeFile(std::wstring filePath);
-		~MappedPeFile();
+		explicit FormatException(const char* message)
+			: std::runtime_error(message)
+		{
+		}
+	};
 
-		LPVOID GetBaseAddress();
+	void HandleFormatError(bool errorOccurred, const char* message);
 
-	private:
-		LPVOID base_ = nullptr;
-	};
+	std::wstring utf8_to_utf16(const std::string& source);
+	std::string utf16_to_utf8(const std::wstring& source);
+
+	// File names are bytes on POSIX and need not be UTF-8. Bytes that are not part of a valid
+	// UTF-8 sequence become U+DC80..U+DCFF, which valid UTF-8 never decodes to, and turn back
+	// into the same bytes, so every name survives the round trip. On Windows these are the
+	// conversions above.
+	std::wstring native_path_to_utf16(const std::string& source);
+	std::string utf16_to_native_path(const std::wstring& source);
 
 	enum class BuildConfiguration
 	{
@@ -37,26 +61,10 @@ namespace peinfo
 		Release
 	};
 
-	struct PeFileVersionInfo
-	{
-		PeFileVersionInfo()
-			: BuildConfiguration(BuildConfiguration::Unknown)
-		{
-		}
-
-		BuildConfiguration BuildConfiguration;
-	};
-
-	class PeFileVersionInfoProvider
-	{
-	public:
-		PeFileVersionInfo GetVersionInfo(std::wstring filePath);
-	};
-
 	struct ClrHeaderInfo
 	{
 		ClrHeaderInfo()
-			: IsPresent(false), Flags(0)
+			: IsPresent(false), Flags(0), AreOptimizationsDisabled(false)
 		{
 		}
 
@@ -67,10 +75,24 @@ namespace peinfo
 		bool AreOptimizationsDisabled;
 	};
 
+	// Totals over the leaves of the resource tree, taken from the data entries without reading the data
+	struct ResourceSummary
+	{
+		DWORD Count = 0;
+		std::uint64_t TotalSize = 0;
+		Resource Largest{};   // all zero when there are no resources
+	};
+
 	class PeFileInfoExtractor
 	{
 	public:
 		PeFileInfoExtractor(std::wstring filePath);
+		// The image must outlive the extractor.
+		PeFileInfoExtractor(Span<const std::uint8_t> image);
+		PeFileInfoExtractor(std::unique_ptr<PeImageSource> image);
+
+		// The import and export tables and the resource tree point at the section map
+		DECLARE_NONCOPYABLE(PeFileInfoExtractor);
 
 		WORD GetMachine();
 		DWORD GetTimeDateStamp();
@@ -79,22 +101,62 @@ namespace peinfo
 		bool IsDll();
 		bool IsPe32Plus();
 		BuildConfiguration GetBuildConfiguration();
-		ClrHeaderInfo GetClrHeaderInfo();
+		const ClrHeaderInfo& GetClrHeaderInfo();
 		DWORD GetDllCharacteristics();
 
+		// Read only the CLR header, not the metadata GetClrHeaderInfo parses
+		bool HasClrHeader();
+		DWORD GetClrFlags();
+
+		// The import, delay import and bound import directories
+		const ImportTable& GetImports();
+
+		// Empty when the image exports nothing
+		const ExportTable& GetExports();
+
+		// Announces the sections that hold the directories the extractor parses, so that a source
+		// that only reads forwards can provide them in any order. Call before reading past the headers.
+		void PrepareDirectorySections();
+
+		// Empty when the image has no resources
+		const ResourceTree& GetResources();
+		const ResourceSummary& GetResourceSummary();
+
+		// The first RT_VERSION resource, or null when the image has none
+		const VersionResource* GetVersionResource();
+
+		// The first RT_MANIFEST resource, or null when the image has none
+		const ApplicationManifest* GetManifest();
+
 	private:
 		PIMAGE_DATA_DIRECTORY GetDataDirectory();
-		PIMAGE_SECTION_HEADER GetSectionHeader();
-		bool TryGetClrHeader(PIMAGE_COR20_HEADER& clrHeader);
-		std::wstring GetTargetFramework(PIMAGE_COR20_HEADER clrHeader);
-		std::wstring GetAssemblyVersion(PIMAGE_COR20_HEADER clrHeader);
-		bool AreOptimizationsDisabled(PIMAGE_COR20_HEADER clrHeader);
+		IMAGE_DATA_DIRECTORY GetDataDirectoryEntry(DWORD index);
+		bool TryGetClrHeader(const IMAGE_COR20_HEADER*& clrHeader);
+		const IMAGE_COR20_HEADER* GetClrHeader();
+		ClrHeaderInfo ReadClrHeaderInfo();
 		DWORD RvaToFileOffset(DWORD rva);
 
-		std::wstring filePath_;
-		MappedPeFile mappedPeFile_;
-		IMAGE_NT_HEADERS_3264* imageNtHeaders_;
-		PeFileVersionInfoProvider peFileVersionInfoProvider_;
+		std::unique_ptr<PeImageSource> image_;
+		IMAGE_NT_HEADERS_3264 imageNtHeaders_{};
+		SectionMap sectionMap_;
+		bool buildConfigurationLoaded_ = false;
+		BuildConfiguration buildConfiguration_ = BuildConfiguration::Unknown;
+		bool clrHeaderLoaded_ = false;
+		const IMAGE_COR20_HEADER* clrHeader_ = nullptr;
+		bool clrHeaderInfoLoaded_ = false;
+		ClrHeaderInfo clrHeaderInfo_;
+		bool importsLoaded_ = false;
+		ImportTable imports_;
+		bool exportsLoaded_ = false;
+		ExportTable exports_;
+		bool resourcesLoaded_ = false;
+		ResourceTree resources_;
+		bool resourceSummaryLoaded_ = false;
+		ResourceSummary resourceSummary_;
+		bool versionResourceLoaded_ = false;
+		std::unique_ptr<VersionResource> versionResource_;
+		bool manifestLoaded_ = false;
+		std::unique_ptr<ApplicationManifest> manifest_;
 	};
 
 	struct PeFileFormattedInfoItem
@@ -109,18 +171,55 @@ namespace peinfo
 		std::vector<PeFileFormattedInfoItem> Items;
 	};
 
+	// The values the formatted items are made from, for output that is read by programs
+	struct PeFileRawInfo
+	{
+		PeFileRawInfo()
+			: Machine(0), TimeDateStamp(0), Subsystem(0), LinkerVersion(0), DllCharacteristics(0),
+			IsDll(false), IsPe32Plus(false), BuildConfiguration(BuildConfiguration::Unknown), IsClr(false), ClrFlags(0)
+		{
+		}
+
+		WORD Machine;
+		DWORD TimeDateStamp;
+		WORD Subsystem;
+		WORD LinkerVersion;
+		DWORD DllCharacteristics;
+		bool IsDll;
+		bool IsPe32Plus;
+		peinfo::BuildConfiguration BuildConfiguration;
+		bool IsClr;
+		DWORD ClrFlags;
+	};
+
 	struct PeFileFormattedInfo
 	{
 		std::vector<PeFileFormattedInfoCategory> Categories;
+		PeFileRawInfo Raw;
+
+		// Set when an ExtractionPlan selected some of the fields. Categories then holds a single
+		// "Fields" category with one item per selected field, named as the field, and Raw is not set.
+		bool IsProjection = false;
 	};
 
 	class PeFileFormattedInfoExtractor
 	{
 	public:
 		PeFileFormattedInfoExtractor(std::wstring filePath);
+		PeFileFormattedInfoExtractor(Span<const std::uint8_t> image);
+		PeFileFormattedInfoExtractor(std::unique_ptr<PeImageSource> image);
 
 		PeFileFormattedInfo Extract();
 
+		// Returns false when the image does not match a predicate of the plan. Otherwise sets info
+		// to the fields the plan selects, or to the result of Extract when it selects all of them.
+		bool TryExtract(const ExtractionPlan& plan, PeFileFormattedInfo& info);
+
+		// The extractor the info is formatted from, for parts of the image it does not format
+		PeFileInfoExtractor& GetInfoExtractor();
+
+		static std::wstring FormatMachine(WORD machine);
+
 	private:
 		std::wstring GetDescription();
 		std::wstring GetMachine();
@@ -128,10 +227,23 @@ namespace peinfo
 		std::wstring GetTimeDateStamp();
 		std::wstring GetSubsystem();
 		std::wstring GetToolset();
-		std::wstring GetConfiguration();
+		std::wstring GetConfiguration(BuildConfiguration configuration);
 		std::wstring GetDepStatus();
 		std::wstring GetAslrStatus();
 		std::wstring GetCfgStatus();
+		std::wstring GetFileVersion(const VS_FIXEDFILEINFO& fixedFileInfo);
+		std::wstring GetVersionString(const char16_t* key);
+		std::wstring GetImportedModules(bool isDelayLoaded);
+		std::wstring GetBoundImports();
+		std::wstring GetExportedNames();
+		std::wstring GetLargestResource();
+		std::wstring GetExecutionLevel();
+		std::wstring GetDependencies();
+		bool Matches(const PlannedPredicate& predicate);
+		std::wstring GetTextField(InfoField field);
+		bool GetFlagField(InfoField field);
+		std::uint64_t GetNumberField(InfoField field);
+		std::wstring FormatField(InfoField field);
 
 		PeFileInfoExtractor peFileInfoExtractor_;
 	};
@@ -0,0 +1,472 @@
+#include "stdafx.h"
+#include "PeBinaryInfo.h"
+#include "PeImageSource.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		// Ranged reads are widened to whole pages, since neighbouring structures are usually read next
+		const std::uint64_t ReadAlignment = 4096;
+
+		thread_local std::vector<std::uint8_t> spareBuffer;
+
+		void CheckRange(std::uint64_t offset, std::uint64_t size, std::uint64_t imageSize)
+		{
+			HandleFormatError(offset > imageSize || size > imageSize - offset, "Range is outside of the file");
+		}
+
+#ifdef _WIN32
+		NativeFileHandle OpenNativeFile(const std::wstring& filePath, std::uint64_t& size)
+		{
+			HANDLE fileHandle = CreateFile(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+			HandleWin32Error(fileHandle == INVALID_HANDLE_VALUE);
+
+			LARGE_INTEGER fileSize{};
+			BOOL result = GetFileSizeEx(fileHandle, &fileSize);
+			if (result == FALSE)
+			{
+				DWORD error = GetLastError();
+				CloseHandle(fileHandle);
+				SetLastError(error);
+			}
+
+			HandleWin32Error(result == FALSE);
+			size = static_cast<std::uint64_t>(fileSize.QuadPart);
+			return fileHandle;
+		}
+
+		void CloseNativeFile(NativeFileHandle file)
+		{
+			CloseHandle(file);
+		}
+
+		void ReadNativeFile(NativeFileHandle file, std::uint64_t offset, std::uint8_t* buffer, std::size_t size, IoStatistics* statistics)
+		{
+			while (size > 0)
+			{
+				OVERLAPPED overlapped{};
+				overlapped.Offset = static_cast<DWORD>(offset);
+				overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+				DWORD bytesRead = 0;
+				DWORD bytesToRead = static_cast<DWORD>(std::min<std::size_t>(size, std::numeric_limits<DWORD>::max()));
+				BOOL result = ReadFile(file, buffer, bytesToRead, &bytesRead, &overlapped);
+				HandleWin32Error(result == FALSE);
+				HandleFormatError(bytesRead == 0, "File was truncated while reading");
+
+				if (statistics != nullptr)
+				{
+					++statistics->ReadCalls;
+					statistics->BytesRead += bytesRead;
+				}
+
+				offset += bytesRead;
+				buffer += bytesRead;
+				size -= bytesRead;
+			}
+		}
+#else
+		NativeFileHandle OpenNativeFile(const std::wstring& filePath, std::uint64_t& size)
+		{
+			int fd = open(utf16_to_native_path(filePath).c_str(), O_RDONLY | O_CLOEXEC);
+			HandlePosixError(fd == -1);
+
+			struct stat fileStat{};
+			int result = fstat(fd, &fileStat);
+			if (result == -1)
+			{
+				int error = errno;
+				close(fd);
+				errno = error;
+			}
+
+			HandlePosixError(result == -1);
+			size = static_cast<std::uint64_t>(fileStat.st_size);
+			return fd;
+		}
+
+		void CloseNativeFile(NativeFileHandle file)
+		{
+			close(file);
+		}
+
+		void ReadNativeFile(NativeFileHandle file, std::uint64_t offset, std::uint8_t* buffer, std::size_t size, IoStatistics* statistics)
+		{
+			while (size > 0)
+			{
+				ssize_t bytesRead = pread(file, buffer, size, static_cast<off_t>(offset));
+				if (bytesRead == -1 && errno == EINTR)
+				{
+					continue;
+				}
+
+				HandlePosixError(bytesRead == -1);
+				HandleFormatError(bytesRead == 0, "File was truncated while reading");
+
+				if (statistics != nullptr)
+				{
+					++statistics->ReadCalls;
+					statistics->BytesRead += static_cast<std::uint64_t>(bytesRead);
+				}
+
+				offset += static_cast<std::uint64_t>(bytesRead);
+				buffer += bytesRead;
+				size -= static_cast<std::size_t>(bytesRead);
+			}
+		}
+#endif
+	}
+
+	void PeImageSource::PrepareRandomAccess(std::uint64_t, std::uint64_t)
+	{
+	}
+
+	std::unique_ptr<PeImageSource> OpenPeImage(const std::wstring& filePath, const IoOptions& options)
+	{
+		std::uint64_t size = 0;
+		auto file = OpenNativeFile(filePath, size);
+
+		std::unique_ptr<PeImageSource> image;
+		try
+		{
+			HandleFormatError(size == 0, "File is empty");
+
+			if (size <= options.SmallFileThreshold)
+			{
+				image = std::make_unique<BufferedPeFile>(file, size, options.Statistics);
+			}
+			else if (size >= options.LargeFileThreshold)
+			{
+				// The ranged source keeps the file open
+				return std::make_unique<RangedPeFile>(file, size, std::vector<std::uint8_t>(), options.Statistics);
+			}
+			else
+			{
+				image = std::make_unique<MappedPeFile>(file, size);
+				if (options.Statistics != nullptr)
+				{
+					++options.Statistics->MappedFiles;
+				}
+			}
+		}
+		catch (...)
+		{
+			CloseNativeFile(file);
+			throw;
+		}
+
+		CloseNativeFile(file);
+		return image;
+	}
+
+	MappedPeFile::MappedPeFile(std::wstring filePath)
+	{
+		std::uint64_t size = 0;
+		auto file = OpenNativeFile(filePath, size);
+		try
+		{
+			Map(file, size);
+		}
+		catch (...)
+		{
+			CloseNativeFile(file);
+			throw;
+		}
+
+		CloseNativeFile(file);
+	}
+
+	MappedPeFile::MappedPeFile(NativeFileHandle file, std::uint64_t size)
+	{
+		Map(file, size);
+	}
+
+#ifdef _WIN32
+	void MappedPeFile::Map(NativeFileHandle file, std::uint64_t size)
+	{
+		HandleFormatError(size == 0, "File is empty");
+
+		HANDLE fileMappingHandle = CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		HandleWin32Error(fileMappingHandle == nullptr);
+
+		base_ = MapViewOfFile(fileMappingHandle, FILE_MAP_READ, 0, 0, 0);
+		DWORD error = GetLastError();
+		CloseHandle(fileMappingHandle);
+		SetLastError(error);
+		HandleWin32Error(base_ == nullptr);
+		size_ = size;
+	}
+
+	MappedPeFile::~MappedPeFile()
+	{
+		if (base_ != nullptr)
+		{
+			UnmapViewOfFile(base_);
+		}
+	}
+#else
+	void MappedPeFile::Map(NativeFileHandle file, std::uint64_t size)
+	{
+		HandleFormatError(size == 0, "File is empty");
+
+		void* base = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_PRIVATE, file, 0);
+		HandlePosixError(base == MAP_FAILED);
+
+		base_ = base;
+		size_ = size;
+
+		// Headers and metadata are visited in a scattered order, so readahead of the whole file
+		// mostly fetches pages that are never touched. Only the first page is certain to be read.
+		madvise(base_, size_, MADV_RANDOM);
+		madvise(base_, std::min<std::uint64_t>(size_, 4096), MADV_WILLNEED);
+	}
+
+	MappedPeFile::~MappedPeFile()
+	{
+		if (base_ != nullptr)
+		{
+			munmap(base_, size_);
+		}
+	}
+#endif
+
+	LPVOID MappedPeFile::GetBaseAddress()
+	{
+		return base_;
+	}
+
+	std::uint64_t MappedPeFile::GetSize() const
+	{
+		return size_;
+	}
+
+	const void* MappedPeFile::GetData(std::uint64_t offset, std::uint64_t size)
+	{
+		CheckRange(offset, size, size_);
+		return AddOffset<const void>(base_, static_cast<ptrdiff_t>(offset));
+	}
+
+	BufferedPeFile::BufferedPeFile(NativeFileHandle file, std::uint64_t size, IoStatistics* statistics)
+	{
+		HandleFormatError(size > std::numeric_limits<std::size_t>::max(), "File is too large to be buffered");
+
+		buffer_.swap(spareBuffer);
+		buffer_.resize(static_cast<std::size_t>(size));
+		ReadNativeFile(file, 0, buffer_.data(), buffer_.size(), statistics);
+
+		if (statistics != nullptr)
+		{
+			++statistics->BufferedFiles;
+		}
+	}
+
+	BufferedPeFile::BufferedPeFile(std::vector<std::uint8_t> content, IoStatistics* statistics)
+		: buffer_(std::move(content))
+	{
+		if (statistics != nullptr)
+		{
+			++statistics->BufferedFiles;
+		}
+	}
+
+	BufferedPeFile::~BufferedPeFile()
+	{
+		if (buffer_.capacity() > spareBuffer.capacity())
+		{
+			buffer_.swap(spareBuffer);
+		}
+	}
+
+	std::uint64_t BufferedPeFile::GetSize() const
+	{
+		return buffer_.size();
+	}
+
+	const void* BufferedPeFile::GetData(std::uint64_t offset, std::uint64_t size)
+	{
+		CheckRange(offset, size, buffer_.size());
+		return buffer_.data() + offset;
+	}
+
+	RangedPeFile::RangedPeFile(std::wstring filePath)
+	{
+		file_ = OpenNativeFile(filePath, size_);
+#ifndef _WIN32
+		posix_fadvise(file_, 0, 0, POSIX_FADV_RANDOM);
+#endif
+	}
+
+	RangedPeFile::RangedPeFile(NativeFileHandle file, std::uint64_t size, std::vector<std::uint8_t> prefix, IoStatistics* statistics)
+		: file_(file), size_(size), statistics_(statistics)
+	{
+		if (prefix.size() > size_)
+		{
+			prefix.resize(static_cast<std::size_t>(size_));
+		}
+
+		if (!prefix.empty())
+		{
+			ranges_.push_back(Range{ 0, std::move(prefix) });
+		}
+
+#ifndef _WIN32
+		posix_fadvise(file_, 0, 0, POSIX_FADV_RANDOM);
+#endif
+
+		if (statistics_ != nullptr)
+		{
+			++statistics_->RangedFiles;
+		}
+	}
+
+	RangedPeFile::~RangedPeFile()
+	{
+		CloseNativeFile(file_);
+	}
+
+	std::uint64_t RangedPeFile::GetSize() const
+	{
+		return size_;
+	}
+
+	const void* RangedPeFile::GetData(std::uint64_t offset, std::uint64_t size)
+	{
+		CheckRange(offset, size, size_);
+
+		for (const auto& range : ranges_)
+		{
+			if (offset >= range.Offset && offset + size <= range.Offset + range.Data.size())
+			{
+				return range.Data.data() + (offset - range.Offset);
+			}
+		}
+
+		auto start = offset / ReadAlignment * ReadAlignment;
+		auto end = std::min(size_, (offset + size + ReadAlignment - 1) / ReadAlignment * ReadAlignment);
+		HandleFormatError(end - start > std::numeric_limits<std::size_t>::max(), "Range is too large");
+
+		Range range{ start, std::vector<std::uint8_t>(static_cast<std::size_t>(end - start)) };
+		ReadNativeFile(file_, start, range.Data.data(), range.Data.size(), statistics_);
+		ranges_.push_back(std::move(range));
+
+		return ranges_.back().Data.data() + (offset - start);
+	}
+
+	MemoryPeImage::MemoryPeImage(Span<const std::uint8_t> image)
+		: image_(image)
+	{
+	}
+
+	std::uint64_t MemoryPeImage::GetSize() const
+	{
+		return image_.size();
+	}
+
+	const void* MemoryPeImage::GetData(std::uint64_t offset, std::uint64_t size)
+	{
+		CheckRange(offset, size, image_.size());
+		return image_.data() + offset;
+	}
+
+	StreamPeImage::StreamPeImage(std::istream& stream, std::uint64_t size)
+		: stream_(stream), size_(size)
+	{
+	}
+
+	std::uint64_t StreamPeImage::GetSize() const
+	{
+		return size_;
+	}
+
+	void StreamPeImage::PrepareRandomAccess(std::uint64_t offset, std::uint64_t size)
+	{
+		GetData(offset, size);
+	}
+
+	const void* StreamPeImage::GetData(std::uint64_t offset, std::uint64_t size)
+	{
+		CheckRange(offset, size, size_);
+		HandleFormatError(size > std::numeric_limits<std::size_t>::max(), "Range is too large");
+
+		for (const auto& range : ranges_)
+		{
+			if (offset >= range.Offset && offset + size <= range.Offset + range.Data.size())
+			{
+				return range.Data.data() + (offset - range.Offset);
+			}
+		}
+
+		// A range that starts behind the stream position is assembled from kept bytes and the
+		// bytes that follow; kept ranges are never grown, since pointers into them are handed out.
+		Range range{ offset, std::vector<std::uint8_t>(static_cast<std::size_t>(size)) };
+		auto keptSize = offset < position_ ? std::min(position_ - offset, size) : 0;
+		HandleFormatError(!CopyKeptBytes(offset, range.Data.data(), static_cast<std::size_t>(keptSize)), "Range was already passed in the stream");
+
+		Skip(offset > position_ ? offset - position_ : 0);
+		Read(range.Data.data() + keptSize, static_cast<std::size_t>(size - keptSize));
+		ranges_.push_back(std::move(range));
+
+		return ranges_.back().Data.data();
+	}
+
+	void StreamPeImage::Read(std::uint8_t* buffer, std::size_t size)
+	{
+		if (size == 0)
+		{
+			return;
+		}
+
+		stream_.read(reinterpret_cast<char*>(buffer), static_cast<std::streamsize>(size));
+		position_ += static_cast<std::uint64_t>(stream_.gcount());
+		if (static_cast<std::size_t>(stream_.gcount()) != size)
+		{
+			size_ = position_;
+		}
+
+		HandleFormatError(static_cast<std::size_t>(stream_.gcount()) != size, "Stream ended before the requested range");
+	}
+
+	void StreamPeImage::Skip(std::uint64_t size)
+	{
+		while (size > 0)
+		{
+			auto chunkSize = static_cast<std::streamsize>(std::min<std::uint64_t>(size, std::numeric_limits<std::streamsize>::max()));
+			stream_.ignore(chunkSize);
+			position_ += static_cast<std::uint64_t>(stream_.gcount());
+			if (stream_.gcount() != chunkSize)
+			{
+				size_ = position_;
+			}
+
+			HandleFormatError(stream_.gcount() != chunkSize, "Stream ended before the requested range");
+			size -= static_cast<std::uint64_t>(chunkSize);
+		}
+	}
+
+	bool StreamPeImage::CopyKeptBytes(std::uint64_t offset, std::uint8_t* buffer, std::size_t size) const
+	{
+		while (size > 0)
+		{
+			auto range = std::find_if(ranges_.begin(), ranges_.end(), [offset](const Range& candidate)
+			{
+				return offset >= candidate.Offset && offset < candidate.Offset + candidate.Data.size();
+			});
+
+			if (range == ranges_.end())
+			{
+				return false;
+			}
+
+			auto rangeOffset = static_cast<std::size_t>(offset - range->Offset);
+			auto count = std::min(size, range->Data.size() - rangeOffset);
+			std::memcpy(buffer, range->Data.data() + rangeOffset, count);
+
+			offset += count;
+			buffer += count;
+			size -= count;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,187 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Helpers.h"
+
+namespace peinfo
+{
+#ifdef _WIN32
+	using NativeFileHandle = HANDLE;
+#else
+	using NativeFileHandle = int;
+#endif
+
+	// Counters shared by every source opened with the same IoOptions
+	struct IoStatistics
+	{
+		std::atomic<std::uint64_t> BufferedFiles{ 0 };
+		std::atomic<std::uint64_t> MappedFiles{ 0 };
+		std::atomic<std::uint64_t> RangedFiles{ 0 };
+		std::atomic<std::uint64_t> ReadCalls{ 0 };
+		std::atomic<std::uint64_t> BytesRead{ 0 };
+	};
+
+	// Selects how OpenPeImage reads a file. Small files are cheaper to read whole than to map, and
+	// of huge files only a few KB of headers are usually needed.
+	struct IoOptions
+	{
+		// Files up to this size are read whole into a buffer reused by the thread
+		std::uint64_t SmallFileThreshold = 256 * 1024;
+
+		// Files of at least this size are read only in the ranges the extractor asks for
+		std::uint64_t LargeFileThreshold = 64 * 1024 * 1024;
+
+		IoStatistics* Statistics = nullptr;
+	};
+
+	// Byte-range access to a PE image. The extractor asks for the ranges it parses instead of
+	// assuming the whole file is mapped, so an image can be backed by a mapping, by buffers
+	// filled by reads on demand, or by buffers prefetched asynchronously.
+	class PeImageSource
+	{
+	public:
+		virtual ~PeImageSource() = default;
+
+		virtual std::uint64_t GetSize() const = 0;
+
+		// Returns [offset, offset + size). Throws when the range is outside of the image.
+		// The pointer stays valid for the lifetime of the source.
+		virtual const void* GetData(std::uint64_t offset, std::uint64_t size) = 0;
+
+		// Announces that parts of [offset, offset + size) will be asked for in no particular order.
+		// Sources that can only read forwards keep the range now; the others need not do anything.
+		virtual void PrepareRandomAccess(std::uint64_t offset, std::uint64_t size);
+	};
+
+	// Opens the file and picks a buffered, mapped or ranged source by its size.
+	std::unique_ptr<PeImageSource> OpenPeImage(const std::wstring& filePath, const IoOptions& options);
+
+	class MappedPeFile : public PeImageSource
+	{
+	public:
+		MappedPeFile(std::wstring filePath);
+		// Does not take ownership of the file.
+		MappedPeFile(NativeFileHandle file, std::uint64_t size);
+		~MappedPeFile();
+
+		MappedPeFile(const MappedPeFile&) = delete;
+		MappedPeFile& operator=(const MappedPeFile&) = delete;
+
+		LPVOID GetBaseAddress();
+		std::uint64_t GetSize() const override;
+		const void* GetData(std::uint64_t offset, std::uint64_t size) override;
+
+	private:
+		void Map(NativeFileHandle file, std::uint64_t size);
+
+		LPVOID base_ = nullptr;
+		std::uint64_t size_ = 0;
+	};
+
+	// Reads the whole file with as few calls as possible. The buffer is taken from and returned to
+	// a per-thread spare, so scanning many small files does not allocate for each of them.
+	class BufferedPeFile : public PeImageSource
+	{
+	public:
+		// Does not take ownership of the file.
+		BufferedPeFile(NativeFileHandle file, std::uint64_t size, IoStatistics* statistics);
+		// Takes the content of a file the caller has read.
+		BufferedPeFile(std::vector<std::uint8_t> content, IoStatistics* statistics);
+		~BufferedPeFile();
+
+		BufferedPeFile(const BufferedPeFile&) = delete;
+		BufferedPeFile& operator=(const BufferedPeFile&) = delete;
+
+		std::uint64_t GetSize() const override;
+		const void* GetData(std::uint64_t offset, std::uint64_t size) override;
+
+	private:
+		std::vector<std::uint8_t> buffer_;
+	};
+
+	// Serves ranges of an image the caller keeps in memory.
+	class MemoryPeImage : public PeImageSource
+	{
+	public:
+		MemoryPeImage(Span<const std::uint8_t> image);
+
+		std::uint64_t GetSize() const override;
+		const void* GetData(std::uint64_t offset, std::uint64_t size) override;
+
+	private:
+		Span<const std::uint8_t> image_;
+	};
+
+	// Reads an image front to back from a stream that cannot seek, such as a pipe. Only requested
+	// ranges are kept and the bytes between them are discarded, so a range must not start before
+	// the end of the previous one unless it is covered by ranges kept earlier. The extractor reads
+	// the headers, then announces the sections that hold the directories it parses, which covers
+	// the data they refer to for images laid out by common linkers. When the size is not given,
+	// GetSize returns UnknownSize until the stream has ended, and a range past the end fails when
+	// it is read.
+	class StreamPeImage : public PeImageSource
+	{
+	public:
+		static const std::uint64_t UnknownSize = std::numeric_limits<std::uint64_t>::max();
+
+		StreamPeImage(std::istream& stream, std::uint64_t size = UnknownSize);
+
+		StreamPeImage(const StreamPeImage&) = delete;
+		StreamPeImage& operator=(const StreamPeImage&) = delete;
+
+		std::uint64_t GetSize() const override;
+		const void* GetData(std::uint64_t offset, std::uint64_t size) override;
+		void PrepareRandomAccess(std::uint64_t offset, std::uint64_t size) override;
+
+	private:
+		struct Range
+		{
+			std::uint64_t Offset;
+			std::vector<std::uint8_t> Data;
+		};
+
+		void Read(std::uint8_t* buffer, std::size_t size);
+		void Skip(std::uint64_t size);
+		bool CopyKeptBytes(std::uint64_t offset, std::uint8_t* buffer, std::size_t size) const;
+
+		std::istream& stream_;
+		std::uint64_t size_;
+		std::uint64_t position_ = 0;
+		std::deque<Range> ranges_;
+	};
+
+	// Reads only the ranges that are asked for. Every range is kept until the source is destroyed,
+	// so returned pointers stay valid; a range already covered by an earlier read costs no I/O.
+	class RangedPeFile : public PeImageSource
+	{
+	public:
+		RangedPeFile(std::wstring filePath);
+		// Takes ownership of the file. prefix holds bytes already read from offset 0.
+		RangedPeFile(NativeFileHandle file, std::uint64_t size, std::vector<std::uint8_t> prefix, IoStatistics* statistics);
+		~RangedPeFile();
+
+		RangedPeFile(const RangedPeFile&) = delete;
+		RangedPeFile& operator=(const RangedPeFile&) = delete;
+
+		std::uint64_t GetSize() const override;
+		const void* GetData(std::uint64_t offset, std::uint64_t size) override;
+
+	private:
+		struct Range
+		{
+			std::uint64_t Offset;
+			std::vector<std::uint8_t> Data;
+		};
+
+		NativeFileHandle file_;
+		std::uint64_t size_ = 0;
+		std::deque<Range> ranges_;
+		IoStatistics* statistics_ = nullptr;
+	};
+}
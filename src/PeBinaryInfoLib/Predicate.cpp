@@ -0,0 +1,192 @@
+#include "stdafx.h"
+#include "Predicate.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		struct OperatorSpelling
+		{
+			const wchar_t* Text;
+			PredicateOperator Operator;
+		};
+
+		// Two-character operators come first, so that "<=" is not read as "<" followed by "="
+		const OperatorSpelling OperatorSpellings[] =
+		{
+			{ L"!=", PredicateOperator::NotEqual },
+			{ L"<=", PredicateOperator::LessOrEqual },
+			{ L">=", PredicateOperator::GreaterOrEqual },
+			{ L"=", PredicateOperator::Equal },
+			{ L"~", PredicateOperator::Contains },
+			{ L"<", PredicateOperator::Less },
+			{ L">", PredicateOperator::Greater }
+		};
+
+		char ToLowerAscii(char character)
+		{
+			return character >= 'A' && character <= 'Z' ? static_cast<char>(character - 'A' + 'a') : character;
+		}
+
+		bool EqualsIgnoringCase(const char* left, const char* right, std::size_t size)
+		{
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				if (ToLowerAscii(left[i]) != ToLowerAscii(right[i]))
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		bool ContainsIgnoringCase(Span<const char> text, Span<const char> value)
+		{
+			if (value.size() > text.size())
+			{
+				return false;
+			}
+
+			for (std::size_t start = 0; start + value.size() <= text.size(); ++start)
+			{
+				if (EqualsIgnoringCase(text.data() + start, value.data(), value.size()))
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		int CompareBytes(Span<const char> left, Span<const char> right)
+		{
+			auto size = std::min(left.size(), right.size());
+			int result = size != 0 ? std::memcmp(left.data(), right.data(), size) : 0;
+			if (result != 0)
+			{
+				return result;
+			}
+
+			return left.size() < right.size() ? -1 : (left.size() > right.size() ? 1 : 0);
+		}
+
+		bool MatchesOrdering(int comparison, PredicateOperator predicateOperator)
+		{
+			switch (predicateOperator)
+			{
+			case PredicateOperator::Less:
+				return comparison < 0;
+			case PredicateOperator::LessOrEqual:
+				return comparison <= 0;
+			case PredicateOperator::Greater:
+				return comparison > 0;
+			case PredicateOperator::GreaterOrEqual:
+				return comparison >= 0;
+			default:
+				return false;
+			}
+		}
+	}
+
+	bool TryParsePredicate(const std::wstring& text, FieldPredicate& predicate)
+	{
+		std::size_t fieldLength = 0;
+		while (fieldLength < text.size() && ((text[fieldLength] >= L'a' && text[fieldLength] <= L'z') || (text[fieldLength] >= L'0' && text[fieldLength] <= L'9')))
+		{
+			++fieldLength;
+		}
+
+		if (fieldLength == 0)
+		{
+			return false;
+		}
+
+		for (const auto& spelling : OperatorSpellings)
+		{
+			auto operatorLength = std::wcslen(spelling.Text);
+			if (text.compare(fieldLength, operatorLength, spelling.Text) == 0)
+			{
+				predicate.Field = text.substr(0, fieldLength);
+				predicate.Operator = spelling.Operator;
+				predicate.Value = text.substr(fieldLength + operatorLength);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool TryParseFlagValue(const std::wstring& value, bool& flag)
+	{
+		if (value == L"yes" || value == L"true" || value == L"1")
+		{
+			flag = true;
+		}
+		else if (value == L"no" || value == L"false" || value == L"0")
+		{
+			flag = false;
+		}
+		else
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	bool MatchesFlag(bool flag, PredicateOperator predicateOperator, bool value)
+	{
+		switch (predicateOperator)
+		{
+		case PredicateOperator::Equal:
+			return flag == value;
+		case PredicateOperator::NotEqual:
+			return flag != value;
+		default:
+			return false;
+		}
+	}
+
+	bool TryParseNumberValue(const std::wstring& value, std::uint64_t& number)
+	{
+		if (value.empty())
+		{
+			return false;
+		}
+
+		wchar_t* end = nullptr;
+		number = std::wcstoull(value.c_str(), &end, 0);
+		return end == value.c_str() + value.size();
+	}
+
+	bool MatchesNumber(std::uint64_t number, PredicateOperator predicateOperator, std::uint64_t value)
+	{
+		switch (predicateOperator)
+		{
+		case PredicateOperator::Equal:
+			return number == value;
+		case PredicateOperator::NotEqual:
+			return number != value;
+		case PredicateOperator::Contains:
+			return false;
+		default:
+			return MatchesOrdering(number < value ? -1 : (number > value ? 1 : 0), predicateOperator);
+		}
+	}
+
+	bool MatchesText(Span<const char> text, PredicateOperator predicateOperator, Span<const char> value)
+	{
+		switch (predicateOperator)
+		{
+		case PredicateOperator::Equal:
+			return text.size() == value.size() && EqualsIgnoringCase(text.data(), value.data(), value.size());
+		case PredicateOperator::NotEqual:
+			return text.size() != value.size() || !EqualsIgnoringCase(text.data(), value.data(), value.size());
+		case PredicateOperator::Contains:
+			return ContainsIgnoringCase(text, value);
+		default:
+			return MatchesOrdering(CompareBytes(text, value), predicateOperator);
+		}
+	}
+}
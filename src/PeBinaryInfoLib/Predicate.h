@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Helpers.h"
+
+namespace peinfo
+{
+	enum class PredicateOperator
+	{
+		Equal,
+		NotEqual,
+		Contains,
+		Less,
+		LessOrEqual,
+		Greater,
+		GreaterOrEqual
+	};
+
+	// A condition on one field, written as <field><operator><value>, for example "aslr=no",
+	// "configuration=Debug", "framework~v4.5" or "timestamp>=1500000000". Field names are
+	// lowercase letters and digits. The operators are =, !=, ~ (contains), <, <=, > and >=.
+	struct FieldPredicate
+	{
+		std::wstring Field;
+		PredicateOperator Operator;
+		std::wstring Value;
+	};
+
+	bool TryParsePredicate(const std::wstring& text, FieldPredicate& predicate);
+
+	// Accepts yes/no, true/false and 1/0. Only = and != apply to flags.
+	bool TryParseFlagValue(const std::wstring& value, bool& flag);
+	bool MatchesFlag(bool flag, PredicateOperator predicateOperator, bool value);
+
+	// Only = and !=, and the ordering operators, apply to numbers.
+	bool TryParseNumberValue(const std::wstring& value, std::uint64_t& number);
+	bool MatchesNumber(std::uint64_t number, PredicateOperator predicateOperator, std::uint64_t value);
+
+	// Compares UTF-8 text, ignoring the case of ASCII letters. The ordering operators compare bytes.
+	bool MatchesText(Span<const char> text, PredicateOperator predicateOperator, Span<const char> value);
+}
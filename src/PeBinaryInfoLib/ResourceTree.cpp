@@ -0,0 +1,259 @@
+#include "stdafx.h"
+#include "ResourceTree.h"
+#include "PeBinaryInfo.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		const int LeafDepth = 2;
+	}
+
+	ResourceDirectory::ResourceDirectory()
+		: tree_(nullptr), entries_(nullptr), namedEntryCount_(0), idEntryCount_(0)
+	{
+	}
+
+	ResourceDirectory::ResourceDirectory(const ResourceTree* tree, const IMAGE_RESOURCE_DIRECTORY_ENTRY* entries, WORD namedEntryCount, WORD idEntryCount)
+		: tree_(tree), entries_(entries), namedEntryCount_(namedEntryCount), idEntryCount_(idEntryCount)
+	{
+	}
+
+	std::size_t ResourceDirectory::GetEntryCount() const
+	{
+		return static_cast<std::size_t>(namedEntryCount_) + idEntryCount_;
+	}
+
+	ResourceDirectoryEntry ResourceDirectory::GetEntry(std::size_t index) const
+	{
+		const auto& entry = entries_[index];
+		return ResourceDirectoryEntry
+		{
+			tree_->ReadKey(entry.Name),
+			IsFlagSet(entry.OffsetToData, IMAGE_RESOURCE_DATA_IS_DIRECTORY),
+			entry.OffsetToData & ~static_cast<DWORD>(IMAGE_RESOURCE_DATA_IS_DIRECTORY)
+		};
+	}
+
+	bool ResourceDirectory::TryFindEntry(WORD id, ResourceDirectoryEntry& entry) const
+	{
+		auto first = entries_ + namedEntryCount_;
+		auto last = first + idEntryCount_;
+		auto found = std::lower_bound(first, last, id, [](const IMAGE_RESOURCE_DIRECTORY_ENTRY& candidate, WORD value) { return candidate.Name < value; });
+		if (found == last || found->Name != id)
+		{
+			return false;
+		}
+
+		entry = GetEntry(found - entries_);
+		return true;
+	}
+
+	ResourceTree::Iterator::Iterator()
+		: tree_(nullptr), indices_{}, topDepth_(0), depth_(-1), current_{}
+	{
+	}
+
+	ResourceTree::Iterator::Iterator(const ResourceTree* tree, ResourceDirectory directory, int depth, const Resource& keys)
+		: tree_(tree), indices_{}, topDepth_(depth), depth_(depth), current_(keys)
+	{
+		directories_[depth] = directory;
+		Settle();
+	}
+
+	const Resource& ResourceTree::Iterator::operator*() const
+	{
+		return current_;
+	}
+
+	const Resource* ResourceTree::Iterator::operator->() const
+	{
+		return &current_;
+	}
+
+	ResourceTree::Iterator& ResourceTree::Iterator::operator++()
+	{
+		++indices_[depth_];
+		Settle();
+		return *this;
+	}
+
+	bool ResourceTree::Iterator::operator==(const Iterator& other) const
+	{
+		bool isEnd = depth_ < topDepth_;
+		bool isOtherEnd = other.depth_ < other.topDepth_;
+		if (isEnd || isOtherEnd)
+		{
+			return isEnd == isOtherEnd;
+		}
+
+		return depth_ == other.depth_ && std::equal(std::begin(indices_), std::end(indices_), std::begin(other.indices_));
+	}
+
+	bool ResourceTree::Iterator::operator!=(const Iterator& other) const
+	{
+		return !(*this == other);
+	}
+
+	void ResourceTree::Iterator::Settle()
+	{
+		while (depth_ >= topDepth_)
+		{
+			const auto& directory = directories_[depth_];
+			if (indices_[depth_] == directory.GetEntryCount())
+			{
+				if (--depth_ >= topDepth_)
+				{
+					++indices_[depth_];
+				}
+
+				continue;
+			}
+
+			auto entry = directory.GetEntry(indices_[depth_]);
+			HandleFormatError(entry.IsDirectory != (depth_ < LeafDepth), "Unexpected resource directory depth");
+
+			if (depth_ < LeafDepth)
+			{
+				(depth_ == 0 ? current_.Type : current_.Name) = entry.Key;
+				++depth_;
+				directories_[depth_] = tree_->GetDirectory(entry);
+				indices_[depth_] = 0;
+				continue;
+			}
+
+			auto dataEntry = tree_->GetDataEntry(entry);
+			current_.Language = entry.Key.Id;
+			current_.DataRva = dataEntry.OffsetToData;
+			current_.Size = dataEntry.Size;
+			current_.CodePage = dataEntry.CodePage;
+			return;
+		}
+	}
+
+	ResourceTree::ResourceTree()
+		: image_(nullptr), sectionMap_(nullptr), rva_(0)
+	{
+	}
+
+	ResourceTree::ResourceTree(PeImageSource& image, const SectionMap& sectionMap, IMAGE_DATA_DIRECTORY directory)
+		: image_(&image), sectionMap_(&sectionMap), rva_(directory.VirtualAddress)
+	{
+		// A depth-first walk goes back and forth between the directories, the data entries and the names
+		DWORD fileOffset = 0;
+		if (!IsEmpty() && sectionMap.RvaToFileOffset(rva_, fileOffset) == RvaLookupStatus::Success)
+		{
+			image.PrepareRandomAccess(fileOffset, directory.Size);
+		}
+	}
+
+	bool ResourceTree::IsEmpty() const
+	{
+		return rva_ == 0;
+	}
+
+	ResourceDirectory ResourceTree::GetRoot() const
+	{
+		if (IsEmpty())
+		{
+			return ResourceDirectory();
+		}
+
+		return GetDirectory(ResourceDirectoryEntry{ ResourceKey{}, true, 0 });
+	}
+
+	ResourceDirectory ResourceTree::GetDirectory(const ResourceDirectoryEntry& entry) const
+	{
+		HandleLogicError(!entry.IsDirectory, "Not a resource directory");
+
+		auto directory = static_cast<const IMAGE_RESOURCE_DIRECTORY*>(GetTreeData(entry.Offset, sizeof(IMAGE_RESOURCE_DIRECTORY)));
+		WORD namedEntryCount = directory->NumberOfNamedEntries;
+		WORD idEntryCount = directory->NumberOfIdEntries;
+		auto entryCount = static_cast<std::uint64_t>(namedEntryCount) + idEntryCount;
+		auto entries = static_cast<const IMAGE_RESOURCE_DIRECTORY_ENTRY*>(
+			GetTreeData(entry.Offset + sizeof(IMAGE_RESOURCE_DIRECTORY), entryCount * sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY)));
+
+		return ResourceDirectory(this, entries, namedEntryCount, idEntryCount);
+	}
+
+	IMAGE_RESOURCE_DATA_ENTRY ResourceTree::GetDataEntry(const ResourceDirectoryEntry& entry) const
+	{
+		HandleLogicError(entry.IsDirectory, "Not a resource data entry");
+
+		IMAGE_RESOURCE_DATA_ENTRY dataEntry;
+		std::memcpy(&dataEntry, GetTreeData(entry.Offset, sizeof(IMAGE_RESOURCE_DATA_ENTRY)), sizeof(dataEntry));
+		return dataEntry;
+	}
+
+	ResourceTree::Range ResourceTree::GetResources() const
+	{
+		if (IsEmpty())
+		{
+			return Range{ Iterator(), Iterator() };
+		}
+
+		return Range{ Iterator(this, GetRoot(), 0, Resource{}), Iterator() };
+	}
+
+	ResourceTree::Range ResourceTree::GetResources(WORD type) const
+	{
+		ResourceDirectoryEntry typeEntry;
+		if (IsEmpty() || !GetRoot().TryFindEntry(type, typeEntry))
+		{
+			return Range{ Iterator(), Iterator() };
+		}
+
+		HandleFormatError(!typeEntry.IsDirectory, "Unexpected resource directory depth");
+
+		Resource keys{};
+		keys.Type = typeEntry.Key;
+		return Range{ Iterator(this, GetDirectory(typeEntry), 1, keys), Iterator() };
+	}
+
+	bool ResourceTree::TryFindFirst(WORD type, Resource& resource) const
+	{
+		auto resources = GetResources(type);
+		if (resources.begin() == resources.end())
+		{
+			return false;
+		}
+
+		resource = *resources.begin();
+		return true;
+	}
+
+	Span<const std::uint8_t> ResourceTree::GetData(const Resource& resource) const
+	{
+		auto offset = RvaToFileOffset(resource.DataRva);
+		HandleFormatError(offset + static_cast<std::uint64_t>(resource.Size) > image_->GetSize(), "Resource data is outside of the file");
+
+		return Span<const std::uint8_t>(static_cast<const std::uint8_t*>(image_->GetData(offset, resource.Size)), resource.Size);
+	}
+
+	const void* ResourceTree::GetTreeData(DWORD offset, std::uint64_t size) const
+	{
+		HandleFormatError(offset > std::numeric_limits<DWORD>::max() - rva_, "Resource offset is out of range");
+		return image_->GetData(RvaToFileOffset(rva_ + offset), size);
+	}
+
+	// A name is an IMAGE_RESOURCE_DIR_STRING_U: a WORD length in characters and the characters
+	ResourceKey ResourceTree::ReadKey(DWORD name) const
+	{
+		if (!IsFlagSet(name, IMAGE_RESOURCE_NAME_IS_STRING))
+		{
+			return ResourceKey{ false, static_cast<WORD>(name), Span<const char16_t>() };
+		}
+
+		DWORD nameOffset = name & ~static_cast<DWORD>(IMAGE_RESOURCE_NAME_IS_STRING);
+		auto length = ReadAtOffset<WORD>(GetTreeData(nameOffset, sizeof(WORD)), 0);
+		auto characters = static_cast<const char16_t*>(GetTreeData(nameOffset + sizeof(WORD), length * sizeof(char16_t)));
+		return ResourceKey{ true, 0, Span<const char16_t>(characters, length) };
+	}
+
+	DWORD ResourceTree::RvaToFileOffset(DWORD rva) const
+	{
+		DWORD fileOffset = 0;
+		HandleFormatError(sectionMap_->RvaToFileOffset(rva, fileOffset) != RvaLookupStatus::Success, "Failed to convert RVA");
+		return fileOffset;
+	}
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include "PeImageSource.h"
+#include "SectionMap.h"
+
+namespace peinfo
+{
+	// Resource types, as the RT_ constants of winuser.h
+	const WORD ResourceTypeVersion = 16;
+	const WORD ResourceTypeManifest = 24;
+
+	// The name or ID of a resource directory entry. A name points into the image, as UTF-16LE
+	// without the terminator.
+	struct ResourceKey
+	{
+		bool IsName;
+		WORD Id;
+		Span<const char16_t> Name;
+	};
+
+	struct ResourceDirectoryEntry
+	{
+		ResourceKey Key;
+		bool IsDirectory;
+		DWORD Offset;   // of the subdirectory or the IMAGE_RESOURCE_DATA_ENTRY, from the start of the tree
+	};
+
+	// A leaf of the tree with the keys that lead to it. The data is not read until asked for.
+	struct Resource
+	{
+		ResourceKey Type;
+		ResourceKey Name;
+		WORD Language;
+		DWORD DataRva;
+		DWORD Size;
+		DWORD CodePage;
+	};
+
+	class ResourceTree;
+
+	// One level of the tree: the directory header and its entries, read when the directory is
+	// reached. Names are read when an entry is.
+	class ResourceDirectory
+	{
+	public:
+		ResourceDirectory();
+
+		std::size_t GetEntryCount() const;
+		ResourceDirectoryEntry GetEntry(std::size_t index) const;
+
+		// Binary search over the ID entries, which follow the named ones sorted by ID
+		bool TryFindEntry(WORD id, ResourceDirectoryEntry& entry) const;
+
+	private:
+		friend class ResourceTree;
+
+		ResourceDirectory(const ResourceTree* tree, const IMAGE_RESOURCE_DIRECTORY_ENTRY* entries, WORD namedEntryCount, WORD idEntryCount);
+
+		const ResourceTree* tree_;
+		const IMAGE_RESOURCE_DIRECTORY_ENTRY* entries_;
+		WORD namedEntryCount_;
+		WORD idEntryCount_;
+	};
+
+	// Walks the IMAGE_RESOURCE_DIRECTORY tree of an image, type, name and language, without
+	// building it: each directory is read from the image when it is reached, and entries are
+	// views into the image. Offsets in the tree are relative to its start; the data entries hold
+	// the RVAs of the data.
+	class ResourceTree
+	{
+	public:
+		// Walks the leaves depth first in directory order
+		class Iterator
+		{
+		public:
+			const Resource& operator*() const;
+			const Resource* operator->() const;
+			Iterator& operator++();
+			bool operator==(const Iterator& other) const;
+			bool operator!=(const Iterator& other) const;
+
+		private:
+			friend class ResourceTree;
+
+			// An end iterator
+			Iterator();
+			Iterator(const ResourceTree* tree, ResourceDirectory directory, int depth, const Resource& keys);
+
+			// Moves to the first leaf at or after the current entries
+			void Settle();
+
+			const ResourceTree* tree_;
+			ResourceDirectory directories_[3];
+			std::size_t indices_[3];
+			int topDepth_;
+			int depth_;
+			Resource current_;
+		};
+
+		struct Range
+		{
+			Iterator First;
+			Iterator Last;
+
+			Iterator begin() const { return First; }
+			Iterator end() const { return Last; }
+		};
+
+		// An empty tree
+		ResourceTree();
+
+		// The image and the section map must outlive the tree. The tree is empty when the
+		// directory has no address.
+		ResourceTree(PeImageSource& image, const SectionMap& sectionMap, IMAGE_DATA_DIRECTORY directory);
+
+		bool IsEmpty() const;
+
+		ResourceDirectory GetRoot() const;
+		ResourceDirectory GetDirectory(const ResourceDirectoryEntry& entry) const;
+		IMAGE_RESOURCE_DATA_ENTRY GetDataEntry(const ResourceDirectoryEntry& entry) const;
+
+		Range GetResources() const;
+		Range GetResources(WORD type) const;
+
+		// The first name and language of the type, which is what the loader picks for a process
+		// without a preferred language
+		bool TryFindFirst(WORD type, Resource& resource) const;
+
+		// Reads the data of a resource. Throws when it is outside of the file.
+		Span<const std::uint8_t> GetData(const Resource& resource) const;
+
+	private:
+		friend class ResourceDirectory;
+
+		const void* GetTreeData(DWORD offset, std::uint64_t size) const;
+		ResourceKey ReadKey(DWORD name) const;
+		DWORD RvaToFileOffset(DWORD rva) const;
+
+		PeImageSource* image_;
+		const SectionMap* sectionMap_;
+		DWORD rva_;
+	};
+}
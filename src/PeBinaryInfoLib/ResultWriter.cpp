@@ -0,0 +1,540 @@
+#include "stdafx.h"
+#include "ResultWriter.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		// Large writes keep the stream and the kernel out of the per-record cost
+		const std::size_t FlushSize = 1024 * 1024;
+
+		const wchar_t* const FormattedColumns[] =
+		{
+			L"Description",
+			L"Build time",
+			L"Configuration",
+			L"Platform",
+			L"Toolset",
+			L"Target Framework",
+			L"Assembly Version",
+			L"DEP",
+			L"ASLR",
+			L"CFG",
+			L"Imported Modules",
+			L"Delay-Loaded Modules",
+			L"Bound Modules",
+			L"Imported Functions",
+			L"Imphash",
+			L"Export Name",
+			L"Exported Functions",
+			L"Forwarded Functions",
+			L"File Version",
+			L"Product Version",
+			L"Company Name",
+			L"Product Name",
+			L"File Description",
+			L"Original Filename",
+			L"Resource Count",
+			L"Resource Size",
+			L"Largest Resource",
+			L"Execution Level",
+			L"Dependencies"
+		};
+
+		const char* const RawColumns[] =
+		{
+			"machine",
+			"timeDateStamp",
+			"subsystem",
+			"linkerVersion",
+			"dllCharacteristics",
+			"isDll",
+			"isPe32Plus",
+			"configuration",
+			"isClr",
+			"clrFlags"
+		};
+
+		const char* GetConfigurationName(BuildConfiguration configuration)
+		{
+			switch (configuration)
+			{
+			case BuildConfiguration::Debug:
+				return "Debug";
+			case BuildConfiguration::Release:
+				return "Release";
+			default:
+				return "Unknown";
+			}
+		}
+
+		void AppendNumber(std::string& buffer, std::uint64_t value)
+		{
+			char digits[20];
+			auto result = std::to_chars(digits, digits + sizeof(digits), value);
+			buffer.append(digits, result.ptr);
+		}
+
+		void AppendBoolean(std::string& buffer, bool value)
+		{
+			buffer.append(value ? "true" : "false");
+		}
+
+		void AppendCodePoint(std::string& buffer, std::uint32_t codePoint)
+		{
+			if (codePoint < 0x80)
+			{
+				buffer.push_back(static_cast<char>(codePoint));
+			}
+			else if (codePoint < 0x800)
+			{
+				buffer.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+				buffer.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+			}
+			else if (codePoint < 0x10000)
+			{
+				buffer.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+				buffer.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+				buffer.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+			}
+			else
+			{
+				buffer.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+				buffer.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+				buffer.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+				buffer.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+			}
+		}
+
+		// Encodes UTF-16 (Windows) or UTF-32 text as UTF-8. escape gets every ASCII character first
+		// and returns false to have it appended unchanged. Unpaired surrogates become U+FFFD.
+		template<class Escape>
+		void AppendText(std::string& buffer, const std::wstring& text, Escape escape)
+		{
+			for (std::size_t i = 0; i < text.size(); ++i)
+			{
+				auto codePoint = static_cast<std::uint32_t>(text[i]);
+				if (codePoint < 0x80)
+				{
+					if (!escape(buffer, static_cast<char>(codePoint)))
+					{
+						buffer.push_back(static_cast<char>(codePoint));
+					}
+
+					continue;
+				}
+
+				if (sizeof(wchar_t) == 2 && codePoint >= 0xD800 && codePoint < 0xDC00 && i + 1 < text.size()
+					&& text[i + 1] >= 0xDC00 && text[i + 1] < 0xE000)
+				{
+					codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (static_cast<std::uint32_t>(text[++i]) - 0xDC00);
+				}
+				else if ((codePoint >= 0xD800 && codePoint < 0xE000) || codePoint > 0x10FFFF)
+				{
+					codePoint = 0xFFFD;
+				}
+
+				AppendCodePoint(buffer, codePoint);
+			}
+		}
+
+		// Exception messages are passed through as bytes; only ASCII characters are escaped
+		template<class Escape>
+		void AppendText(std::string& buffer, const std::string& text, Escape escape)
+		{
+			for (char character : text)
+			{
+				if (static_cast<unsigned char>(character) >= 0x80 || !escape(buffer, character))
+				{
+					buffer.push_back(character);
+				}
+			}
+		}
+
+		bool EscapeJson(std::string& buffer, char character)
+		{
+			switch (character)
+			{
+			case '"':
+				buffer.append("\\\"");
+				return true;
+			case '\\':
+				buffer.append("\\\\");
+				return true;
+			case '\n':
+				buffer.append("\\n");
+				return true;
+			case '\r':
+				buffer.append("\\r");
+				return true;
+			case '\t':
+				buffer.append("\\t");
+				return true;
+			default:
+				if (static_cast<unsigned char>(character) < 0x20)
+				{
+					const char hexDigits[] = "0123456789abcdef";
+					buffer.append("\\u00");
+					buffer.push_back(hexDigits[character >> 4]);
+					buffer.push_back(hexDigits[character & 0xF]);
+					return true;
+				}
+
+				return false;
+			}
+		}
+
+		bool EscapeTsv(std::string& buffer, char character)
+		{
+			switch (character)
+			{
+			case '\t':
+				buffer.append("\\t");
+				return true;
+			case '\n':
+				buffer.append("\\n");
+				return true;
+			case '\r':
+				buffer.append("\\r");
+				return true;
+			case '\\':
+				buffer.append("\\\\");
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		bool EscapeCsv(std::string& buffer, char character)
+		{
+			if (character == '"')
+			{
+				buffer.append("\"\"");
+				return true;
+			}
+
+			return false;
+		}
+
+		template<class Text>
+		bool NeedsCsvQuotes(const Text& text)
+		{
+			return std::any_of(text.begin(), text.end(), [](auto character)
+			{
+				return character == ',' || character == '"' || character == '\n' || character == '\r';
+			});
+		}
+
+		class JsonLinesResultWriter : public ResultWriter
+		{
+		public:
+			explicit JsonLinesResultWriter(std::ostream& output)
+				: ResultWriter(output)
+			{
+			}
+
+			void Write(const BatchScanResult& result) override
+			{
+				buffer_.append("{\"file\":");
+				AppendString(result.FilePath);
+
+				if (!result.Succeeded)
+				{
+					buffer_.append(",\"status\":\"failed\",\"error\":");
+					AppendString(result.Error);
+					buffer_.append("}\n");
+					EndRecord();
+					return;
+				}
+
+				buffer_.append(",\"status\":\"extracted\",\"info\":{");
+				for (std::size_t i = 0; i < result.Info.Categories.size(); ++i)
+				{
+					const auto& category = result.Info.Categories[i];
+					if (i != 0)
+					{
+						buffer_.push_back(',');
+					}
+
+					AppendString(category.Name);
+					buffer_.append(":{");
+					for (std::size_t j = 0; j < category.Items.size(); ++j)
+					{
+						if (j != 0)
+						{
+							buffer_.push_back(',');
+						}
+
+						AppendString(category.Items[j].Name);
+						buffer_.push_back(':');
+						AppendString(category.Items[j].Value);
+					}
+
+					buffer_.push_back('}');
+				}
+
+				if (result.Info.IsProjection)
+				{
+					buffer_.append("}}\n");
+					EndRecord();
+					return;
+				}
+
+				const auto& raw = result.Info.Raw;
+				buffer_.append("},\"raw\":{\"machine\":");
+				AppendNumber(buffer_, raw.Machine);
+				buffer_.append(",\"timeDateStamp\":");
+				AppendNumber(buffer_, raw.TimeDateStamp);
+				buffer_.append(",\"subsystem\":");
+				AppendNumber(buffer_, raw.Subsystem);
+				buffer_.append(",\"linkerVersion\":");
+				AppendNumber(buffer_, raw.LinkerVersion);
+				buffer_.append(",\"dllCharacteristics\":");
+				AppendNumber(buffer_, raw.DllCharacteristics);
+				buffer_.append(",\"isDll\":");
+				AppendBoolean(buffer_, raw.IsDll);
+				buffer_.append(",\"isPe32Plus\":");
+				AppendBoolean(buffer_, raw.IsPe32Plus);
+				buffer_.append(",\"configuration\":\"");
+				buffer_.append(GetConfigurationName(raw.BuildConfiguration));
+				buffer_.append("\",\"isClr\":");
+				AppendBoolean(buffer_, raw.IsClr);
+				buffer_.append(",\"clrFlags\":");
+				AppendNumber(buffer_, raw.ClrFlags);
+				buffer_.append("}}\n");
+				EndRecord();
+			}
+
+			void WriteRemoved(const std::wstring& filePath) override
+			{
+				buffer_.append("{\"file\":");
+				AppendString(filePath);
+				buffer_.append(",\"status\":\"removed\"}\n");
+				EndRecord();
+			}
+
+		private:
+			template<class Text>
+			void AppendString(const Text& text)
+			{
+				buffer_.push_back('"');
+				AppendText(buffer_, text, EscapeJson);
+				buffer_.push_back('"');
+			}
+		};
+
+		class DelimitedResultWriter : public ResultWriter
+		{
+		public:
+			DelimitedResultWriter(std::ostream& output, char separator, const ExtractionPlan& plan)
+				: ResultWriter(output), separator_(separator), hasRawColumns_(plan.SelectsAllFields())
+			{
+				if (plan.SelectsAllFields())
+				{
+					columns_.assign(std::begin(FormattedColumns), std::end(FormattedColumns));
+				}
+				else
+				{
+					for (auto field : plan.GetFields())
+					{
+						columns_.push_back(GetInfoFieldName(field));
+					}
+				}
+
+				buffer_.append("file");
+				buffer_.push_back(separator_);
+				buffer_.append("status");
+				buffer_.push_back(separator_);
+				buffer_.append("error");
+				for (const auto& column : columns_)
+				{
+					buffer_.push_back(separator_);
+					AppendField(column);
+				}
+
+				if (hasRawColumns_)
+				{
+					for (auto column : RawColumns)
+					{
+						buffer_.push_back(separator_);
+						buffer_.append(column);
+					}
+				}
+
+				buffer_.push_back('\n');
+			}
+
+			void Write(const BatchScanResult& result) override
+			{
+				AppendField(result.FilePath);
+				buffer_.push_back(separator_);
+				buffer_.append(result.Succeeded ? "extracted" : "failed");
+				buffer_.push_back(separator_);
+				AppendField(result.Error);
+
+				// Items are matched to their columns by name; items without a column are left out
+				values_.assign(columns_.size(), nullptr);
+				for (const auto& category : result.Info.Categories)
+				{
+					for (const auto& item : category.Items)
+					{
+						for (std::size_t column = 0; column < columns_.size(); ++column)
+						{
+							if (item.Name == columns_[column])
+							{
+								values_[column] = &item.Value;
+								break;
+							}
+						}
+					}
+				}
+
+				for (auto value : values_)
+				{
+					buffer_.push_back(separator_);
+					if (value != nullptr)
+					{
+						AppendField(*value);
+					}
+				}
+
+				if (hasRawColumns_)
+				{
+					if (result.Succeeded)
+					{
+						const auto& raw = result.Info.Raw;
+						AppendNumberField(raw.Machine);
+						AppendNumberField(raw.TimeDateStamp);
+						AppendNumberField(raw.Subsystem);
+						AppendNumberField(raw.LinkerVersion);
+						AppendNumberField(raw.DllCharacteristics);
+						AppendBooleanField(raw.IsDll);
+						AppendBooleanField(raw.IsPe32Plus);
+						buffer_.push_back(separator_);
+						buffer_.append(GetConfigurationName(raw.BuildConfiguration));
+						AppendBooleanField(raw.IsClr);
+						AppendNumberField(raw.ClrFlags);
+					}
+					else
+					{
+						buffer_.append(sizeof(RawColumns) / sizeof(RawColumns[0]), separator_);
+					}
+				}
+
+				buffer_.push_back('\n');
+				EndRecord();
+			}
+
+			void WriteRemoved(const std::wstring& filePath) override
+			{
+				AppendField(filePath);
+				buffer_.push_back(separator_);
+				buffer_.append("removed");
+				buffer_.append(1 + columns_.size() + (hasRawColumns_ ? sizeof(RawColumns) / sizeof(RawColumns[0]) : 0), separator_);
+				buffer_.push_back('\n');
+				EndRecord();
+			}
+
+		private:
+			template<class Text>
+			void AppendField(const Text& text)
+			{
+				if (separator_ == '\t')
+				{
+					AppendText(buffer_, text, EscapeTsv);
+				}
+				else if (NeedsCsvQuotes(text))
+				{
+					buffer_.push_back('"');
+					AppendText(buffer_, text, EscapeCsv);
+					buffer_.push_back('"');
+				}
+				else
+				{
+					AppendText(buffer_, text, [](std::string&, char) { return false; });
+				}
+			}
+
+			void AppendNumberField(std::uint64_t value)
+			{
+				buffer_.push_back(separator_);
+				AppendNumber(buffer_, value);
+			}
+
+			void AppendBooleanField(bool value)
+			{
+				buffer_.push_back(separator_);
+				AppendBoolean(buffer_, value);
+			}
+
+			char separator_;
+			bool hasRawColumns_;
+			std::vector<std::wstring> columns_;
+			std::vector<const std::wstring*> values_;
+		};
+	}
+
+	bool TryParseOutputFormat(const std::wstring& name, OutputFormat& format)
+	{
+		if (name == L"jsonl")
+		{
+			format = OutputFormat::JsonLines;
+		}
+		else if (name == L"csv")
+		{
+			format = OutputFormat::Csv;
+		}
+		else if (name == L"tsv")
+		{
+			format = OutputFormat::Tsv;
+		}
+		else
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	std::unique_ptr<ResultWriter> ResultWriter::Create(OutputFormat format, std::ostream& output, const ExtractionPlan& plan)
+	{
+		switch (format)
+		{
+		case OutputFormat::JsonLines:
+			return std::make_unique<JsonLinesResultWriter>(output);
+		case OutputFormat::Csv:
+			return std::make_unique<DelimitedResultWriter>(output, ',', plan);
+		case OutputFormat::Tsv:
+			return std::make_unique<DelimitedResultWriter>(output, '\t', plan);
+		default:
+			HandleLogicError(true, "Unknown output format");
+			return nullptr;
+		}
+	}
+
+	ResultWriter::ResultWriter(std::ostream& output)
+		: output_(output)
+	{
+		buffer_.reserve(FlushSize + 64 * 1024);
+	}
+
+	ResultWriter::~ResultWriter()
+	{
+		Flush();
+	}
+
+	void ResultWriter::Flush()
+	{
+		output_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+		output_.flush();
+		buffer_.clear();
+	}
+
+	void ResultWriter::EndRecord()
+	{
+		if (buffer_.size() >= FlushSize)
+		{
+			Flush();
+		}
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "BatchScanner.h"
+
+namespace peinfo
+{
+	enum class OutputFormat
+	{
+		JsonLines,
+		Csv,
+		Tsv
+	};
+
+	// Recognizes "jsonl", "csv" and "tsv".
+	bool TryParseOutputFormat(const std::wstring& name, OutputFormat& format);
+
+	// Writes batch scan results as UTF-8 records for programs to read, one record per line.
+	// Records are formatted from the result straight into one large buffer, without intermediate
+	// strings or locale-dependent formatting, and the buffer goes to the stream only when it is
+	// full, so the serialized result callback of a parallel scan stays short. Not thread-safe;
+	// BatchScanner already serializes its callback calls.
+	//
+	// JSON Lines records carry every formatted category and the raw values. CSV and TSV have a
+	// header line and a fixed set of columns: the items the extractor produces and the raw values,
+	// or only the fields when the plan selects some of them. Projected results carry no raw values.
+	// CSV fields are quoted as in RFC 4180; TSV fields escape tab, line breaks and backslash.
+	class ResultWriter
+	{
+	public:
+		static std::unique_ptr<ResultWriter> Create(OutputFormat format, std::ostream& output, const ExtractionPlan& plan);
+
+		virtual ~ResultWriter();
+
+		ResultWriter(const ResultWriter&) = delete;
+		ResultWriter& operator=(const ResultWriter&) = delete;
+
+		virtual void Write(const BatchScanResult& result) = 0;
+
+		// Records that a file reported earlier is gone, with the status "removed"
+		virtual void WriteRemoved(const std::wstring& filePath) = 0;
+
+		// Writes out the buffered records. Also done when the buffer is full.
+		void Flush();
+
+	protected:
+		explicit ResultWriter(std::ostream& output);
+
+		// Flushes once the buffer is full. Called after each record.
+		void EndRecord();
+
+		std::string buffer_;
+
+	private:
+		std::ostream& output_;
+	};
+}
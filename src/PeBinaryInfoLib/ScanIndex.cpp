@@ -0,0 +1,725 @@
+#include "stdafx.h"
+#include "ScanIndex.h"
+#include "FilesystemPath.h"
+#include "IndexFile.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		const char IndexMagic[8] = { 'P', 'E', 'I', 'N', 'F', 'O', 'I', 'X' };
+		const std::uint32_t IndexFormatVersion = 2;
+
+		enum ColumnKind : std::uint32_t
+		{
+			// Values: row count + 1 64-bit offsets into Strings, which holds the UTF-8 text
+			TextColumn = 1,
+			// Values: a 32-bit code per row. Strings: entry count, entry count + 1 32-bit offsets
+			// and the UTF-8 text of the entries.
+			DictionaryColumn = 2,
+			// Values: a 64-bit word per 64 rows, the first row in the lowest bit
+			BitmapColumn = 3,
+			// Values: a 32-bit number per row
+			NumberColumn = 4,
+			// Only in a delta segment. Values: a 64-bit word per 64 rows of the index the delta
+			// applies to, set for the rows it replaces or removes.
+			RemovedRowsColumn = 5
+		};
+
+		struct IndexHeader
+		{
+			char Magic[8];
+			std::uint32_t FormatVersion;
+			std::uint32_t ColumnCount;
+			std::uint64_t RowCount;
+			std::uint64_t Generation;  // of the index; in a delta segment, of the index it applies to
+		};
+
+		struct IndexColumnEntry
+		{
+			char Name[16];  // zero-padded
+			std::uint32_t Kind;
+			std::uint32_t Reserved;
+			std::uint64_t ValuesOffset;
+			std::uint64_t ValuesSize;
+			std::uint64_t StringsOffset;
+			std::uint64_t StringsSize;
+		};
+
+		// Every section starts at a multiple of this, so the columns can be read as arrays in place
+		const std::uint64_t SectionAlignment = 8;
+
+		const std::uint64_t RowsPerWord = 64;
+
+		std::uint64_t AlignSection(std::uint64_t offset)
+		{
+			return (offset + SectionAlignment - 1) / SectionAlignment * SectionAlignment;
+		}
+
+		std::uint64_t GetWordCount(std::uint64_t rowCount)
+		{
+			return (rowCount + RowsPerWord - 1) / RowsPerWord;
+		}
+
+		std::wstring GetDeltaPath(const std::wstring& indexPath)
+		{
+			return indexPath + L".delta";
+		}
+
+		const std::wstring* FindItemValue(const PeFileFormattedInfo& info, const wchar_t* name)
+		{
+			for (const auto& category : info.Categories)
+			{
+				for (const auto& item : category.Items)
+				{
+					if (item.Name == name)
+					{
+						return &item.Value;
+					}
+				}
+			}
+
+			return nullptr;
+		}
+
+		// Clears the bits of the rows that do not match. Words already cleared by earlier
+		// predicates are skipped; the inner loop has no branches, so it vectorizes.
+		template<class Match>
+		void ScanRows(std::uint64_t rowCount, Match match, std::vector<std::uint64_t>& result)
+		{
+			for (std::uint64_t word = 0; word < result.size(); ++word)
+			{
+				if (result[word] == 0)
+				{
+					continue;
+				}
+
+				auto firstRow = word * RowsPerWord;
+				auto rowsInWord = std::min(RowsPerWord, rowCount - firstRow);
+				std::uint64_t bits = 0;
+				for (std::uint64_t i = 0; i < rowsInWord; ++i)
+				{
+					bits |= static_cast<std::uint64_t>(match(firstRow + i) ? 1 : 0) << i;
+				}
+
+				result[word] &= bits;
+			}
+		}
+
+
+		// Row offsets are not validated when the index is opened, since that would read the whole
+		// column; a damaged offset yields a truncated or empty text instead
+		Span<const char> GetRowText(const std::uint64_t* offsets, const char* text, std::uint64_t textSize, std::uint64_t row)
+		{
+			auto begin = std::min(offsets[row], textSize);
+			auto end = std::min(std::max(offsets[row + 1], begin), textSize);
+			return Span<const char>(text + begin, static_cast<std::size_t>(end - begin));
+		}
+
+		[[noreturn]] void ThrowPredicateError(const char* message, const std::wstring& field)
+		{
+			throw std::runtime_error(message + utf16_to_utf8(field));
+		}
+	}
+
+	struct ScanIndexWriter::Columns
+	{
+		struct Text
+		{
+			std::string Bytes;
+			std::vector<std::uint64_t> Offsets{ 0 };
+
+			void Add(const std::string& value)
+			{
+				Bytes += value;
+				Offsets.push_back(Bytes.size());
+			}
+		};
+
+		struct Dictionary
+		{
+			std::vector<std::uint32_t> Codes;
+			std::unordered_map<std::wstring, std::uint32_t> EntryCodes;
+			std::vector<std::string> Entries;
+
+			void Add(const std::wstring& value)
+			{
+				auto entry = EntryCodes.find(value);
+				if (entry == EntryCodes.end())
+				{
+					entry = EntryCodes.emplace(value, static_cast<std::uint32_t>(Entries.size())).first;
+					Entries.push_back(utf16_to_utf8(value));
+				}
+
+				Codes.push_back(entry->second);
+			}
+		};
+
+		struct Bitmap
+		{
+			std::vector<std::uint64_t> Words;
+			std::uint64_t RowCount = 0;
+
+			void Add(bool value)
+			{
+				if (RowCount % RowsPerWord == 0)
+				{
+					Words.push_back(0);
+				}
+
+				Words.back() |= static_cast<std::uint64_t>(value ? 1 : 0) << (RowCount % RowsPerWord);
+				++RowCount;
+			}
+		};
+
+		std::uint64_t RowCount = 0;
+		Text Path;
+		Dictionary Machine;
+		Dictionary Platform;
+		Dictionary Toolset;
+		Dictionary Framework;
+		Dictionary Configuration;
+		Bitmap Dep;
+		Bitmap Aslr;
+		Bitmap HighEntropyVa;
+		Bitmap Cfg;
+		Bitmap Dll;
+		Bitmap Clr;
+		Bitmap Pe32Plus;
+		std::vector<std::uint32_t> Timestamp;
+		std::vector<std::uint32_t> Subsystem;
+		std::vector<std::uint32_t> Linker;
+		std::vector<std::uint64_t> RemovedRows;
+	};
+
+	ScanIndexWriter::ScanIndexWriter()
+		: columns_(std::make_unique<Columns>())
+	{
+	}
+
+	ScanIndexWriter::~ScanIndexWriter()
+	{
+	}
+
+	void ScanIndexWriter::Add(const BatchScanResult& result)
+	{
+		if (!result.Succeeded)
+		{
+			return;
+		}
+
+		auto& columns = *columns_;
+		const auto& raw = result.Info.Raw;
+		auto addItem = [&result](Columns::Dictionary& column, const wchar_t* itemName)
+		{
+			auto value = FindItemValue(result.Info, itemName);
+			column.Add(value != nullptr ? *value : std::wstring());
+		};
+
+		++columns.RowCount;
+		columns.Path.Add(utf16_to_native_path(result.FilePath));
+		columns.Machine.Add(PeFileFormattedInfoExtractor::FormatMachine(raw.Machine));
+		addItem(columns.Platform, L"Platform");
+		addItem(columns.Toolset, L"Toolset");
+		addItem(columns.Framework, L"Target Framework");
+		addItem(columns.Configuration, L"Configuration");
+		columns.Dep.Add(IsFlagSet(raw.DllCharacteristics, IMAGE_DLLCHARACTERISTICS_NX_COMPAT));
+		columns.Aslr.Add(IsFlagSet(raw.DllCharacteristics, IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE));
+		columns.HighEntropyVa.Add(IsFlagSet(raw.DllCharacteristics, IMAGE_DLLCHARACTERISTICS_HIGH_ENTROPY_VA));
+		columns.Cfg.Add(IsFlagSet(raw.DllCharacteristics, IMAGE_DLLCHARACTERISTICS_GUARD_CF));
+		columns.Dll.Add(raw.IsDll);
+		columns.Clr.Add(raw.IsClr);
+		columns.Pe32Plus.Add(raw.IsPe32Plus);
+		columns.Timestamp.push_back(raw.TimeDateStamp);
+		columns.Subsystem.push_back(raw.Subsystem);
+		columns.Linker.push_back(raw.LinkerVersion);
+	}
+
+	void ScanIndexWriter::Remove(std::uint64_t row)
+	{
+		columns_->RemovedRows.push_back(row);
+	}
+
+	std::uint64_t ScanIndexWriter::Write(const std::wstring& indexPath)
+	{
+		// Time stamps tell an index apart from the ones written over it before
+		auto generation = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+		WriteFile(indexPath, generation, nullptr);
+
+		// The delta of the replaced index no longer applies
+		RemoveIndexFile(GetDeltaPath(indexPath));
+		return generation;
+	}
+
+	void ScanIndexWriter::WriteDelta(const std::wstring& indexPath, std::uint64_t generation, std::uint64_t rowCount)
+	{
+		std::vector<std::uint64_t> removedWords(static_cast<std::size_t>(GetWordCount(rowCount)), 0);
+		for (auto row : columns_->RemovedRows)
+		{
+			HandleLogicError(row >= rowCount, "Row is outside of the index");
+			removedWords[static_cast<std::size_t>(row / RowsPerWord)] |= std::uint64_t(1) << (row % RowsPerWord);
+		}
+
+		WriteFile(GetDeltaPath(indexPath), generation, &removedWords);
+	}
+
+	void ScanIndexWriter::WriteFile(const std::wstring& indexPath, std::uint64_t generation, const std::vector<std::uint64_t>* removedWords)
+	{
+		struct Section
+		{
+			const void* Data;
+			std::uint64_t Size;
+		};
+
+		struct ColumnSections
+		{
+			const char* Name;
+			std::uint32_t Kind;
+			Section Values;
+			Section Strings;
+		};
+
+		const auto& columns = *columns_;
+		std::deque<std::string> dictionaryTables;
+		auto dictionarySections = [&dictionaryTables](const Columns::Dictionary& column)
+		{
+			std::string table;
+			auto appendUInt32 = [&table](std::uint32_t value) { table.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+
+			appendUInt32(static_cast<std::uint32_t>(column.Entries.size()));
+			std::uint32_t offset = 0;
+			appendUInt32(offset);
+			for (const auto& entry : column.Entries)
+			{
+				offset += static_cast<std::uint32_t>(entry.size());
+				appendUInt32(offset);
+			}
+
+			for (const auto& entry : column.Entries)
+			{
+				table += entry;
+			}
+
+			dictionaryTables.push_back(std::move(table));
+			return std::make_pair(
+				Section{ column.Codes.data(), column.Codes.size() * sizeof(std::uint32_t) },
+				Section{ dictionaryTables.back().data(), dictionaryTables.back().size() });
+		};
+
+		auto text = [](const char* name, const Columns::Text& column)
+		{
+			return ColumnSections{ name, TextColumn, { column.Offsets.data(), column.Offsets.size() * sizeof(std::uint64_t) }, { column.Bytes.data(), column.Bytes.size() } };
+		};
+
+		auto dictionary = [&dictionarySections](const char* name, const Columns::Dictionary& column)
+		{
+			auto sections = dictionarySections(column);
+			return ColumnSections{ name, DictionaryColumn, sections.first, sections.second };
+		};
+
+		auto bitmap = [](const char* name, const Columns::Bitmap& column)
+		{
+			return ColumnSections{ name, BitmapColumn, { column.Words.data(), column.Words.size() * sizeof(std::uint64_t) }, { nullptr, 0 } };
+		};
+
+		auto number = [](const char* name, const std::vector<std::uint32_t>& column)
+		{
+			return ColumnSections{ name, NumberColumn, { column.data(), column.size() * sizeof(std::uint32_t) }, { nullptr, 0 } };
+		};
+
+		std::vector<ColumnSections> sections =
+		{
+			text("path", columns.Path),
+			dictionary("machine", columns.Machine),
+			dictionary("platform", columns.Platform),
+			dictionary("toolset", columns.Toolset),
+			dictionary("framework", columns.Framework),
+			dictionary("configuration", columns.Configuration),
+			bitmap("dep", columns.Dep),
+			bitmap("aslr", columns.Aslr),
+			bitmap("highentropyva", columns.HighEntropyVa),
+			bitmap("cfg", columns.Cfg),
+			bitmap("dll", columns.Dll),
+			bitmap("clr", columns.Clr),
+			bitmap("pe32plus", columns.Pe32Plus),
+			number("timestamp", columns.Timestamp),
+			number("subsystem", columns.Subsystem),
+			number("linker", columns.Linker)
+		};
+
+		if (removedWords != nullptr)
+		{
+			sections.push_back(ColumnSections{ "removed", RemovedRowsColumn, { removedWords->data(), removedWords->size() * sizeof(std::uint64_t) }, { nullptr, 0 } });
+		}
+
+		const auto columnCount = static_cast<std::uint32_t>(sections.size());
+
+		IndexHeader header{};
+		std::memcpy(header.Magic, IndexMagic, sizeof(header.Magic));
+		header.FormatVersion = IndexFormatVersion;
+		header.ColumnCount = columnCount;
+		header.RowCount = columns.RowCount;
+		header.Generation = generation;
+
+		std::vector<IndexColumnEntry> entries(columnCount);
+		auto offset = AlignSection(sizeof(IndexHeader) + columnCount * sizeof(IndexColumnEntry));
+		for (std::uint32_t i = 0; i < columnCount; ++i)
+		{
+			auto& entry = entries[i];
+			std::strncpy(entry.Name, sections[i].Name, sizeof(entry.Name));
+			entry.Kind = sections[i].Kind;
+			entry.ValuesOffset = offset;
+			entry.ValuesSize = sections[i].Values.Size;
+			offset = AlignSection(offset + entry.ValuesSize);
+			entry.StringsOffset = offset;
+			entry.StringsSize = sections[i].Strings.Size;
+			offset = AlignSection(offset + entry.StringsSize);
+		}
+
+		auto temporaryPath = indexPath + L".tmp";
+		{
+			std::ofstream file(ToFilesystemPath(temporaryPath), std::ios::binary | std::ios::trunc);
+			HandleFormatError(!file, "Failed to create the index file");
+
+			const char padding[SectionAlignment] = {};
+			std::uint64_t position = 0;
+			auto write = [&file, &position, &padding](const void* data, std::uint64_t size, std::uint64_t targetOffset)
+			{
+				file.write(padding, static_cast<std::streamsize>(targetOffset - position));
+				if (size != 0)
+				{
+					file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+				}
+
+				position = targetOffset + size;
+			};
+
+			write(&header, sizeof(header), 0);
+			write(entries.data(), entries.size() * sizeof(IndexColumnEntry), position);
+			for (std::uint32_t i = 0; i < columnCount; ++i)
+			{
+				write(sections[i].Values.Data, sections[i].Values.Size, entries[i].ValuesOffset);
+				write(sections[i].Strings.Data, sections[i].Strings.Size, entries[i].StringsOffset);
+			}
+
+			file.close();
+			HandleFormatError(!file, "Failed to write the index file");
+		}
+
+		ReplaceIndexFile(temporaryPath, indexPath);
+	}
+
+	// One mapped file: the index itself, or the delta segment written for it
+	struct ScanIndex::Segment
+	{
+		struct Column
+		{
+			std::wstring Name;
+			std::uint32_t Kind;
+			const void* Values;
+			std::uint64_t ValuesSize;
+			const void* Strings;
+			std::uint64_t StringsSize;
+		};
+
+		// Takes ownership of the mapping
+		Segment(const void* base, std::uint64_t size);
+		~Segment();
+
+		Segment(const Segment&) = delete;
+		Segment& operator=(const Segment&) = delete;
+
+		std::vector<std::uint64_t> Evaluate(const std::vector<FieldPredicate>& predicates) const;
+		Span<const char> GetPath(std::uint64_t row) const;
+		const Column& FindColumn(const std::wstring& name) const;
+		void EvaluatePredicate(const FieldPredicate& predicate, std::vector<std::uint64_t>& result) const;
+
+		const void* Base;
+		std::uint64_t Size;
+		std::uint64_t RowCount;
+		std::uint64_t Generation;
+		std::vector<Column> Columns;
+		const Column* PathColumn;
+		const std::uint64_t* RemovedRows;  // null outside of a delta segment
+		std::uint64_t RemovedWordCount;
+	};
+
+	ScanIndex::Segment::Segment(const void* base, std::uint64_t size)
+		: Base(base), Size(size), RowCount(0), Generation(0), PathColumn(nullptr), RemovedRows(nullptr), RemovedWordCount(0)
+	{
+		try
+		{
+			auto header = static_cast<const IndexHeader*>(Base);
+			HandleFormatError(Size < sizeof(IndexHeader) || std::memcmp(header->Magic, IndexMagic, sizeof(IndexMagic)) != 0, "Not a scan index file");
+			HandleFormatError(header->FormatVersion != IndexFormatVersion, "Unsupported scan index version");
+			HandleFormatError(header->ColumnCount > (Size - sizeof(IndexHeader)) / sizeof(IndexColumnEntry), "Scan index is corrupt");
+			RowCount = header->RowCount;
+			Generation = header->Generation;
+
+			auto entries = AddOffset<const IndexColumnEntry>(Base, sizeof(IndexHeader));
+			for (std::uint32_t i = 0; i < header->ColumnCount; ++i)
+			{
+				const auto& entry = entries[i];
+				auto isInFile = [this](std::uint64_t offset, std::uint64_t size)
+				{
+					return offset % SectionAlignment == 0 && offset <= Size && size <= Size - offset;
+				};
+
+				HandleFormatError(!isInFile(entry.ValuesOffset, entry.ValuesSize) || !isInFile(entry.StringsOffset, entry.StringsSize), "Scan index is corrupt");
+
+				Column column{ std::wstring(entry.Name, std::find(entry.Name, entry.Name + sizeof(entry.Name), '\0')), entry.Kind,
+					AddOffset<const void>(Base, static_cast<ptrdiff_t>(entry.ValuesOffset)), entry.ValuesSize,
+					AddOffset<const void>(Base, static_cast<ptrdiff_t>(entry.StringsOffset)), entry.StringsSize };
+
+				bool isValid = false;
+				switch (entry.Kind)
+				{
+				case TextColumn:
+				{
+					auto offsets = static_cast<const std::uint64_t*>(column.Values);
+					isValid = entry.ValuesSize >= sizeof(std::uint64_t) && entry.ValuesSize / sizeof(std::uint64_t) - 1 == RowCount && offsets[0] == 0 && offsets[RowCount] <= entry.StringsSize;
+					break;
+				}
+				case DictionaryColumn:
+				{
+					auto table = static_cast<const std::uint32_t*>(column.Strings);
+					isValid = entry.ValuesSize / sizeof(std::uint32_t) == RowCount && entry.StringsSize >= 2 * sizeof(std::uint32_t)
+						&& table[0] <= entry.StringsSize / sizeof(std::uint32_t) - 2;
+					for (std::uint32_t entryIndex = 0; isValid && entryIndex < table[0]; ++entryIndex)
+					{
+						auto textSize = entry.StringsSize - (table[0] + 2) * sizeof(std::uint32_t);
+						isValid = table[entryIndex + 1] <= table[entryIndex + 2] && table[entryIndex + 2] <= textSize;
+					}
+					break;
+				}
+				case BitmapColumn:
+					isValid = entry.ValuesSize / sizeof(std::uint64_t) == GetWordCount(RowCount);
+					break;
+				case NumberColumn:
+					isValid = entry.ValuesSize / sizeof(std::uint32_t) == RowCount;
+					break;
+				case RemovedRowsColumn:
+					// The size is checked against the index the delta applies to
+					isValid = RemovedRows == nullptr;
+					RemovedRows = static_cast<const std::uint64_t*>(column.Values);
+					RemovedWordCount = entry.ValuesSize / sizeof(std::uint64_t);
+					break;
+				}
+
+				HandleFormatError(!isValid, "Scan index is corrupt");
+				Columns.push_back(std::move(column));
+			}
+
+			PathColumn = &FindColumn(L"path");
+			HandleFormatError(PathColumn->Kind != TextColumn, "Scan index is corrupt");
+		}
+		catch (...)
+		{
+			UnmapIndexFile(Base, Size);
+			throw;
+		}
+	}
+
+	ScanIndex::Segment::~Segment()
+	{
+		UnmapIndexFile(Base, Size);
+	}
+
+	std::vector<std::uint64_t> ScanIndex::Segment::Evaluate(const std::vector<FieldPredicate>& predicates) const
+	{
+		std::vector<std::uint64_t> result(static_cast<std::size_t>(GetWordCount(RowCount)), ~std::uint64_t(0));
+		if (RowCount % RowsPerWord != 0)
+		{
+			result.back() = (std::uint64_t(1) << (RowCount % RowsPerWord)) - 1;
+		}
+
+		for (const auto& predicate : predicates)
+		{
+			EvaluatePredicate(predicate, result);
+		}
+
+		return result;
+	}
+
+	Span<const char> ScanIndex::Segment::GetPath(std::uint64_t row) const
+	{
+		HandleLogicError(row >= RowCount, "Row is outside of the index");
+
+		auto offsets = static_cast<const std::uint64_t*>(PathColumn->Values);
+		return GetRowText(offsets, static_cast<const char*>(PathColumn->Strings), PathColumn->StringsSize, row);
+	}
+
+	const ScanIndex::Segment::Column& ScanIndex::Segment::FindColumn(const std::wstring& name) const
+	{
+		for (const auto& column : Columns)
+		{
+			if (column.Name == name)
+			{
+				return column;
+			}
+		}
+
+		ThrowPredicateError("Unknown field: ", name);
+	}
+
+	void ScanIndex::Segment::EvaluatePredicate(const FieldPredicate& predicate, std::vector<std::uint64_t>& result) const
+	{
+		const auto& column = FindColumn(predicate.Field);
+		auto predicateOperator = predicate.Operator;
+
+		switch (column.Kind)
+		{
+		case BitmapColumn:
+		{
+			bool value = false;
+			if ((predicateOperator != PredicateOperator::Equal && predicateOperator != PredicateOperator::NotEqual) || !TryParseFlagValue(predicate.Value, value))
+			{
+				ThrowPredicateError("Expected =yes, =no, !=yes or !=no for field: ", predicate.Field);
+			}
+
+			bool matchesSetBits = MatchesFlag(true, predicateOperator, value);
+			auto words = static_cast<const std::uint64_t*>(column.Values);
+			for (std::size_t word = 0; word < result.size(); ++word)
+			{
+				result[word] &= matchesSetBits ? words[word] : ~words[word];
+			}
+			break;
+		}
+		case NumberColumn:
+		{
+			std::uint64_t value = 0;
+			if (predicateOperator == PredicateOperator::Contains || !TryParseNumberValue(predicate.Value, value))
+			{
+				ThrowPredicateError("Expected a number and a comparison for field: ", predicate.Field);
+			}
+
+			auto values = static_cast<const std::uint32_t*>(column.Values);
+			switch (predicateOperator)
+			{
+			case PredicateOperator::Equal:
+				ScanRows(RowCount, [values, value](std::uint64_t row) { return values[row] == value; }, result);
+				break;
+			case PredicateOperator::NotEqual:
+				ScanRows(RowCount, [values, value](std::uint64_t row) { return values[row] != value; }, result);
+				break;
+			case PredicateOperator::Less:
+				ScanRows(RowCount, [values, value](std::uint64_t row) { return values[row] < value; }, result);
+				break;
+			case PredicateOperator::LessOrEqual:
+				ScanRows(RowCount, [values, value](std::uint64_t row) { return values[row] <= value; }, result);
+				break;
+			case PredicateOperator::Greater:
+				ScanRows(RowCount, [values, value](std::uint64_t row) { return values[row] > value; }, result);
+				break;
+			case PredicateOperator::GreaterOrEqual:
+				ScanRows(RowCount, [values, value](std::uint64_t row) { return values[row] >= value; }, result);
+				break;
+			default:
+				break;
+			}
+			break;
+		}
+		case DictionaryColumn:
+		{
+			// The predicate is decided once per dictionary entry; the scan only looks codes up.
+			// Codes outside of the dictionary map to the extra entry, which never matches.
+			auto value = utf16_to_utf8(predicate.Value);
+			auto table = static_cast<const std::uint32_t*>(column.Strings);
+			auto entryCount = table[0];
+			auto text = AddOffset<const char>(table, static_cast<ptrdiff_t>((entryCount + 2) * sizeof(std::uint32_t)));
+
+			std::vector<std::uint8_t> matches(entryCount + 1, 0);
+			for (std::uint32_t entry = 0; entry < entryCount; ++entry)
+			{
+				Span<const char> entryText(text + table[entry + 1], table[entry + 2] - table[entry + 1]);
+				matches[entry] = MatchesText(entryText, predicateOperator, Span<const char>(value.data(), value.size())) ? 1 : 0;
+			}
+
+			auto codes = static_cast<const std::uint32_t*>(column.Values);
+			auto matchTable = matches.data();
+			ScanRows(RowCount, [codes, matchTable, entryCount](std::uint64_t row) { return matchTable[std::min(codes[row], entryCount)] != 0; }, result);
+			break;
+		}
+		case TextColumn:
+		{
+			auto value = utf16_to_native_path(predicate.Value);
+			auto offsets = static_cast<const std::uint64_t*>(column.Values);
+			auto text = static_cast<const char*>(column.Strings);
+			auto textSize = column.StringsSize;
+			Span<const char> valueText(value.data(), value.size());
+			ScanRows(RowCount, [offsets, text, textSize, valueText, predicateOperator](std::uint64_t row)
+			{
+				return MatchesText(GetRowText(offsets, text, textSize, row), predicateOperator, valueText);
+			}, result);
+			break;
+		}
+		default:
+			ThrowPredicateError("Unsupported column kind for field: ", predicate.Field);
+		}
+	}
+
+	ScanIndex::ScanIndex(const std::wstring& indexPath)
+		: rowCount_(0)
+	{
+		// Queries read whole columns
+		std::uint64_t size = 0;
+		auto base = MapIndexFile(indexPath, true, size);
+		index_ = std::make_unique<Segment>(base, size);
+		HandleFormatError(index_->RemovedRows != nullptr, "Scan index is corrupt");
+
+		auto deltaBase = TryMapIndexFile(GetDeltaPath(indexPath), true, size);
+		if (deltaBase != nullptr)
+		{
+			auto delta = std::make_unique<Segment>(deltaBase, size);
+
+			// A delta left behind by an index that has been replaced since does not apply
+			if (delta->Generation == index_->Generation)
+			{
+				HandleFormatError(delta->RemovedRows == nullptr || delta->RemovedWordCount != GetWordCount(index_->RowCount), "Scan index is corrupt");
+				delta_ = std::move(delta);
+			}
+		}
+
+		for (auto word : Evaluate(std::vector<FieldPredicate>()))
+		{
+			rowCount_ += std::bitset<64>(word).count();
+		}
+	}
+
+	ScanIndex::~ScanIndex()
+	{
+	}
+
+	std::uint64_t ScanIndex::GetRowCount() const
+	{
+		return rowCount_;
+	}
+
+	std::vector<std::uint64_t> ScanIndex::Evaluate(const std::vector<FieldPredicate>& predicates) const
+	{
+		auto result = index_->Evaluate(predicates);
+		if (delta_)
+		{
+			for (std::size_t word = 0; word < result.size(); ++word)
+			{
+				result[word] &= ~delta_->RemovedRows[word];
+			}
+
+			auto deltaResult = delta_->Evaluate(predicates);
+			result.insert(result.end(), deltaResult.begin(), deltaResult.end());
+		}
+
+		return result;
+	}
+
+	Span<const char> ScanIndex::GetPath(std::uint64_t row) const
+	{
+		auto deltaFirstRow = GetWordCount(index_->RowCount) * RowsPerWord;
+		if (delta_ && row >= deltaFirstRow)
+		{
+			return delta_->GetPath(row - deltaFirstRow);
+		}
+
+		return index_->GetPath(row);
+	}
+}
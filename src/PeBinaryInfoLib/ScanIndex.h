@@ -0,0 +1,82 @@
+#pragma once
+#include "BatchScanner.h"
+#include "Predicate.h"
+
+namespace peinfo
+{
+	// Collects extracted batch scan results and writes them as a ScanIndex file, or as the delta
+	// segment of one. Failed results are not indexed. Rows are kept in column order in memory
+	// until Write.
+	class ScanIndexWriter
+	{
+	public:
+		ScanIndexWriter();
+		~ScanIndexWriter();
+
+		ScanIndexWriter(const ScanIndexWriter&) = delete;
+		ScanIndexWriter& operator=(const ScanIndexWriter&) = delete;
+
+		void Add(const BatchScanResult& result);
+
+		// Marks a row of the index the delta is written for as replaced or removed
+		void Remove(std::uint64_t row);
+
+		// Writes a temporary file next to the index and renames it over the index, so readers
+		// never map a partially written file. Removes the delta of the replaced index and returns
+		// the generation that deltas written for the new index refer to.
+		std::uint64_t Write(const std::wstring& indexPath);
+
+		// Writes the added and the removed rows as the delta segment of the index of the
+		// generation, which has the given number of rows, replacing its earlier delta.
+		void WriteDelta(const std::wstring& indexPath, std::uint64_t generation, std::uint64_t rowCount);
+
+	private:
+		struct Columns;
+
+		void WriteFile(const std::wstring& indexPath, std::uint64_t generation, const std::vector<std::uint64_t>* removedWords);
+
+		std::unique_ptr<Columns> columns_;
+	};
+
+	// Read-only mapping of a columnar index of scan results. Every field is one column:
+	// machine, platform, toolset, framework and configuration are dictionary-encoded strings,
+	// dep, aslr, highentropyva, cfg, dll, clr and pe32plus are bitmaps, timestamp, subsystem and
+	// linker are 32-bit numbers, and path holds the file paths as utf16_to_native_path writes them.
+	//
+	// A query resolves each predicate to the dictionary codes it accepts, then scans the column
+	// 64 rows at a time into a word of the result bitmap. Bitmap columns are combined a word at a
+	// time, and only the rows that remain set are touched to read their paths.
+	//
+	// An index can have a delta segment next to it, named like the index with ".delta" appended,
+	// which holds the rows of files that changed since the index was written and a bitmap of the
+	// index rows they replace or that were removed. A query evaluates both and clears the removed
+	// rows, so an index that is updated often does not have to be rewritten whole every time. A
+	// delta applies only to the index of the generation it was written for.
+	class ScanIndex
+	{
+	public:
+		explicit ScanIndex(const std::wstring& indexPath);
+		~ScanIndex();
+
+		ScanIndex(const ScanIndex&) = delete;
+		ScanIndex& operator=(const ScanIndex&) = delete;
+
+		// Rows a query can match: those of the index that the delta leaves in place, and the delta's
+		std::uint64_t GetRowCount() const;
+
+		// Returns one bit per row, set for the rows that match every predicate. Throws for unknown
+		// fields and for operators or values that do not apply to the field. The rows of the delta
+		// follow those of the index, starting at the next word.
+		std::vector<std::uint64_t> Evaluate(const std::vector<FieldPredicate>& predicates) const;
+
+		// Path of the row as utf16_to_native_path writes it
+		Span<const char> GetPath(std::uint64_t row) const;
+
+	private:
+		struct Segment;
+
+		std::unique_ptr<Segment> index_;
+		std::unique_ptr<Segment> delta_;
+		std::uint64_t rowCount_;
+	};
+}
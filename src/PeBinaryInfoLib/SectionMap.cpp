@@ -0,0 +1,154 @@
+#include "stdafx.h"
+#include "PeBinaryInfo.h"
+#include "SectionMap.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		DWORD AlignUp(DWORD value, DWORD alignment)
+		{
+			if (alignment == 0)
+			{
+				return value;
+			}
+
+			auto aligned = (static_cast<std::uint64_t>(value) + alignment - 1) / alignment * alignment;
+			return static_cast<DWORD>(std::min<std::uint64_t>(aligned, std::numeric_limits<DWORD>::max()));
+		}
+
+		// The loader ignores the low bits of PointerToRawData when the file alignment is at least 512
+		const DWORD MinimumRawDataAlignment = 0x200;
+	}
+
+	SectionMap::SectionMap()
+		: fileSize_(0), lastHit_(0)
+	{
+	}
+
+	SectionMap::SectionMap(const IMAGE_SECTION_HEADER* sections, WORD sectionCount, DWORD sizeOfHeaders, DWORD fileAlignment, std::uint64_t fileSize)
+		: fileSize_(fileSize), lastHit_(0)
+	{
+		regions_.reserve(sectionCount + 1);
+
+		auto headersSize = static_cast<DWORD>(std::min<std::uint64_t>(sizeOfHeaders, fileSize));
+		regions_.push_back(Region{ 0, headersSize, 0, headersSize });
+
+		for (WORD i = 0; i < sectionCount; ++i)
+		{
+			const auto& section = sections[i];
+			auto virtualSize = section.Misc.VirtualSize != 0 ? section.Misc.VirtualSize : section.SizeOfRawData;
+			auto virtualEnd = static_cast<DWORD>(std::min<std::uint64_t>(
+				static_cast<std::uint64_t>(section.VirtualAddress) + virtualSize, std::numeric_limits<DWORD>::max()));
+
+			auto rawStart = section.PointerToRawData;
+			if (fileAlignment >= MinimumRawDataAlignment)
+			{
+				rawStart &= ~(MinimumRawDataAlignment - 1);
+			}
+
+			auto rawSize = section.PointerToRawData == 0 ? 0 : std::min(AlignUp(section.SizeOfRawData, fileAlignment), virtualSize);
+			regions_.push_back(Region{ section.VirtualAddress, virtualEnd, rawStart, rawSize });
+		}
+
+		std::stable_sort(regions_.begin(), regions_.end(), [](const Region& left, const Region& right)
+		{
+			return left.VirtualStart < right.VirtualStart;
+		});
+	}
+
+	RvaLookupStatus SectionMap::RvaToFileOffset(DWORD rva, DWORD& fileOffset) const
+	{
+		DWORD availableSize = 0;
+		return RvaToFileOffset(rva, fileOffset, availableSize);
+	}
+
+	RvaLookupStatus SectionMap::RvaToFileOffset(DWORD rva, DWORD& fileOffset, DWORD& availableSize) const
+	{
+		auto region = FindRegion(rva);
+		if (region == nullptr)
+		{
+			return RvaLookupStatus::NotMapped;
+		}
+
+		auto delta = rva - region->VirtualStart;
+		auto offset = static_cast<std::uint64_t>(region->RawStart) + delta;
+		if (delta >= region->RawSize || offset >= fileSize_)
+		{
+			return RvaLookupStatus::NotInFile;
+		}
+
+		fileOffset = static_cast<DWORD>(offset);
+		availableSize = static_cast<DWORD>(std::min<std::uint64_t>(region->RawSize - delta, fileSize_ - offset));
+		return RvaLookupStatus::Success;
+	}
+
+	RvaLookupStatus SectionMap::GetSectionRange(DWORD rva, DWORD& fileOffset, DWORD& size) const
+	{
+		DWORD rvaOffset = 0;
+		DWORD availableSize = 0;
+		auto status = RvaToFileOffset(rva, rvaOffset, availableSize);
+		if (status == RvaLookupStatus::Success)
+		{
+			auto region = FindRegion(rva);
+			fileOffset = region->RawStart;
+			size = rvaOffset - region->RawStart + availableSize;
+		}
+
+		return status;
+	}
+
+	std::size_t SectionMap::RvaToFileOffsets(Span<const DWORD> rvas, Span<DWORD> fileOffsets, Span<RvaLookupStatus> statuses) const
+	{
+		HandleLogicError(fileOffsets.size() < rvas.size() || statuses.size() < rvas.size(), "Output spans are smaller than the input");
+
+		std::size_t translatedCount = 0;
+		for (std::size_t i = 0; i < rvas.size(); ++i)
+		{
+			statuses[i] = RvaToFileOffset(rvas[i], fileOffsets[i]);
+			if (statuses[i] == RvaLookupStatus::Success)
+			{
+				++translatedCount;
+			}
+		}
+
+		return translatedCount;
+	}
+
+	const SectionMap::Region* SectionMap::FindRegion(DWORD rva) const
+	{
+		if (regions_.empty())
+		{
+			return nullptr;
+		}
+
+		// A later region that starts inside the last one takes the RVAs from its start on, as the
+		// search below does, so the last hit only answers up to the start of the next region
+		const auto& lastRegion = regions_[lastHit_];
+		auto lastEnd = lastHit_ + 1 < regions_.size() ? std::min(lastRegion.VirtualEnd, regions_[lastHit_ + 1].VirtualStart) : lastRegion.VirtualEnd;
+		if (rva >= lastRegion.VirtualStart && rva < lastEnd)
+		{
+			return &lastRegion;
+		}
+
+		// last region that starts at or before the RVA
+		auto next = std::upper_bound(regions_.begin(), regions_.end(), rva, [](DWORD value, const Region& region)
+		{
+			return value < region.VirtualStart;
+		});
+
+		if (next == regions_.begin())
+		{
+			return nullptr;
+		}
+
+		auto region = std::prev(next);
+		if (rva >= region->VirtualEnd)
+		{
+			return nullptr;
+		}
+
+		lastHit_ = static_cast<std::size_t>(region - regions_.begin());
+		return &*region;
+	}
+}
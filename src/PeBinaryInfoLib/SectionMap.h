@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include "Helpers.h"
+
+namespace peinfo
+{
+	enum class RvaLookupStatus
+	{
+		Success,
+		NotMapped,  // the RVA is neither in the headers nor in any section
+		NotInFile   // the RVA is mapped but has no data in the file, e.g. uninitialized data or a truncated file
+	};
+
+	// Translates RVAs to file offsets the way the loader lays out the image. Section bounds are sorted
+	// once per file, so a lookup is a binary search, and the last matching section is checked first
+	// because consecutive lookups usually land in the same section.
+	class SectionMap
+	{
+	public:
+		SectionMap();
+		SectionMap(const IMAGE_SECTION_HEADER* sections, WORD sectionCount, DWORD sizeOfHeaders, DWORD fileAlignment, std::uint64_t fileSize);
+
+		RvaLookupStatus RvaToFileOffset(DWORD rva, DWORD& fileOffset) const;
+
+		// Also returns how many bytes of the section are in the file from the RVA on, so data of
+		// unknown length, such as a string, can be read without running past the section.
+		RvaLookupStatus RvaToFileOffset(DWORD rva, DWORD& fileOffset, DWORD& availableSize) const;
+
+		// The part of the file that holds the section, or the headers, the RVA is in
+		RvaLookupStatus GetSectionRange(DWORD rva, DWORD& fileOffset, DWORD& size) const;
+
+		// fileOffsets[i] is only set when statuses[i] is RvaLookupStatus::Success.
+		// Returns the number of RVAs that were translated successfully.
+		std::size_t RvaToFileOffsets(Span<const DWORD> rvas, Span<DWORD> fileOffsets, Span<RvaLookupStatus> statuses) const;
+
+	private:
+		struct Region
+		{
+			DWORD VirtualStart;
+			DWORD VirtualEnd;
+			DWORD RawStart;
+			DWORD RawSize;
+		};
+
+		const Region* FindRegion(DWORD rva) const;
+
+		std::vector<Region> regions_;
+		std::uint64_t fileSize_;
+		mutable std::size_t lastHit_;
+	};
+}
@@ -0,0 +1,422 @@
+#include "stdafx.h"
+#include "SymbolIndex.h"
+#include "FilesystemPath.h"
+#include "IndexFile.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		const char IndexMagic[8] = { 'P', 'E', 'I', 'N', 'F', 'O', 'S', 'X' };
+		const std::uint32_t IndexFormatVersion = 1;
+
+		struct IndexSection
+		{
+			std::uint64_t Offset;
+			std::uint64_t Size;
+		};
+
+		struct IndexHeader
+		{
+			char Magic[8];
+			std::uint32_t FormatVersion;
+			std::uint32_t FileCount;
+			std::uint32_t TermCount;
+			std::uint32_t Reserved;
+			IndexSection PathOffsets;     // file count + 1 64-bit offsets into PathText
+			IndexSection PathText;        // the paths, as utf16_to_native_path writes them
+			IndexSection TermOffsets;     // term count + 1 64-bit offsets into TermText
+			IndexSection TermText;        // the UTF-8 terms, sorted by bytes
+			IndexSection PostingCounts;   // the number of files of every term, 32 bits each
+			IndexSection PostingOffsets;  // term count + 1 64-bit offsets into Postings
+			IndexSection Postings;        // the varint-encoded file number differences of every term
+		};
+
+		// Every section starts at a multiple of this, so the tables can be read as arrays in place
+		const std::uint64_t SectionAlignment = 8;
+
+		std::uint64_t AlignSection(std::uint64_t offset)
+		{
+			return (offset + SectionAlignment - 1) / SectionAlignment * SectionAlignment;
+		}
+
+		std::string ToLowerAscii(std::string text)
+		{
+			for (auto& character : text)
+			{
+				if (character >= 'A' && character <= 'Z')
+				{
+					character = static_cast<char>(character - 'A' + 'a');
+				}
+			}
+
+			return text;
+		}
+
+		std::string FormatFunction(const ImportedFunction& function)
+		{
+			return function.IsOrdinal ? "#" + std::to_string(function.Ordinal) : std::string(function.Name.begin(), function.Name.end());
+		}
+
+		void AppendVarint(std::string& bytes, std::uint32_t value)
+		{
+			while (value >= 0x80)
+			{
+				bytes.push_back(static_cast<char>((value & 0x7F) | 0x80));
+				value >>= 7;
+			}
+
+			bytes.push_back(static_cast<char>(value));
+		}
+
+		// Offsets are not validated when the index is opened, since that would read the whole
+		// table; a damaged offset yields a truncated or empty text instead
+		Span<const char> GetText(const std::uint64_t* offsets, const char* text, std::uint64_t textSize, std::uint64_t index)
+		{
+			auto begin = std::min(offsets[index], textSize);
+			auto end = std::min(std::max(offsets[index + 1], begin), textSize);
+			return Span<const char>(text + begin, static_cast<std::size_t>(end - begin));
+		}
+	}
+
+	// The posting lists of one thread. File numbers are taken in increasing order, so every list
+	// stays sorted as it grows and a file is only appended once.
+	struct SymbolIndexWriter::Partial
+	{
+		std::vector<std::pair<std::uint32_t, std::string>> Files;
+		std::unordered_map<std::string, std::vector<std::uint32_t>> Postings;
+
+		void AddTerm(const std::string& term, std::uint32_t fileId)
+		{
+			auto& fileIds = Postings[term];
+			if (fileIds.empty() || fileIds.back() != fileId)
+			{
+				fileIds.push_back(fileId);
+			}
+		}
+	};
+
+	SymbolIndexWriter::SymbolIndexWriter()
+		: nextFileId_(0)
+	{
+	}
+
+	SymbolIndexWriter::~SymbolIndexWriter()
+	{
+	}
+
+	void SymbolIndexWriter::Add(const std::wstring& filePath, const ImportTable& imports)
+	{
+		auto path = utf16_to_native_path(filePath);
+		auto& partial = GetPartial();
+		auto fileId = nextFileId_++;
+		partial.Files.emplace_back(fileId, std::move(path));
+
+		for (const auto& module : imports.GetModules())
+		{
+			auto moduleName = ToLowerAscii(std::string(module.Name.begin(), module.Name.end()));
+			partial.AddTerm(moduleName, fileId);
+			for (const auto& function : module.Functions)
+			{
+				auto functionName = FormatFunction(function);
+				if (!function.IsOrdinal)
+				{
+					partial.AddTerm("!" + functionName, fileId);
+				}
+
+				partial.AddTerm(moduleName + "!" + functionName, fileId);
+			}
+		}
+	}
+
+	SymbolIndexWriter::Partial& SymbolIndexWriter::GetPartial()
+	{
+		std::lock_guard<std::mutex> lock(partialsMutex_);
+		auto& partial = partials_[std::this_thread::get_id()];
+		if (!partial)
+		{
+			partial = std::make_unique<Partial>();
+		}
+
+		return *partial;
+	}
+
+	void SymbolIndexWriter::Write(const std::wstring& indexPath)
+	{
+		std::uint32_t fileCount = nextFileId_;
+		std::vector<const std::string*> paths(fileCount, nullptr);
+		std::vector<std::string> terms;
+		for (const auto& partial : partials_)
+		{
+			for (const auto& file : partial.second->Files)
+			{
+				paths[file.first] = &file.second;
+			}
+
+			for (const auto& posting : partial.second->Postings)
+			{
+				terms.push_back(posting.first);
+			}
+		}
+
+		std::sort(terms.begin(), terms.end());
+		terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+		std::vector<std::uint64_t> pathOffsets{ 0 };
+		std::string pathText;
+		for (auto path : paths)
+		{
+			pathText += *path;
+			pathOffsets.push_back(pathText.size());
+		}
+
+		// Every file is in one partial only, so merging the lists of a term is a sort of their concatenation
+		std::vector<std::uint64_t> termOffsets{ 0 };
+		std::string termText;
+		std::vector<std::uint32_t> postingCounts;
+		std::vector<std::uint64_t> postingOffsets{ 0 };
+		std::string postings;
+		std::vector<std::uint32_t> fileIds;
+		for (const auto& term : terms)
+		{
+			termText += term;
+			termOffsets.push_back(termText.size());
+
+			fileIds.clear();
+			for (const auto& partial : partials_)
+			{
+				auto posting = partial.second->Postings.find(term);
+				if (posting != partial.second->Postings.end())
+				{
+					fileIds.insert(fileIds.end(), posting->second.begin(), posting->second.end());
+				}
+			}
+
+			std::sort(fileIds.begin(), fileIds.end());
+			std::uint32_t previousFileId = 0;
+			for (auto fileId : fileIds)
+			{
+				AppendVarint(postings, fileId - previousFileId);
+				previousFileId = fileId;
+			}
+
+			postingCounts.push_back(static_cast<std::uint32_t>(fileIds.size()));
+			postingOffsets.push_back(postings.size());
+		}
+
+		IndexHeader header{};
+		std::memcpy(header.Magic, IndexMagic, sizeof(header.Magic));
+		header.FormatVersion = IndexFormatVersion;
+		header.FileCount = fileCount;
+		header.TermCount = static_cast<std::uint32_t>(terms.size());
+
+		struct Section
+		{
+			IndexSection& Entry;
+			const void* Data;
+			std::uint64_t Size;
+		};
+
+		const Section sections[] =
+		{
+			{ header.PathOffsets, pathOffsets.data(), pathOffsets.size() * sizeof(std::uint64_t) },
+			{ header.PathText, pathText.data(), pathText.size() },
+			{ header.TermOffsets, termOffsets.data(), termOffsets.size() * sizeof(std::uint64_t) },
+			{ header.TermText, termText.data(), termText.size() },
+			{ header.PostingCounts, postingCounts.data(), postingCounts.size() * sizeof(std::uint32_t) },
+			{ header.PostingOffsets, postingOffsets.data(), postingOffsets.size() * sizeof(std::uint64_t) },
+			{ header.Postings, postings.data(), postings.size() }
+		};
+
+		auto offset = AlignSection(sizeof(IndexHeader));
+		for (const auto& section : sections)
+		{
+			section.Entry = IndexSection{ offset, section.Size };
+			offset = AlignSection(offset + section.Size);
+		}
+
+		auto temporaryPath = indexPath + L".tmp";
+		{
+			std::ofstream file(ToFilesystemPath(temporaryPath), std::ios::binary | std::ios::trunc);
+			HandleFormatError(!file, "Failed to create the index file");
+
+			const char padding[SectionAlignment] = {};
+			std::uint64_t position = 0;
+			auto write = [&file, &position, &padding](const void* data, std::uint64_t size, std::uint64_t targetOffset)
+			{
+				file.write(padding, static_cast<std::streamsize>(targetOffset - position));
+				if (size != 0)
+				{
+					file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+				}
+
+				position = targetOffset + size;
+			};
+
+			write(&header, sizeof(header), 0);
+			for (const auto& section : sections)
+			{
+				write(section.Data, section.Size, section.Entry.Offset);
+			}
+
+			file.close();
+			HandleFormatError(!file, "Failed to write the index file");
+		}
+
+		ReplaceIndexFile(temporaryPath, indexPath);
+	}
+
+	SymbolIndex::SymbolIndex(const std::wstring& indexPath)
+		: base_(nullptr), size_(0), fileCount_(0), termCount_(0), pathOffsets_(nullptr), pathText_(nullptr), pathTextSize_(0),
+		termOffsets_(nullptr), termText_(nullptr), termTextSize_(0), postingCounts_(nullptr), postingOffsets_(nullptr),
+		postings_(nullptr), postingsSize_(0)
+	{
+		// A lookup reads a few terms and one posting list
+		base_ = MapIndexFile(indexPath, false, size_);
+
+		try
+		{
+			auto header = static_cast<const IndexHeader*>(base_);
+			HandleFormatError(size_ < sizeof(IndexHeader) || std::memcmp(header->Magic, IndexMagic, sizeof(IndexMagic)) != 0, "Not a symbol index file");
+			HandleFormatError(header->FormatVersion != IndexFormatVersion, "Unsupported symbol index version");
+			fileCount_ = header->FileCount;
+			termCount_ = header->TermCount;
+
+			auto getSection = [this](const IndexSection& section, std::uint64_t expectedSize)
+			{
+				HandleFormatError(section.Offset % SectionAlignment != 0 || section.Offset > size_ || section.Size > size_ - section.Offset
+					|| (expectedSize != 0 && section.Size != expectedSize), "Symbol index is corrupt");
+				return AddOffset<const void>(base_, static_cast<ptrdiff_t>(section.Offset));
+			};
+
+			pathOffsets_ = static_cast<const std::uint64_t*>(getSection(header->PathOffsets, (std::uint64_t(fileCount_) + 1) * sizeof(std::uint64_t)));
+			pathText_ = static_cast<const char*>(getSection(header->PathText, 0));
+			pathTextSize_ = header->PathText.Size;
+			termOffsets_ = static_cast<const std::uint64_t*>(getSection(header->TermOffsets, (std::uint64_t(termCount_) + 1) * sizeof(std::uint64_t)));
+			termText_ = static_cast<const char*>(getSection(header->TermText, 0));
+			termTextSize_ = header->TermText.Size;
+			postingCounts_ = static_cast<const std::uint32_t*>(getSection(header->PostingCounts, std::uint64_t(termCount_) * sizeof(std::uint32_t)));
+			postingOffsets_ = static_cast<const std::uint64_t*>(getSection(header->PostingOffsets, (std::uint64_t(termCount_) + 1) * sizeof(std::uint64_t)));
+			postings_ = static_cast<const std::uint8_t*>(getSection(header->Postings, 0));
+			postingsSize_ = header->Postings.Size;
+
+			HandleFormatError(pathOffsets_[0] != 0 || pathOffsets_[fileCount_] > pathTextSize_
+				|| termOffsets_[0] != 0 || termOffsets_[termCount_] > termTextSize_
+				|| postingOffsets_[0] != 0 || postingOffsets_[termCount_] > postingsSize_, "Symbol index is corrupt");
+		}
+		catch (...)
+		{
+			UnmapIndexFile(base_, size_);
+			throw;
+		}
+	}
+
+	SymbolIndex::~SymbolIndex()
+	{
+		UnmapIndexFile(base_, size_);
+	}
+
+	std::uint32_t SymbolIndex::GetFileCount() const
+	{
+		return fileCount_;
+	}
+
+	std::vector<std::uint32_t> SymbolIndex::FindFunction(const std::string& symbol) const
+	{
+		// Function names have no '!', so it separates the module
+		auto separator = symbol.rfind('!');
+		std::vector<std::uint32_t> fileIds;
+		if (separator == std::string::npos)
+		{
+			TryFindTerm("!" + symbol, fileIds);
+		}
+		else
+		{
+			auto moduleName = ToLowerAscii(symbol.substr(0, separator));
+			auto functionName = symbol.substr(separator);
+			if (!TryFindTerm(moduleName + functionName, fileIds) && moduleName.find('.') == std::string::npos)
+			{
+				TryFindTerm(moduleName + ".dll" + functionName, fileIds);
+			}
+		}
+
+		return fileIds;
+	}
+
+	std::vector<std::uint32_t> SymbolIndex::FindModule(const std::string& moduleName) const
+	{
+		auto term = ToLowerAscii(moduleName);
+		std::vector<std::uint32_t> fileIds;
+		if (!TryFindTerm(term, fileIds) && term.find('.') == std::string::npos)
+		{
+			TryFindTerm(term + ".dll", fileIds);
+		}
+
+		return fileIds;
+	}
+
+	Span<const char> SymbolIndex::GetPath(std::uint32_t fileId) const
+	{
+		HandleLogicError(fileId >= fileCount_, "File number is outside of the symbol index");
+		return GetText(pathOffsets_, pathText_, pathTextSize_, fileId);
+	}
+
+	bool SymbolIndex::TryFindTerm(const std::string& term, std::vector<std::uint32_t>& fileIds) const
+	{
+		std::uint32_t first = 0;
+		std::uint32_t last = termCount_;
+		while (first < last)
+		{
+			auto middle = first + (last - first) / 2;
+			auto candidate = GetText(termOffsets_, termText_, termTextSize_, middle);
+			auto comparison = std::string_view(candidate.data(), candidate.size()).compare(term);
+			if (comparison < 0)
+			{
+				first = middle + 1;
+			}
+			else if (comparison > 0)
+			{
+				last = middle;
+			}
+			else
+			{
+				first = middle;
+				break;
+			}
+		}
+
+		if (first == last)
+		{
+			return false;
+		}
+
+		// The count bounds the decoding, so a damaged list cannot make it run away
+		auto position = std::min(postingOffsets_[first], postingsSize_);
+		auto end = std::min(std::max(postingOffsets_[first + 1], position), postingsSize_);
+		auto count = postingCounts_[first];
+		HandleFormatError(count > end - position || count > fileCount_, "Symbol index is corrupt");
+
+		fileIds.reserve(count);
+		std::uint32_t fileId = 0;
+		for (std::uint32_t i = 0; i < count; ++i)
+		{
+			std::uint32_t delta = 0;
+			for (unsigned shift = 0;; shift += 7)
+			{
+				HandleFormatError(position == end || shift > 28, "Symbol index is corrupt");
+				auto byte = postings_[position++];
+				delta |= static_cast<std::uint32_t>(byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0)
+				{
+					break;
+				}
+			}
+
+			HandleFormatError(delta >= fileCount_ - fileId || (i != 0 && delta == 0), "Symbol index is corrupt");
+			fileId += delta;
+			fileIds.push_back(fileId);
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "ImportTable.h"
+
+namespace peinfo
+{
+	// Collects the imports of scanned images and writes them as a SymbolIndex file. Add may be
+	// called from any thread: every thread fills a partial index of its own, without locking,
+	// and the partial indexes are merged by Write.
+	class SymbolIndexWriter
+	{
+	public:
+		SymbolIndexWriter();
+		~SymbolIndexWriter();
+
+		SymbolIndexWriter(const SymbolIndexWriter&) = delete;
+		SymbolIndexWriter& operator=(const SymbolIndexWriter&) = delete;
+
+		// Adds the imports and delay imports of the image at the path
+		void Add(const std::wstring& filePath, const ImportTable& imports);
+
+		// Writes a temporary file next to the index and renames it over the index, so readers
+		// never map a partially written file. No Add may be running.
+		void Write(const std::wstring& indexPath);
+
+	private:
+		struct Partial;
+
+		Partial& GetPartial();
+
+		std::atomic<std::uint32_t> nextFileId_;
+		std::mutex partialsMutex_;
+		std::unordered_map<std::thread::id, std::unique_ptr<Partial>> partials_;
+	};
+
+	// Read-only mapping of an inverted index of imported symbols. Files are numbered in the order
+	// they were added, and every term maps to the sorted numbers of the files that import it:
+	// "module" for a module, "!function" for a function of any module and "module!function" for a
+	// function of one module, with the module in lowercase and functions imported by ordinal
+	// written as "#N". The terms are sorted, so a lookup is a binary search, and each posting
+	// list is stored as the differences between consecutive file numbers in LEB128 varints,
+	// which take a byte or two each.
+	class SymbolIndex
+	{
+	public:
+		explicit SymbolIndex(const std::wstring& indexPath);
+		~SymbolIndex();
+
+		SymbolIndex(const SymbolIndex&) = delete;
+		SymbolIndex& operator=(const SymbolIndex&) = delete;
+
+		std::uint32_t GetFileCount() const;
+
+		// The sorted numbers of the files that import the function, given as "function" for any
+		// module or as "module!function". Module names ignore ASCII case; function names do not.
+		std::vector<std::uint32_t> FindFunction(const std::string& symbol) const;
+
+		// The sorted numbers of the files that import the module, ignoring ASCII case. A name
+		// without an extension also finds the .dll.
+		std::vector<std::uint32_t> FindModule(const std::string& moduleName) const;
+
+		// Path of the file as utf16_to_native_path writes it
+		Span<const char> GetPath(std::uint32_t fileId) const;
+
+	private:
+		bool TryFindTerm(const std::string& term, std::vector<std::uint32_t>& fileIds) const;
+
+		const void* base_;
+		std::uint64_t size_;
+		std::uint32_t fileCount_;
+		std::uint32_t termCount_;
+		const std::uint64_t* pathOffsets_;
+		const char* pathText_;
+		std::uint64_t pathTextSize_;
+		const std::uint64_t* termOffsets_;
+		const char* termText_;
+		std::uint64_t termTextSize_;
+		const std::uint32_t* postingCounts_;
+		const std::uint64_t* postingOffsets_;
+		const std::uint8_t* postings_;
+		std::uint64_t postingsSize_;
+	};
+}
@@ -0,0 +1,155 @@
+#include "stdafx.h"
+#include "ThreadPool.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		// Index of the worker running on the current thread within its pool, used to keep tasks
+		// submitted by a task on the same worker.
+		thread_local const ThreadPool* currentPool = nullptr;
+		thread_local std::size_t currentWorkerIndex = 0;
+	}
+
+	ThreadPool::ThreadPool(std::size_t threadCount)
+		: nextQueue_(0), queuedCount_(0), failedTaskCount_(0), stopping_(false), pendingCount_(0)
+	{
+		if (threadCount == 0)
+		{
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+
+		for (std::size_t i = 0; i < threadCount; ++i)
+		{
+			queues_.push_back(std::make_unique<WorkerQueue>());
+		}
+
+		for (std::size_t i = 0; i < threadCount; ++i)
+		{
+			workers_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		Wait();
+
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex_);
+			stopping_ = true;
+		}
+
+		wakeCondition_.notify_all();
+		for (auto& worker : workers_)
+		{
+			worker.join();
+		}
+	}
+
+	std::size_t ThreadPool::GetThreadCount() const
+	{
+		return workers_.size();
+	}
+
+	void ThreadPool::Submit(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(idleMutex_);
+			++pendingCount_;
+		}
+
+		auto queueIndex = currentPool == this ? currentWorkerIndex : nextQueue_++ % queues_.size();
+		{
+			auto& queue = *queues_[queueIndex];
+			std::lock_guard<std::mutex> lock(queue.Mutex);
+			queue.Tasks.push_back(std::move(task));
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex_);
+			++queuedCount_;
+		}
+
+		wakeCondition_.notify_one();
+	}
+
+	void ThreadPool::Wait()
+	{
+		std::unique_lock<std::mutex> lock(idleMutex_);
+		idleCondition_.wait(lock, [this] { return pendingCount_ == 0; });
+	}
+
+	std::size_t ThreadPool::GetFailedTaskCount() const
+	{
+		return failedTaskCount_;
+	}
+
+	void ThreadPool::WorkerLoop(std::size_t workerIndex)
+	{
+		currentPool = this;
+		currentWorkerIndex = workerIndex;
+
+		for (;;)
+		{
+			std::function<void()> task;
+			if (TryTakeTask(workerIndex, task))
+			{
+				--queuedCount_;
+
+				// Tasks report their own failures; one that escapes is counted for the owner of the
+				// pool instead of taking the pool down.
+				try
+				{
+					task();
+				}
+				catch (...)
+				{
+					++failedTaskCount_;
+				}
+
+				std::lock_guard<std::mutex> lock(idleMutex_);
+				if (--pendingCount_ == 0)
+				{
+					idleCondition_.notify_all();
+				}
+
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(wakeMutex_);
+			wakeCondition_.wait(lock, [this] { return stopping_ || queuedCount_ > 0; });
+			if (stopping_ && queuedCount_ == 0)
+			{
+				return;
+			}
+		}
+	}
+
+	bool ThreadPool::TryTakeTask(std::size_t workerIndex, std::function<void()>& task)
+	{
+		{
+			auto& ownQueue = *queues_[workerIndex];
+			std::lock_guard<std::mutex> lock(ownQueue.Mutex);
+			if (!ownQueue.Tasks.empty())
+			{
+				task = std::move(ownQueue.Tasks.back());
+				ownQueue.Tasks.pop_back();
+				return true;
+			}
+		}
+
+		for (std::size_t i = 1; i < queues_.size(); ++i)
+		{
+			auto& victim = *queues_[(workerIndex + i) % queues_.size()];
+			std::lock_guard<std::mutex> lock(victim.Mutex);
+			if (!victim.Tasks.empty())
+			{
+				task = std::move(victim.Tasks.front());
+				victim.Tasks.pop_front();
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
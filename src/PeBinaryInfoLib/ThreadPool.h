@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace peinfo
+{
+	// Fixed size pool with one task deque per worker. A worker takes its newest task first and,
+	// when its own deque is empty, steals the oldest task of another worker.
+	class ThreadPool
+	{
+	public:
+		explicit ThreadPool(std::size_t threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		std::size_t GetThreadCount() const;
+
+		void Submit(std::function<void()> task);
+
+		// Blocks until every submitted task has finished.
+		void Wait();
+
+		// Number of tasks that ended with an exception. Tasks are expected to report their own
+		// failures, so a nonzero count means an outcome was lost.
+		std::size_t GetFailedTaskCount() const;
+
+	private:
+		struct WorkerQueue
+		{
+			std::mutex Mutex;
+			std::deque<std::function<void()>> Tasks;
+		};
+
+		void WorkerLoop(std::size_t workerIndex);
+		bool TryTakeTask(std::size_t workerIndex, std::function<void()>& task);
+
+		std::vector<std::unique_ptr<WorkerQueue>> queues_;
+		std::vector<std::thread> workers_;
+		std::atomic<std::size_t> nextQueue_;
+
+		std::mutex wakeMutex_;
+		std::condition_variable wakeCondition_;
+		std::atomic<std::size_t> queuedCount_;
+		std::atomic<std::size_t> failedTaskCount_;
+		bool stopping_;
+
+		std::mutex idleMutex_;
+		std::condition_variable idleCondition_;
+		std::size_t pendingCount_;
+	};
+}
@@ -0,0 +1,197 @@
+#include "stdafx.h"
+#include "VersionResource.h"
+#include "PeBinaryInfo.h"
+
+namespace peinfo
+{
+	namespace
+	{
+		const WORD TextValueType = 1;
+
+		// Every block is a WORD length, a WORD value length, a WORD type, a null-terminated key,
+		// the value and the child blocks, each of the last three starting on a DWORD boundary.
+		struct VersionBlock
+		{
+			Span<const std::uint8_t> Data;
+			Span<const char16_t> Key;
+			Span<const std::uint8_t> Value;
+			Span<const std::uint8_t> Children;
+		};
+
+		const std::size_t BlockHeaderSize = 3 * sizeof(WORD);
+
+		std::size_t AlignToDword(std::size_t offset)
+		{
+			return (offset + 3) & ~static_cast<std::size_t>(3);
+		}
+
+		WORD ReadWord(const std::uint8_t* data)
+		{
+			WORD value;
+			std::memcpy(&value, data, sizeof(value));
+			return value;
+		}
+
+		// data starts at a DWORD-aligned block and runs to the end of its parent
+		VersionBlock ReadBlock(Span<const std::uint8_t> data)
+		{
+			HandleFormatError(data.size() < BlockHeaderSize, "Version block is truncated");
+			std::size_t length = ReadWord(data.data());
+			std::size_t valueLength = ReadWord(data.data() + sizeof(WORD));
+			WORD type = ReadWord(data.data() + 2 * sizeof(WORD));
+			HandleFormatError(length < BlockHeaderSize || length > data.size(), "Version block is outside of the resource");
+
+			auto key = reinterpret_cast<const char16_t*>(data.data() + BlockHeaderSize);
+			std::size_t maxKeyLength = (length - BlockHeaderSize) / sizeof(char16_t);
+			std::size_t keyLength = 0;
+			while (keyLength < maxKeyLength && key[keyLength] != 0)
+			{
+				++keyLength;
+			}
+
+			HandleFormatError(keyLength == maxKeyLength, "Version block key is not terminated");
+
+			// Text values are counted in characters, binary values in bytes
+			auto valueOffset = std::min(AlignToDword(BlockHeaderSize + (keyLength + 1) * sizeof(char16_t)), length);
+			auto valueSize = std::min(type == TextValueType ? valueLength * sizeof(char16_t) : valueLength, length - valueOffset);
+			auto childrenOffset = std::min(AlignToDword(valueOffset + valueSize), length);
+
+			return VersionBlock
+			{
+				data.subspan(0, length),
+				Span<const char16_t>(key, keyLength),
+				data.subspan(valueOffset, valueSize),
+				data.subspan(childrenOffset, length - childrenOffset)
+			};
+		}
+
+		template<class Callback>
+		void ForEachChild(Span<const std::uint8_t> children, Callback callback)
+		{
+			// Padding after the last child is shorter than a block header
+			for (std::size_t offset = 0; offset + BlockHeaderSize <= children.size();)
+			{
+				auto child = ReadBlock(children.subspan(offset));
+				callback(child);
+				offset = AlignToDword(offset + child.Data.size());
+			}
+		}
+
+		bool KeyEquals(Span<const char16_t> key, const char16_t* expected)
+		{
+			std::size_t i = 0;
+			for (; i < key.size(); ++i)
+			{
+				if (expected[i] != key[i])
+				{
+					return false;
+				}
+			}
+
+			return expected[i] == 0;
+		}
+
+		// Many linkers store the byte count or nothing at all as the length of a String value, so
+		// the value is taken as the text up to the terminator or the end of the block instead
+		Span<const char16_t> ReadStringValue(const VersionBlock& block)
+		{
+			auto keyEnd = block.Key.data() + block.Key.size() + 1;
+			auto valueOffset = std::min(AlignToDword(static_cast<std::size_t>(AddressDifference(keyEnd, block.Data.data()))), block.Data.size());
+			auto value = reinterpret_cast<const char16_t*>(block.Data.data() + valueOffset);
+			std::size_t maxValueLength = (block.Data.size() - valueOffset) / sizeof(char16_t);
+			std::size_t valueLength = 0;
+			while (valueLength < maxValueLength && value[valueLength] != 0)
+			{
+				++valueLength;
+			}
+
+			return Span<const char16_t>(value, valueLength);
+		}
+	}
+
+	VersionResource::VersionResource(Span<const std::uint8_t> resource)
+		: hasFixedFileInfo_(false), fixedFileInfo_{}
+	{
+		auto root = ReadBlock(resource);
+		HandleFormatError(!KeyEquals(root.Key, u"VS_VERSION_INFO"), "Resource is not a VS_VERSIONINFO");
+
+		if (root.Value.size() >= sizeof(VS_FIXEDFILEINFO))
+		{
+			std::memcpy(&fixedFileInfo_, root.Value.data(), sizeof(VS_FIXEDFILEINFO));
+			hasFixedFileInfo_ = fixedFileInfo_.dwSignature == VS_FFI_SIGNATURE;
+		}
+
+		ForEachChild(root.Children, [this](const VersionBlock& fileInfo)
+		{
+			if (!KeyEquals(fileInfo.Key, u"StringFileInfo"))
+			{
+				return;
+			}
+
+			// Each StringTable is one language and code page; the first one is the image's own
+			bool isFirstTable = true;
+			ForEachChild(fileInfo.Children, [this, &isFirstTable](const VersionBlock& table)
+			{
+				if (!isFirstTable)
+				{
+					return;
+				}
+
+				isFirstTable = false;
+				ForEachChild(table.Children, [this](const VersionBlock& string)
+				{
+					strings_.push_back(VersionString{ string.Key, ReadStringValue(string) });
+				});
+			});
+		});
+	}
+
+	bool VersionResource::HasFixedFileInfo() const
+	{
+		return hasFixedFileInfo_;
+	}
+
+	const VS_FIXEDFILEINFO& VersionResource::GetFixedFileInfo() const
+	{
+		return fixedFileInfo_;
+	}
+
+	const std::vector<VersionString>& VersionResource::GetStrings() const
+	{
+		return strings_;
+	}
+
+	Span<const char16_t> VersionResource::GetString(const char16_t* key) const
+	{
+		for (const auto& string : strings_)
+		{
+			if (KeyEquals(string.Key, key))
+			{
+				return string.Value;
+			}
+		}
+
+		return Span<const char16_t>();
+	}
+
+	std::wstring Utf16ToWString(Span<const char16_t> text)
+	{
+		std::wstring result;
+		result.reserve(text.size());
+		for (std::size_t i = 0; i < text.size(); ++i)
+		{
+			char32_t character = text[i];
+#ifndef _WIN32
+			// wchar_t holds whole code points here, so surrogate pairs are combined
+			if (character >= 0xD800 && character < 0xDC00 && i + 1 < text.size() && text[i + 1] >= 0xDC00 && text[i + 1] < 0xE000)
+			{
+				character = 0x10000 + ((character - 0xD800) << 10) + (text[i + 1] - 0xDC00);
+				++i;
+			}
+#endif
+			result.push_back(static_cast<wchar_t>(character));
+		}
+
+		return result;
+	}
+}
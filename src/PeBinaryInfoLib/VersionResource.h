@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Helpers.h"
+
+namespace peinfo
+{
+	// A String of a StringTable. Both views point into the resource, as UTF-16LE without the terminator.
+	struct VersionString
+	{
+		Span<const char16_t> Key;
+		Span<const char16_t> Value;
+	};
+
+	// Decodes a VS_VERSIONINFO resource in place: the VS_FIXEDFILEINFO and the strings of the first
+	// StringTable of the StringFileInfo, such as CompanyName and ProductVersion. The resource must
+	// outlive the object; only the fixed file info is copied, since it is not necessarily aligned.
+	class VersionResource
+	{
+	public:
+		// Throws for a block that does not fit in the resource or is not a VS_VERSIONINFO.
+		explicit VersionResource(Span<const std::uint8_t> resource);
+
+		// False when the resource carries no VS_FIXEDFILEINFO or its signature does not match
+		bool HasFixedFileInfo() const;
+		const VS_FIXEDFILEINFO& GetFixedFileInfo() const;
+
+		const std::vector<VersionString>& GetStrings() const;
+
+		// Returns an empty string when the key is not in the table
+		Span<const char16_t> GetString(const char16_t* key) const;
+
+	private:
+		bool hasFixedFileInfo_;
+		VS_FIXEDFILEINFO fixedFileInfo_;
+		std::vector<VersionString> strings_;
+	};
+
+	// Converts UTF-16 text, such as a VersionString, to the platform wide string
+	std::wstring Utf16ToWString(Span<const char16_t> text);
+}
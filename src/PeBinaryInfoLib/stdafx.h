@@ -5,9 +5,12 @@
 
 #pragma once
 
+#ifdef _WIN32
 #include "targetver.h"
 
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
+#define NOMINMAX                        // std::min, std::max and numeric_limits<T>::max are used throughout
+#endif
 
 
 
@@ -15,6 +18,7 @@
 #include <iostream>
 #include <string>
 #include <cstring>
+#include <cctype>
 #include <cassert>
 #include <string_view>
 #include <vector>
@@ -31,9 +35,41 @@
 #include <memory>
 #include <locale> 
 #include <codecvt>
+#include <cstdint>
+#include <limits>
+#include <system_error>
+#include <utility>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <shared_mutex>
+#include <charconv>
+#include <unordered_map>
+#include <map>
+#include <chrono>
 
+#ifdef _WIN32
 #include <Windows.h>
-#include <atlbase.h>
-#include <cor.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+
+#include "WinTypes.h"
+#endif
 
 using namespace std::literals::string_literals;
\ No newline at end of file
@@ -8,6 +8,10 @@
 #define STRICT
 #endif
 
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
 #include "targetver.h"
 
 #define _ATL_APARTMENT_THREADED
@@ -0,0 +1,136 @@
+#include "stdafx.h"
+#include "../PeBinaryInfoLib/CliCustomAttribute.h"
+#include "TestFramework.h"
+#include "TestMetadata.h"
+
+using namespace peinfo;
+using namespace peinfo::tests;
+
+namespace
+{
+	struct DecodedArgument
+	{
+		CustomAttributeArgument Argument;
+		CustomAttributeValue Value;
+	};
+
+	// [System.ObsoleteAttribute(...)] on the assembly, constructed through a MemberRef, with the
+	// constructor signature and the value blob given by the test
+	class CustomAttributeFixture
+	{
+	public:
+		CustomAttributeFixture(const std::vector<std::uint8_t>& constructorSignature, const std::vector<std::uint8_t>& value)
+		{
+			TestMetadata metadata;
+			auto system = metadata.AddString("System");
+			metadata.AddRow(TableId::TypeRef, { 0x0006, metadata.AddString("ObsoleteAttribute"), system });
+			metadata.AddRow(TableId::TypeRef, { 0x0006, metadata.AddString("Type"), system });
+			metadata.AddRow(TableId::MemberRef, { (1 << 3) | 1, metadata.AddString(".ctor"), metadata.AddBlob(constructorSignature) });
+			metadata.AddRow(TableId::CustomAttribute, { (1 << 5) | 14, TypeIndex, metadata.AddBlob(value) });
+
+			bytes_ = metadata.Build();
+			directory_ = MetadataDirectoryReader().Read(bytes_.data(), static_cast<std::uint32_t>(bytes_.size()));
+		}
+
+		const MetadataTables& GetTables() const
+		{
+			return directory_->GetMetadataTables();
+		}
+
+		std::vector<DecodedArgument> Decode() const
+		{
+			std::vector<DecodedArgument> arguments;
+			CustomAttributeDecoder decoder(GetTables());
+			auto value = GetTables().GetCustomAttributeTable().GetValueBlob(0);
+			decoder.Decode(TypeIndex, value, [&arguments](const CustomAttributeArgument& argument, const CustomAttributeValue& value)
+			{
+				arguments.push_back(DecodedArgument{ argument, value });
+			});
+
+			return arguments;
+		}
+
+		// CustomAttributeType of MemberRef 1
+		static const std::uint16_t TypeIndex = (1 << 3) | 3;
+
+	private:
+		std::vector<std::uint8_t> bytes_;
+		std::unique_ptr<MetadataDirectoryFacade> directory_;
+	};
+}
+
+TEST(CustomAttributeFixedAndNamedArguments)
+{
+	// .ctor(string, int32, class System.Type)
+	std::vector<std::uint8_t> constructor{ 0x20, 0x03, 0x01, 0x0E, 0x08, 0x12, 0x09 };
+	std::vector<std::uint8_t> value
+	{
+		0x01, 0x00,
+		0x05, 'h', 'e', 'l', 'l', 'o',
+		0x2A, 0x00, 0x00, 0x00,
+		0xFF,
+		0x03, 0x00,
+		0x54, 0x02, 0x04, 'F', 'l', 'a', 'g', 0x01,
+		0x53, 0x1D, 0x08, 0x06, 'V', 'a', 'l', 'u', 'e', 's', 0x02, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0xF9, 0xFF, 0xFF, 0xFF,
+		0x54, 0x51, 0x04, 'B', 'o', 'x', 'd', 0x0C, 0x00, 0x00, 0xC0, 0x3F
+	};
+
+	CustomAttributeFixture fixture(constructor, value);
+	auto arguments = fixture.Decode();
+	CHECK_EQUAL(8u, arguments.size());
+
+	CHECK(arguments[0].Argument.Kind == CustomAttributeArgumentKind::Fixed);
+	CHECK(arguments[0].Value.Type == ElementType::String);
+	CHECK(arguments[0].Value.Text == "hello");
+
+	CHECK_EQUAL(1u, arguments[1].Argument.Index);
+	CHECK_EQUAL(42, arguments[1].Value.AsInt64());
+
+	CHECK(arguments[2].Value.Type == ElementType::Type);
+	CHECK(arguments[2].Value.IsNull);
+
+	CHECK(arguments[3].Argument.Kind == CustomAttributeArgumentKind::Property);
+	CHECK(arguments[3].Argument.Name == "Flag");
+	CHECK(arguments[3].Value.AsBool());
+
+	CHECK(arguments[4].Argument.Kind == CustomAttributeArgumentKind::Field);
+	CHECK(arguments[4].Value.Type == ElementType::SzArray);
+	CHECK_EQUAL(2u, arguments[4].Value.ArrayLength);
+	CHECK_EQUAL(1u, arguments[6].Argument.ArrayIndex);
+	CHECK_EQUAL(7, arguments[5].Value.AsInt64());
+	CHECK_EQUAL(-7, arguments[6].Value.AsInt64());
+
+	CHECK(arguments[7].Argument.Name == "Boxd");
+	CHECK(arguments[7].Value.IsBoxed);
+	CHECK(arguments[7].Value.AsDouble() == 1.5);
+}
+
+TEST(CustomAttributeTypeNameComesFromTheConstructorParent)
+{
+	CustomAttributeFixture fixture({ 0x20, 0x00, 0x01 }, { 0x01, 0x00, 0x00, 0x00 });
+	CustomAttributeDecoder decoder(fixture.GetTables());
+
+	std::string_view typeNamespace;
+	std::string_view typeName;
+	CHECK(decoder.TryGetAttributeTypeName(CustomAttributeFixture::TypeIndex, typeNamespace, typeName));
+	CHECK(typeNamespace == "System");
+	CHECK(typeName == "ObsoleteAttribute");
+
+	// Tag 0 of CustomAttributeType is unused
+	CHECK(!decoder.TryGetAttributeTypeName(1 << 3, typeNamespace, typeName));
+	CHECK(fixture.Decode().empty());
+}
+
+TEST(MalformedCustomAttributeBlobsThrow)
+{
+	std::vector<std::uint8_t> constructor{ 0x20, 0x01, 0x01, 0x08 };
+
+	CustomAttributeFixture wrongProlog(constructor, { 0x02, 0x00, 0x2A, 0x00, 0x00, 0x00, 0x00, 0x00 });
+	CHECK_THROWS(wrongProlog.Decode());
+
+	CustomAttributeFixture truncatedValue(constructor, { 0x01, 0x00, 0x2A, 0x00 });
+	CHECK_THROWS(truncatedValue.Decode());
+
+	CustomAttributeFixture invalidNamedKind(constructor, { 0x01, 0x00, 0x2A, 0x00, 0x00, 0x00, 0x01, 0x00, 0x50, 0x08, 0x01, 'X', 0x00, 0x00, 0x00, 0x00 });
+	CHECK_THROWS(invalidNamedKind.Decode());
+}
@@ -0,0 +1,277 @@
+#include "stdafx.h"
+#include "../PeBinaryInfoLib/CliMetadata.h"
+#include "TestFramework.h"
+#include "TestMetadata.h"
+
+using namespace peinfo;
+using namespace peinfo::tests;
+
+namespace
+{
+	// Column indices, in the order of ECMA-335 II.22
+	const std::uint32_t ModuleMvidColumn = 2;
+	const std::uint32_t TypeDefTypeNameColumn = 1;
+	const std::uint32_t TypeDefExtendsColumn = 3;
+	const std::uint32_t TypeDefFieldListColumn = 4;
+	const std::uint32_t TypeDefMethodListColumn = 5;
+	const std::uint32_t CustomAttributeParentColumn = 0;
+	const std::uint32_t CustomAttributeTypeColumn = 1;
+	const std::uint32_t CustomAttributeValueColumn = 2;
+
+	std::uint32_t GetColumnSize(const std::array<std::uint32_t, 64>& rowCounts, BYTE heapIndexSizes, TableId tableId, std::uint32_t column)
+	{
+		SchemaInfoProvider schema(rowCounts, heapIndexSizes, 0);
+		return schema.GetColumnTypeSize(tableId, column);
+	}
+
+	std::uint16_t HasCustomAttribute(TableId tableId, std::uint32_t rid)
+	{
+		return static_cast<std::uint16_t>(EncodeIndex(ColumnType::HasCustomAttribute, RowReference{ tableId, rid }));
+	}
+
+	// Five custom attributes on two parents, in the order of their Parent column: Assembly 1
+	// encodes as 0x2E and TypeDef 2 as 0x43
+	TestMetadata MakeCustomAttributes(bool isSorted)
+	{
+		TestMetadata metadata;
+		auto value = metadata.AddBlob({ 0x01, 0x00, 0x00, 0x00 });
+		for (auto parent : { HasCustomAttribute(TableId::Assembly, 1), HasCustomAttribute(TableId::Assembly, 1),
+			HasCustomAttribute(TableId::Assembly, 1), HasCustomAttribute(TableId::TypeDef, 2), HasCustomAttribute(TableId::TypeDef, 2) })
+		{
+			metadata.AddRow(TableId::CustomAttribute, { parent, 0x000B, value });
+		}
+
+		if (isSorted)
+		{
+			metadata.SetSorted(TableId::CustomAttribute);
+		}
+
+		return metadata;
+	}
+}
+
+TEST(CodedIndexIsWideFromTheRowCountItsTagBitsLeaveNoRoomFor)
+{
+	std::array<std::uint32_t, 64> rowCounts{};
+
+	// TypeDefOrRef has two tag bits, so 14 bits are left for the row
+	rowCounts[static_cast<int>(TableId::TypeRef)] = (1u << 14) - 1;
+	CHECK_EQUAL(2u, GetColumnSize(rowCounts, 0, TableId::TypeDef, TypeDefExtendsColumn));
+	rowCounts[static_cast<int>(TableId::TypeRef)] = 1u << 14;
+	CHECK_EQUAL(4u, GetColumnSize(rowCounts, 0, TableId::TypeDef, TypeDefExtendsColumn));
+
+	// HasCustomAttribute has five, and takes the largest of its 22 tables
+	rowCounts = {};
+	rowCounts[static_cast<int>(TableId::GenericParam)] = (1u << 11) - 1;
+	CHECK_EQUAL(2u, GetColumnSize(rowCounts, 0, TableId::CustomAttribute, CustomAttributeParentColumn));
+	rowCounts[static_cast<int>(TableId::MethodSpec)] = 1u << 11;
+	CHECK_EQUAL(4u, GetColumnSize(rowCounts, 0, TableId::CustomAttribute, CustomAttributeParentColumn));
+
+	// The unused tags of CustomAttributeType do not count
+	rowCounts = {};
+	rowCounts[static_cast<int>(TableId::TypeRef)] = 1u << 13;
+	CHECK_EQUAL(2u, GetColumnSize(rowCounts, 0, TableId::CustomAttribute, CustomAttributeTypeColumn));
+	rowCounts[static_cast<int>(TableId::MemberRef)] = 1u << 13;
+	CHECK_EQUAL(4u, GetColumnSize(rowCounts, 0, TableId::CustomAttribute, CustomAttributeTypeColumn));
+}
+
+TEST(SimpleIndexAndHeapIndexWidths)
+{
+	std::array<std::uint32_t, 64> rowCounts{};
+	rowCounts[static_cast<int>(TableId::Field)] = 0xFFFF;
+	CHECK_EQUAL(2u, GetColumnSize(rowCounts, 0, TableId::TypeDef, TypeDefFieldListColumn));
+	rowCounts[static_cast<int>(TableId::Field)] = 0x10000;
+	CHECK_EQUAL(4u, GetColumnSize(rowCounts, 0, TableId::TypeDef, TypeDefFieldListColumn));
+
+	// HeapOffsetSizes: 1 for #Strings, 2 for #GUID, 4 for #Blob
+	CHECK_EQUAL(2u, GetColumnSize(rowCounts, 0x06, TableId::TypeDef, TypeDefTypeNameColumn));
+	CHECK_EQUAL(4u, GetColumnSize(rowCounts, 0x01, TableId::TypeDef, TypeDefTypeNameColumn));
+	CHECK_EQUAL(4u, GetColumnSize(rowCounts, 0x02, TableId::Module, ModuleMvidColumn));
+	CHECK_EQUAL(4u, GetColumnSize(rowCounts, 0x04, TableId::CustomAttribute, CustomAttributeValueColumn));
+
+	SchemaInfoProvider schema(rowCounts, 0x07, 0);
+	CHECK_EQUAL(4u + 4 + 4 + 2 + 4 + 2, schema.GetRowSize(TableId::TypeDef));
+	CHECK_EQUAL(schema.GetColumnOffset(TableId::TypeDef, TypeDefFieldListColumn) + 4, schema.GetColumnOffset(TableId::TypeDef, TypeDefMethodListColumn));
+}
+
+TEST(TableLayoutRejectsRowCountsPastFourGigabytes)
+{
+	std::array<std::uint32_t, 64> rowCounts{};
+	rowCounts[static_cast<int>(TableId::TypeDef)] = 0xFFFFFFFF;
+	rowCounts[static_cast<int>(TableId::MethodDef)] = 0xFFFFFFFF;
+	CHECK_THROWS(SchemaInfoProvider(rowCounts, 0x07, 0));
+}
+
+TEST(CodedIndexDecodesTagAndRow)
+{
+	RowReference reference{};
+	CHECK(TryDecodeIndex(ColumnType::HasCustomAttribute, (5u << 5) | 3, reference));
+	CHECK(reference.Table == TableId::TypeDef);
+	CHECK_EQUAL(5u, reference.Rid);
+
+	CHECK(TryDecodeIndex(ColumnType::CustomAttributeType, (7u << 3) | 3, reference));
+	CHECK(reference.Table == TableId::MemberRef);
+	CHECK_EQUAL(7u, reference.Rid);
+
+	CHECK(TryDecodeIndex(ColumnType::TypeDefOrRef, 0x49, reference));
+	CHECK(reference.Table == TableId::TypeRef);
+	CHECK_EQUAL(0x12u, reference.Rid);
+
+	// A tag of an unused table, or past the last table, does not decode
+	CHECK(!TryDecodeIndex(ColumnType::CustomAttributeType, (1u << 3) | 0, reference));
+	CHECK(!TryDecodeIndex(ColumnType::CustomAttributeType, (1u << 3) | 5, reference));
+	CHECK(!TryDecodeIndex(ColumnType::TypeDefOrRef, (1u << 2) | 3, reference));
+}
+
+TEST(CodedIndexEncodesWhatItDecodes)
+{
+	auto value = EncodeIndex(ColumnType::HasCustomAttribute, RowReference{ TableId::Assembly, 1 });
+	CHECK_EQUAL((1u << 5) | 14, value);
+
+	RowReference reference{};
+	CHECK(TryDecodeIndex(ColumnType::HasCustomAttribute, value, reference));
+	CHECK(reference.Table == TableId::Assembly);
+	CHECK_EQUAL(1u, reference.Rid);
+
+	CHECK_THROWS(EncodeIndex(ColumnType::TypeDefOrRef, RowReference{ TableId::MethodDef, 1 }));
+}
+
+TEST(MetadataReaderReadsHandBuiltTables)
+{
+	TestMetadata metadata;
+	metadata.AddRow(TableId::Module, { 0, metadata.AddString("Test.dll"), 0, 0, 0 });
+	auto mscorlib = static_cast<std::uint16_t>(EncodeIndex(ColumnType::ResolutionScope, RowReference{ TableId::AssemblyRef, 1 }));
+	metadata.AddRow(TableId::TypeRef, { mscorlib, metadata.AddString("Object"), metadata.AddString("System") });
+	metadata.AddRow(TableId::TypeRef, { mscorlib, metadata.AddString("Attribute"), metadata.AddString("System") });
+
+	auto bytes = metadata.Build();
+	auto directory = MetadataDirectoryReader().Read(bytes.data(), static_cast<std::uint32_t>(bytes.size()));
+	const auto& tables = directory->GetMetadataTables();
+
+	CHECK(tables.GetModuleTable().GetName(0) == "Test.dll");
+	CHECK_EQUAL(2u, tables.GetTypeRefTable().GetRowCount());
+	CHECK(tables.GetTypeRefTable().GetTypeNamespace(1) == "System");
+	CHECK(tables.GetTypeRefTable().GetTypeName(1) == "Attribute");
+	CHECK_EQUAL(static_cast<std::uint32_t>(mscorlib), tables.GetRow<TableId::TypeRef>(0).Get(TypeRefSchema::ResolutionScope));
+	CHECK_EQUAL(0u, tables.GetTypeDefTable().GetRowCount());
+
+	// The rows of ForEachRow, laid out at compile time, match those of the module's layout
+	std::vector<std::string_view> names;
+	ForEachRow<TableId::TypeRef>(tables, [&names](const auto& row)
+	{
+		names.push_back(row.GetString(TypeRefSchema::TypeName));
+	});
+	CHECK(names == (std::vector<std::string_view>{ "Object", "Attribute" }));
+}
+
+TEST(MetadataReaderRejectsTablesPastTheEndOfTheMetadata)
+{
+	TestMetadata metadata;
+	metadata.AddRow(TableId::TypeRef, { 0, 0, 0 });
+	metadata.SetRowCount(TableId::TypeRef, 1000);
+
+	auto bytes = metadata.Build();
+	CHECK_THROWS(MetadataDirectoryReader().Read(bytes.data(), static_cast<std::uint32_t>(bytes.size())));
+}
+
+TEST(MetadataReaderRejectsStreamsPastTheEndOfTheMetadata)
+{
+	TestMetadata metadata;
+	metadata.AddRow(TableId::TypeRef, { 0, 0, 0 });
+
+	auto bytes = metadata.Build();
+	CHECK_THROWS(MetadataDirectoryReader().Read(bytes.data(), static_cast<std::uint32_t>(bytes.size() - 4)));
+
+	bytes[0] = 'X';
+	CHECK_THROWS(MetadataDirectoryReader().Read(bytes.data(), static_cast<std::uint32_t>(bytes.size())));
+}
+
+TEST(MetadataReaderRejectsTruncatedAndOversizedHeaders)
+{
+	TestMetadata metadata;
+	metadata.AddRow(TableId::TypeRef, { 0, 0, 0 });
+	auto bytes = metadata.Build();
+
+	// Cut inside the storage header, a stream header, a stream name or a stream
+	for (std::uint32_t size = 0; size < bytes.size(); ++size)
+	{
+		CHECK_THROWS(MetadataDirectoryReader().Read(bytes.data(), size));
+	}
+
+	// A version string length that runs past the end of the metadata
+	auto oversized = bytes;
+	const std::uint32_t versionLength = 0x40000000;
+	std::memcpy(oversized.data() + 12, &versionLength, sizeof(versionLength));
+	CHECK_THROWS(MetadataDirectoryReader().Read(oversized.data(), static_cast<std::uint32_t>(oversized.size())));
+}
+
+TEST(EqualRangeFindsTheRowsOfAKeyInASortedTable)
+{
+	auto bytes = MakeCustomAttributes(true).Build();
+	auto directory = MetadataDirectoryReader().Read(bytes.data(), static_cast<std::uint32_t>(bytes.size()));
+	const auto& tables = directory->GetMetadataTables();
+
+	auto assemblyRange = EqualRange<TableId::CustomAttribute>(tables, HasCustomAttribute(TableId::Assembly, 1));
+	CHECK_EQUAL(0u, assemblyRange.Begin);
+	CHECK_EQUAL(3u, assemblyRange.End);
+
+	auto typeDefRange = EqualRange<TableId::CustomAttribute>(tables, HasCustomAttribute(TableId::TypeDef, 2));
+	CHECK_EQUAL(3u, typeDefRange.Begin);
+	CHECK_EQUAL(5u, typeDefRange.End);
+
+	// A missing key gives an empty range where it would be inserted
+	auto missingRange = EqualRange<TableId::CustomAttribute>(tables, HasCustomAttribute(TableId::MethodDef, 2));
+	CHECK_EQUAL(3u, missingRange.Begin);
+	CHECK_EQUAL(3u, missingRange.End);
+
+	auto pastLastRange = EqualRange<TableId::CustomAttribute>(tables, std::numeric_limits<std::uint32_t>::max());
+	CHECK_EQUAL(5u, pastLastRange.Begin);
+	CHECK_EQUAL(5u, pastLastRange.End);
+
+	std::size_t count = 0;
+	ForEachCustomAttribute(tables, RowReference{ TableId::Assembly, 1 }, [&count](const auto&) { ++count; });
+	CHECK_EQUAL(3u, count);
+}
+
+TEST(RowsWithKeyAreScannedWhenTheTableIsNotSorted)
+{
+	auto bytes = MakeCustomAttributes(false).Build();
+	auto directory = MetadataDirectoryReader().Read(bytes.data(), static_cast<std::uint32_t>(bytes.size()));
+	const auto& tables = directory->GetMetadataTables();
+
+	CHECK_THROWS(EqualRange<TableId::CustomAttribute>(tables, HasCustomAttribute(TableId::TypeDef, 2)));
+
+	std::vector<std::uint32_t> rows;
+	ForEachCustomAttribute(tables, RowReference{ TableId::TypeDef, 2 }, [&rows](const auto& row) { rows.push_back(row.GetIndex()); });
+	CHECK(rows == (std::vector<std::uint32_t>{ 3, 4 }));
+
+	// The visitor stops the scan by returning false
+	rows.clear();
+	auto completed = ForEachCustomAttribute(tables, RowReference{ TableId::Assembly, 1 }, [&rows](const auto& row)
+	{
+		rows.push_back(row.GetIndex());
+		return false;
+	});
+	CHECK(!completed);
+	CHECK(rows == (std::vector<std::uint32_t>{ 0 }));
+}
+
+TEST(TypeNameIndexFindsTheFirstRowOfEachName)
+{
+	TestMetadata metadata;
+	auto system = metadata.AddString("System");
+	metadata.AddRow(TableId::TypeRef, { 0, metadata.AddString("Object"), system });
+	metadata.AddRow(TableId::TypeRef, { 0, metadata.AddString("Attribute"), system });
+	metadata.AddRow(TableId::TypeRef, { 0, metadata.AddString("Object"), system });
+	metadata.AddRow(TableId::TypeRef, { 0, metadata.AddString("Object"), 0 });
+
+	auto bytes = metadata.Build();
+	auto directory = MetadataDirectoryReader().Read(bytes.data(), static_cast<std::uint32_t>(bytes.size()));
+	const auto& tables = directory->GetMetadataTables();
+
+	CHECK_EQUAL(1u, tables.GetTypeRefNameIndex().Find("System", "Object"));
+	CHECK_EQUAL(2u, tables.GetTypeRefNameIndex().Find("System", "Attribute"));
+	CHECK_EQUAL(4u, tables.GetTypeRefNameIndex().Find("", "Object"));
+	CHECK_EQUAL(0u, tables.GetTypeRefNameIndex().Find("System", "String"));
+	CHECK_EQUAL(0u, tables.GetTypeDefNameIndex().Find("System", "Object"));
+}
@@ -0,0 +1,162 @@
+#include "stdafx.h"
+#include "../PeBinaryInfoLib/CliSignature.h"
+#include "TestFramework.h"
+
+using namespace peinfo;
+using namespace peinfo::tests;
+
+namespace
+{
+	Span<const std::uint8_t> ToSpan(const std::vector<std::uint8_t>& bytes)
+	{
+		return Span<const std::uint8_t>(bytes.data(), bytes.size());
+	}
+
+	std::uint32_t ReadCompressedUInt32(std::vector<std::uint8_t> bytes)
+	{
+		BlobReader reader(ToSpan(bytes));
+		auto value = reader.ReadCompressedUInt32();
+		CHECK(reader.IsAtEnd());
+		return value;
+	}
+
+	std::int32_t ReadCompressedInt32(std::vector<std::uint8_t> bytes)
+	{
+		BlobReader reader(ToSpan(bytes));
+		auto value = reader.ReadCompressedInt32();
+		CHECK(reader.IsAtEnd());
+		return value;
+	}
+
+	std::vector<ElementType> GetElementTypes(const MethodSignature& signature)
+	{
+		std::vector<ElementType> elementTypes;
+		signature.ForEachParameter([&elementTypes](const TypeSignature& parameter)
+		{
+			elementTypes.push_back(parameter.GetElementType());
+		});
+
+		return elementTypes;
+	}
+}
+
+TEST(CompressedUnsignedIntegers)
+{
+	// ECMA-335 II.23.2
+	CHECK_EQUAL(0x03u, ReadCompressedUInt32({ 0x03 }));
+	CHECK_EQUAL(0x7Fu, ReadCompressedUInt32({ 0x7F }));
+	CHECK_EQUAL(0x80u, ReadCompressedUInt32({ 0x80, 0x80 }));
+	CHECK_EQUAL(0x2E57u, ReadCompressedUInt32({ 0xAE, 0x57 }));
+	CHECK_EQUAL(0x3FFFu, ReadCompressedUInt32({ 0xBF, 0xFF }));
+	CHECK_EQUAL(0x4000u, ReadCompressedUInt32({ 0xC0, 0x00, 0x40, 0x00 }));
+	CHECK_EQUAL(0x1FFFFFFFu, ReadCompressedUInt32({ 0xDF, 0xFF, 0xFF, 0xFF }));
+
+	CHECK_THROWS(ReadCompressedUInt32({ 0xE0, 0x00, 0x00, 0x00 }));
+	CHECK_THROWS(ReadCompressedUInt32({ 0xC0, 0x00, 0x40 }));
+	CHECK_THROWS(ReadCompressedUInt32({}));
+}
+
+TEST(CompressedSignedIntegers)
+{
+	CHECK_EQUAL(3, ReadCompressedInt32({ 0x06 }));
+	CHECK_EQUAL(-3, ReadCompressedInt32({ 0x7B }));
+	CHECK_EQUAL(64, ReadCompressedInt32({ 0x80, 0x80 }));
+	CHECK_EQUAL(-64, ReadCompressedInt32({ 0x01 }));
+	CHECK_EQUAL(8192, ReadCompressedInt32({ 0xC0, 0x00, 0x40, 0x00 }));
+	CHECK_EQUAL(-8192, ReadCompressedInt32({ 0x80, 0x01 }));
+	CHECK_EQUAL(268435455, ReadCompressedInt32({ 0xDF, 0xFF, 0xFF, 0xFE }));
+	CHECK_EQUAL(-268435456, ReadCompressedInt32({ 0xC0, 0x00, 0x00, 0x01 }));
+}
+
+TEST(GenericInstanceMethodSignature)
+{
+	// instance void M<T>(int32, string[], class TypeRef 0x12, !!0)
+	std::vector<std::uint8_t> blob{ 0x30, 0x01, 0x04, 0x01, 0x08, 0x1D, 0x0E, 0x12, 0x49, 0x1E, 0x00 };
+	MethodSignature signature(ToSpan(blob));
+
+	CHECK(signature.HasThis());
+	CHECK_EQUAL(1u, signature.GetGenericParameterCount());
+	CHECK_EQUAL(4u, signature.GetParameterCount());
+	CHECK(signature.GetReturnType().GetElementType() == ElementType::Void);
+	CHECK(GetElementTypes(signature) == (std::vector<ElementType>{ ElementType::I4, ElementType::SzArray, ElementType::Class, ElementType::MVar }));
+
+	std::vector<TypeSignature> parameters;
+	signature.ForEachParameter([&parameters](const TypeSignature& parameter) { parameters.push_back(parameter); });
+	CHECK(parameters[1].GetElementTypeSignature().GetElementType() == ElementType::String);
+	CHECK(parameters[2].GetTypeReference().Table == TableId::TypeRef);
+	CHECK_EQUAL(0x12u, parameters[2].GetTypeReference().Rid);
+	CHECK_EQUAL(0u, parameters[3].GetGenericParameterNumber());
+	CHECK_THROWS(parameters[0].GetTypeReference());
+}
+
+TEST(VarArgSentinelIsSkipped)
+{
+	// vararg void M(int32, ..., string)
+	std::vector<std::uint8_t> blob{ 0x05, 0x02, 0x01, 0x08, 0x41, 0x0E };
+	MethodSignature signature(ToSpan(blob));
+	CHECK(!signature.HasThis());
+	CHECK(GetElementTypes(signature) == (std::vector<ElementType>{ ElementType::I4, ElementType::String }));
+}
+
+TEST(FieldSignatureWithGenericInstanceAndModifiers)
+{
+	// class TypeRef 0x12<int32, string>
+	std::vector<std::uint8_t> genericBlob{ 0x06, 0x15, 0x12, 0x49, 0x02, 0x08, 0x0E };
+	CHECK(IsFieldSignature(ToSpan(genericBlob)));
+	FieldSignature genericField(ToSpan(genericBlob));
+	CHECK(genericField.GetType().GetElementType() == ElementType::GenericInst);
+	CHECK_EQUAL(0x12u, genericField.GetType().GetTypeReference().Rid);
+
+	std::vector<ElementType> arguments;
+	genericField.GetType().ForEachGenericArgument([&arguments](const TypeSignature& argument) { arguments.push_back(argument.GetElementType()); });
+	CHECK(arguments == (std::vector<ElementType>{ ElementType::I4, ElementType::String }));
+
+	// modreq(TypeRef 0x12) int32
+	std::vector<std::uint8_t> modifiedBlob{ 0x06, 0x1F, 0x49, 0x08 };
+	FieldSignature modifiedField(ToSpan(modifiedBlob));
+	CHECK(modifiedField.GetType().GetElementType() == ElementType::I4);
+
+	std::size_t requiredCount = 0;
+	modifiedField.GetType().ForEachCustomModifier([&requiredCount](bool isRequired, RowReference type)
+	{
+		CHECK(type.Table == TableId::TypeRef);
+		requiredCount += isRequired ? 1 : 0;
+	});
+	CHECK_EQUAL(1u, requiredCount);
+
+	std::vector<std::uint8_t> methodBlob{ 0x00, 0x00, 0x01 };
+	CHECK(!IsFieldSignature(ToSpan(methodBlob)));
+	CHECK_THROWS(FieldSignature(ToSpan(methodBlob)));
+}
+
+TEST(LocalVariableSignatureWithArrayShape)
+{
+	// pinned int32&, int32[5, 0...]
+	std::vector<std::uint8_t> blob{ 0x07, 0x02, 0x45, 0x10, 0x08, 0x14, 0x08, 0x02, 0x01, 0x05, 0x01, 0x00 };
+	LocalVarSignature signature(ToSpan(blob));
+	CHECK_EQUAL(2u, signature.GetLocalCount());
+
+	std::vector<TypeSignature> locals;
+	signature.ForEachLocal([&locals](const TypeSignature& local) { locals.push_back(local); });
+	CHECK(locals[0].GetElementType() == ElementType::Pinned);
+	CHECK(locals[0].GetElementTypeSignature().GetElementType() == ElementType::ByRef);
+	CHECK(locals[1].GetElementType() == ElementType::Array);
+	CHECK_EQUAL(7u, locals[1].GetData().size());
+}
+
+TEST(MalformedSignaturesThrow)
+{
+	// A parameter is missing
+	std::vector<std::uint8_t> truncated{ 0x20, 0x02, 0x01, 0x08 };
+	MethodSignature truncatedSignature(ToSpan(truncated));
+	CHECK_THROWS(GetElementTypes(truncatedSignature));
+
+	// Pointers nested deeper than any compiler emits
+	std::vector<std::uint8_t> deep{ 0x06 };
+	deep.insert(deep.end(), 100, 0x0F);
+	deep.push_back(0x08);
+	CHECK_THROWS(FieldSignature(ToSpan(deep)));
+
+	std::vector<std::uint8_t> invalidElement{ 0x06, 0x17 };
+	CHECK_THROWS(FieldSignature(ToSpan(invalidElement)));
+}
@@ -0,0 +1,168 @@
+#include "stdafx.h"
+#include "../PeBinaryInfoLib/ExportTable.h"
+#include "TestFramework.h"
+#include "TestImage.h"
+
+using namespace peinfo;
+using namespace peinfo::tests;
+
+namespace
+{
+	std::string ToString(Span<const char> text)
+	{
+		return std::string(text.data(), text.size());
+	}
+
+	Span<const char> ToSpan(const char* text)
+	{
+		return Span<const char>(text, std::strlen(text));
+	}
+
+	// test.dll with ordinal base 5: Alpha and alpha at ordinal 5, an unused ordinal 6, Beta at
+	// ordinal 7 forwarded to NTDLL.RtlAllocateHeap and ordinal 8 exported without a name
+	struct ExportFixture
+	{
+		static const DWORD DirectoryRva = 0x1000;
+		static const DWORD DirectorySize = 0x200;
+
+		ExportFixture()
+		{
+			IMAGE_EXPORT_DIRECTORY directory{};
+			directory.Name = 0x1100;
+			directory.Base = 5;
+			directory.NumberOfFunctions = 4;
+			directory.NumberOfNames = 3;
+			directory.AddressOfFunctions = 0x1040;
+			directory.AddressOfNames = 0x1060;
+			directory.AddressOfNameOrdinals = 0x1070;
+			Image.Write(DirectoryRva, directory);
+
+			const DWORD functions[] = { 0x1800, 0, 0x1120, 0x1900 };
+			Image.WriteBytes(0x1040, functions, sizeof(functions));
+
+			// Sorted by bytes, so uppercase names come first
+			const DWORD names[] = { 0x1140, 0x1150, 0x1160 };
+			Image.WriteBytes(0x1060, names, sizeof(names));
+			const WORD nameOrdinals[] = { 0, 2, 0 };
+			Image.WriteBytes(0x1070, nameOrdinals, sizeof(nameOrdinals));
+
+			Image.WriteString(0x1100, "test.dll");
+			Image.WriteString(0x1120, "NTDLL.RtlAllocateHeap");
+			Image.WriteString(0x1140, "Alpha");
+			Image.WriteString(0x1150, "Beta");
+			Image.WriteString(0x1160, "alpha");
+		}
+
+		TestImage Image;
+	};
+}
+
+TEST(ExportTableCountsFunctionsAndForwarders)
+{
+	ExportFixture fixture;
+	auto sectionMap = fixture.Image.GetSectionMap();
+	MemoryPeImage image(fixture.Image.GetBytes());
+	ExportTable exports(image, sectionMap, IMAGE_DATA_DIRECTORY{ ExportFixture::DirectoryRva, ExportFixture::DirectorySize });
+
+	CHECK(!exports.IsEmpty());
+	CHECK(ToString(exports.GetModuleName()) == "test.dll");
+	CHECK_EQUAL(3u, exports.GetFunctionCount());
+	CHECK_EQUAL(1u, exports.GetForwarderCount());
+
+	std::vector<std::string> names;
+	std::vector<DWORD> ordinals;
+	for (auto exported : exports.GetNamedExports())
+	{
+		names.push_back(ToString(exported.Name));
+		ordinals.push_back(exported.Ordinal);
+	}
+
+	CHECK(names == (std::vector<std::string>{ "Alpha", "Beta", "alpha" }));
+	CHECK(ordinals == (std::vector<DWORD>{ 5, 7, 5 }));
+}
+
+TEST(ExportTableFindsNamesByBinarySearch)
+{
+	ExportFixture fixture;
+	auto sectionMap = fixture.Image.GetSectionMap();
+	MemoryPeImage image(fixture.Image.GetBytes());
+	ExportTable exports(image, sectionMap, IMAGE_DATA_DIRECTORY{ ExportFixture::DirectoryRva, ExportFixture::DirectorySize });
+
+	Export exported{};
+	CHECK(exports.TryFindByName(ToSpan("Alpha"), exported));
+	CHECK_EQUAL(5u, exported.Ordinal);
+	CHECK_EQUAL(0x1800u, exported.Rva);
+	CHECK(exported.Forwarder.empty());
+
+	CHECK(exports.TryFindByName(ToSpan("alpha"), exported));
+	CHECK_EQUAL(5u, exported.Ordinal);
+
+	CHECK(exports.TryFindByName(ToSpan("Beta"), exported));
+	CHECK_EQUAL(7u, exported.Ordinal);
+	CHECK_EQUAL(0u, exported.Rva);
+	CHECK(ToString(exported.Forwarder) == "NTDLL.RtlAllocateHeap");
+
+	// Names compare byte by byte, and a prefix is not a match
+	CHECK(!exports.TryFindByName(ToSpan("ALPHA"), exported));
+	CHECK(!exports.TryFindByName(ToSpan("Alph"), exported));
+	CHECK(!exports.TryFindByName(ToSpan("Alphabet"), exported));
+	CHECK(!exports.TryFindByName(ToSpan(""), exported));
+}
+
+TEST(ExportTableFindsOrdinals)
+{
+	ExportFixture fixture;
+	auto sectionMap = fixture.Image.GetSectionMap();
+	MemoryPeImage image(fixture.Image.GetBytes());
+	ExportTable exports(image, sectionMap, IMAGE_DATA_DIRECTORY{ ExportFixture::DirectoryRva, ExportFixture::DirectorySize });
+
+	Export exported{};
+	CHECK(exports.TryFindByOrdinal(8, exported));
+	CHECK_EQUAL(0x1900u, exported.Rva);
+	CHECK(exported.Name.empty());
+
+	CHECK(exports.TryFindByOrdinal(5, exported));
+	CHECK(ToString(exported.Name) == "Alpha");
+
+	CHECK(!exports.TryFindByOrdinal(4, exported));
+	CHECK(!exports.TryFindByOrdinal(6, exported));
+	CHECK(!exports.TryFindByOrdinal(9, exported));
+
+	CHECK(exports.TryFind(ToSpan("#7"), exported));
+	CHECK(ToString(exported.Name) == "Beta");
+	CHECK(exports.TryFind(ToSpan("alpha"), exported));
+	CHECK(!exports.TryFind(ToSpan("#"), exported));
+	CHECK(!exports.TryFind(ToSpan("#7x"), exported));
+	CHECK(!exports.TryFind(ToSpan("#-1"), exported));
+}
+
+TEST(ExportTableWithoutDirectoryIsEmpty)
+{
+	ExportFixture fixture;
+	auto sectionMap = fixture.Image.GetSectionMap();
+	MemoryPeImage image(fixture.Image.GetBytes());
+	ExportTable exports(image, sectionMap, IMAGE_DATA_DIRECTORY{ 0, 0 });
+
+	Export exported{};
+	CHECK(exports.IsEmpty());
+	CHECK(exports.GetModuleName().empty());
+	CHECK_EQUAL(0u, exports.GetFunctionCount());
+	CHECK(exports.GetNamedExports().begin() == exports.GetNamedExports().end());
+	CHECK(!exports.TryFind(ToSpan("Alpha"), exported));
+	CHECK(!exports.TryFind(ToSpan("#5"), exported));
+}
+
+TEST(ExportTableRejectsTablesOutsideOfTheSection)
+{
+	ExportFixture fixture;
+	IMAGE_EXPORT_DIRECTORY directory{};
+	directory.Base = 1;
+	directory.NumberOfFunctions = 0x10000;
+	directory.AddressOfFunctions = 0x1040;
+	fixture.Image.Write(ExportFixture::DirectoryRva, directory);
+
+	auto sectionMap = fixture.Image.GetSectionMap();
+	MemoryPeImage image(fixture.Image.GetBytes());
+	CHECK_THROWS(ExportTable(image, sectionMap, IMAGE_DATA_DIRECTORY{ ExportFixture::DirectoryRva, ExportFixture::DirectorySize }));
+	CHECK_THROWS(ExportTable(image, sectionMap, IMAGE_DATA_DIRECTORY{ 0x8000, ExportFixture::DirectorySize }));
+}
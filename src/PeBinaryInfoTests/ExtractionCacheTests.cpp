@@ -0,0 +1,99 @@
+#include "stdafx.h"
+#include "../PeBinaryInfoLib/ExtractionCache.h"
+#include "TemporaryPath.h"
+#include "TestFramework.h"
+#include "TestInfo.h"
+
+using namespace peinfo;
+using namespace peinfo::tests;
+
+namespace
+{
+	FileIdentity MakeIdentity(std::uint64_t inode)
+	{
+		return FileIdentity{ 0x801, inode, 0x1000 + inode, 1500000000000000000 + inode, 1500000000000000001 + inode };
+	}
+}
+
+TEST(ExtractionCacheRoundTripsEveryKindOfResult)
+{
+	TemporaryPath cachePath(L"cache");
+	auto info = MakeInfo(0x8664, Hardened, L"x64", L"Release");
+	info.Raw.IsClr = true;
+	info.Raw.ClrFlags = 1;
+
+	{
+		ExtractionCache cache(cachePath.Get(), 0);
+		cache.Put(MakeIdentity(1), CachedResult{ CachedResultKind::Extracted, info, std::string() });
+		cache.Put(MakeIdentity(2), CachedResult{ CachedResultKind::Failed, PeFileFormattedInfo(), "Failed to convert RVA" });
+		cache.Put(MakeIdentity(3), CachedResult{ CachedResultKind::NotPe, PeFileFormattedInfo(), std::string() });
+	}
+
+	// Read back by another instance, as the next run would
+	ExtractionCache cache(cachePath.Get(), 0);
+	CachedResult result;
+	CHECK(cache.TryGet(MakeIdentity(1), result));
+	CHECK(result.Kind == CachedResultKind::Extracted);
+	CHECK_EQUAL(2u, result.Info.Categories.size());
+	CHECK(result.Info.Categories[0].Name == L"General");
+	CHECK(result.Info.Categories[0].Items[1].Name == L"Configuration");
+	CHECK(result.Info.Categories[0].Items[1].Value == L"Release");
+	CHECK(result.Info.Categories[1].Items[0].Value.empty());
+	CHECK_EQUAL(0x8664, result.Info.Raw.Machine);
+	CHECK_EQUAL(0x5A000000u, result.Info.Raw.TimeDateStamp);
+	CHECK_EQUAL(0x0E10, result.Info.Raw.LinkerVersion);
+	CHECK_EQUAL(Hardened, result.Info.Raw.DllCharacteristics);
+	CHECK(result.Info.Raw.IsDll);
+	CHECK(result.Info.Raw.IsPe32Plus);
+	CHECK(result.Info.Raw.IsClr);
+	CHECK_EQUAL(1u, result.Info.Raw.ClrFlags);
+	CHECK(result.Info.Raw.BuildConfiguration == BuildConfiguration::Release);
+
+	CHECK(cache.TryGet(MakeIdentity(2), result));
+	CHECK(result.Kind == CachedResultKind::Failed);
+	CHECK(result.Error == "Failed to convert RVA");
+
+	CHECK(cache.TryGet(MakeIdentity(3), result));
+	CHECK(result.Kind == CachedResultKind::NotPe);
+}
+
+TEST(ExtractionCacheMissesChangedFiles)
+{
+	TemporaryPath cachePath(L"cache");
+	ExtractionCache cache(cachePath.Get(), 0);
+	cache.Put(MakeIdentity(1), CachedResult{ CachedResultKind::NotPe, PeFileFormattedInfo(), std::string() });
+
+	CachedResult result;
+	auto identity = MakeIdentity(1);
+	CHECK(cache.TryGet(identity, result));
+
+	// Any field of the identity tells a new version of the file apart
+	identity.ModificationTime += 1;
+	CHECK(!cache.TryGet(identity, result));
+	identity = MakeIdentity(1);
+	identity.ChangeTime += 1;
+	CHECK(!cache.TryGet(identity, result));
+	identity = MakeIdentity(1);
+	identity.Size += 1;
+	CHECK(!cache.TryGet(identity, result));
+	CHECK(!cache.TryGet(MakeIdentity(4), result));
+}
+
+TEST(ExtractionCacheKeepsRecentEntriesWhenItFillsUp)
+{
+	TemporaryPath cachePath(L"cache");
+	ExtractionCache cache(cachePath.Get(), 0);
+
+	// Far more than the smallest cache holds, so it is compacted a few times
+	std::string error(4096, 'e');
+	const std::uint64_t entryCount = 1024;
+	for (std::uint64_t inode = 1; inode <= entryCount; ++inode)
+	{
+		cache.Put(MakeIdentity(inode), CachedResult{ CachedResultKind::Failed, PeFileFormattedInfo(), error });
+	}
+
+	CachedResult result;
+	CHECK(cache.TryGet(MakeIdentity(entryCount), result));
+	CHECK(result.Error == error);
+	CHECK(!cache.TryGet(MakeIdentity(1), result));
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "../PeBinaryInfoLib/ImportTable.h"
+#include "TestImage.h"
+
+namespace peinfo
+{
+	namespace tests
+	{
+		// A PE32 image base 0x400000 that imports CreateFileW and ExitProcess from KERNEL32.dll and
+		// ordinal 115 from WS2_32.dll, delay loads MessageBoxW from user32.dll through a current
+		// descriptor and TextOutW from gdi32.dll through an old one, which holds VAs, and is bound
+		// to KERNEL32.dll, which forwards to ntdll.dll.
+		struct ImportFixture
+		{
+			static const ULONGLONG ImageBase = 0x400000;
+
+			ImportFixture()
+			{
+				IMAGE_IMPORT_DESCRIPTOR kernel32{};
+				kernel32.OriginalFirstThunk = 0x1100;
+				kernel32.Name = 0x1300;
+				kernel32.FirstThunk = 0x1180;
+				Image.Write(0x1000, kernel32);
+
+				// No INT: the names are read from the IAT
+				IMAGE_IMPORT_DESCRIPTOR ws2_32{};
+				ws2_32.Name = 0x1310;
+				ws2_32.FirstThunk = 0x11A0;
+				Image.Write(0x1000 + sizeof(IMAGE_IMPORT_DESCRIPTOR), ws2_32);
+
+				Image.Write(0x1100, DWORD(0x1200));
+				Image.Write(0x1104, DWORD(0x1220));
+				Image.Write(0x11A0, DWORD(IMAGE_ORDINAL_FLAG32 | 115));
+				Image.Write(0x1200, WORD(0xC5));
+				Image.WriteString(0x1202, "CreateFileW");
+				Image.Write(0x1220, WORD(0x120));
+				Image.WriteString(0x1222, "ExitProcess");
+				Image.WriteString(0x1300, "KERNEL32.dll");
+				Image.WriteString(0x1310, "WS2_32.dll");
+
+				IMAGE_DELAYLOAD_DESCRIPTOR user32{};
+				user32.Attributes.AllAttributes = 1;
+				user32.DllNameRVA = 0x1500;
+				user32.ImportNameTableRVA = 0x1480;
+				Image.Write(0x1400, user32);
+
+				IMAGE_DELAYLOAD_DESCRIPTOR gdi32{};
+				gdi32.DllNameRVA = static_cast<DWORD>(ImageBase + 0x1540);
+				gdi32.ImportNameTableRVA = static_cast<DWORD>(ImageBase + 0x14A0);
+				Image.Write(0x1400 + sizeof(IMAGE_DELAYLOAD_DESCRIPTOR), gdi32);
+
+				Image.Write(0x1480, DWORD(0x1520));
+				Image.Write(0x14A0, static_cast<DWORD>(ImageBase + 0x1560));
+				Image.WriteString(0x1500, "user32.dll");
+				Image.WriteString(0x1522, "MessageBoxW");
+				Image.WriteString(0x1540, "gdi32.dll");
+				Image.WriteString(0x1562, "TextOutW");
+
+				IMAGE_BOUND_IMPORT_DESCRIPTOR bound{};
+				bound.TimeDateStamp = 0x5000;
+				bound.OffsetModuleName = 0x20;
+				bound.NumberOfModuleForwarderRefs = 1;
+				Image.Write(0x1600, bound);
+
+				IMAGE_BOUND_FORWARDER_REF forwarder{};
+				forwarder.TimeDateStamp = 0x6000;
+				forwarder.OffsetModuleName = 0x30;
+				Image.Write(0x1600 + sizeof(bound), forwarder);
+				Image.WriteString(0x1620, "KERNEL32.dll");
+				Image.WriteString(0x1630, "ntdll.dll");
+
+				Directories.Imports = IMAGE_DATA_DIRECTORY{ 0x1000, 3 * sizeof(IMAGE_IMPORT_DESCRIPTOR) };
+				Directories.DelayImports = IMAGE_DATA_DIRECTORY{ 0x1400, 3 * sizeof(IMAGE_DELAYLOAD_DESCRIPTOR) };
+				Directories.BoundImports = IMAGE_DATA_DIRECTORY{ 0x1600, 0x40 };
+			}
+
+			TestImage Image;
+			ImportDirectories Directories{};
+		};
+	}
+}
@@ -0,0 +1,148 @@
+#include "stdafx.h"
+#include "../PeBinaryInfoLib/ImportTable.h"
+#include "ImportFixture.h"
+#include "TestFramework.h"
+
+using namespace peinfo;
+using namespace peinfo::tests;
+
+namespace
+{
+	std::string ToString(Span<const char> text)
+	{
+		return std::string(text.data(), text.size());
+	}
+}
+
+TEST(ImportTableReadsImportsByNameAndByOrdinal)
+{
+	ImportFixture fixture;
+	auto sectionMap = fixture.Image.GetSectionMap();
+	MemoryPeImage image(fixture.Image.GetBytes());
+	ImportTable imports(image, sectionMap, fixture.Directories, false, ImportFixture::ImageBase);
+
+	const auto& modules = imports.GetModules();
+	CHECK_EQUAL(4u, modules.size());
+	CHECK_EQUAL(5u, imports.GetFunctionCount());
+
+	CHECK(ToString(modules[0].Name) == "KERNEL32.dll");
+	CHECK(!modules[0].IsDelayLoaded);
+	CHECK_EQUAL(2u, modules[0].Functions.size());
+	CHECK(!modules[0].Functions[0].IsOrdinal);
+	CHECK_EQUAL(0xC5, modules[0].Functions[0].Hint);
+	CHECK(ToString(modules[0].Functions[0].Name) == "CreateFileW");
+	CHECK(ToString(modules[0].Functions[1].Name) == "ExitProcess");
+
+	CHECK(ToString(modules[1].Name) == "WS2_32.dll");
+	CHECK_EQUAL(1u, modules[1].Functions.size());
+	CHECK(modules[1].Functions[0].IsOrdinal);
+	CHECK_EQUAL(115, modules[1].Functions[0].Ordinal);
+}
+
+TEST(ImportTableReadsDelayImportsWithRvasAndVas)
+{
+	ImportFixture fixture;
+	auto sectionMap = fixture.Image.GetSectionMap();
+	MemoryPeImage image(fixture.Image.GetBytes());
+	ImportTable imports(image, sectionMap, fixture.Directories, false, ImportFixture::ImageBase);
+
+	const auto& modules = imports.GetModules();
+	CHECK(ToString(modules[2].Name) == "user32.dll");
+	CHECK(modules[2].IsDelayLoaded);
+	CHECK_EQUAL(1u, modules[2].Functions.size());
+	CHECK(ToString(modules[2].Functions[0].Name) == "MessageBoxW");
+
+	CHECK(ToString(modules[3].Name) == "gdi32.dll");
+	CHECK(modules[3].IsDelayLoaded);
+	CHECK_EQUAL(1u, modules[3].Functions.size());
+	CHECK(ToString(modules[3].Functions[0].Name) == "TextOutW");
+}
+
+TEST(ImportTableReadsBoundImportsAndForwarders)
+{
+	ImportFixture fixture;
+	auto sectionMap = fixture.Image.GetSectionMap();
+	MemoryPeImage image(fixture.Image.GetBytes());
+	ImportTable imports(image, sectionMap, fixture.Directories, false, ImportFixture::ImageBase);
+
+	const auto& boundImports = imports.GetBoundImports();
+	CHECK_EQUAL(2u, boundImports.size());
+	CHECK(ToString(boundImports[0].Name) == "KERNEL32.dll");
+	CHECK_EQUAL(0x5000u, boundImports[0].TimeDateStamp);
+	CHECK(!boundImports[0].IsForwarder);
+	CHECK(ToString(boundImports[1].Name) == "ntdll.dll");
+	CHECK_EQUAL(0x6000u, boundImports[1].TimeDateStamp);
+	CHECK(boundImports[1].IsForwarder);
+}
+
+TEST(ImphashCoversTheImportDirectoryOnly)
+{
+	ImportFixture fixture;
+	auto sectionMap = fixture.Image.GetSectionMap();
+	MemoryPeImage image(fixture.Image.GetBytes());
+	ImportTable imports(image, sectionMap, fixture.Directories, false, ImportFixture::ImageBase);
+
+	// MD5 of "kernel32.createfilew,kernel32.exitprocess,ws2_32.ord115"
+	CHECK(imports.GetImphash() == "d30bd81bdb6633516a95ce237a994ac0");
+	CHECK(ImportTable().GetImphash().empty());
+}
+
+TEST(ImportTableReadsPe32PlusThunks)
+{
+	TestImage testImage;
+	IMAGE_IMPORT_DESCRIPTOR descriptor{};
+	descriptor.OriginalFirstThunk = 0x1100;
+	descriptor.Name = 0x1300;
+	descriptor.FirstThunk = 0x1100;
+	testImage.Write(0x1000, descriptor);
+	testImage.Write(0x1100, ULONGLONG(0x1200));
+	testImage.Write(0x1108, ULONGLONG(IMAGE_ORDINAL_FLAG64 | 7));
+	testImage.WriteString(0x1202, "Sleep");
+	testImage.WriteString(0x1300, "kernel32.dll");
+
+	auto sectionMap = testImage.GetSectionMap();
+	MemoryPeImage image(testImage.GetBytes());
+	ImportDirectories directories{};
+	directories.Imports = IMAGE_DATA_DIRECTORY{ 0x1000, 2 * sizeof(IMAGE_IMPORT_DESCRIPTOR) };
+	ImportTable imports(image, sectionMap, directories, true, 0x140000000);
+
+	CHECK_EQUAL(1u, imports.GetModules().size());
+	const auto& functions = imports.GetModules()[0].Functions;
+	CHECK_EQUAL(2u, functions.size());
+	CHECK(ToString(functions[0].Name) == "Sleep");
+	CHECK(functions[1].IsOrdinal);
+	CHECK_EQUAL(7, functions[1].Ordinal);
+}
+
+TEST(ImportTableRejectsUnterminatedData)
+{
+	// The thunks run to the end of the section
+	TestImage testImage(0x200);
+	IMAGE_IMPORT_DESCRIPTOR descriptor{};
+	descriptor.Name = 0x1100;
+	descriptor.FirstThunk = 0x11F8;
+	testImage.Write(0x1000, descriptor);
+	testImage.WriteString(0x1100, "a.dll");
+	testImage.Write(0x11F8, DWORD(IMAGE_ORDINAL_FLAG32 | 1));
+	testImage.Write(0x11FC, DWORD(IMAGE_ORDINAL_FLAG32 | 2));
+
+	auto sectionMap = testImage.GetSectionMap();
+	MemoryPeImage image(testImage.GetBytes());
+	ImportDirectories directories{};
+	directories.Imports = IMAGE_DATA_DIRECTORY{ 0x1000, 2 * sizeof(IMAGE_IMPORT_DESCRIPTOR) };
+	CHECK_THROWS(ImportTable(image, sectionMap, directories, false, 0x400000));
+
+	// The name runs to the end of the section
+	const char name[8] = { 'b', '.', 'd', 'l', 'l', 'x', 'x', 'x' };
+	testImage.WriteBytes(0x11F8, name, sizeof(name));
+	descriptor.Name = 0x11F8;
+	descriptor.FirstThunk = 0x1100;
+	testImage.Write(0x1000, descriptor);
+	testImage.Write(0x1100, DWORD(0));
+	MemoryPeImage renamedImage(testImage.GetBytes());
+	CHECK_THROWS(ImportTable(renamedImage, sectionMap, directories, false, 0x400000));
+
+	// The descriptor is outside of the image
+	directories.Imports = IMAGE_DATA_DIRECTORY{ 0x5000, sizeof(IMAGE_IMPORT_DESCRIPTOR) };
+	CHECK_THROWS(ImportTable(image, sectionMap, directories, false, 0x400000));
+}
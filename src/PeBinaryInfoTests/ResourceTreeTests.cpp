@@ -0,0 +1,221 @@
+#include "stdafx.h"
+#include "../PeBinaryInfoLib/ResourceTree.h"
+#include "../PeBinaryInfoLib/VersionResource.h"
+#include "TestFramework.h"
+#include "TestImage.h"
+#include "TestVersionInfo.h"
+
+using namespace peinfo;
+using namespace peinfo::tests;
+
+namespace
+{
+	std::u16string ToString(Span<const char16_t> text)
+	{
+		return std::u16string(text.data(), text.size());
+	}
+
+	// A resource directory at 0x1000 with a named type CUSTOM, version resources in German and
+	// English and a manifest. Offsets in the tree are from its start; the data is at 0x1400 and on.
+	struct ResourceFixture
+	{
+		static const DWORD DirectoryRva = 0x1000;
+		static const DWORD DirectorySize = 0x400;
+		static const DWORD ManifestRva = 0x1400;
+		static const DWORD VersionRva = 0x1500;
+
+		ResourceFixture()
+			: VersionInfo(MakeVersionInfo(MakeFixedFileInfo(VS_FFI_SIGNATURE)))
+		{
+			WriteDirectory(0x00, 1, 2);
+			WriteEntry(0x10, IMAGE_RESOURCE_NAME_IS_STRING | 0x300, IMAGE_RESOURCE_DATA_IS_DIRECTORY | 0x100);
+			WriteEntry(0x18, ResourceTypeVersion, IMAGE_RESOURCE_DATA_IS_DIRECTORY | 0x40);
+			WriteEntry(0x20, ResourceTypeManifest, IMAGE_RESOURCE_DATA_IS_DIRECTORY | 0x80);
+
+			WriteDirectory(0x40, 0, 1);
+			WriteEntry(0x50, 1, IMAGE_RESOURCE_DATA_IS_DIRECTORY | 0x60);
+			WriteDirectory(0x60, 0, 2);
+			WriteEntry(0x70, 0x407, 0x210);
+			WriteEntry(0x78, 0x409, 0x220);
+
+			WriteDirectory(0x80, 0, 1);
+			WriteEntry(0x90, 1, IMAGE_RESOURCE_DATA_IS_DIRECTORY | 0xA0);
+			WriteDirectory(0xA0, 0, 1);
+			WriteEntry(0xB0, 0x409, 0x230);
+
+			WriteDirectory(0x100, 0, 1);
+			WriteEntry(0x110, 101, IMAGE_RESOURCE_DATA_IS_DIRECTORY | 0x120);
+			WriteDirectory(0x120, 0, 1);
+			WriteEntry(0x130, 0, 0x200);
+
+			WriteDataEntry(0x200, 0x1480, 4);
+			WriteDataEntry(0x210, VersionRva, static_cast<DWORD>(VersionInfo.size()));
+			WriteDataEntry(0x220, VersionRva, static_cast<DWORD>(VersionInfo.size()));
+			WriteDataEntry(0x230, ManifestRva, 10);
+
+			Image.Write(DirectoryRva + 0x300, WORD(6));
+			Image.WriteBytes(DirectoryRva + 0x302, u"CUSTOM", 6 * sizeof(char16_t));
+
+			Image.WriteString(ManifestRva, "<assembly>");
+			Image.WriteBytes(VersionRva, VersionInfo.data(), VersionInfo.size());
+		}
+
+		void WriteDirectory(DWORD offset, WORD namedEntryCount, WORD idEntryCount)
+		{
+			IMAGE_RESOURCE_DIRECTORY directory{};
+			directory.NumberOfNamedEntries = namedEntryCount;
+			directory.NumberOfIdEntries = idEntryCount;
+			Image.Write(DirectoryRva + offset, directory);
+		}
+
+		void WriteEntry(DWORD offset, DWORD name, DWORD offsetToData)
+		{
+			const DWORD entry[] = { name, offsetToData };
+			Image.WriteBytes(DirectoryRva + offset, entry, sizeof(entry));
+		}
+
+		void WriteDataEntry(DWORD offset, DWORD rva, DWORD size)
+		{
+			IMAGE_RESOURCE_DATA_ENTRY dataEntry{};
+			dataEntry.OffsetToData = rva;
+			dataEntry.Size = size;
+			dataEntry.CodePage = 1252;
+			Image.Write(DirectoryRva + offset, dataEntry);
+		}
+
+		Bytes VersionInfo;
+		TestImage Image;
+	};
+}
+
+TEST(ResourceTreeWalksLeavesDepthFirst)
+{
+	ResourceFixture fixture;
+	auto sectionMap = fixture.Image.GetSectionMap();
+	MemoryPeImage image(fixture.Image.GetBytes());
+	ResourceTree tree(image, sectionMap, IMAGE_DATA_DIRECTORY{ ResourceFixture::DirectoryRva, ResourceFixture::DirectorySize });
+
+	std::vector<Resource> resources;
+	for (const auto& resource : tree.GetResources())
+	{
+		resources.push_back(resource);
+	}
+
+	CHECK_EQUAL(4u, resources.size());
+	CHECK(resources[0].Type.IsName);
+	CHECK(ToString(resources[0].Type.Name) == u"CUSTOM");
+	CHECK_EQUAL(101, resources[0].Name.Id);
+	CHECK_EQUAL(0, resources[0].Language);
+	CHECK_EQUAL(0x1480u, resources[0].DataRva);
+
+	CHECK_EQUAL(ResourceTypeVersion, resources[1].Type.Id);
+	CHECK_EQUAL(0x407, resources[1].Language);
+	CHECK_EQUAL(ResourceTypeVersion, resources[2].Type.Id);
+	CHECK_EQUAL(0x409, resources[2].Language);
+	CHECK_EQUAL(1252u, resources[2].CodePage);
+
+	CHECK_EQUAL(ResourceTypeManifest, resources[3].Type.Id);
+	CHECK(!resources[3].Type.IsName);
+	CHECK_EQUAL(1, resources[3].Name.Id);
+}
+
+TEST(ResourceTreeFindsTypesById)
+{
+	ResourceFixture fixture;
+	auto sectionMap = fixture.Image.GetSectionMap();
+	MemoryPeImage image(fixture.Image.GetBytes());
+	ResourceTree tree(image, sectionMap, IMAGE_DATA_DIRECTORY{ ResourceFixture::DirectoryRva, ResourceFixture::DirectorySize });
+
+	auto root = tree.GetRoot();
+	CHECK_EQUAL(3u, root.GetEntryCount());
+
+	// The named entry is not found by ID
+	ResourceDirectoryEntry entry{};
+	CHECK(root.TryFindEntry(ResourceTypeManifest, entry));
+	CHECK(entry.IsDirectory);
+	CHECK_EQUAL(0x80u, entry.Offset);
+	CHECK(!root.TryFindEntry(0x300, entry));
+	CHECK(!root.TryFindEntry(3, entry));
+
+	// The first language is taken
+	Resource resource{};
+	CHECK(tree.TryFindFirst(ResourceTypeVersion, resource));
+	CHECK_EQUAL(0x407, resource.Language);
+	CHECK(!tree.TryFindFirst(3, resource));
+
+	CHECK(tree.TryFindFirst(ResourceTypeManifest, resource));
+	auto data = tree.GetData(resource);
+	CHECK(std::string(reinterpret_cast<const char*>(data.data()), data.size()) == "<assembly>");
+
+	std::size_t versionCount = 0;
+	for (const auto& version : tree.GetResources(ResourceTypeVersion))
+	{
+		CHECK_EQUAL(ResourceTypeVersion, version.Type.Id);
+		++versionCount;
+	}
+
+	CHECK_EQUAL(2u, versionCount);
+}
+
+TEST(ResourceTreeWithoutDirectoryIsEmpty)
+{
+	ResourceFixture fixture;
+	auto sectionMap = fixture.Image.GetSectionMap();
+	MemoryPeImage image(fixture.Image.GetBytes());
+	ResourceTree tree(image, sectionMap, IMAGE_DATA_DIRECTORY{ 0, 0 });
+
+	Resource resource{};
+	CHECK(tree.IsEmpty());
+	CHECK_EQUAL(0u, tree.GetRoot().GetEntryCount());
+	CHECK(tree.GetResources().begin() == tree.GetResources().end());
+	CHECK(!tree.TryFindFirst(ResourceTypeVersion, resource));
+	CHECK(ResourceTree().GetResources().begin() == ResourceTree().GetResources().end());
+}
+
+TEST(ResourceTreeRejectsMalformedDirectories)
+{
+	// A language entry that points at a directory is one level too deep
+	ResourceFixture deepFixture;
+	deepFixture.WriteEntry(0xB0, 0x409, IMAGE_RESOURCE_DATA_IS_DIRECTORY | 0xA0);
+	auto deepSectionMap = deepFixture.Image.GetSectionMap();
+	MemoryPeImage deepImage(deepFixture.Image.GetBytes());
+	ResourceTree deepTree(deepImage, deepSectionMap, IMAGE_DATA_DIRECTORY{ ResourceFixture::DirectoryRva, ResourceFixture::DirectorySize });
+	Resource resource{};
+	CHECK_THROWS(deepTree.TryFindFirst(ResourceTypeManifest, resource));
+
+	// A type entry that points at data is not deep enough
+	ResourceFixture shallowFixture;
+	shallowFixture.WriteEntry(0x20, ResourceTypeManifest, 0x230);
+	auto shallowSectionMap = shallowFixture.Image.GetSectionMap();
+	MemoryPeImage shallowImage(shallowFixture.Image.GetBytes());
+	ResourceTree shallowTree(shallowImage, shallowSectionMap, IMAGE_DATA_DIRECTORY{ ResourceFixture::DirectoryRva, ResourceFixture::DirectorySize });
+	CHECK_THROWS(shallowTree.TryFindFirst(ResourceTypeManifest, resource));
+
+	// Entries and data that run past the end of the section
+	ResourceFixture outsideFixture;
+	outsideFixture.WriteDirectory(0x80, 0, 0x400);
+	outsideFixture.WriteDataEntry(0x210, ResourceFixture::VersionRva, 0x10000);
+	auto outsideSectionMap = outsideFixture.Image.GetSectionMap();
+	MemoryPeImage outsideImage(outsideFixture.Image.GetBytes());
+	ResourceTree outsideTree(outsideImage, outsideSectionMap, IMAGE_DATA_DIRECTORY{ ResourceFixture::DirectoryRva, ResourceFixture::DirectorySize });
+	CHECK_THROWS(outsideTree.TryFindFirst(ResourceTypeManifest, resource));
+	CHECK(outsideTree.TryFindFirst(ResourceTypeVersion, resource));
+	CHECK_THROWS(outsideTree.GetData(resource));
+}
+
+TEST(ResourceTreeReadsTheVersionResourceInPlace)
+{
+	ResourceFixture fixture;
+	auto sectionMap = fixture.Image.GetSectionMap();
+	MemoryPeImage image(fixture.Image.GetBytes());
+	ResourceTree tree(image, sectionMap, IMAGE_DATA_DIRECTORY{ ResourceFixture::DirectoryRva, ResourceFixture::DirectorySize });
+
+	Resource resource{};
+	CHECK(tree.TryFindFirst(ResourceTypeVersion, resource));
+	auto data = tree.GetData(resource);
+	CHECK(Bytes(data.begin(), data.end()) == fixture.VersionInfo);
+
+	VersionResource version(data);
+	CHECK(version.HasFixedFileInfo());
+	CHECK(ToString(version.GetString(u"CompanyName")) == u"Contoso");
+}
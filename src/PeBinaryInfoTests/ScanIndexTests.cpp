@@ -0,0 +1,119 @@
+#include "stdafx.h"
+#include "../PeBinaryInfoLib/ScanIndex.h"
+#include "TemporaryPath.h"
+#include "TestFramework.h"
+#include "TestInfo.h"
+
+using namespace peinfo;
+using namespace peinfo::tests;
+
+namespace
+{
+	std::string ToString(Span<const char> text)
+	{
+		return std::string(text.data(), text.size());
+	}
+
+	std::vector<FieldPredicate> ParsePredicates(std::initializer_list<const wchar_t*> texts)
+	{
+		std::vector<FieldPredicate> predicates;
+		for (auto text : texts)
+		{
+			FieldPredicate predicate;
+			if (!TryParsePredicate(text, predicate))
+			{
+				throw std::logic_error("Test predicate does not parse");
+			}
+
+			predicates.push_back(predicate);
+		}
+
+		return predicates;
+	}
+
+	std::vector<std::uint64_t> GetRows(const std::vector<std::uint64_t>& words)
+	{
+		std::vector<std::uint64_t> rows;
+		for (std::size_t word = 0; word < words.size(); ++word)
+		{
+			for (std::uint64_t bit = 0; bit < 64; ++bit)
+			{
+				if ((words[word] >> bit) & 1)
+				{
+					rows.push_back(word * 64 + bit);
+				}
+			}
+		}
+
+		return rows;
+	}
+}
+
+TEST(ScanIndexAnswersPredicatesFromItsColumns)
+{
+	TemporaryPath indexPath(L"index");
+	ScanIndexWriter writer;
+	writer.Add(BatchScanResult{ L"/bin/a.dll", true, MakeInfo(0x8664, Hardened, L"x64", L"Release"), std::string() });
+	writer.Add(BatchScanResult{ L"/bin/b.dll", true, MakeInfo(0x14c, 0, L"x86", L"Debug"), std::string() });
+	writer.Add(BatchScanResult{ L"/bin/broken.dll", false, PeFileFormattedInfo(), "Failed to convert RVA" });
+	writer.Add(BatchScanResult{ L"/bin/c.dll", true, MakeInfo(0x14c, Hardened, L"x86", L"Release"), std::string() });
+	writer.Write(indexPath.Get());
+
+	ScanIndex index(indexPath.Get());
+	CHECK_EQUAL(3u, index.GetRowCount());
+	CHECK(ToString(index.GetPath(0)) == "/bin/a.dll");
+	CHECK(ToString(index.GetPath(2)) == "/bin/c.dll");
+
+	CHECK(GetRows(index.Evaluate({})) == (std::vector<std::uint64_t>{ 0, 1, 2 }));
+	CHECK(GetRows(index.Evaluate(ParsePredicates({ L"aslr=yes" }))) == (std::vector<std::uint64_t>{ 0, 2 }));
+	CHECK(GetRows(index.Evaluate(ParsePredicates({ L"machine=i386" }))) == (std::vector<std::uint64_t>{ 1, 2 }));
+	CHECK(GetRows(index.Evaluate(ParsePredicates({ L"machine=i386", L"configuration=release" }))) == (std::vector<std::uint64_t>{ 2 }));
+	CHECK(GetRows(index.Evaluate(ParsePredicates({ L"platform!=x64", L"dep=no" }))) == (std::vector<std::uint64_t>{ 1 }));
+	CHECK(GetRows(index.Evaluate(ParsePredicates({ L"pe32plus=yes", L"timestamp>=1509949440" }))) == (std::vector<std::uint64_t>{ 0 }));
+	CHECK(GetRows(index.Evaluate(ParsePredicates({ L"path~c.dll" }))) == (std::vector<std::uint64_t>{ 2 }));
+	CHECK(GetRows(index.Evaluate(ParsePredicates({ L"framework=net" }))).empty());
+
+	CHECK_THROWS(index.Evaluate(ParsePredicates({ L"unknown=1" })));
+	CHECK_THROWS(index.Evaluate(ParsePredicates({ L"aslr>1" })));
+	CHECK_THROWS(index.Evaluate(ParsePredicates({ L"linker=new" })));
+}
+
+TEST(ScanIndexAppliesItsDelta)
+{
+	TemporaryPath indexPath(L"index");
+	ScanIndexWriter writer;
+	for (int i = 0; i < 3; ++i)
+	{
+		writer.Add(BatchScanResult{ L"/bin/" + std::to_wstring(i) + L".dll", true, MakeInfo(0x14c, 0, L"x86", L"Debug"), std::string() });
+	}
+
+	auto generation = writer.Write(indexPath.Get());
+
+	// 1.dll was rebuilt with ASLR, 2.dll was deleted and 3.dll is new
+	ScanIndexWriter deltaWriter;
+	deltaWriter.Add(BatchScanResult{ L"/bin/1.dll", true, MakeInfo(0x14c, Hardened, L"x86", L"Debug"), std::string() });
+	deltaWriter.Add(BatchScanResult{ L"/bin/3.dll", true, MakeInfo(0x8664, 0, L"x64", L"Debug"), std::string() });
+	deltaWriter.Remove(1);
+	deltaWriter.Remove(2);
+	deltaWriter.WriteDelta(indexPath.Get(), generation, 3);
+
+	ScanIndexWriter outsideWriter;
+	outsideWriter.Remove(3);
+	CHECK_THROWS(outsideWriter.WriteDelta(indexPath.Get(), generation, 3));
+
+	{
+		ScanIndex index(indexPath.Get());
+		CHECK_EQUAL(3u, index.GetRowCount());
+		CHECK(GetRows(index.Evaluate({})) == (std::vector<std::uint64_t>{ 0, 64, 65 }));
+		CHECK(GetRows(index.Evaluate(ParsePredicates({ L"aslr=yes" }))) == (std::vector<std::uint64_t>{ 64 }));
+		CHECK(ToString(index.GetPath(0)) == "/bin/0.dll");
+		CHECK(ToString(index.GetPath(64)) == "/bin/1.dll");
+		CHECK(ToString(index.GetPath(65)) == "/bin/3.dll");
+	}
+
+	// Rewriting the index drops the delta of the old one
+	writer.Write(indexPath.Get());
+	ScanIndex index(indexPath.Get());
+	CHECK_EQUAL(3u, index.GetRowCount());
+	CHECK(GetRows(index.Evaluate({})) == (std::vector<std::uint64_t>{ 0, 1, 2 }));
+}
@@ -0,0 +1,157 @@
+#include "stdafx.h"
+#include "../PeBinaryInfoLib/SectionMap.h"
+#include "TestFramework.h"
+
+using namespace peinfo;
+
+namespace
+{
+	IMAGE_SECTION_HEADER MakeSection(DWORD virtualAddress, DWORD virtualSize, DWORD pointerToRawData, DWORD sizeOfRawData)
+	{
+		IMAGE_SECTION_HEADER section{};
+		section.VirtualAddress = virtualAddress;
+		section.Misc.VirtualSize = virtualSize;
+		section.PointerToRawData = pointerToRawData;
+		section.SizeOfRawData = sizeOfRawData;
+		return section;
+	}
+
+	RvaLookupStatus Lookup(const SectionMap& sectionMap, DWORD rva, DWORD& fileOffset)
+	{
+		fileOffset = 0xFFFFFFFF;
+		return sectionMap.RvaToFileOffset(rva, fileOffset);
+	}
+}
+
+TEST(SectionMapTranslatesHeadersAndSections)
+{
+	IMAGE_SECTION_HEADER sections[] =
+	{
+		MakeSection(0x2000, 0x800, 0x600, 0x800),
+		MakeSection(0x1000, 0x300, 0x400, 0x200)
+	};
+	SectionMap sectionMap(sections, 2, 0x400, 0x200, 0xE00);
+
+	DWORD fileOffset = 0;
+	DWORD availableSize = 0;
+	CHECK(sectionMap.RvaToFileOffset(0x10, fileOffset, availableSize) == RvaLookupStatus::Success);
+	CHECK_EQUAL(0x10u, fileOffset);
+	CHECK_EQUAL(0x3F0u, availableSize);
+
+	CHECK(sectionMap.RvaToFileOffset(0x1010, fileOffset, availableSize) == RvaLookupStatus::Success);
+	CHECK_EQUAL(0x410u, fileOffset);
+	CHECK_EQUAL(0x1F0u, availableSize);
+
+	CHECK(sectionMap.RvaToFileOffset(0x27FF, fileOffset, availableSize) == RvaLookupStatus::Success);
+	CHECK_EQUAL(0xDFFu, fileOffset);
+	CHECK_EQUAL(1u, availableSize);
+
+	// Past the raw data but inside the virtual size, between the sections and past the last one
+	CHECK(Lookup(sectionMap, 0x1200, fileOffset) == RvaLookupStatus::NotInFile);
+	CHECK(Lookup(sectionMap, 0x1800, fileOffset) == RvaLookupStatus::NotMapped);
+	CHECK(Lookup(sectionMap, 0x2800, fileOffset) == RvaLookupStatus::NotMapped);
+	CHECK_EQUAL(0xFFFFFFFFu, fileOffset);
+
+	DWORD sectionSize = 0;
+	CHECK(sectionMap.GetSectionRange(0x2100, fileOffset, sectionSize) == RvaLookupStatus::Success);
+	CHECK_EQUAL(0x600u, fileOffset);
+	CHECK_EQUAL(0x800u, sectionSize);
+}
+
+TEST(SectionMapHandlesZeroRawSize)
+{
+	IMAGE_SECTION_HEADER sections[] =
+	{
+		MakeSection(0x1000, 0x1000, 0x400, 0x200),
+		// .bss: no data in the file
+		MakeSection(0x2000, 0x1000, 0, 0),
+		// raw size without a virtual size is taken as the virtual size
+		MakeSection(0x3000, 0, 0x600, 0x200)
+	};
+	SectionMap sectionMap(sections, 3, 0x400, 0x200, 0x800);
+
+	DWORD fileOffset = 0;
+	CHECK(Lookup(sectionMap, 0x2000, fileOffset) == RvaLookupStatus::NotInFile);
+	CHECK(Lookup(sectionMap, 0x2FFF, fileOffset) == RvaLookupStatus::NotInFile);
+	CHECK(Lookup(sectionMap, 0x3100, fileOffset) == RvaLookupStatus::Success);
+	CHECK_EQUAL(0x700u, fileOffset);
+	CHECK(Lookup(sectionMap, 0x3200, fileOffset) == RvaLookupStatus::NotMapped);
+}
+
+TEST(SectionMapAlignsRawDataLikeTheLoader)
+{
+	// PointerToRawData is rounded down to 512 bytes and the raw size up to the file alignment
+	IMAGE_SECTION_HEADER sections[] = { MakeSection(0x1000, 0x1000, 0x410, 0x100) };
+	SectionMap sectionMap(sections, 1, 0x400, 0x200, 0x1000);
+
+	DWORD fileOffset = 0;
+	CHECK(Lookup(sectionMap, 0x1000, fileOffset) == RvaLookupStatus::Success);
+	CHECK_EQUAL(0x400u, fileOffset);
+	CHECK(Lookup(sectionMap, 0x11FF, fileOffset) == RvaLookupStatus::Success);
+	CHECK(Lookup(sectionMap, 0x1200, fileOffset) == RvaLookupStatus::NotInFile);
+}
+
+TEST(SectionMapReportsTruncatedFiles)
+{
+	IMAGE_SECTION_HEADER sections[] = { MakeSection(0x1000, 0x1000, 0x400, 0x1000) };
+	SectionMap sectionMap(sections, 1, 0x400, 0x200, 0x900);
+
+	DWORD fileOffset = 0;
+	DWORD availableSize = 0;
+	CHECK(sectionMap.RvaToFileOffset(0x1400, fileOffset, availableSize) == RvaLookupStatus::Success);
+	CHECK_EQUAL(0x100u, availableSize);
+	CHECK(Lookup(sectionMap, 0x1500, fileOffset) == RvaLookupStatus::NotInFile);
+
+	// Headers that run past the end of the file are cut to it
+	SectionMap shortFile(sections, 1, 0x400, 0x200, 0x100);
+	CHECK(Lookup(shortFile, 0xFF, fileOffset) == RvaLookupStatus::Success);
+	CHECK(Lookup(shortFile, 0x100, fileOffset) == RvaLookupStatus::NotMapped);
+}
+
+TEST(SectionMapResolvesOverlappingSectionsIndependentlyOfLookupOrder)
+{
+	// The second section starts inside the first one and ends before it
+	IMAGE_SECTION_HEADER sections[] =
+	{
+		MakeSection(0x1000, 0x2000, 0x400, 0x2000),
+		MakeSection(0x2000, 0x800, 0x2400, 0x800)
+	};
+	SectionMap sectionMap(sections, 2, 0x400, 0x200, 0x3000);
+
+	DWORD expected = 0;
+	CHECK(Lookup(SectionMap(sections, 2, 0x400, 0x200, 0x3000), 0x2100, expected) == RvaLookupStatus::Success);
+
+	// The same RVA translates the same way after a lookup in the other section
+	DWORD fileOffset = 0;
+	CHECK(Lookup(sectionMap, 0x1100, fileOffset) == RvaLookupStatus::Success);
+	CHECK_EQUAL(0x500u, fileOffset);
+	CHECK(Lookup(sectionMap, 0x2100, fileOffset) == RvaLookupStatus::Success);
+	CHECK_EQUAL(expected, fileOffset);
+	CHECK(Lookup(sectionMap, 0x1100, fileOffset) == RvaLookupStatus::Success);
+	CHECK(Lookup(sectionMap, 0x2100, fileOffset) == RvaLookupStatus::Success);
+	CHECK_EQUAL(expected, fileOffset);
+
+	// The section that starts later wins where they overlap
+	CHECK_EQUAL(0x2500u, expected);
+}
+
+TEST(SectionMapTranslatesBatches)
+{
+	IMAGE_SECTION_HEADER sections[] = { MakeSection(0x1000, 0x1000, 0x400, 0x200) };
+	SectionMap sectionMap(sections, 1, 0x400, 0x200, 0x600);
+
+	DWORD rvas[] = { 0x1000, 0x1300, 0x5000, 0x20 };
+	DWORD fileOffsets[4] = {};
+	RvaLookupStatus statuses[4] = {};
+	auto translatedCount = sectionMap.RvaToFileOffsets(Span<const DWORD>(rvas, 4), Span<DWORD>(fileOffsets, 4), Span<RvaLookupStatus>(statuses, 4));
+
+	CHECK_EQUAL(2u, translatedCount);
+	CHECK(statuses[0] == RvaLookupStatus::Success);
+	CHECK_EQUAL(0x400u, fileOffsets[0]);
+	CHECK(statuses[1] == RvaLookupStatus::NotInFile);
+	CHECK(statuses[2] == RvaLookupStatus::NotMapped);
+	CHECK(statuses[3] == RvaLookupStatus::Success);
+	CHECK_EQUAL(0x20u, fileOffsets[3]);
+
+	CHECK_THROWS(sectionMap.RvaToFileOffsets(Span<const DWORD>(rvas, 4), Span<DWORD>(fileOffsets, 3), Span<RvaLookupStatus>(statuses, 4)));
+}
@@ -0,0 +1,62 @@
+#include "stdafx.h"
+#include "../PeBinaryInfoLib/SymbolIndex.h"
+#include "ImportFixture.h"
+#include "TemporaryPath.h"
+#include "TestFramework.h"
+
+using namespace peinfo;
+using namespace peinfo::tests;
+
+namespace
+{
+	std::string ToString(Span<const char> text)
+	{
+		return std::string(text.data(), text.size());
+	}
+}
+
+TEST(SymbolIndexFindsImportedFunctionsAndModules)
+{
+	TemporaryPath indexPath(L"symbols");
+	ImportFixture fixture;
+	auto sectionMap = fixture.Image.GetSectionMap();
+	MemoryPeImage image(fixture.Image.GetBytes());
+	ImportTable imports(image, sectionMap, fixture.Directories, false, ImportFixture::ImageBase);
+
+	{
+		SymbolIndexWriter writer;
+		writer.Add(L"/bin/app.exe", imports);
+		writer.Add(L"/bin/empty.exe", ImportTable());
+		writer.Add(L"/bin/other.exe", imports);
+		writer.Write(indexPath.Get());
+	}
+
+	SymbolIndex index(indexPath.Get());
+	CHECK_EQUAL(3u, index.GetFileCount());
+	CHECK(ToString(index.GetPath(1)) == "/bin/empty.exe");
+
+	const std::vector<std::uint32_t> importers{ 0, 2 };
+	CHECK(index.FindFunction("CreateFileW") == importers);
+	CHECK(index.FindFunction("kernel32.dll!ExitProcess") == importers);
+	CHECK(index.FindFunction("KERNEL32.DLL!ExitProcess") == importers);
+	CHECK(index.FindFunction("ws2_32.dll!#115") == importers);
+	CHECK(index.FindFunction("MessageBoxW") == importers);
+	CHECK(index.FindFunction("gdi32.dll!TextOutW") == importers);
+	CHECK(index.FindFunction("createfilew").empty());
+	CHECK(index.FindFunction("user32.dll!CreateFileW").empty());
+
+	CHECK(index.FindModule("KERNEL32") == importers);
+	CHECK(index.FindModule("ws2_32.dll") == importers);
+	CHECK(index.FindModule("kernel").empty());
+	CHECK(index.FindModule("advapi32.dll").empty());
+}
+
+TEST(SymbolIndexRejectsTruncatedFiles)
+{
+	TemporaryPath indexPath(L"symbols");
+	SymbolIndexWriter().Write(indexPath.Get());
+	CHECK_EQUAL(0u, SymbolIndex(indexPath.Get()).GetFileCount());
+
+	std::filesystem::resize_file(std::filesystem::path(indexPath.Get()), 8);
+	CHECK_THROWS(SymbolIndex(indexPath.Get()));
+}
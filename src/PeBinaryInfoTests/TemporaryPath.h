@@ -0,0 +1,45 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+namespace peinfo
+{
+	namespace tests
+	{
+		// A file name in the temporary directory that is unique to the test. The file and the ones
+		// the index formats keep next to it are removed with it.
+		class TemporaryPath
+		{
+		public:
+			explicit TemporaryPath(const wchar_t* name)
+			{
+				auto directory = std::filesystem::temp_directory_path();
+				path_ = (directory / (L"PeBinaryInfoTests-" + std::to_wstring(std::chrono::steady_clock::now().time_since_epoch().count()) + L"-" + name)).wstring();
+				Remove();
+			}
+
+			~TemporaryPath()
+			{
+				Remove();
+			}
+
+			const std::wstring& Get() const
+			{
+				return path_;
+			}
+
+		private:
+			void Remove()
+			{
+				std::error_code error;
+				for (auto suffix : { L"", L".delta", L".lock", L".tmp", L".delta.tmp" })
+				{
+					std::filesystem::remove(std::filesystem::path(path_ + suffix), error);
+				}
+			}
+
+			std::wstring path_;
+		};
+	}
+}
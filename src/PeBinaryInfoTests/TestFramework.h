@@ -0,0 +1,93 @@
+#pragma once
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace peinfo
+{
+	namespace tests
+	{
+		struct TestCase
+		{
+			const char* Name;
+			void (*Function)();
+		};
+
+		// Tests register themselves from static initializers, so the list is created on first use
+		inline std::vector<TestCase>& GetTestCases()
+		{
+			static std::vector<TestCase> testCases;
+			return testCases;
+		}
+
+		struct TestRegistration
+		{
+			TestRegistration(const char* name, void (*function)())
+			{
+				GetTestCases().push_back(TestCase{ name, function });
+			}
+		};
+
+		class TestFailure : public std::runtime_error
+		{
+		public:
+			explicit TestFailure(const std::string& message)
+				: std::runtime_error(message)
+			{
+			}
+		};
+
+		inline void Fail(const char* file, int line, const std::string& message)
+		{
+			std::ostringstream stream;
+			stream << file << "(" << line << "): " << message;
+			throw TestFailure(stream.str());
+		}
+	}
+}
+
+#define TEST(Name) \
+	static void Name(); \
+	static peinfo::tests::TestRegistration Name##Registration(#Name, &Name); \
+	static void Name()
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			peinfo::tests::Fail(__FILE__, __LINE__, "CHECK(" #condition ") failed"); \
+		} \
+	} while (false)
+
+#define CHECK_EQUAL(expected, actual) \
+	do \
+	{ \
+		if (!((expected) == (actual))) \
+		{ \
+			peinfo::tests::Fail(__FILE__, __LINE__, "CHECK_EQUAL(" #expected ", " #actual ") failed"); \
+		} \
+	} while (false)
+
+#define CHECK_THROWS(expression) \
+	do \
+	{ \
+		bool thrown = false; \
+		try \
+		{ \
+			expression; \
+		} \
+		catch (const peinfo::tests::TestFailure&) \
+		{ \
+			throw; \
+		} \
+		catch (const std::exception&) \
+		{ \
+			thrown = true; \
+		} \
+		if (!thrown) \
+		{ \
+			peinfo::tests::Fail(__FILE__, __LINE__, "CHECK_THROWS(" #expression ") did not throw"); \
+		} \
+	} while (false)
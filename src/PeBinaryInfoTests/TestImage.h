@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include "../PeBinaryInfoLib/SectionMap.h"
+
+namespace peinfo
+{
+	namespace tests
+	{
+		// The bytes of an image with a single section, written at RVAs. The section starts at
+		// SectionRva in memory and at SectionFileOffset in the file, after the headers.
+		class TestImage
+		{
+		public:
+			static const DWORD SectionRva = 0x1000;
+			static const DWORD SectionFileOffset = 0x200;
+
+			explicit TestImage(DWORD sectionSize = 0x1000)
+				: bytes_(SectionFileOffset + sectionSize), section_{}
+			{
+				section_.VirtualAddress = SectionRva;
+				section_.Misc.VirtualSize = sectionSize;
+				section_.SizeOfRawData = sectionSize;
+				section_.PointerToRawData = SectionFileOffset;
+			}
+
+			template<class T>
+			void Write(DWORD rva, const T& value)
+			{
+				WriteBytes(rva, &value, sizeof(T));
+			}
+
+			// Writes the text with its terminator
+			void WriteString(DWORD rva, const char* text)
+			{
+				WriteBytes(rva, text, std::strlen(text) + 1);
+			}
+
+			void WriteBytes(DWORD rva, const void* data, std::size_t size)
+			{
+				auto offset = static_cast<std::size_t>(rva - SectionRva) + SectionFileOffset;
+				CheckFixture(rva >= SectionRva && offset + size <= bytes_.size(), "Write is outside of the test section");
+				std::memcpy(bytes_.data() + offset, data, size);
+			}
+
+			SectionMap GetSectionMap() const
+			{
+				return SectionMap(&section_, 1, SectionFileOffset, SectionFileOffset, bytes_.size());
+			}
+
+			Span<const std::uint8_t> GetBytes() const
+			{
+				return Span<const std::uint8_t>(bytes_.data(), bytes_.size());
+			}
+
+		private:
+			static void CheckFixture(bool condition, const char* message)
+			{
+				if (!condition)
+				{
+					throw std::logic_error(message);
+				}
+			}
+
+			std::vector<std::uint8_t> bytes_;
+			IMAGE_SECTION_HEADER section_;
+		};
+	}
+}
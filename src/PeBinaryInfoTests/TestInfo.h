@@ -0,0 +1,27 @@
+#pragma once
+#include "../PeBinaryInfoLib/PeBinaryInfo.h"
+
+namespace peinfo
+{
+	namespace tests
+	{
+		const DWORD Hardened = IMAGE_DLLCHARACTERISTICS_NX_COMPAT | IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE;
+
+		// An extraction result with a General and a CLR category and the raw values of a release DLL
+		inline PeFileFormattedInfo MakeInfo(WORD machine, DWORD dllCharacteristics, const wchar_t* platform, const wchar_t* configuration)
+		{
+			PeFileFormattedInfo info;
+			info.Categories.push_back(PeFileFormattedInfoCategory{ L"General", { { L"Platform", platform }, { L"Configuration", configuration } } });
+			info.Categories.push_back(PeFileFormattedInfoCategory{ L"CLR", { { L"Target Framework", L"" } } });
+			info.Raw.Machine = machine;
+			info.Raw.TimeDateStamp = 0x5A000000;
+			info.Raw.Subsystem = 3;
+			info.Raw.LinkerVersion = 0x0E10;
+			info.Raw.DllCharacteristics = dllCharacteristics;
+			info.Raw.IsDll = true;
+			info.Raw.IsPe32Plus = machine == 0x8664;
+			info.Raw.BuildConfiguration = BuildConfiguration::Release;
+			return info;
+		}
+	}
+}
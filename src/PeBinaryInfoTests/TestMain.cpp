@@ -0,0 +1,26 @@
+// TestMain.cpp : Runs every registered test and returns nonzero when one of them fails.
+//
+
+#include "stdafx.h"
+#include "TestFramework.h"
+
+int main()
+{
+	std::size_t failedCount = 0;
+	for (const auto& testCase : peinfo::tests::GetTestCases())
+	{
+		try
+		{
+			testCase.Function();
+			std::cout << "[ OK ] " << testCase.Name << std::endl;
+		}
+		catch (const std::exception& e)
+		{
+			++failedCount;
+			std::cout << "[FAIL] " << testCase.Name << ": " << e.what() << std::endl;
+		}
+	}
+
+	std::cout << peinfo::tests::GetTestCases().size() - failedCount << " passed, " << failedCount << " failed" << std::endl;
+	return failedCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include <map>
+#include <vector>
+#include "../PeBinaryInfoLib/CliMetadata.h"
+
+namespace peinfo
+{
+	namespace tests
+	{
+		// A metadata root (ECMA-335 II.24.2.1) with the #~, #Strings and #Blob streams. The tests keep
+		// the heaps and the tables small, so every heap index and table index is two bytes wide and
+		// rows are given as their cells in column order.
+		class TestMetadata
+		{
+		public:
+			TestMetadata()
+				: strings_(1, 0), blobs_(1, 0), sorted_(0)
+			{
+			}
+
+			std::uint16_t AddString(const char* text)
+			{
+				auto index = static_cast<std::uint16_t>(strings_.size());
+				strings_.insert(strings_.end(), text, text + std::strlen(text) + 1);
+				return index;
+			}
+
+			std::uint16_t AddBlob(const std::vector<std::uint8_t>& blob)
+			{
+				if (blob.size() >= 0x80)
+				{
+					throw std::logic_error("Test blobs must have a one byte length");
+				}
+
+				auto index = static_cast<std::uint16_t>(blobs_.size());
+				blobs_.push_back(static_cast<std::uint8_t>(blob.size()));
+				blobs_.insert(blobs_.end(), blob.begin(), blob.end());
+				return index;
+			}
+
+			void AddRow(TableId tableId, std::initializer_list<std::uint16_t> cells)
+			{
+				auto& table = tables_[tableId];
+				++table.RowCount;
+				table.Cells.insert(table.Cells.end(), cells);
+			}
+
+			// Claims more rows than were added, as a corrupt image would
+			void SetRowCount(TableId tableId, std::uint32_t rowCount)
+			{
+				tables_[tableId].RowCount = rowCount;
+			}
+
+			void SetSorted(TableId tableId)
+			{
+				sorted_ |= std::uint64_t(1) << static_cast<int>(tableId);
+			}
+
+			std::vector<std::uint8_t> Build() const
+			{
+				std::vector<std::uint8_t> tableStream;
+				std::uint64_t valid = 0;
+				for (const auto& table : tables_)
+				{
+					valid |= std::uint64_t(1) << static_cast<int>(table.first);
+				}
+
+				Append(tableStream, std::uint32_t(0));
+				Append(tableStream, std::uint8_t(2));
+				Append(tableStream, std::uint8_t(0));
+				Append(tableStream, std::uint8_t(0));  // heap indices are two bytes
+				Append(tableStream, std::uint8_t(1));
+				Append(tableStream, valid);
+				Append(tableStream, sorted_);
+				for (const auto& table : tables_)
+				{
+					Append(tableStream, table.second.RowCount);
+				}
+
+				for (const auto& table : tables_)
+				{
+					for (auto cell : table.second.Cells)
+					{
+						Append(tableStream, cell);
+					}
+				}
+
+				const char version[12] = "v4.0.30319";
+				const std::pair<const char*, const std::vector<std::uint8_t>*> streams[] =
+				{
+					{ "#~", &tableStream },
+					{ "#Strings", &strings_ },
+					{ "#Blob", &blobs_ }
+				};
+
+				std::vector<std::uint8_t> metadata;
+				Append(metadata, std::uint32_t(0x424A5342));
+				Append(metadata, std::uint16_t(1));
+				Append(metadata, std::uint16_t(1));
+				Append(metadata, std::uint32_t(0));
+				Append(metadata, std::uint32_t(sizeof(version)));
+				metadata.insert(metadata.end(), version, version + sizeof(version));
+				Append(metadata, std::uint16_t(0));
+				Append(metadata, static_cast<std::uint16_t>(std::size(streams)));
+
+				auto streamOffset = static_cast<std::uint32_t>(metadata.size());
+				for (const auto& stream : streams)
+				{
+					streamOffset += 2 * sizeof(std::uint32_t) + AlignToDword(std::strlen(stream.first) + 1);
+				}
+
+				for (const auto& stream : streams)
+				{
+					auto size = static_cast<std::uint32_t>(AlignToDword(stream.second->size()));
+					Append(metadata, streamOffset);
+					Append(metadata, size);
+					auto nameSize = std::strlen(stream.first);
+					metadata.insert(metadata.end(), stream.first, stream.first + nameSize);
+					metadata.resize(metadata.size() + AlignToDword(nameSize + 1) - nameSize, 0);
+					streamOffset += size;
+				}
+
+				for (const auto& stream : streams)
+				{
+					metadata.insert(metadata.end(), stream.second->begin(), stream.second->end());
+					metadata.resize(AlignToDword(metadata.size()), 0);
+				}
+
+				return metadata;
+			}
+
+		private:
+			struct TableRows
+			{
+				std::uint32_t RowCount = 0;
+				std::vector<std::uint16_t> Cells;
+			};
+
+			template<class T>
+			static void Append(std::vector<std::uint8_t>& bytes, T value)
+			{
+				auto data = reinterpret_cast<const std::uint8_t*>(&value);
+				bytes.insert(bytes.end(), data, data + sizeof(T));
+			}
+
+			static std::size_t AlignToDword(std::size_t size)
+			{
+				return (size + 3) & ~static_cast<std::size_t>(3);
+			}
+
+			std::vector<std::uint8_t> strings_;
+			std::vector<std::uint8_t> blobs_;
+			std::map<TableId, TableRows> tables_;
+			std::uint64_t sorted_;
+		};
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "../PeBinaryInfoLib/Helpers.h"
+
+namespace peinfo
+{
+	namespace tests
+	{
+		// Builders for VS_VERSIONINFO resources and their String, StringTable and VarFileInfo blocks
+		typedef std::vector<std::uint8_t> Bytes;
+
+		inline void Append(Bytes& bytes, const void* data, std::size_t size)
+		{
+			auto first = static_cast<const std::uint8_t*>(data);
+			bytes.insert(bytes.end(), first, first + size);
+		}
+
+		inline void AlignToDword(Bytes& bytes)
+		{
+			bytes.resize((bytes.size() + 3) & ~static_cast<std::size_t>(3));
+		}
+
+		// A version block: the header, the key, the value and the children, each of the last three
+		// aligned to a DWORD. The length does not count the padding after the last child.
+		inline Bytes MakeBlock(const std::u16string& key, const Bytes& value, WORD valueLength, WORD type, const std::vector<Bytes>& children)
+		{
+			Bytes block(3 * sizeof(WORD));
+			Append(block, key.c_str(), (key.size() + 1) * sizeof(char16_t));
+			AlignToDword(block);
+			Append(block, value.data(), value.size());
+			for (const auto& child : children)
+			{
+				AlignToDword(block);
+				Append(block, child.data(), child.size());
+			}
+
+			WORD header[] = { static_cast<WORD>(block.size()), valueLength, type };
+			std::memcpy(block.data(), header, sizeof(header));
+			return block;
+		}
+
+		inline Bytes MakeString(const std::u16string& key, const std::u16string& value)
+		{
+			Bytes text;
+			Append(text, value.c_str(), (value.size() + 1) * sizeof(char16_t));
+			return MakeBlock(key, text, static_cast<WORD>(value.size() + 1), 1, {});
+		}
+
+		inline Bytes MakeFixedFileInfo(DWORD signature)
+		{
+			VS_FIXEDFILEINFO fixedFileInfo{};
+			fixedFileInfo.dwSignature = signature;
+			fixedFileInfo.dwStrucVersion = 0x10000;
+			fixedFileInfo.dwFileVersionMS = 0x10002;
+			fixedFileInfo.dwFileVersionLS = 0x30004;
+			Bytes bytes;
+			Append(bytes, &fixedFileInfo, sizeof(fixedFileInfo));
+			return bytes;
+		}
+
+		// English strings first, then German ones, which are not read
+		inline Bytes MakeVersionInfo(const Bytes& fixedFileInfo)
+		{
+			auto english = MakeBlock(u"040904b0", {}, 0, 1,
+			{
+				MakeString(u"CompanyName", u"Contoso"),
+				MakeString(u"ProductVersion", u"1.2.3.4")
+			});
+			auto german = MakeBlock(u"040704b0", {}, 0, 1, { MakeString(u"CompanyName", u"Contoso GmbH") });
+
+			DWORD translation = 0x04b00409;
+			Bytes translationValue;
+			Append(translationValue, &translation, sizeof(translation));
+			auto varFileInfo = MakeBlock(u"VarFileInfo", {}, 0, 1, { MakeBlock(u"Translation", translationValue, sizeof(translation), 0, {}) });
+
+			return MakeBlock(u"VS_VERSION_INFO", fixedFileInfo, static_cast<WORD>(fixedFileInfo.size()), 0,
+			{
+				MakeBlock(u"StringFileInfo", {}, 0, 1, { english, german }),
+				varFileInfo
+			});
+		}
+
+		inline Span<const std::uint8_t> ToSpan(const Bytes& bytes)
+		{
+			return Span<const std::uint8_t>(bytes.data(), bytes.size());
+		}
+	}
+}
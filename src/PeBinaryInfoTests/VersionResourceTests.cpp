@@ -0,0 +1,110 @@
+#include "stdafx.h"
+#include "../PeBinaryInfoLib/VersionResource.h"
+#include "TestFramework.h"
+#include "TestVersionInfo.h"
+
+using namespace peinfo;
+using namespace peinfo::tests;
+
+namespace
+{
+	std::u16string ToString(Span<const char16_t> text)
+	{
+		return std::u16string(text.data(), text.size());
+	}
+}
+
+TEST(VersionResourceReadsFixedFileInfoAndFirstStringTable)
+{
+	auto versionInfo = MakeVersionInfo(MakeFixedFileInfo(VS_FFI_SIGNATURE));
+	VersionResource version(ToSpan(versionInfo));
+
+	CHECK(version.HasFixedFileInfo());
+	CHECK_EQUAL(0x10002u, version.GetFixedFileInfo().dwFileVersionMS);
+	CHECK_EQUAL(0x30004u, version.GetFixedFileInfo().dwFileVersionLS);
+
+	CHECK_EQUAL(2u, version.GetStrings().size());
+	CHECK(ToString(version.GetStrings()[1].Key) == u"ProductVersion");
+	CHECK(ToString(version.GetString(u"CompanyName")) == u"Contoso");
+	CHECK(ToString(version.GetString(u"ProductVersion")) == u"1.2.3.4");
+	CHECK(version.GetString(u"Company").empty());
+	CHECK(version.GetString(u"CompanyNameX").empty());
+}
+
+TEST(VersionResourceReadsStringsWhateverTheirValueLength)
+{
+	// Value lengths in bytes and no value length at all are both common
+	auto table = MakeBlock(u"040904b0", {}, 0, 1,
+	{
+		MakeBlock(u"FileDescription", Bytes{ 'T', 0, 'o', 0, 'o', 0, 'l', 0, 0, 0 }, 10, 1, {}),
+		MakeBlock(u"InternalName", Bytes{ 't', 0, 'o', 0, 'o', 0, 'l', 0, 0, 0 }, 0, 1, {}),
+		MakeString(u"Comments", u"")
+	});
+	auto versionInfo = MakeBlock(u"VS_VERSION_INFO", {}, 0, 0, { MakeBlock(u"StringFileInfo", {}, 0, 1, { table }) });
+	VersionResource version(ToSpan(versionInfo));
+
+	CHECK(!version.HasFixedFileInfo());
+	CHECK_EQUAL(3u, version.GetStrings().size());
+	CHECK(ToString(version.GetString(u"FileDescription")) == u"Tool");
+	CHECK(ToString(version.GetString(u"InternalName")) == u"tool");
+	CHECK(version.GetString(u"Comments").empty());
+}
+
+TEST(VersionResourceChecksTheFixedFileInfoSignature)
+{
+	auto versionInfo = MakeVersionInfo(MakeFixedFileInfo(0xFEEF04BE));
+	VersionResource version(ToSpan(versionInfo));
+
+	CHECK(!version.HasFixedFileInfo());
+	CHECK(ToString(version.GetString(u"CompanyName")) == u"Contoso");
+
+	// A value shorter than a VS_FIXEDFILEINFO is ignored
+	auto shortInfo = MakeFixedFileInfo(VS_FFI_SIGNATURE);
+	shortInfo.resize(sizeof(VS_FIXEDFILEINFO) - 4);
+	CHECK(!VersionResource(ToSpan(MakeVersionInfo(shortInfo))).HasFixedFileInfo());
+}
+
+TEST(VersionResourceRejectsMalformedBlocks)
+{
+	auto versionInfo = MakeVersionInfo(MakeFixedFileInfo(VS_FFI_SIGNATURE));
+
+	// Shorter than a block header, and shorter than the root block says
+	CHECK_THROWS(VersionResource(Span<const std::uint8_t>(versionInfo.data(), 4)));
+	CHECK_THROWS(VersionResource(Span<const std::uint8_t>(versionInfo.data(), versionInfo.size() - 2)));
+
+	// A length shorter than the header
+	auto shortLength = versionInfo;
+	shortLength[0] = 4;
+	shortLength[1] = 0;
+	CHECK_THROWS(VersionResource(ToSpan(shortLength)));
+
+	// A key without its terminator inside the block
+	auto unterminated = MakeBlock(u"VS_VERSION_INFO", {}, 0, 0, {});
+	unterminated.resize(unterminated.size() - 4);
+	unterminated[0] = static_cast<std::uint8_t>(unterminated.size());
+	CHECK_THROWS(VersionResource(ToSpan(unterminated)));
+
+	CHECK_THROWS(VersionResource(ToSpan(MakeBlock(u"VS_VERSION_INF", {}, 0, 0, {}))));
+	CHECK_THROWS(VersionResource(ToSpan(MakeBlock(u"VS_VERSION_INFOX", {}, 0, 0, {}))));
+
+	// A child that runs past its parent
+	auto string = MakeString(u"CompanyName", u"Contoso");
+	auto table = MakeBlock(u"040904b0", {}, 0, 1, { string });
+	auto versionWithLongChild = MakeBlock(u"VS_VERSION_INFO", {}, 0, 0, { MakeBlock(u"StringFileInfo", {}, 0, 1, { table }) });
+	auto stringOffset = versionWithLongChild.size() - string.size();
+	versionWithLongChild[stringOffset] = static_cast<std::uint8_t>(string.size() + 8);
+	CHECK_THROWS(VersionResource(ToSpan(versionWithLongChild)));
+}
+
+TEST(Utf16ToWStringKeepsSupplementaryCharacters)
+{
+	const char16_t text[] = { u'a', 0xD83D, 0xDE00, u'b' };
+	CHECK(Utf16ToWString(Span<const char16_t>(text, 4)) == L"a\U0001F600b");
+
+	// Unpaired surrogates are kept as they are
+	const char16_t unpaired[] = { 0xDE00, 0xD83D };
+	auto converted = Utf16ToWString(Span<const char16_t>(unpaired, 2));
+	CHECK_EQUAL(2u, converted.size());
+	CHECK_EQUAL(0xDE00u, static_cast<unsigned>(converted[0]));
+	CHECK_EQUAL(0xD83Du, static_cast<unsigned>(converted[1]));
+}
@@ -0,0 +1,9 @@
+// stdafx.h : include file for standard system include files,
+// or project specific include files that are used frequently, but
+// are changed infrequently
+//
+
+#pragma once
+
+// The tests include the library's headers, which expect its standard and platform headers
+#include "../PeBinaryInfoLib/stdafx.h"